@@ -0,0 +1,310 @@
+// Example : decision tree categorical split evaluation with node masks
+// usage: prog training_data_file testing_data_file
+
+// For use with test / training datasets : dt_example1
+
+// Trains the (all categorical) tree of decisiontree.cpp and compares the
+// speed of CvDTree::predict(), the flattened tree of tools/flat_dtree.h
+// (one cat_map search per categorical split) and the flattened tree with the
+// categorical columns dictionary encoded once per sample and each split
+// decided by one bit of a 64-bit node mask - checking all three classify
+// the testing set identically.
+
+// Author : Toby Breckon, toby.breckon@cranfield.ac.uk
+
+// Copyright (c) 2010 School of Engineering, Cranfield University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+
+#include "../tools/flat_dtree.h"
+
+/******************************************************************************/
+// global definitions (for speed and ease of use)
+
+#define NUMBER_OF_TRAINING_SAMPLES 1383
+#define ATTRIBUTES_PER_SAMPLE 6  // not the last as this is the class
+#define NUMBER_OF_TESTING_SAMPLES 345
+
+#define NUMBER_OF_CLASSES 4 // classes 0->3
+static char* CLASSES[NUMBER_OF_CLASSES] =
+{(char *) "unacc", (char *) "acc", (char *) "good", (char *) "vgood"};
+
+#define NUMBER_OF_TIMING_PASSES 1000 // passes over the testing set when timing
+
+/******************************************************************************/
+
+// a basic hash function from: http://www.cse.yorku.ca/~oz/hash.html
+
+int hash(char *str)
+{
+    int hash = 5381;
+    int c;
+
+    while ((c = (*str++)))
+    {
+        hash = ((hash << 5) + hash) + c;
+    }
+
+    return hash;
+}
+
+/******************************************************************************/
+
+// loads the sample database from file (which is a CSV text file)
+
+int read_data_from_csv(const char* filename, Mat data, Mat classes,
+                       int n_samples )
+{
+    char tmp_buf[10];
+    int i = 0;
+    char c;
+
+    // if we can't read the input file then return 0
+    FILE* f = fopen( filename, "r" );
+    if( !f )
+    {
+        printf("ERROR: cannot read file %s\n",  filename);
+        return 0; // all not OK
+    }
+
+    // for each sample in the file
+
+    for(int line = 0; line < n_samples; line++)
+    {
+
+        // for each attribute on the line in the file
+
+        for(int attribute = 0; attribute < (ATTRIBUTES_PER_SAMPLE + 1); attribute++)
+        {
+            // last attribute is the class
+
+            if (attribute == 6)
+            {
+                c = '\0';
+                for(i=0; c != '\n'; i++)
+                {
+                    c = fgetc(f);
+                    tmp_buf[i] = c;
+                }
+                tmp_buf[i - 1] = '\0';
+                //printf("%s\n", tmp_buf);
+
+                // find the class number and record this
+
+                for (int i = 0; i < NUMBER_OF_CLASSES; i++)
+                {
+                    if (strcmp(CLASSES[i], tmp_buf) == 0)
+                    {
+                        classes.at<float>(line, 0) = (float) i;
+                    }
+                }
+            }
+            else
+            {
+
+                // for all other attributes just read in the string value
+                // and use a hash function to convert to to a float
+                // (N.B. openCV uses a floating point decision tree implementation!)
+
+                c = '\0';
+                for(i=0; c != ','; i++)
+                {
+                    c = fgetc(f);
+                    tmp_buf[i] = c;
+                }
+                tmp_buf[i - 1] = '\0';
+                data.at<float>(line, attribute) = (float) hash(tmp_buf);
+
+                //printf("%s,", tmp_buf);
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 1; // all OK
+}
+
+/******************************************************************************/
+
+int main( int argc, char** argv )
+{
+    // lets just check the version first
+
+    printf ("OpenCV version %s (%d.%d.%d)\n",
+            CV_VERSION,
+            CV_MAJOR_VERSION, CV_MINOR_VERSION, CV_SUBMINOR_VERSION);
+
+    // define training data storage matrices (one for attribute examples, one
+    // for classifications)
+
+    Mat training_data = Mat(NUMBER_OF_TRAINING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat training_classifications = Mat(NUMBER_OF_TRAINING_SAMPLES, 1, CV_32FC1);
+
+    //define testing data storage matrices
+
+    Mat testing_data = Mat(NUMBER_OF_TESTING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat testing_classifications = Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    // define all the attributes as categorical (i.e. categories) as is the
+    // output (classification problem)
+
+    Mat var_type = Mat(ATTRIBUTES_PER_SAMPLE + 1, 1, CV_8U );
+    var_type = Scalar(CV_VAR_CATEGORICAL); // all inputs are categorical
+
+    // load training and testing data sets
+
+    if ((argc == 3) &&
+            read_data_from_csv(argv[1], training_data, training_classifications, NUMBER_OF_TRAINING_SAMPLES) &&
+            read_data_from_csv(argv[2], testing_data, testing_classifications, NUMBER_OF_TESTING_SAMPLES))
+    {
+        // define the parameters for training the decision tree (as
+        // decisiontree.cpp)
+
+        float priors[] = { 1, 1, 1, 1 }; // weights of each classification for classes
+
+        CvDTreeParams params = CvDTreeParams(25, // max depth
+                                             10, // min sample count
+                                             0, // regression accuracy: N/A here
+                                             false, // compute surrogate split, no missing data
+                                             25, // max number of categories (use sub-optimal algorithm for larger numbers)
+                                             10, // the number of cross-validation folds
+                                             true, // use 1SE rule => smaller tree
+                                             false, // throw away the pruned tree branches
+                                             priors // the array of priors
+                                            );
+
+        printf( "\nUsing training database: %s\n", argv[1]);
+        printf( "Using testing database: %s\n\n", argv[2]);
+
+        // train decision tree classifier (using training data)
+
+        CvDTree* dtree = new CvDTree;
+
+        dtree->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                     Mat(), Mat(), var_type, Mat(), params);
+
+        // flatten it (compiling the categorical node masks)
+
+        FlatDTree ftree;
+        ftree.build(dtree);
+
+        printf( "Tree: %d nodes, depth %d, categorical node masks %s\n\n",
+                ftree.get_node_count(), ftree.get_depth(),
+                ftree.has_cat_masks() ? "used" : "NOT used (> 64 categories)");
+
+        // all three must classify the testing set identically
+
+        Mat flat_results, encoded_results, codes;
+        ftree.predict(testing_data, flat_results);
+        ftree.encode(testing_data, codes);
+        ftree.predict_encoded(testing_data, codes, encoded_results);
+
+        int correct_class = 0;
+        int mismatches = 0;
+
+        for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+        {
+            double result = dtree->predict(testing_data.row(tsample), Mat(), false)->value;
+
+            if ((result != flat_results.at<double>(tsample, 0))
+                    || (result != encoded_results.at<double>(tsample, 0)))
+            {
+                mismatches++;
+            }
+            if (fabs(result - testing_classifications.at<float>(tsample, 0)) < FLT_EPSILON)
+            {
+                correct_class++;
+            }
+        }
+
+        printf( "Test set: correct classification %d (%g%%), mismatches %d\n\n",
+                correct_class, (double) correct_class*100/NUMBER_OF_TESTING_SAMPLES,
+                mismatches);
+
+        // time each over repeated passes of the testing set
+
+        int n_predictions = NUMBER_OF_TIMING_PASSES * NUMBER_OF_TESTING_SAMPLES;
+        double sum = 0; // (so the predictions are not optimised away)
+
+        int64 start = getTickCount();
+        for (int pass = 0; pass < NUMBER_OF_TIMING_PASSES; pass++)
+        {
+            for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+            {
+                sum += dtree->predict(testing_data.row(tsample), Mat(), false)->value;
+            }
+        }
+        double dtree_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        start = getTickCount();
+        for (int pass = 0; pass < NUMBER_OF_TIMING_PASSES; pass++)
+        {
+            for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+            {
+                sum += ftree.predict(testing_data.ptr<float>(tsample));
+            }
+        }
+        double flat_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        // encoding each sample then predicting
+
+        std::vector<int> sample_codes(ATTRIBUTES_PER_SAMPLE);
+
+        start = getTickCount();
+        for (int pass = 0; pass < NUMBER_OF_TIMING_PASSES; pass++)
+        {
+            for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+            {
+                const float* sample = testing_data.ptr<float>(tsample);
+                ftree.encode(sample, &sample_codes[0]);
+                sum += ftree.predict_encoded(sample, &sample_codes[0]);
+            }
+        }
+        double encode_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        // predicting from samples encoded in advance
+
+        start = getTickCount();
+        for (int pass = 0; pass < NUMBER_OF_TIMING_PASSES; pass++)
+        {
+            for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+            {
+                sum += ftree.predict_encoded(testing_data.ptr<float>(tsample),
+                                             codes.ptr<int>(tsample));
+            }
+        }
+        double encoded_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        printf( "Prediction time (%d predictions, checksum %g):\n"
+                "\tCvDTree::predict(): %g s (%g samples/s)\n"
+                "\tflattened (cat_map search per split): %g s (%g samples/s, x%g)\n"
+                "\tflattened (encode + node masks): %g s (%g samples/s, x%g)\n"
+                "\tflattened (pre-encoded, node masks only): %g s (%g samples/s, x%g)\n",
+                n_predictions, sum,
+                dtree_time, n_predictions / dtree_time,
+                flat_time, n_predictions / flat_time, dtree_time / flat_time,
+                encode_time, n_predictions / encode_time, dtree_time / encode_time,
+                encoded_time, n_predictions / encoded_time, dtree_time / encoded_time);
+
+        delete dtree;
+
+        // all matrix memory free by destructors
+
+        // all OK : main returns 0 (unless the predictors disagree)
+
+        return (mismatches == 0) ? 0 : -1;
+    }
+
+    // not OK : main returns -1
+
+    printf("usage: %s training_data_file testing_data_file\n", argv[0]);
+    return -1;
+}
+/******************************************************************************/
@@ -0,0 +1,265 @@
+// Example : decision tree learning with parallel cross validation pruning
+// usage: prog training_data_file testing_data_file
+
+// For use with test / training datasets : dt_example1
+
+// Trains the tree of decisiontree.cpp (10 fold cross validation pruning with
+// the 1SE rule) with CvDTree and with ParallelCvDTree (tools/parallel_cv_dtree.h)
+// which prunes the folds concurrently, checks that both choose the same pruned
+// tree and reports the wall time of each phase of the training.
+
+// Author : Toby Breckon, toby.breckon@cranfield.ac.uk
+
+// Copyright (c) 2010 School of Engineering, Cranfield University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+
+#include "../tools/parallel_cv_dtree.h"
+
+/******************************************************************************/
+// global definitions (for speed and ease of use)
+
+#define NUMBER_OF_TRAINING_SAMPLES 1383
+#define ATTRIBUTES_PER_SAMPLE 6  // not the last as this is the class
+#define NUMBER_OF_TESTING_SAMPLES 345
+
+#define NUMBER_OF_CLASSES 4 // classes 0->3
+
+#define CV_FOLDS_SEED 0x12345678 // seed of the cross validation fold assignment
+static char* CLASSES[NUMBER_OF_CLASSES] =
+{(char *) "unacc", (char *) "acc", (char *) "good", (char *) "vgood"};
+
+/******************************************************************************/
+
+// a basic hash function from: http://www.cse.yorku.ca/~oz/hash.html
+
+int hash(char *str)
+{
+    int hash = 5381;
+    int c;
+
+    while ((c = (*str++)))
+    {
+        hash = ((hash << 5) + hash) + c;
+    }
+
+    return hash;
+}
+
+/******************************************************************************/
+
+// loads the sample database from file (which is a CSV text file)
+
+int read_data_from_csv(const char* filename, Mat data, Mat classes,
+                       int n_samples )
+{
+    char tmp_buf[10];
+    int i = 0;
+    char c;
+
+    // if we can't read the input file then return 0
+    FILE* f = fopen( filename, "r" );
+    if( !f )
+    {
+        printf("ERROR: cannot read file %s\n",  filename);
+        return 0; // all not OK
+    }
+
+    // for each sample in the file
+
+    for(int line = 0; line < n_samples; line++)
+    {
+
+        // for each attribute on the line in the file
+
+        for(int attribute = 0; attribute < (ATTRIBUTES_PER_SAMPLE + 1); attribute++)
+        {
+            // last attribute is the class
+
+            if (attribute == 6)
+            {
+                c = '\0';
+                for(i=0; c != '\n'; i++)
+                {
+                    c = fgetc(f);
+                    tmp_buf[i] = c;
+                }
+                tmp_buf[i - 1] = '\0';
+                //printf("%s\n", tmp_buf);
+
+                // find the class number and record this
+
+                for (int i = 0; i < NUMBER_OF_CLASSES; i++)
+                {
+                    if (strcmp(CLASSES[i], tmp_buf) == 0)
+                    {
+                        classes.at<float>(line, 0) = (float) i;
+                    }
+                }
+            }
+            else
+            {
+
+                // for all other attributes just read in the string value
+                // and use a hash function to convert to to a float
+                // (N.B. openCV uses a floating point decision tree implementation!)
+
+                c = '\0';
+                for(i=0; c != ','; i++)
+                {
+                    c = fgetc(f);
+                    tmp_buf[i] = c;
+                }
+                tmp_buf[i - 1] = '\0';
+                data.at<float>(line, attribute) = (float) hash(tmp_buf);
+
+                //printf("%s,", tmp_buf);
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 1; // all OK
+}
+
+/******************************************************************************/
+
+int main( int argc, char** argv )
+{
+    // lets just check the version first
+
+    printf ("OpenCV version %s (%d.%d.%d)\n",
+            CV_VERSION,
+            CV_MAJOR_VERSION, CV_MINOR_VERSION, CV_SUBMINOR_VERSION);
+
+    // define training data storage matrices (one for attribute examples, one
+    // for classifications)
+
+    Mat training_data = Mat(NUMBER_OF_TRAINING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat training_classifications = Mat(NUMBER_OF_TRAINING_SAMPLES, 1, CV_32FC1);
+
+    //define testing data storage matrices
+
+    Mat testing_data = Mat(NUMBER_OF_TESTING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat testing_classifications = Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    // define all the attributes as categorical (i.e. categories) as is the
+    // output (classification problem)
+
+    Mat var_type = Mat(ATTRIBUTES_PER_SAMPLE + 1, 1, CV_8U );
+    var_type = Scalar(CV_VAR_CATEGORICAL); // all inputs are categorical
+
+    // load training and testing data sets
+
+    if ((argc == 3) &&
+            read_data_from_csv(argv[1], training_data, training_classifications, NUMBER_OF_TRAINING_SAMPLES) &&
+            read_data_from_csv(argv[2], testing_data, testing_classifications, NUMBER_OF_TESTING_SAMPLES))
+    {
+        // define the parameters for training the decision tree (as
+        // decisiontree.cpp)
+
+        float priors[] = { 1, 1, 1, 1 }; // weights of each classification for classes
+
+        CvDTreeParams params = CvDTreeParams(25, // max depth
+                                             10, // min sample count
+                                             0, // regression accuracy: N/A here
+                                             false, // compute surrogate split, no missing data
+                                             25, // max number of categories (use sub-optimal algorithm for larger numbers)
+                                             10, // the number of cross-validation folds
+                                             true, // use 1SE rule => smaller tree
+                                             false, // throw away the pruned tree branches
+                                             priors // the array of priors
+                                            );
+
+        printf( "\nUsing training database: %s\n", argv[1]);
+        printf( "Using testing database: %s\n\n", argv[2]);
+
+        // train with CvDTree (folds pruned serially)
+
+        CvDTree* dtree = new CvDTree;
+
+        // (both trainers assign the samples to folds at random from theRNG(),
+        // so reset it to the same seed before each to use the same folds)
+
+        theRNG() = RNG(CV_FOLDS_SEED);
+
+        int64 start = getTickCount();
+        dtree->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                     Mat(), Mat(), var_type, Mat(), params);
+        double dtree_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        // train with ParallelCvDTree (folds pruned in parallel)
+
+        ParallelCvDTree* ptree = new ParallelCvDTree;
+
+        theRNG() = RNG(CV_FOLDS_SEED);
+
+        start = getTickCount();
+        ptree->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                     Mat(), Mat(), var_type, Mat(), params);
+        double ptree_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        // both must choose the same pruned tree and so classify identically
+
+        int correct_class = 0;
+        int mismatches = 0;
+
+        for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+        {
+            double result = ptree->predict(testing_data.row(tsample), Mat(), false)->value;
+
+            if (result != dtree->predict(testing_data.row(tsample), Mat(), false)->value)
+            {
+                mismatches++;
+            }
+            if (fabs(result - testing_classifications.at<float>(tsample, 0)) < FLT_EPSILON)
+            {
+                correct_class++;
+            }
+        }
+
+        printf( "Pruned tree index: CvDTree %d, ParallelCvDTree %d (%s)\n",
+                dtree->get_pruned_tree_idx(), ptree->get_pruned_tree_idx(),
+                (dtree->get_pruned_tree_idx() == ptree->get_pruned_tree_idx())
+                ? "identical" : "DIFFERENT");
+        printf( "Test set: correct classification %d (%g%%), mismatches %d\n\n",
+                correct_class, (double) correct_class*100/NUMBER_OF_TESTING_SAMPLES,
+                mismatches);
+
+        printf( "Wall time (%d threads):\n"
+                "\tCvDTree training: %g s\n"
+                "\tParallelCvDTree training: %g s (x%g)\n"
+                "\t\tdata preparation: %g s\n"
+                "\t\ttree growing: %g s\n"
+                "\t\tpruning sequence (full tree): %g s\n"
+                "\t\tpruning sequences (%d folds): %g s\n"
+                "\t\tpruned tree selection: %g s\n",
+                getNumThreads(), dtree_time, ptree_time, dtree_time / ptree_time,
+                ptree_time - ptree->grow_time - ptree->sequence_time
+                - ptree->folds_time - ptree->select_time,
+                ptree->grow_time, ptree->sequence_time,
+                params.cv_folds, ptree->folds_time, ptree->select_time);
+
+        delete dtree;
+        delete ptree;
+
+        // all matrix memory free by destructors
+
+        // all OK : main returns 0
+
+        return 0;
+    }
+
+    // not OK : main returns -1
+
+    printf("usage: %s training_data_file testing_data_file\n", argv[0]);
+    return -1;
+}
+/******************************************************************************/
@@ -0,0 +1,303 @@
+// Example : locality sensitive hashing (LSH) for approximate knn
+// usage: prog training_data_file testing_data_file
+
+// For use with test / training datasets : handwritten_ex
+
+// Reports the recall / latency trade off of the bit sampling LSH index
+// (tools/lsh_hamming.h) against an exhaustive Hamming distance search, for
+// a range of table counts, key widths and multi-probe radii - both on the
+// semeion data itself and on a synthetic 100x enlargement of the training set.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+
+#include "../tools/lsh_hamming.h"
+
+/******************************************************************************/
+// global definitions (for speed and ease of use)
+
+#define NUMBER_OF_TRAINING_SAMPLES 797
+#define ATTRIBUTES_PER_SAMPLE 256
+#define NUMBER_OF_TESTING_SAMPLES 796
+
+#define NUMBER_OF_CLASSES 10
+
+#define K_NEIGHBOURS 7          // k for the kNN search
+
+#define ENLARGEMENT_FACTOR 100  // copies of each sample in the synthetic set
+#define ENLARGEMENT_NOISE 0.03  // probability of flipping each bit in a copy
+
+// N.B. classes are integer handwritten digits in range 0-9
+
+/******************************************************************************/
+
+// loads the sample database from file (which is a CSV text file)
+
+int read_data_from_csv(const char* filename, Mat data, Mat classes,
+                       int n_samples )
+{
+    float tmpf;
+
+    // if we can't read the input file then return 0
+    FILE* f = fopen( filename, "r" );
+    if( !f )
+    {
+        printf("ERROR: cannot read file %s\n",  filename);
+        return 0; // all not OK
+    }
+
+    // for each sample in the file
+
+    for(int line = 0; line < n_samples; line++)
+    {
+
+        // for each attribute on the line in the file
+
+        for(int attribute = 0; attribute < (ATTRIBUTES_PER_SAMPLE + 1); attribute++)
+        {
+            if (attribute < ATTRIBUTES_PER_SAMPLE)
+            {
+
+                // first 256 elements (0-255) in each line are the attributes
+
+                fscanf(f, "%f,", &tmpf);
+                data.at<float>(line, attribute) = tmpf;
+
+            }
+            else if (attribute == ATTRIBUTES_PER_SAMPLE)
+            {
+
+                // attribute 256 is the class label {0 ... 9}
+
+                fscanf(f, "%f,", &tmpf);
+                classes.at<float>(line, 0) = tmpf;
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 1; // all OK
+}
+
+/******************************************************************************/
+
+// synthetic enlargement of a binary data set - each sample is copied
+// "factor" times with every bit of each copy flipped with probability "noise"
+
+void enlarge_data(const Mat& data, const Mat& classes, int factor, double noise,
+                  Mat& big_data, Mat& big_classes)
+{
+    RNG rng(0xfeedbeef);
+
+    big_data.create(data.rows * factor, data.cols, CV_32F);
+    big_classes.create(data.rows * factor, 1, CV_32F);
+
+    for (int i = 0; i < data.rows; i++)
+    {
+        for (int c = 0; c < factor; c++)
+        {
+            int row = (i * factor) + c;
+            for (int j = 0; j < data.cols; j++)
+            {
+                float v = data.at<float>(i, j);
+                if ((c > 0) && (rng.uniform(0.0, 1.0) < noise))
+                {
+                    v = (v != 0) ? 0.0f : 1.0f;
+                }
+                big_data.at<float>(row, j) = v;
+            }
+            big_classes.at<float>(row, 0) = classes.at<float>(i, 0);
+        }
+    }
+}
+
+/******************************************************************************/
+
+// majority vote over the classes of a list of neighbours
+
+int vote(const Mat& classes, const std::vector<int>& indices)
+{
+    int votes[NUMBER_OF_CLASSES] = {0,0,0,0,0,0,0,0,0,0};
+    int best = 0;
+
+    for (size_t j = 0; j < indices.size(); j++)
+    {
+        votes[(int) classes.at<float>(indices[j], 0)]++;
+    }
+    for (int c = 1; c < NUMBER_OF_CLASSES; c++)
+    {
+        if (votes[c] > votes[best])
+        {
+            best = c;
+        }
+    }
+    return best;
+}
+
+/******************************************************************************/
+
+// run all the test samples against the exhaustive search and a range of LSH
+// settings over the given training data and print the trade off table
+
+void run_tradeoff(const char* title, const Mat& training_data,
+                  const Mat& training_classifications,
+                  const Mat& testing_data, const Mat& testing_classifications)
+{
+    std::vector<int> indices, dists;
+    int64 start;
+
+    printf("\n%s (%d training samples, k = %d)\n\n", title,
+           training_data.rows, K_NEIGHBOURS);
+
+    // exhaustive search as the ground truth - record the k-th distance for
+    // each test sample so that ties with the k-th neighbour count as found
+
+    HammingLSH lsh;
+    lsh.train(training_data, 1, 1); // (index not used by exhaustive search)
+
+    std::vector<int> kth_dist(testing_data.rows);
+    int correct_class = 0;
+
+    start = getTickCount();
+    for (int tsample = 0; tsample < testing_data.rows; tsample++)
+    {
+        lsh.find_nearest_exhaustive(testing_data.row(tsample), K_NEIGHBOURS,
+                                    indices, dists);
+        kth_dist[tsample] = dists.back();
+        if (vote(training_classifications, indices) ==
+                (int) testing_classifications.at<float>(tsample, 0))
+        {
+            correct_class++;
+        }
+    }
+    double exhaustive_ms = (double) (getTickCount() - start) * 1000
+                           / (getTickFrequency() * testing_data.rows);
+
+    printf("\ttables\tkey bits\tprobe\trecall\tcandidates\tms/query\tspeed up\taccuracy\n");
+    printf("\texhaustive\t\t\t1\t%d\t\t%.4f\t\t1\t\t%.2f%%\n",
+           training_data.rows, exhaustive_ms,
+           (double) correct_class*100/testing_data.rows);
+
+    // LSH settings
+
+    int table_counts[] = {4, 8, 16, 32};
+    int key_widths[] = {12, 16, 24};
+
+    for (int t = 0; t < 4; t++)
+    {
+        for (int b = 0; b < 3; b++)
+        {
+            lsh.train(training_data, table_counts[t], key_widths[b]);
+
+            for (int probe = 0; probe <= 1; probe++)
+            {
+                lsh.set_probe_radius(probe);
+                lsh.reset_stats();
+
+                int found = 0;
+                correct_class = 0;
+
+                start = getTickCount();
+                for (int tsample = 0; tsample < testing_data.rows; tsample++)
+                {
+                    lsh.find_nearest(testing_data.row(tsample), K_NEIGHBOURS,
+                                     indices, dists);
+
+                    for (size_t j = 0; j < dists.size(); j++)
+                    {
+                        if (dists[j] <= kth_dist[tsample])
+                        {
+                            found++;
+                        }
+                    }
+                    if (vote(training_classifications, indices) ==
+                            (int) testing_classifications.at<float>(tsample, 0))
+                    {
+                        correct_class++;
+                    }
+                }
+                double lsh_ms = (double) (getTickCount() - start) * 1000
+                                / (getTickFrequency() * testing_data.rows);
+
+                printf("\t%d\t%d\t\t%d\t%.3f\t%.1f\t\t%.4f\t\t%.1f\t\t%.2f%%\n",
+                       table_counts[t], key_widths[b], probe,
+                       (double) found / (K_NEIGHBOURS * testing_data.rows),
+                       lsh.average_candidates(), lsh_ms, exhaustive_ms / lsh_ms,
+                       (double) correct_class*100/testing_data.rows);
+            }
+        }
+    }
+}
+
+/******************************************************************************/
+
+int main( int argc, char** argv )
+{
+    // lets just check the version first
+
+    printf ("OpenCV version %s (%d.%d.%d)\n",
+            CV_VERSION,
+            CV_MAJOR_VERSION, CV_MINOR_VERSION, CV_SUBMINOR_VERSION);
+
+    // define training data storage matrices (one for attribute examples, one
+    // for classifications)
+
+    Mat training_data =
+        Mat(NUMBER_OF_TRAINING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat training_classifications = Mat(NUMBER_OF_TRAINING_SAMPLES, 1, CV_32FC1);
+
+    //define testing data storage matrices
+
+    Mat testing_data =
+        Mat(NUMBER_OF_TESTING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat testing_classifications =
+        Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    // load training and testing data sets
+
+    if ((argc == 3) &&
+            read_data_from_csv(argv[1], training_data, training_classifications, NUMBER_OF_TRAINING_SAMPLES) &&
+            read_data_from_csv(argv[2], testing_data, testing_classifications, NUMBER_OF_TESTING_SAMPLES))
+    {
+        printf( "\nUsing training database: %s\n", argv[1]);
+        printf( "Using testing database: %s\n", argv[2]);
+
+        // 1. the original training set
+
+        run_tradeoff("Semeion training set", training_data,
+                     training_classifications,
+                     testing_data, testing_classifications);
+
+        // 2. the synthetic (noisy copy) enlargement of the training set
+
+        Mat big_data, big_classifications;
+        enlarge_data(training_data, training_classifications,
+                     ENLARGEMENT_FACTOR, ENLARGEMENT_NOISE,
+                     big_data, big_classifications);
+
+        run_tradeoff("Synthetic 100x enlargement", big_data,
+                     big_classifications,
+                     testing_data, testing_classifications);
+
+        // all matrix memory free by destructors
+
+        // all OK : main returns 0
+
+        return 0;
+    }
+
+    // not OK : main returns -1
+
+    printf("usage: %s training_data_file testing_data_file\n", argv[0]);
+    return -1;
+}
+/******************************************************************************/
@@ -0,0 +1,334 @@
+// Example : multiclass boosted tree learning without unrolling the data
+// usage: prog training_data_file testing_data_file
+
+// For use with test / training datasets : opticaldigits_ex
+
+// Trains boosted trees for the 10 digit classes both as boosttree.cpp - a
+// 2-class CvBoost on the training data "unrolled" to 10 samples (one per
+// candidate class) per training sample, each testing sample predicted 10
+// times - and with MulticlassBoost (tools/multiclass_boost.h), whose SAMME.R
+// boosting grows 10-class trees directly on the original samples so that
+// each testing sample is predicted once. MulticlassBoost also boosts the
+// same unrolled 2-class problem as CvBoost from an UnrolledData view
+// (tools/unrolled_data.h) of the training data, without building the
+// unrolled data. The training data size, the training and prediction times
+// and the classification of the testing data are compared.
+
+// Author : Toby Breckon, toby.breckon@cranfield.ac.uk
+
+// Copyright (c) 2011 School of Engineering, Cranfield University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+
+#include "../tools/multiclass_boost.h"
+
+/******************************************************************************/
+// global definitions (for speed and ease of use)
+
+#define NUMBER_OF_TRAINING_SAMPLES 3823
+#define ATTRIBUTES_PER_SAMPLE 64
+#define NUMBER_OF_TESTING_SAMPLES 1797
+
+#define NUMBER_OF_CLASSES 10
+
+// N.B. classes are integer handwritten digits in range 0-9
+
+/******************************************************************************/
+
+// loads the sample database from file (which is a CSV text file)
+
+int read_data_from_csv(const char* filename, Mat data, Mat classes,
+                       int n_samples )
+{
+    float tmp;
+
+    // if we can't read the input file then return 0
+    FILE* f = fopen( filename, "r" );
+    if( !f )
+    {
+        printf("ERROR: cannot read file %s\n",  filename);
+        return 0; // all not OK
+    }
+
+    // for each sample in the file
+
+    for(int line = 0; line < n_samples; line++)
+    {
+
+        // for each attribute on the line in the file
+
+        for(int attribute = 0; attribute < (ATTRIBUTES_PER_SAMPLE + 1); attribute++)
+        {
+            if (attribute < 64)
+            {
+
+                // first 64 elements (0-63) in each line are the attributes
+
+                fscanf(f, "%f,", &tmp);
+                data.at<float>(line, attribute) = tmp;
+                // printf("%f,", data.at<float>(line, attribute));
+
+            }
+            else if (attribute == 64)
+            {
+
+                // attribute 65 is the class label {0 ... 9}
+
+                fscanf(f, "%f,", &tmp);
+                classes.at<float>(line, 0) = tmp;
+                // printf("%f\n", classes.at<float>(line, 0));
+
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 1; // all OK
+}
+
+/******************************************************************************/
+
+// predict a sample with the unrolled boosted trees (as boosttree.cpp, the
+// class whose unrolled sample has the maximal sum of weak responses)
+
+int predict_unrolled(CvBoost* boostTree, const Mat& sample, Mat& new_sample,
+                     Mat& weak_responses)
+{
+    for(int k = 0; k < ATTRIBUTES_PER_SAMPLE; k++ )
+    {
+        new_sample.at<float>( 0, k) = sample.at<float>(0, k);
+    }
+
+    int best_class = 0;
+    double max_sum = INT_MIN;
+
+    for(int c = 0; c < NUMBER_OF_CLASSES; c++ )
+    {
+        new_sample.at<float>(0, ATTRIBUTES_PER_SAMPLE) = (float) c;
+
+        CvMat _new_sample = new_sample;
+        CvMat _weak_responses = weak_responses;
+        boostTree->predict(&_new_sample, NULL, &_weak_responses);
+
+        Scalar responseSum = sum( weak_responses );
+        if( responseSum.val[0] > max_sum)
+        {
+            max_sum = (double) responseSum.val[0];
+            best_class = c;
+        }
+    }
+
+    return best_class;
+}
+
+/******************************************************************************/
+
+int main( int argc, char** argv )
+{
+    // lets just check the version first
+
+    printf ("OpenCV version %s (%d.%d.%d)\n",
+            CV_VERSION,
+            CV_MAJOR_VERSION, CV_MINOR_VERSION, CV_SUBMINOR_VERSION);
+
+    // define training data storage matrices (one for attribute examples, one
+    // for classifications)
+
+    Mat training_data = Mat(NUMBER_OF_TRAINING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat training_classifications = Mat(NUMBER_OF_TRAINING_SAMPLES, 1, CV_32FC1);
+
+    //define testing data storage matrices
+
+    Mat testing_data = Mat(NUMBER_OF_TESTING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat testing_classifications = Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    // load training and testing data sets
+
+    if ((argc == 3) &&
+            read_data_from_csv(argv[1], training_data, training_classifications, NUMBER_OF_TRAINING_SAMPLES) &&
+            read_data_from_csv(argv[2], testing_data, testing_classifications, NUMBER_OF_TESTING_SAMPLES))
+    {
+        printf( "\nUsing training database: %s\n", argv[1]);
+        printf( "Using testing database: %s\n\n", argv[2]);
+
+        // 1. CvBoost on the unrolled training data (as boosttree.cpp - CvBoost
+        // can only be trained from the unrolled data built in full)
+
+        int64 start = getTickCount();
+
+        UnrolledData unrolled(training_data, training_classifications);
+
+        Mat new_data, new_responses;
+        unrolled.copy_to(new_data, new_responses);
+
+        Mat var_type = Mat(ATTRIBUTES_PER_SAMPLE + 2, 1, CV_8U );
+        var_type.setTo(Scalar(CV_VAR_NUMERICAL) ); // all inputs are numerical
+        var_type.at<uchar>(ATTRIBUTES_PER_SAMPLE, 0) = CV_VAR_CATEGORICAL;
+        var_type.at<uchar>(ATTRIBUTES_PER_SAMPLE + 1, 0) = CV_VAR_CATEGORICAL;
+
+        // (N.B. in the "unrolled" data we have an imbalance in the training examples)
+
+        float unrolled_priors[] = {( NUMBER_OF_CLASSES - 1),1};
+
+        CvBoostParams params = CvBoostParams(CvBoost::REAL,  // boosting type
+                                             100,			 // number of weak classifiers
+                                             0.95,   		 // trim rate
+                                             25, 	  // max depth of trees
+                                             false,  // compute surrogate split, no missing data
+                                             unrolled_priors );
+
+        params.max_categories = 15; 	// max number of categories (use sub-optimal algorithm for larger numbers)
+        params.min_sample_count = 5; 	// min sample count
+        params.cv_folds = 1;					// cross validation folds
+        params.use_1se_rule = false; 			// use 1SE rule => smaller tree
+        params.truncate_pruned_tree = false; 	// throw away the pruned tree branches
+        params.regression_accuracy = 0.0; 		// regression accuracy: N/A here
+
+        printf( "Training CvBoost on the unrolled data .... (this may take several minutes) .... ");
+        fflush(NULL);
+
+        CvBoost* boostTree = new CvBoost;
+        boostTree->train( new_data, CV_ROW_SAMPLE, new_responses, Mat(), Mat(), var_type,
+                          Mat(), params, false);
+        double unrolled_time = (double) (getTickCount() - start) / getTickFrequency();
+        printf( "Done.\n");
+
+        size_t unrolled_bytes = new_data.total() * new_data.elemSize()
+                                + new_responses.total() * new_responses.elemSize();
+
+        Mat weak_responses = Mat( 1, boostTree->get_weak_predictors()->total, CV_32F );
+        Mat new_sample = Mat( 1,  ATTRIBUTES_PER_SAMPLE + 1, CV_32F );
+
+        int unrolled_correct = 0;
+        start = getTickCount();
+        for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+        {
+            int best_class = predict_unrolled(boostTree, testing_data.row(tsample),
+                                              new_sample, weak_responses);
+            if (fabs(((float) (best_class)) - testing_classifications.at<float>( tsample, 0))
+                    < FLT_EPSILON)
+            {
+                unrolled_correct++;
+            }
+        }
+        double unrolled_predict_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        printf( "CvBoost (unrolled, %d weak trees): training data %d x %d (%g MB), training %g s, "
+                "prediction %g ms / sample, correct classification %g%%\n",
+                boostTree->get_weak_predictors()->total, new_data.rows, new_data.cols + 1,
+                unrolled_bytes / (1024.0 * 1024.0), unrolled_time,
+                unrolled_predict_time * 1000 / NUMBER_OF_TESTING_SAMPLES,
+                (double) unrolled_correct*100/NUMBER_OF_TESTING_SAMPLES);
+
+        delete boostTree;
+
+        // 2. MulticlassBoost on the unrolled data view (same problem and
+        // parameters as CvBoost - only the boosting weights are held per
+        // unrolled sample)
+
+        new_data.release();
+        new_responses.release();
+
+        MulticlassBoost unrolled_boost;
+
+        start = getTickCount();
+        if (!unrolled_boost.train(unrolled, params))
+        {
+            printf("ERROR: cannot train the boosted trees on the unrolled data view\n");
+            return -1;
+        }
+        double view_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        size_t view_bytes = training_data.total() * training_data.elemSize()
+                            + unrolled.get_bytes() + unrolled_boost.get_train_bytes();
+
+        int view_correct = 0;
+        start = getTickCount();
+        for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+        {
+            if (fabs(unrolled_boost.predict_unrolled(testing_data.ptr<float>(tsample))
+                     - testing_classifications.at<float>(tsample, 0)) < FLT_EPSILON)
+            {
+                view_correct++;
+            }
+        }
+        double view_predict_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        printf( "MulticlassBoost (unrolled view, %d weak trees): training data %d x %d "
+                "(%g MB with its bins), training %g s, prediction %g ms / sample, "
+                "correct classification %g%%\n",
+                unrolled_boost.get_weak_count(), unrolled.rows(), unrolled.cols() + 1,
+                view_bytes / (1024.0 * 1024.0), view_time,
+                view_predict_time * 1000 / NUMBER_OF_TESTING_SAMPLES,
+                (double) view_correct*100/NUMBER_OF_TESTING_SAMPLES);
+
+        // 3. MulticlassBoost (SAMME.R) on the original training data (same
+        // parameters, equal priors as there is no imbalance)
+
+        float priors[] = {1,1,1,1,1,1,1,1,1,1};
+        params.priors = priors;
+
+        MulticlassBoost multiclass;
+
+        start = getTickCount();
+        if (!multiclass.train(training_data, training_classifications, params))
+        {
+            printf("ERROR: cannot train the multiclass boosted trees\n");
+            return -1;
+        }
+        double multiclass_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        size_t multiclass_bytes = training_data.total() * training_data.elemSize()
+                                  + training_classifications.total() * training_classifications.elemSize()
+                                  + multiclass.get_train_bytes();
+
+        int multiclass_correct = 0;
+        start = getTickCount();
+        for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+        {
+            if (fabs(multiclass.predict(testing_data.ptr<float>(tsample))
+                     - testing_classifications.at<float>(tsample, 0)) < FLT_EPSILON)
+            {
+                multiclass_correct++;
+            }
+        }
+        double multiclass_predict_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        printf( "MulticlassBoost (SAMME.R, %d weak trees, %d nodes): training data %d x %d "
+                "(%g MB with its bins), training %g s, prediction %g ms / sample, "
+                "correct classification %g%%\n",
+                multiclass.get_weak_count(), multiclass.get_node_count(),
+                training_data.rows, training_data.cols + 1,
+                multiclass_bytes / (1024.0 * 1024.0), multiclass_time,
+                multiclass_predict_time * 1000 / NUMBER_OF_TESTING_SAMPLES,
+                (double) multiclass_correct*100/NUMBER_OF_TESTING_SAMPLES);
+
+        printf( "\nMulticlassBoost (unrolled view) vs CvBoost (unrolled) : training data "
+                "x%g smaller, training x%g faster\n",
+                (double) unrolled_bytes / view_bytes, unrolled_time / view_time);
+
+        printf( "MulticlassBoost vs CvBoost (unrolled) : training data x%g smaller, "
+                "training x%g faster, prediction x%g faster\n",
+                (double) unrolled_bytes / multiclass_bytes, unrolled_time / multiclass_time,
+                unrolled_predict_time / multiclass_predict_time);
+
+        // all matrix memory free by destructors
+
+        // all OK : main returns 0
+
+        return 0;
+    }
+
+    // not OK : main returns -1
+
+    printf("usage: %s training_data_file testing_data_file\n", argv[0]);
+    return -1;
+}
+/******************************************************************************/
@@ -1,5 +1,5 @@
 // Example : decision tree learning
-// usage: prog training_data_file testing_data_file
+// usage: prog training_data_file testing_data_file [saved_tree_file]
 
 // For use with test / training datasets : opticaldigits_ex
 
@@ -145,6 +145,14 @@ int main( int argc, char** argv )
         dtree->train(training_data, CV_ROW_SAMPLE, training_classifications,
                      Mat(), Mat(), var_type, Mat(), params);
 
+        // optionally save the trained tree (e.g. for use with tools/dt_codegen)
+
+        if (argc > 3)
+        {
+            dtree->save(argv[3]);
+            printf( "\nSaved decision tree to: %s\n", argv[3]);
+        }
+
         // perform classifier testing and report results
 
         Mat test_sample;
@@ -0,0 +1,262 @@
+// Example : compiled decision tree inference
+// usage: prog testing_data_file
+
+// For use with test / training datasets : opticaldigits_ex
+
+// Benchmarks a saved optdigits tree (e.g. saved by decisiontree.cpp, 3rd
+// argument), compiled to C++ source by tools/dt_codegen and built in by
+// add_compiled_tree() (see CMakeLists.txt: OPTDIGITS_TREE), against
+// CvDTree::predict() on the same saved tree and the flattened tree of
+// tools/flat_dtree.h - all three must agree exactly. The saved tree is the
+// one compiled in (COMPILED_TREE_FILE, defined by the build), so they are
+// the same tree by construction.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+
+#include "../tools/flat_dtree.h"
+
+/******************************************************************************/
+// global definitions (for speed and ease of use)
+
+#define NUMBER_OF_TRAINING_SAMPLES 3823
+#define ATTRIBUTES_PER_SAMPLE 64
+#define NUMBER_OF_TESTING_SAMPLES 1797
+
+#define NUMBER_OF_CLASSES 10
+
+#define BENCHMARK_PASSES 100 // passes over the test set for the timing
+
+// N.B. classes are integer handwritten digits in range 0-9
+
+// the compiled tree (generated by tools/dt_codegen as optdigits_tree_predict)
+// and the saved tree file it was generated from
+
+double optdigits_tree_predict(const float* sample);
+
+#ifndef COMPILED_TREE_FILE
+#error "COMPILED_TREE_FILE (the saved tree compiled in) must be defined by the build"
+#endif
+
+/******************************************************************************/
+
+// loads the sample database from file (which is a CSV text file)
+
+int read_data_from_csv(const char* filename, Mat data, Mat classes,
+                       int n_samples )
+{
+    float tmp;
+
+    // if we can't read the input file then return 0
+    FILE* f = fopen( filename, "r" );
+    if( !f )
+    {
+        printf("ERROR: cannot read file %s\n",  filename);
+        return 0; // all not OK
+    }
+
+    // for each sample in the file
+
+    for(int line = 0; line < n_samples; line++)
+    {
+
+        // for each attribute on the line in the file
+
+        for(int attribute = 0; attribute < (ATTRIBUTES_PER_SAMPLE + 1); attribute++)
+        {
+            if (attribute < 64)
+            {
+
+                // first 64 elements (0-63) in each line are the attributes
+
+                fscanf(f, "%f,", &tmp);
+                data.at<float>(line, attribute) = tmp;
+                // printf("%f,", data.at<float>(line, attribute));
+
+            }
+            else if (attribute == 64)
+            {
+
+                // attribute 65 is the class label {0 ... 9}
+
+                fscanf(f, "%f,", &tmp);
+                classes.at<float>(line, 0) = tmp;
+                // printf("%f\n", classes.at<float>(line, 0));
+
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 1; // all OK
+}
+
+/******************************************************************************/
+
+int main( int argc, char** argv )
+{
+    // lets just check the version first
+
+    printf ("OpenCV version %s (%d.%d.%d)\n",
+            CV_VERSION,
+            CV_MAJOR_VERSION, CV_MINOR_VERSION, CV_SUBMINOR_VERSION);
+
+    //define testing data storage matrices
+
+    Mat testing_data = Mat(NUMBER_OF_TESTING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat testing_classifications = Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    // load the testing data set
+
+    if ((argc == 2) &&
+            read_data_from_csv(argv[1], testing_data, testing_classifications, NUMBER_OF_TESTING_SAMPLES))
+    {
+        // load the saved decision tree (the same one that was compiled in)
+
+        printf( "\nUsing saved decision tree: %s\n", COMPILED_TREE_FILE);
+        CvDTree* dtree = new CvDTree;
+        dtree->load(COMPILED_TREE_FILE);
+
+        FlatDTree ftree;
+        if (!ftree.build(dtree))
+        {
+            printf("ERROR: cannot read the decision tree in %s\n", COMPILED_TREE_FILE);
+            return -1;
+        }
+
+        // perform classifier testing (all three predictors) and report results
+
+        Mat test_sample;
+        int correct_class = 0;
+        int wrong_class = 0;
+        int mismatches = 0;
+        int false_positives [NUMBER_OF_CLASSES] = {0,0,0,0,0,0,0,0,0,0};
+        double result;
+
+        printf( "\nUsing testing database: %s\n\n", argv[1]);
+
+        for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+        {
+
+            // extract a row from the testing matrix
+
+            test_sample = testing_data.row(tsample);
+
+            // run compiled tree prediction and check against the others
+
+            result = optdigits_tree_predict(test_sample.ptr<float>(0));
+
+            if ((result != dtree->predict(test_sample, Mat(), false)->value)
+                    || (result != ftree.predict(test_sample.ptr<float>(0))))
+            {
+                mismatches++;
+                printf("Testing Sample %i -> MISMATCH (compiled digit %d)\n",
+                       tsample, (int) result);
+            }
+
+            // if the prediction and the (true) testing classification are the same
+            // (N.B. openCV uses a floating point decision tree implementation!)
+
+            if (fabs(result - testing_classifications.at<float>(tsample, 0))
+                    >= FLT_EPSILON)
+            {
+                // if they differ more than floating point error => wrong class
+
+                wrong_class++;
+
+                false_positives[(int) result]++;
+
+            }
+            else
+            {
+
+                // otherwise correct
+
+                correct_class++;
+            }
+        }
+
+        printf( "\nResults on the testing database: %s\n"
+                "\tCorrect classification: %d (%g%%)\n"
+                "\tWrong classifications: %d (%g%%)\n",
+                argv[1],
+                correct_class, (double) correct_class*100/NUMBER_OF_TESTING_SAMPLES,
+                wrong_class, (double) wrong_class*100/NUMBER_OF_TESTING_SAMPLES);
+
+        for (int i = 0; i < NUMBER_OF_CLASSES; i++)
+        {
+            printf( "\tClass (digit %d) false postives 	%d (%g%%)\n", i,
+                    false_positives[i],
+                    (double) false_positives[i]*100/NUMBER_OF_TESTING_SAMPLES);
+        }
+
+        // throughput of the three predictors over repeated passes of the test set
+
+        double checksum = 0;
+        double times[3];
+        int64 start;
+
+        start = getTickCount();
+        for (int pass = 0; pass < BENCHMARK_PASSES; pass++)
+        {
+            for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+            {
+                checksum += dtree->predict(testing_data.row(tsample), Mat(), false)->value;
+            }
+        }
+        times[0] = (double) (getTickCount() - start) / getTickFrequency();
+
+        start = getTickCount();
+        for (int pass = 0; pass < BENCHMARK_PASSES; pass++)
+        {
+            for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+            {
+                checksum -= ftree.predict(testing_data.ptr<float>(tsample));
+            }
+        }
+        times[1] = (double) (getTickCount() - start) / getTickFrequency();
+
+        start = getTickCount();
+        for (int pass = 0; pass < BENCHMARK_PASSES; pass++)
+        {
+            for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+            {
+                checksum += optdigits_tree_predict(testing_data.ptr<float>(tsample));
+            }
+        }
+        times[2] = (double) (getTickCount() - start) / getTickFrequency();
+
+        double samples = (double) BENCHMARK_PASSES*NUMBER_OF_TESTING_SAMPLES;
+
+        printf( "\nPrediction throughput (%d passes, checksum %g):\n"
+                "\tMismatches: %d\n"
+                "\tCvDTree::predict: %g samples/s\n"
+                "\tFlattened tree: %g samples/s (x%g)\n"
+                "\tCompiled tree: %g samples/s (x%g)\n",
+                BENCHMARK_PASSES, checksum, mismatches,
+                samples/times[0],
+                samples/times[1], times[0]/times[1],
+                samples/times[2], times[0]/times[2]);
+
+        // all matrix memory free by destructors
+
+        // all OK : main returns 0 (unless the predictors disagree)
+
+        return (mismatches == 0) ? 0 : -1;
+    }
+
+    // not OK : main returns -1
+
+    printf("usage: %s testing_data_file\n", argv[0]);
+    return -1;
+}
+/******************************************************************************/
@@ -0,0 +1,307 @@
+// Example : flattened decision tree inference
+// usage: prog training_data_file testing_data_file
+
+// For use with test / training datasets : opticaldigits_ex
+
+// Trains the same decision tree as decisiontree.cpp, flattens it into the
+// struct of arrays form of tools/flat_dtree.h and checks that the batch
+// prediction over the flattened arrays matches CvDTree::predict() exactly
+// for every test sample, reporting the throughput of both (and of the lockstep
+// batch traversal, AVX2 where available, scalar otherwise).
+
+// Author : Toby Breckon, toby.breckon@cranfield.ac.uk
+
+// Copyright (c) 2011 School of Engineering, Cranfield University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+
+#include "../tools/flat_dtree.h"
+
+/******************************************************************************/
+// global definitions (for speed and ease of use)
+
+#define NUMBER_OF_TRAINING_SAMPLES 3823
+#define ATTRIBUTES_PER_SAMPLE 64
+#define NUMBER_OF_TESTING_SAMPLES 1797
+
+#define NUMBER_OF_CLASSES 10
+
+#define BENCHMARK_PASSES 100 // passes over the test set for the timing
+
+// N.B. classes are integer handwritten digits in range 0-9
+
+/******************************************************************************/
+
+// loads the sample database from file (which is a CSV text file)
+
+int read_data_from_csv(const char* filename, Mat data, Mat classes,
+                       int n_samples )
+{
+    float tmp;
+
+    // if we can't read the input file then return 0
+    FILE* f = fopen( filename, "r" );
+    if( !f )
+    {
+        printf("ERROR: cannot read file %s\n",  filename);
+        return 0; // all not OK
+    }
+
+    // for each sample in the file
+
+    for(int line = 0; line < n_samples; line++)
+    {
+
+        // for each attribute on the line in the file
+
+        for(int attribute = 0; attribute < (ATTRIBUTES_PER_SAMPLE + 1); attribute++)
+        {
+            if (attribute < 64)
+            {
+
+                // first 64 elements (0-63) in each line are the attributes
+
+                fscanf(f, "%f,", &tmp);
+                data.at<float>(line, attribute) = tmp;
+                // printf("%f,", data.at<float>(line, attribute));
+
+            }
+            else if (attribute == 64)
+            {
+
+                // attribute 65 is the class label {0 ... 9}
+
+                fscanf(f, "%f,", &tmp);
+                classes.at<float>(line, 0) = tmp;
+                // printf("%f\n", classes.at<float>(line, 0));
+
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 1; // all OK
+}
+
+/******************************************************************************/
+
+int main( int argc, char** argv )
+{
+    // lets just check the version first
+
+    printf ("OpenCV version %s (%d.%d.%d)\n",
+            CV_VERSION,
+            CV_MAJOR_VERSION, CV_MINOR_VERSION, CV_SUBMINOR_VERSION);
+
+    // define training data storage matrices (one for attribute examples, one
+    // for classifications)
+
+    Mat training_data = Mat(NUMBER_OF_TRAINING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat training_classifications = Mat(NUMBER_OF_TRAINING_SAMPLES, 1, CV_32FC1);
+
+    //define testing data storage matrices
+
+    Mat testing_data = Mat(NUMBER_OF_TESTING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat testing_classifications = Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    // define all the attributes as numerical
+    // alternatives are CV_VAR_CATEGORICAL or CV_VAR_ORDERED(=CV_VAR_NUMERICAL)
+    // that can be assigned on a per attribute basis
+
+    Mat var_type = Mat(ATTRIBUTES_PER_SAMPLE + 1, 1, CV_8U );
+    var_type.setTo(Scalar(CV_VAR_NUMERICAL) ); // all inputs are numerical
+
+    // this is a classification problem (i.e. predict a discrete number of class
+    // outputs) so reset the last (+1) output var_type element to CV_VAR_CATEGORICAL
+
+    var_type.at<uchar>(ATTRIBUTES_PER_SAMPLE, 0) = CV_VAR_CATEGORICAL;
+
+    CvDTreeNode* resultNode; // node returned from a prediction
+
+    // load training and testing data sets
+
+    if ((argc == 3) &&
+            read_data_from_csv(argv[1], training_data, training_classifications, NUMBER_OF_TRAINING_SAMPLES) &&
+            read_data_from_csv(argv[2], testing_data, testing_classifications, NUMBER_OF_TESTING_SAMPLES))
+    {
+        // define the parameters for training the decision tree
+
+        float priors[] = {1,1,1,1,1,1,1,1,1,1};  // weights of each classification for classes
+        // (all equal as equal samples of each digit)
+
+        CvDTreeParams params = CvDTreeParams(25, // max depth
+                                             5, // min sample count
+                                             0, // regression accuracy: N/A here
+                                             false, // compute surrogate split, no missing data
+                                             15, // max number of categories (use sub-optimal algorithm for larger numbers)
+                                             15, // the number of cross-validation folds
+                                             false, // use 1SE rule => smaller tree
+                                             false, // throw away the pruned tree branches
+                                             priors // the array of priors
+                                            );
+
+
+        // train decision tree classifier (using training data)
+
+        printf( "\nUsing training database: %s\n\n", argv[1]);
+        CvDTree* dtree = new CvDTree;
+
+        dtree->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                     Mat(), Mat(), var_type, Mat(), params);
+
+        // flatten the trained tree
+
+        FlatDTree ftree;
+        if (!ftree.build(dtree))
+        {
+            printf("ERROR: cannot flatten the decision tree\n");
+            return -1;
+        }
+
+        printf( "Flattened tree: %d nodes, depth %d, %d bytes\n",
+                ftree.get_node_count(), ftree.get_depth(),
+                (int) ftree.get_size_bytes());
+
+        // perform classifier testing (both predictors) and report results
+
+        Mat test_sample;
+        Mat flat_results;
+        int correct_class = 0;
+        int wrong_class = 0;
+        int mismatches = 0;
+        int false_positives [NUMBER_OF_CLASSES] = {0,0,0,0,0,0,0,0,0,0};
+
+        printf( "\nUsing testing database: %s\n\n", argv[2]);
+
+        ftree.predict(testing_data, flat_results);
+
+        for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+        {
+
+            // extract a row from the testing matrix
+
+            test_sample = testing_data.row(tsample);
+
+            // run decision tree prediction
+
+            resultNode = dtree->predict(test_sample, Mat(), false);
+
+            // the flattened prediction must be identical
+
+            if (resultNode->value != flat_results.at<double>(tsample, 0))
+            {
+                printf("Testing Sample %i -> MISMATCH (CvDTree digit %d, flattened digit %d)\n",
+                       tsample, (int) (resultNode->value),
+                       (int) flat_results.at<double>(tsample, 0));
+                mismatches++;
+            }
+            else
+            {
+                printf("Testing Sample %i -> class result (digit %d)\n", tsample,
+                       (int) flat_results.at<double>(tsample, 0));
+            }
+
+            // if the prediction and the (true) testing classification are the same
+            // (N.B. openCV uses a floating point decision tree implementation!)
+
+            if (fabs(flat_results.at<double>(tsample, 0) - testing_classifications.at<float>(tsample, 0))
+                    >= FLT_EPSILON)
+            {
+                // if they differ more than floating point error => wrong class
+
+                wrong_class++;
+
+                false_positives[(int) flat_results.at<double>(tsample, 0)]++;
+
+            }
+            else
+            {
+
+                // otherwise correct
+
+                correct_class++;
+            }
+        }
+
+        printf( "\nResults on the testing database: %s\n"
+                "\tCorrect classification: %d (%g%%)\n"
+                "\tWrong classifications: %d (%g%%)\n",
+                argv[2],
+                correct_class, (double) correct_class*100/NUMBER_OF_TESTING_SAMPLES,
+                wrong_class, (double) wrong_class*100/NUMBER_OF_TESTING_SAMPLES);
+
+        for (int i = 0; i < NUMBER_OF_CLASSES; i++)
+        {
+            printf( "\tClass (digit %d) false postives 	%d (%g%%)\n", i,
+                    false_positives[i],
+                    (double) false_positives[i]*100/NUMBER_OF_TESTING_SAMPLES);
+        }
+
+        // throughput of both predictors over repeated passes of the test set
+
+        double checksum = 0;
+        int64 start = getTickCount();
+        for (int pass = 0; pass < BENCHMARK_PASSES; pass++)
+        {
+            for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+            {
+                checksum += dtree->predict(testing_data.row(tsample), Mat(), false)->value;
+            }
+        }
+        double dtree_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        start = getTickCount();
+        for (int pass = 0; pass < BENCHMARK_PASSES; pass++)
+        {
+            ftree.predict(testing_data, flat_results);
+            checksum -= sum(flat_results).val[0];
+        }
+        double flat_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        // lockstep batch traversal (checked against the flattened predictions)
+
+        Mat lockstep_results;
+        ftree.predict_lockstep(testing_data, lockstep_results);
+        mismatches += countNonZero(lockstep_results != flat_results);
+
+        start = getTickCount();
+        for (int pass = 0; pass < BENCHMARK_PASSES; pass++)
+        {
+            ftree.predict_lockstep(testing_data, lockstep_results);
+            checksum += sum(lockstep_results).val[0];
+        }
+        double lockstep_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        printf( "\nPrediction throughput (%d passes, checksum %g):\n"
+                "\tMismatches against CvDTree: %d\n"
+                "\tCvDTree::predict: %g samples/s\n"
+                "\tFlattened batch predict: %g samples/s (x%g)\n"
+                "\tFlattened lockstep predict (%s): %g samples/s (x%g)\n",
+                BENCHMARK_PASSES, checksum, mismatches,
+                (double) BENCHMARK_PASSES*NUMBER_OF_TESTING_SAMPLES/dtree_time,
+                (double) BENCHMARK_PASSES*NUMBER_OF_TESTING_SAMPLES/flat_time,
+                dtree_time/flat_time,
+                checkHardwareSupport(CV_CPU_AVX2) ? "AVX2" : "scalar",
+                (double) BENCHMARK_PASSES*NUMBER_OF_TESTING_SAMPLES/lockstep_time,
+                dtree_time/lockstep_time);
+
+        // all matrix memory free by destructors
+
+        // all OK : main returns 0 (unless the predictors disagree)
+
+        return (mismatches == 0) ? 0 : -1;
+    }
+
+    // not OK : main returns -1
+
+    printf("usage: %s training_data_file testing_data_file\n", argv[0]);
+    return -1;
+}
+/******************************************************************************/
@@ -0,0 +1,242 @@
+// Example : histogram based decision tree learning
+// usage: prog training_data_file testing_data_file [saved_tree_file]
+
+// For use with test / training datasets : opticaldigits_ex
+
+// Trains the same (unpruned) tree with CvDTree and with the histogram based
+// trainer of tools/hist_dtree.h and compares their training time and test
+// accuracy. If a file is given the histogram tree is saved to it in the
+// CvDTree format, reloaded with CvDTree::load() and checked to predict
+// exactly as before.
+
+// Author : Toby Breckon, toby.breckon@cranfield.ac.uk
+
+// Copyright (c) 2011 School of Engineering, Cranfield University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+
+#include "../tools/hist_dtree.h"
+
+/******************************************************************************/
+// global definitions (for speed and ease of use)
+
+#define NUMBER_OF_TRAINING_SAMPLES 3823
+#define ATTRIBUTES_PER_SAMPLE 64
+#define NUMBER_OF_TESTING_SAMPLES 1797
+
+#define NUMBER_OF_CLASSES 10
+
+// N.B. classes are integer handwritten digits in range 0-9
+
+/******************************************************************************/
+
+// loads the sample database from file (which is a CSV text file)
+
+int read_data_from_csv(const char* filename, Mat data, Mat classes,
+                       int n_samples )
+{
+    float tmp;
+
+    // if we can't read the input file then return 0
+    FILE* f = fopen( filename, "r" );
+    if( !f )
+    {
+        printf("ERROR: cannot read file %s\n",  filename);
+        return 0; // all not OK
+    }
+
+    // for each sample in the file
+
+    for(int line = 0; line < n_samples; line++)
+    {
+
+        // for each attribute on the line in the file
+
+        for(int attribute = 0; attribute < (ATTRIBUTES_PER_SAMPLE + 1); attribute++)
+        {
+            if (attribute < 64)
+            {
+
+                // first 64 elements (0-63) in each line are the attributes
+
+                fscanf(f, "%f,", &tmp);
+                data.at<float>(line, attribute) = tmp;
+                // printf("%f,", data.at<float>(line, attribute));
+
+            }
+            else if (attribute == 64)
+            {
+
+                // attribute 65 is the class label {0 ... 9}
+
+                fscanf(f, "%f,", &tmp);
+                classes.at<float>(line, 0) = tmp;
+                // printf("%f\n", classes.at<float>(line, 0));
+
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 1; // all OK
+}
+
+/******************************************************************************/
+
+int main( int argc, char** argv )
+{
+    // lets just check the version first
+
+    printf ("OpenCV version %s (%d.%d.%d)\n",
+            CV_VERSION,
+            CV_MAJOR_VERSION, CV_MINOR_VERSION, CV_SUBMINOR_VERSION);
+
+    // define training data storage matrices (one for attribute examples, one
+    // for classifications)
+
+    Mat training_data = Mat(NUMBER_OF_TRAINING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat training_classifications = Mat(NUMBER_OF_TRAINING_SAMPLES, 1, CV_32FC1);
+
+    //define testing data storage matrices
+
+    Mat testing_data = Mat(NUMBER_OF_TESTING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat testing_classifications = Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    // define all the attributes as numerical (the histogram trainer only
+    // supports numerical attributes) and the output as categorical
+
+    Mat var_type = Mat(ATTRIBUTES_PER_SAMPLE + 1, 1, CV_8U );
+    var_type.setTo(Scalar(CV_VAR_NUMERICAL) ); // all inputs are numerical
+    var_type.at<uchar>(ATTRIBUTES_PER_SAMPLE, 0) = CV_VAR_CATEGORICAL;
+
+    // load training and testing data sets
+
+    if (((argc == 3) || (argc == 4)) &&
+            read_data_from_csv(argv[1], training_data, training_classifications, NUMBER_OF_TRAINING_SAMPLES) &&
+            read_data_from_csv(argv[2], testing_data, testing_classifications, NUMBER_OF_TESTING_SAMPLES))
+    {
+        // define the parameters for training the decision tree - as
+        // decisiontree.cpp but without cross validation pruning (which the
+        // histogram trainer does not do)
+
+        float priors[] = {1,1,1,1,1,1,1,1,1,1};  // weights of each classification for classes
+        // (all equal as equal samples of each digit)
+
+        CvDTreeParams params = CvDTreeParams(25, // max depth
+                                             5, // min sample count
+                                             0, // regression accuracy: N/A here
+                                             false, // compute surrogate split, no missing data
+                                             15, // max number of categories (use sub-optimal algorithm for larger numbers)
+                                             0, // the number of cross-validation folds
+                                             false, // use 1SE rule => smaller tree
+                                             false, // throw away the pruned tree branches
+                                             priors // the array of priors
+                                            );
+
+        printf( "\nUsing training database: %s\n", argv[1]);
+        printf( "Using testing database: %s\n\n", argv[2]);
+
+        // train the decision tree with CvDTree (sorting the attribute values)
+
+        CvDTree* dtree = new CvDTree;
+
+        int64 start = getTickCount();
+        dtree->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                     Mat(), Mat(), var_type, Mat(), params);
+        double dtree_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        // train the decision tree from the attribute histograms
+
+        HistDTree htree;
+        htree.train(training_data, training_classifications, params);
+
+        double htree_time = htree.binning_time + htree.growing_time;
+
+        // test both trees
+
+        int dtree_correct = 0;
+        int htree_correct = 0;
+        int agree = 0;
+
+        for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+        {
+            double truth = testing_classifications.at<float>(tsample, 0);
+            double dtree_result = dtree->predict(testing_data.row(tsample), Mat(), false)->value;
+            double htree_result = htree.predict(testing_data.ptr<float>(tsample));
+
+            if (fabs(dtree_result - truth) < FLT_EPSILON)
+            {
+                dtree_correct++;
+            }
+            if (fabs(htree_result - truth) < FLT_EPSILON)
+            {
+                htree_correct++;
+            }
+            if (dtree_result == htree_result)
+            {
+                agree++;
+            }
+        }
+
+        printf( "CvDTree: trained in %g s, correct classification: %d (%g%%)\n",
+                dtree_time, dtree_correct,
+                (double) dtree_correct*100/NUMBER_OF_TESTING_SAMPLES);
+        printf( "Histogram tree: trained in %g s (binning %g s, growing %g s)"
+                " x%g faster, %d nodes, depth %d\n"
+                "\tcorrect classification: %d (%g%%)\n"
+                "\tagreement with CvDTree: %d (%g%%)\n",
+                htree_time, htree.binning_time, htree.growing_time,
+                dtree_time / htree_time,
+                htree.get_node_count(), htree.get_depth(),
+                htree_correct, (double) htree_correct*100/NUMBER_OF_TESTING_SAMPLES,
+                agree, (double) agree*100/NUMBER_OF_TESTING_SAMPLES);
+
+        // optionally save the histogram tree in the CvDTree format, then
+        // reload it as a CvDTree and check it still predicts the same
+
+        if (argc == 4)
+        {
+            htree.save(argv[3]);
+
+            CvDTree* loaded = new CvDTree;
+            loaded->load(argv[3]);
+
+            int mismatches = 0;
+            for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+            {
+                if (loaded->predict(testing_data.row(tsample), Mat(), false)->value
+                        != htree.predict(testing_data.ptr<float>(tsample)))
+                {
+                    mismatches++;
+                }
+            }
+
+            printf( "\nSaved histogram tree to: %s\n"
+                    "\tmismatches after reloading with CvDTree::load(): %d\n",
+                    argv[3], mismatches);
+
+            delete loaded;
+        }
+
+        delete dtree;
+
+        // all matrix memory free by destructors
+
+        // all OK : main returns 0
+
+        return 0;
+    }
+
+    // not OK : main returns -1
+
+    printf("usage: %s training_data_file testing_data_file [saved_tree_file]\n", argv[0]);
+    return -1;
+}
+/******************************************************************************/
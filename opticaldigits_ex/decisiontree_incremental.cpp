@@ -0,0 +1,249 @@
+// Example : incremental decision tree learning
+// usage: prog training_data_file testing_data_file
+
+// For use with test / training datasets : opticaldigits_ex
+
+// Simulates a training set that grows by small increments: trains the
+// histogram based tree of tools/hist_dtree.h on the first part of the
+// training data then adds the rest an increment at a time, both updating the
+// tree incrementally (HistDTree::update(), regrowing only the subtrees whose
+// best split changed) and retraining from scratch on all the samples so far.
+// The time taken, size and test accuracy of the two trees are compared after
+// each increment and the regrown subtrees listed.
+
+// Author : Toby Breckon, toby.breckon@cranfield.ac.uk
+
+// Copyright (c) 2011 School of Engineering, Cranfield University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+
+#include "../tools/hist_dtree.h"
+
+/******************************************************************************/
+// global definitions (for speed and ease of use)
+
+#define NUMBER_OF_TRAINING_SAMPLES 3823
+#define ATTRIBUTES_PER_SAMPLE 64
+#define NUMBER_OF_TESTING_SAMPLES 1797
+
+#define NUMBER_OF_CLASSES 10
+
+#define NUMBER_OF_INITIAL_SAMPLES 3000 // trained on before the increments
+#define INCREMENT_SIZE 100             // samples added by each increment
+
+#define HISTOGRAM_CACHE_BYTES (64 << 20) // node histograms kept for updates
+
+/******************************************************************************/
+
+// loads the sample database from file (which is a CSV text file)
+
+int read_data_from_csv(const char* filename, Mat data, Mat classes,
+                       int n_samples )
+{
+    float tmp;
+
+    // if we can't read the input file then return 0
+    FILE* f = fopen( filename, "r" );
+    if( !f )
+    {
+        printf("ERROR: cannot read file %s\n",  filename);
+        return 0; // all not OK
+    }
+
+    // for each sample in the file
+
+    for(int line = 0; line < n_samples; line++)
+    {
+
+        // for each attribute on the line in the file
+
+        for(int attribute = 0; attribute < (ATTRIBUTES_PER_SAMPLE + 1); attribute++)
+        {
+            if (attribute < 64)
+            {
+
+                // first 64 elements (0-63) in each line are the attributes
+
+                fscanf(f, "%f,", &tmp);
+                data.at<float>(line, attribute) = tmp;
+                // printf("%f,", data.at<float>(line, attribute));
+
+            }
+            else if (attribute == 64)
+            {
+
+                // attribute 65 is the class label {0 ... 9}
+
+                fscanf(f, "%f,", &tmp);
+                classes.at<float>(line, 0) = tmp;
+                // printf("%f\n", classes.at<float>(line, 0));
+
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 1; // all OK
+}
+
+/******************************************************************************/
+
+// test a tree - returns the number of testing samples correctly classified
+
+int test_tree(const HistDTree& htree, const Mat& testing_data,
+              const Mat& testing_classifications)
+{
+    int correct_class = 0;
+
+    for (int tsample = 0; tsample < testing_data.rows; tsample++)
+    {
+        double result = htree.predict(testing_data.ptr<float>(tsample));
+        if (fabs(result - testing_classifications.at<float>(tsample, 0)) < FLT_EPSILON)
+        {
+            correct_class++;
+        }
+    }
+
+    return correct_class;
+}
+
+/******************************************************************************/
+
+int main( int argc, char** argv )
+{
+    // lets just check the version first
+
+    printf ("OpenCV version %s (%d.%d.%d)\n",
+            CV_VERSION,
+            CV_MAJOR_VERSION, CV_MINOR_VERSION, CV_SUBMINOR_VERSION);
+
+    // define training data storage matrices (one for attribute examples, one
+    // for classifications)
+
+    Mat training_data = Mat(NUMBER_OF_TRAINING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat training_classifications = Mat(NUMBER_OF_TRAINING_SAMPLES, 1, CV_32FC1);
+
+    //define testing data storage matrices
+
+    Mat testing_data = Mat(NUMBER_OF_TESTING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat testing_classifications = Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    // load training and testing data sets
+
+    if ((argc == 3) &&
+            read_data_from_csv(argv[1], training_data, training_classifications, NUMBER_OF_TRAINING_SAMPLES) &&
+            read_data_from_csv(argv[2], testing_data, testing_classifications, NUMBER_OF_TESTING_SAMPLES))
+    {
+        // define the parameters for training the decision tree (as
+        // decisiontree_hist.cpp)
+
+        float priors[] = {1,1,1,1,1,1,1,1,1,1};  // weights of each classification for classes
+        // (all equal as equal samples of each digit)
+
+        CvDTreeParams params = CvDTreeParams(25, // max depth
+                                             5, // min sample count
+                                             0, // regression accuracy: N/A here
+                                             false, // compute surrogate split, no missing data
+                                             15, // max number of categories (use sub-optimal algorithm for larger numbers)
+                                             0, // the number of cross-validation folds
+                                             false, // use 1SE rule => smaller tree
+                                             false, // throw away the pruned tree branches
+                                             priors // the array of priors
+                                            );
+
+        printf( "\nUsing training database: %s\n", argv[1]);
+        printf( "Using testing database: %s\n\n", argv[2]);
+
+        // initial training (keeping node histograms for the updates)
+
+        HistDTree htree;
+        htree.train(training_data.rowRange(0, NUMBER_OF_INITIAL_SAMPLES),
+                    training_classifications.rowRange(0, NUMBER_OF_INITIAL_SAMPLES),
+                    params, HIST_DTREE_MAX_BINS, HISTOGRAM_CACHE_BYTES);
+
+        printf( "Initial tree: %d samples, %d nodes, trained in %g s (%d node histograms kept)\n\n",
+                NUMBER_OF_INITIAL_SAMPLES, htree.get_node_count(),
+                htree.binning_time + htree.growing_time, htree.get_cached_node_count());
+
+        double total_update_time = 0;
+        double total_retrain_time = 0;
+
+        for (int end = NUMBER_OF_INITIAL_SAMPLES; end < NUMBER_OF_TRAINING_SAMPLES; )
+        {
+            int begin = end;
+            end = MIN(end + INCREMENT_SIZE, NUMBER_OF_TRAINING_SAMPLES);
+
+            // update the tree with the increment
+
+            if (!htree.update(training_data.rowRange(begin, end),
+                              training_classifications.rowRange(begin, end)))
+            {
+                printf("ERROR: cannot update the tree with samples %d to %d\n", begin, end - 1);
+                return -1;
+            }
+
+            // retrain from scratch on all the samples so far
+
+            HistDTree retrained;
+            retrained.train(training_data.rowRange(0, end),
+                            training_classifications.rowRange(0, end), params);
+            double retrain_time = retrained.binning_time + retrained.growing_time;
+
+            total_update_time += htree.update_time;
+            total_retrain_time += retrain_time;
+
+            int agree = 0;
+            for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+            {
+                if (htree.predict(testing_data.ptr<float>(tsample))
+                        == retrained.predict(testing_data.ptr<float>(tsample)))
+                {
+                    agree++;
+                }
+            }
+
+            int updated_correct = test_tree(htree, testing_data, testing_classifications);
+            int retrained_correct = test_tree(retrained, testing_data, testing_classifications);
+
+            printf( "Samples %d - %d: update %g s (retrain %g s, x%g)\n"
+                    "\tupdated: %d nodes, correct classification %g%%\n"
+                    "\tretrained: %d nodes, correct classification %g%%\n"
+                    "\tagreement: %g%%, subtrees regrown: %d\n",
+                    begin, end - 1, htree.update_time, retrain_time,
+                    retrain_time / htree.update_time,
+                    htree.get_node_count(), (double) updated_correct*100/NUMBER_OF_TESTING_SAMPLES,
+                    retrained.get_node_count(), (double) retrained_correct*100/NUMBER_OF_TESTING_SAMPLES,
+                    (double) agree*100/NUMBER_OF_TESTING_SAMPLES, (int) htree.rebuilt.size());
+
+            for (size_t i = 0; i < htree.rebuilt.size(); i++)
+            {
+                const HistDTreeRebuild& r = htree.rebuilt[i];
+                printf( "\t\tdepth %d, %d samples: split on attribute %d -> %d, %d -> %d nodes\n",
+                        r.depth, r.sample_count, r.old_var, r.new_var, r.old_nodes, r.new_nodes);
+            }
+        }
+
+        printf( "\nTotal: update %g s, retrain %g s (x%g)\n",
+                total_update_time, total_retrain_time,
+                total_retrain_time / total_update_time);
+
+        // all matrix memory free by destructors
+
+        // all OK : main returns 0
+
+        return 0;
+    }
+
+    // not OK : main returns -1
+
+    printf("usage: %s training_data_file testing_data_file\n", argv[0]);
+    return -1;
+}
+/******************************************************************************/
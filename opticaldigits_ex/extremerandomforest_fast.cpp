@@ -0,0 +1,295 @@
+// Example : extremely random forest training with vectorised split evaluation
+// usage: prog training_data_file testing_data_file [forest_file.yml]
+
+// For use with test / training datasets : opticaldigits_ex
+
+// Trains a forest of 100 trees over the optical digits data with CvRTrees,
+// with CvERTrees and with FastERTrees (tools/fast_ertrees.h) - which keeps
+// the samples of each node grouped by class and evaluates the random split
+// of each attribute tried as one compare and count over the node's values -
+// both with scalar loops and with AVX2 (where the CPU supports it), comparing
+// the training time and the classification of the testing data. If a forest
+// file is given the FastERTrees forest is saved to it and read back with
+// CvERTrees::load(), checking that it then classifies identically.
+
+// Author : Toby Breckon, toby.breckon@cranfield.ac.uk
+
+// Copyright (c) 2012 School of Engineering, Cranfield University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+
+#include "../tools/fast_ertrees.h"
+
+/******************************************************************************/
+// global definitions (for speed and ease of use)
+
+#define NUMBER_OF_TRAINING_SAMPLES 3823
+#define ATTRIBUTES_PER_SAMPLE 64
+#define NUMBER_OF_TESTING_SAMPLES 1797
+
+#define NUMBER_OF_CLASSES 10
+
+// N.B. classes are integer handwritten digits in range 0-9
+
+/******************************************************************************/
+
+// loads the sample database from file (which is a CSV text file)
+
+int read_data_from_csv(const char* filename, Mat data, Mat classes,
+                       int n_samples )
+{
+    float tmp;
+
+    // if we can't read the input file then return 0
+    FILE* f = fopen( filename, "r" );
+    if( !f )
+    {
+        printf("ERROR: cannot read file %s\n",  filename);
+        return 0; // all not OK
+    }
+
+    // for each sample in the file
+
+    for(int line = 0; line < n_samples; line++)
+    {
+
+        // for each attribute on the line in the file
+
+        for(int attribute = 0; attribute < (ATTRIBUTES_PER_SAMPLE + 1); attribute++)
+        {
+            if (attribute < 64)
+            {
+
+                // first 64 elements (0-63) in each line are the attributes
+
+                fscanf(f, "%f,", &tmp);
+                data.at<float>(line, attribute) = tmp;
+                // printf("%f,", data.at<float>(line, attribute));
+
+            }
+            else if (attribute == 64)
+            {
+
+                // attribute 65 is the class label {0 ... 9}
+
+                fscanf(f, "%f,", &tmp);
+                classes.at<float>(line, 0) = tmp;
+                // printf("%f\n", classes.at<float>(line, 0));
+
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 1; // all OK
+}
+
+/******************************************************************************/
+
+// the percentage of the testing data correctly classified by a forest
+
+double test_accuracy(const CvRTrees* forest, const Mat& testing_data,
+                     const Mat& testing_classifications)
+{
+    int correct_class = 0;
+    for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+    {
+        if (fabs(forest->predict(testing_data.row(tsample), Mat())
+                 - testing_classifications.at<float>(tsample, 0)) < FLT_EPSILON)
+        {
+            correct_class++;
+        }
+    }
+    return (double) correct_class*100/NUMBER_OF_TESTING_SAMPLES;
+}
+
+/******************************************************************************/
+
+// train a FastERTrees forest, printing its training time and classification
+// of the testing data (returns false if it cannot be trained)
+
+bool train_fast_ertrees(FastERTrees& forest, const CvRTParams& params,
+                        const Mat& training_data, const Mat& training_classifications,
+                        const Mat& testing_data, const Mat& testing_classifications,
+                        double ertree_time)
+{
+    int64 start = getTickCount();
+    if (!forest.train(training_data, training_classifications, params))
+    {
+        printf("ERROR: cannot train the extremely random forest\n");
+        return false;
+    }
+    double forest_time = (double) (getTickCount() - start) / getTickFrequency();
+
+    int correct_class = 0;
+    for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+    {
+        if (fabs(forest.predict(testing_data.ptr<float>(tsample))
+                 - testing_classifications.at<float>(tsample, 0)) < FLT_EPSILON)
+        {
+            correct_class++;
+        }
+    }
+
+    printf( "FastERTrees %s (%d trees, %d nodes, %d threads): training %g s "
+            "(trees %g s, x%g CvERTrees), correct classification %g%%\n",
+            forest.is_simd_used() ? "AVX2" : "scalar",
+            forest.get_tree_count(), forest.get_node_count(), getNumThreads(),
+            forest_time, forest.grow_time, ertree_time / forest_time,
+            (double) correct_class*100/NUMBER_OF_TESTING_SAMPLES);
+
+    return true;
+}
+
+/******************************************************************************/
+
+int main( int argc, char** argv )
+{
+    // lets just check the version first
+
+    printf ("OpenCV version %s (%d.%d.%d)\n",
+            CV_VERSION,
+            CV_MAJOR_VERSION, CV_MINOR_VERSION, CV_SUBMINOR_VERSION);
+
+    // define training data storage matrices (one for attribute examples, one
+    // for classifications)
+
+    Mat training_data = Mat(NUMBER_OF_TRAINING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat training_classifications = Mat(NUMBER_OF_TRAINING_SAMPLES, 1, CV_32FC1);
+
+    //define testing data storage matrices
+
+    Mat testing_data = Mat(NUMBER_OF_TESTING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat testing_classifications = Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    // define all the attributes as numerical (with a categorical output)
+
+    Mat var_type = Mat(ATTRIBUTES_PER_SAMPLE + 1, 1, CV_8U );
+    var_type.setTo(Scalar(CV_VAR_NUMERICAL) ); // all inputs are numerical
+    var_type.at<uchar>(ATTRIBUTES_PER_SAMPLE, 0) = CV_VAR_CATEGORICAL;
+
+    // load training and testing data sets
+
+    if (((argc == 3) || (argc == 4)) &&
+            read_data_from_csv(argv[1], training_data, training_classifications, NUMBER_OF_TRAINING_SAMPLES) &&
+            read_data_from_csv(argv[2], testing_data, testing_classifications, NUMBER_OF_TESTING_SAMPLES))
+    {
+        // define the parameters for training the random forest (trees)
+
+        float priors[] = {1,1,1,1,1,1,1,1,1,1};  // weights of each classification for classes
+        // (all equal as equal samples of each digit)
+
+        CvRTParams params = CvRTParams(25, // max depth
+                                       5, // min sample count
+                                       0, // regression accuracy: N/A here
+                                       false, // compute surrogate split, no missing data
+                                       15, // max number of categories (use sub-optimal algorithm for larger numbers)
+                                       priors, // the array of priors
+                                       false,  // calculate variable importance
+                                       4,       // number of variables randomly selected at node and used to find the best split(s).
+                                       100,	 // max number of trees in the forest
+                                       0.01f,				// forrest accuracy
+                                       CV_TERMCRIT_ITER // termination cirteria (all of the trees)
+                                      );
+
+        printf( "\nUsing training database: %s\n", argv[1]);
+        printf( "Using testing database: %s\n\n", argv[2]);
+
+        // CvRTrees (best split of each attribute tried, bootstrap samples)
+
+        CvRTrees* rtree = new CvRTrees;
+
+        int64 start = getTickCount();
+        rtree->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                     Mat(), Mat(), var_type, Mat(), params);
+        double rtree_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        printf( "CvRTrees (%d trees): training %g s, correct classification %g%%\n",
+                rtree->get_tree_count(), rtree_time,
+                test_accuracy(rtree, testing_data, testing_classifications));
+
+        // CvERTrees (random split of each attribute tried)
+
+        CvERTrees* ertree = new CvERTrees;
+
+        start = getTickCount();
+        ertree->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                      Mat(), Mat(), var_type, Mat(), params);
+        double ertree_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        printf( "CvERTrees (%d trees): training %g s, correct classification %g%%\n",
+                ertree->get_tree_count(), ertree_time,
+                test_accuracy(ertree, testing_data, testing_classifications));
+
+        // FastERTrees, scalar then (where supported) AVX2 split evaluation -
+        // the same forest (the same seed) either way
+
+        FastERTrees scalar_forest;
+        scalar_forest.use_simd = false;
+
+        FastERTrees forest;
+
+        if (!train_fast_ertrees(scalar_forest, params, training_data, training_classifications,
+                                testing_data, testing_classifications, ertree_time)
+                || !train_fast_ertrees(forest, params, training_data, training_classifications,
+                                       testing_data, testing_classifications, ertree_time))
+        {
+            delete rtree;
+            delete ertree;
+            return -1;
+        }
+
+        // save the forest and read it back as a CvERTrees
+
+        if (argc == 4)
+        {
+            if (!forest.save(argv[3]))
+            {
+                printf("ERROR: cannot save the forest to %s\n", argv[3]);
+                delete rtree;
+                delete ertree;
+                return -1;
+            }
+
+            CvERTrees* loaded = new CvERTrees;
+            loaded->load(argv[3]);
+
+            int mismatches = 0;
+            for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+            {
+                if (loaded->predict(testing_data.row(tsample), Mat())
+                        != forest.predict(testing_data.ptr<float>(tsample)))
+                {
+                    mismatches++;
+                }
+            }
+
+            printf( "\nForest saved to %s and loaded by CvERTrees (%d trees): mismatches %d\n",
+                    argv[3], loaded->get_tree_count(), mismatches);
+
+            delete loaded;
+        }
+
+        delete rtree;
+        delete ertree;
+
+        // all matrix memory free by destructors
+
+        // all OK : main returns 0
+
+        return 0;
+    }
+
+    // not OK : main returns -1
+
+    printf("usage: %s training_data_file testing_data_file [forest_file.yml]\n", argv[0]);
+    return -1;
+}
+/******************************************************************************/
@@ -0,0 +1,263 @@
+// Example : batched random forest prediction with early exit voting
+// usage: prog training_data_file testing_data_file
+
+// For use with test / training datasets : opticaldigits_ex
+
+// Trains the random forest of randomforest.cpp and the extremely random forest
+// of extremerandomforest.cpp (up to 100 trees each) and classifies the testing
+// data with each both a row at a time with CvRTrees::predict() and in batches
+// with FlatForest (tools/flat_forest.h) - which spreads blocks of rows across
+// the threads and stops evaluating the trees for a row once its vote is
+// decided.
+// The prediction time, the mean number of trees evaluated per sample and any
+// difference in the classifications are reported.
+
+// Author : Toby Breckon, toby.breckon@cranfield.ac.uk
+
+// Copyright (c) 2011 School of Engineering, Cranfield University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+
+#include "../tools/flat_forest.h"
+
+/******************************************************************************/
+// global definitions (for speed and ease of use)
+
+#define NUMBER_OF_TRAINING_SAMPLES 3823
+#define ATTRIBUTES_PER_SAMPLE 64
+#define NUMBER_OF_TESTING_SAMPLES 1797
+
+#define NUMBER_OF_CLASSES 10
+
+#define NUMBER_OF_REPEATS 10 // predictions of the testing data timed
+
+// N.B. classes are integer handwritten digits in range 0-9
+
+/******************************************************************************/
+
+// loads the sample database from file (which is a CSV text file)
+
+int read_data_from_csv(const char* filename, Mat data, Mat classes,
+                       int n_samples )
+{
+    float tmp;
+
+    // if we can't read the input file then return 0
+    FILE* f = fopen( filename, "r" );
+    if( !f )
+    {
+        printf("ERROR: cannot read file %s\n",  filename);
+        return 0; // all not OK
+    }
+
+    // for each sample in the file
+
+    for(int line = 0; line < n_samples; line++)
+    {
+
+        // for each attribute on the line in the file
+
+        for(int attribute = 0; attribute < (ATTRIBUTES_PER_SAMPLE + 1); attribute++)
+        {
+            if (attribute < 64)
+            {
+
+                // first 64 elements (0-63) in each line are the attributes
+
+                fscanf(f, "%f,", &tmp);
+                data.at<float>(line, attribute) = tmp;
+                // printf("%f,", data.at<float>(line, attribute));
+
+            }
+            else if (attribute == 64)
+            {
+
+                // attribute 65 is the class label {0 ... 9}
+
+                fscanf(f, "%f,", &tmp);
+                classes.at<float>(line, 0) = tmp;
+                // printf("%f\n", classes.at<float>(line, 0));
+
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 1; // all OK
+}
+
+/******************************************************************************/
+
+// classify the testing data with a forest both row by row (CvRTrees) and in
+// batches (FlatForest) reporting the time taken and the agreement
+
+void compare_predictions(const char* name, const CvRTrees* forest,
+                         const Mat& testing_data, const Mat& testing_classifications)
+{
+    // row by row with CvRTrees::predict()
+
+    Mat results = Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    int64 start = getTickCount();
+    for (int repeat = 0; repeat < NUMBER_OF_REPEATS; repeat++)
+    {
+        for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+        {
+            results.at<float>(tsample, 0) = forest->predict(testing_data.row(tsample), Mat());
+        }
+    }
+    double forest_time = (double) (getTickCount() - start) / getTickFrequency();
+
+    int correct_class = 0;
+    for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+    {
+        if (fabs(results.at<float>(tsample, 0) - testing_classifications.at<float>(tsample, 0))
+                < FLT_EPSILON)
+        {
+            correct_class++;
+        }
+    }
+
+    printf( "%s (%d trees): correct classification %g%%\n"
+            "\tCvRTrees::predict() row by row: %g s\n",
+            name, forest->get_tree_count(),
+            (double) correct_class*100/NUMBER_OF_TESTING_SAMPLES,
+            forest_time / NUMBER_OF_REPEATS);
+
+    // in batches with FlatForest, all of the trees then with early exit on
+    // one thread and on all of them
+
+    FlatForest fforest;
+    if (!fforest.build(forest))
+    {
+        printf("ERROR: cannot flatten the trees of the forest\n");
+        return;
+    }
+
+    int n_threads = getNumThreads();
+    const char* modes[] = { "all trees", "early exit", "early exit" };
+    bool early_exit[] = { false, true, true };
+    int threads[] = { 1, 1, n_threads };
+
+    for (int m = 0; m < 3; m++)
+    {
+        setNumThreads(threads[m]);
+
+        Mat batch_results;
+        double mean_trees = 0;
+
+        start = getTickCount();
+        for (int repeat = 0; repeat < NUMBER_OF_REPEATS; repeat++)
+        {
+            mean_trees = fforest.predict(testing_data, batch_results, early_exit[m]);
+        }
+        double batch_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        int mismatches = 0;
+        for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+        {
+            if (batch_results.at<float>(tsample, 0) != results.at<float>(tsample, 0))
+            {
+                mismatches++;
+            }
+        }
+
+        printf( "\tFlatForest batch, %s (%d threads): %g s (x%g), "
+                "mean trees evaluated %g, mismatches %d\n",
+                modes[m], threads[m], batch_time / NUMBER_OF_REPEATS,
+                forest_time / batch_time, mean_trees, mismatches);
+    }
+
+    setNumThreads(n_threads);
+}
+
+/******************************************************************************/
+
+int main( int argc, char** argv )
+{
+    // lets just check the version first
+
+    printf ("OpenCV version %s (%d.%d.%d)\n",
+            CV_VERSION,
+            CV_MAJOR_VERSION, CV_MINOR_VERSION, CV_SUBMINOR_VERSION);
+
+    // define training data storage matrices (one for attribute examples, one
+    // for classifications)
+
+    Mat training_data = Mat(NUMBER_OF_TRAINING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat training_classifications = Mat(NUMBER_OF_TRAINING_SAMPLES, 1, CV_32FC1);
+
+    //define testing data storage matrices
+
+    Mat testing_data = Mat(NUMBER_OF_TESTING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat testing_classifications = Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    // define all the attributes as numerical (with a categorical output, as
+    // randomforest.cpp)
+
+    Mat var_type = Mat(ATTRIBUTES_PER_SAMPLE + 1, 1, CV_8U );
+    var_type.setTo(Scalar(CV_VAR_NUMERICAL) ); // all inputs are numerical
+    var_type.at<uchar>(ATTRIBUTES_PER_SAMPLE, 0) = CV_VAR_CATEGORICAL;
+
+    // load training and testing data sets
+
+    if ((argc == 3) &&
+            read_data_from_csv(argv[1], training_data, training_classifications, NUMBER_OF_TRAINING_SAMPLES) &&
+            read_data_from_csv(argv[2], testing_data, testing_classifications, NUMBER_OF_TESTING_SAMPLES))
+    {
+        // define the parameters for training the forests (as randomforest.cpp)
+
+        float priors[] = {1,1,1,1,1,1,1,1,1,1};  // weights of each classification for classes
+        // (all equal as equal samples of each digit)
+
+        CvRTParams params = CvRTParams(25, // max depth
+                                       5, // min sample count
+                                       0, // regression accuracy: N/A here
+                                       false, // compute surrogate split, no missing data
+                                       15, // max number of categories (use sub-optimal algorithm for larger numbers)
+                                       priors, // the array of priors
+                                       false,  // calculate variable importance
+                                       4,       // number of variables randomly selected at node and used to find the best split(s).
+                                       100,	 // max number of trees in the forest
+                                       0.01f,				// forrest accuracy
+                                       CV_TERMCRIT_ITER |	CV_TERMCRIT_EPS // termination cirteria
+                                      );
+
+        printf( "\nUsing training database: %s\n", argv[1]);
+        printf( "Using testing database: %s\n\n", argv[2]);
+
+        CvRTrees* rtree = new CvRTrees;
+        rtree->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                     Mat(), Mat(), var_type, Mat(), params);
+
+        compare_predictions("Random forest", rtree, testing_data, testing_classifications);
+
+        CvERTrees* ertree = new CvERTrees;
+        ertree->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                      Mat(), Mat(), var_type, Mat(), params);
+
+        compare_predictions("Extremely random forest", ertree, testing_data, testing_classifications);
+
+        delete rtree;
+        delete ertree;
+
+        // all matrix memory free by destructors
+
+        // all OK : main returns 0
+
+        return 0;
+    }
+
+    // not OK : main returns -1
+
+    printf("usage: %s training_data_file testing_data_file\n", argv[0]);
+    return -1;
+}
+/******************************************************************************/
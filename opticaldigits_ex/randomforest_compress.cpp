@@ -0,0 +1,288 @@
+// Example : random forest model compression
+// usage: prog training_data_file testing_data_file
+
+// For use with test / training datasets : opticaldigits_ex
+
+// Trains the random forest of randomforest.cpp and the extremely random forest
+// of extremerandomforest.cpp (up to 100 trees each) and compresses each with
+// CompactForest (tools/compact_forest.h) - thresholds quantized to 8 bit bins
+// of the 0 .. 16 attribute values, unreachable branches dropped and identical
+// subtrees shared across the trees. The memory used by the forest before
+// (CvRTrees nodes and splits, and flattened as tools/flat_forest.h) and after
+// compression is reported and the compressed forest checked to classify the
+// training and testing data exactly as CvRTrees::predict().
+
+// Author : Toby Breckon, toby.breckon@cranfield.ac.uk
+
+// Copyright (c) 2011 School of Engineering, Cranfield University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+
+#include "../tools/flat_forest.h"
+#include "../tools/compact_forest.h"
+
+/******************************************************************************/
+// global definitions (for speed and ease of use)
+
+#define NUMBER_OF_TRAINING_SAMPLES 3823
+#define ATTRIBUTES_PER_SAMPLE 64
+#define NUMBER_OF_TESTING_SAMPLES 1797
+
+#define NUMBER_OF_CLASSES 10
+
+// N.B. classes are integer handwritten digits in range 0-9
+
+/******************************************************************************/
+
+// loads the sample database from file (which is a CSV text file)
+
+int read_data_from_csv(const char* filename, Mat data, Mat classes,
+                       int n_samples )
+{
+    float tmp;
+
+    // if we can't read the input file then return 0
+    FILE* f = fopen( filename, "r" );
+    if( !f )
+    {
+        printf("ERROR: cannot read file %s\n",  filename);
+        return 0; // all not OK
+    }
+
+    // for each sample in the file
+
+    for(int line = 0; line < n_samples; line++)
+    {
+
+        // for each attribute on the line in the file
+
+        for(int attribute = 0; attribute < (ATTRIBUTES_PER_SAMPLE + 1); attribute++)
+        {
+            if (attribute < 64)
+            {
+
+                // first 64 elements (0-63) in each line are the attributes
+
+                fscanf(f, "%f,", &tmp);
+                data.at<float>(line, attribute) = tmp;
+                // printf("%f,", data.at<float>(line, attribute));
+
+            }
+            else if (attribute == 64)
+            {
+
+                // attribute 65 is the class label {0 ... 9}
+
+                fscanf(f, "%f,", &tmp);
+                classes.at<float>(line, 0) = tmp;
+                // printf("%f\n", classes.at<float>(line, 0));
+
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 1; // all OK
+}
+
+/******************************************************************************/
+
+// number of results that differ between two predictions of the same data
+
+int count_mismatches(const Mat& results1, const Mat& results2)
+{
+    int mismatches = 0;
+    for (int tsample = 0; tsample < results1.rows; tsample++)
+    {
+        if (results1.at<float>(tsample, 0) != results2.at<float>(tsample, 0))
+        {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+/******************************************************************************/
+
+// classify data with a forest row by row (CvRTrees::predict()) - returns the
+// number classified correctly
+
+int test_forest(const CvRTrees* forest, const Mat& data, const Mat& classifications,
+                Mat& results)
+{
+    int correct_class = 0;
+
+    results = Mat(data.rows, 1, CV_32FC1);
+    for (int tsample = 0; tsample < data.rows; tsample++)
+    {
+        results.at<float>(tsample, 0) = forest->predict(data.row(tsample), Mat());
+        if (fabs(results.at<float>(tsample, 0) - classifications.at<float>(tsample, 0))
+                < FLT_EPSILON)
+        {
+            correct_class++;
+        }
+    }
+
+    return correct_class;
+}
+
+/******************************************************************************/
+
+// compress a forest reporting its memory before and after and checking the
+// classifications of the training and testing data are unchanged
+
+void compress_forest(const char* name, const CvRTrees* forest,
+                     const Mat& training_data, const Mat& training_classifications,
+                     const Mat& testing_data, const Mat& testing_classifications)
+{
+    // the forest as trained (CvDTreeNode / CvDTreeSplit) and flattened
+
+    size_t forest_bytes = 0;
+    for (int k = 0; k < forest->get_tree_count(); k++)
+    {
+        forest_bytes += CompactForest::get_tree_size_bytes(forest->get_tree(k)->get_root());
+    }
+
+    FlatForest fforest;
+    CompactForest cforest;
+    if (!fforest.build(forest) || !cforest.build(forest, training_data))
+    {
+        printf("ERROR: cannot compress the trees of the forest\n");
+        return;
+    }
+
+    size_t flat_bytes = 0;
+    for (int k = 0; k < fforest.get_tree_count(); k++)
+    {
+        flat_bytes += fforest.get_tree(k).get_size_bytes();
+    }
+
+    // classify with both
+
+    Mat training_results, testing_results;
+    test_forest(forest, training_data, training_classifications, training_results);
+
+    int64 start = getTickCount();
+    int correct_class = test_forest(forest, testing_data, testing_classifications,
+                                    testing_results);
+    double forest_time = (double) (getTickCount() - start) / getTickFrequency();
+
+    Mat compact_training_results, compact_testing_results;
+    cforest.predict(training_data, compact_training_results);
+
+    start = getTickCount();
+    cforest.predict(testing_data, compact_testing_results);
+    double compact_time = (double) (getTickCount() - start) / getTickFrequency();
+
+    printf( "%s (%d trees): correct classification %g%%\n"
+            "\tCvRTrees: %d nodes, %g KB\n"
+            "\tflattened: %g KB\n"
+            "\tcompressed: %d nodes (%d tests dropped, %d subtrees shared), "
+            "at most %d bins per attribute, %g KB (x%g smaller, x%g on flattened)\n"
+            "\tmismatches: training data %d, testing data %d\n"
+            "\tprediction time: CvRTrees %g s, compressed %g s\n\n",
+            name, forest->get_tree_count(),
+            (double) correct_class*100/NUMBER_OF_TESTING_SAMPLES,
+            cforest.get_source_node_count(), (double) forest_bytes / 1024,
+            (double) flat_bytes / 1024,
+            cforest.get_node_count(), cforest.get_decided_count(), cforest.get_shared_count(),
+            cforest.get_max_bins(), (double) cforest.get_size_bytes() / 1024,
+            (double) forest_bytes / cforest.get_size_bytes(),
+            (double) flat_bytes / cforest.get_size_bytes(),
+            count_mismatches(training_results, compact_training_results),
+            count_mismatches(testing_results, compact_testing_results),
+            forest_time, compact_time);
+}
+
+/******************************************************************************/
+
+int main( int argc, char** argv )
+{
+    // lets just check the version first
+
+    printf ("OpenCV version %s (%d.%d.%d)\n",
+            CV_VERSION,
+            CV_MAJOR_VERSION, CV_MINOR_VERSION, CV_SUBMINOR_VERSION);
+
+    // define training data storage matrices (one for attribute examples, one
+    // for classifications)
+
+    Mat training_data = Mat(NUMBER_OF_TRAINING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat training_classifications = Mat(NUMBER_OF_TRAINING_SAMPLES, 1, CV_32FC1);
+
+    //define testing data storage matrices
+
+    Mat testing_data = Mat(NUMBER_OF_TESTING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat testing_classifications = Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    // define all the attributes as numerical (with a categorical output, as
+    // randomforest.cpp)
+
+    Mat var_type = Mat(ATTRIBUTES_PER_SAMPLE + 1, 1, CV_8U );
+    var_type.setTo(Scalar(CV_VAR_NUMERICAL) ); // all inputs are numerical
+    var_type.at<uchar>(ATTRIBUTES_PER_SAMPLE, 0) = CV_VAR_CATEGORICAL;
+
+    // load training and testing data sets
+
+    if ((argc == 3) &&
+            read_data_from_csv(argv[1], training_data, training_classifications, NUMBER_OF_TRAINING_SAMPLES) &&
+            read_data_from_csv(argv[2], testing_data, testing_classifications, NUMBER_OF_TESTING_SAMPLES))
+    {
+        // define the parameters for training the forests (as randomforest.cpp)
+
+        float priors[] = {1,1,1,1,1,1,1,1,1,1};  // weights of each classification for classes
+        // (all equal as equal samples of each digit)
+
+        CvRTParams params = CvRTParams(25, // max depth
+                                       5, // min sample count
+                                       0, // regression accuracy: N/A here
+                                       false, // compute surrogate split, no missing data
+                                       15, // max number of categories (use sub-optimal algorithm for larger numbers)
+                                       priors, // the array of priors
+                                       false,  // calculate variable importance
+                                       4,       // number of variables randomly selected at node and used to find the best split(s).
+                                       100,	 // max number of trees in the forest
+                                       0.01f,				// forrest accuracy
+                                       CV_TERMCRIT_ITER |	CV_TERMCRIT_EPS // termination cirteria
+                                      );
+
+        printf( "\nUsing training database: %s\n", argv[1]);
+        printf( "Using testing database: %s\n\n", argv[2]);
+
+        CvRTrees* rtree = new CvRTrees;
+        rtree->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                     Mat(), Mat(), var_type, Mat(), params);
+
+        compress_forest("Random forest", rtree, training_data, training_classifications,
+                        testing_data, testing_classifications);
+
+        CvERTrees* ertree = new CvERTrees;
+        ertree->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                      Mat(), Mat(), var_type, Mat(), params);
+
+        compress_forest("Extremely random forest", ertree, training_data, training_classifications,
+                        testing_data, testing_classifications);
+
+        delete rtree;
+        delete ertree;
+
+        // all matrix memory free by destructors
+
+        // all OK : main returns 0
+
+        return 0;
+    }
+
+    // not OK : main returns -1
+
+    printf("usage: %s training_data_file testing_data_file\n", argv[0]);
+    return -1;
+}
+/******************************************************************************/
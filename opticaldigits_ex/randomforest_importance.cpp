@@ -0,0 +1,255 @@
+// Example : random forest (tree) variable importance computed after training
+// usage: prog training_data_file testing_data_file [forest_file.yml]
+
+// For use with test / training datasets : opticaldigits_ex
+
+// Trains the forest of randomforest.cpp with CvRTrees, without and with its
+// variable importance (calc_var_importance, computed as each tree is grown),
+// and with ParallelRTrees (tools/parallel_rtrees.h), which computes the
+// variable importance in a separate parallel pass once the trees are grown -
+// the out of bag permutation importance (as CvRTrees) and the Gini (split
+// quality) importance. The training times are compared and the importance of
+// each attribute reported. If a forest file is given the ParallelRTrees
+// forest is saved to it with both its permutation and Gini importance, which
+// tools/dt_varimportance then reports.
+
+// Author : Toby Breckon, toby.breckon@cranfield.ac.uk
+
+// Copyright (c) 2011 School of Engineering, Cranfield University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+
+#include "../tools/parallel_rtrees.h"
+
+/******************************************************************************/
+// global definitions (for speed and ease of use)
+
+#define NUMBER_OF_TRAINING_SAMPLES 3823
+#define ATTRIBUTES_PER_SAMPLE 64
+#define NUMBER_OF_TESTING_SAMPLES 1797
+
+#define NUMBER_OF_CLASSES 10
+
+// N.B. classes are integer handwritten digits in range 0-9
+
+/******************************************************************************/
+
+// loads the sample database from file (which is a CSV text file)
+
+int read_data_from_csv(const char* filename, Mat data, Mat classes,
+                       int n_samples )
+{
+    float tmp;
+
+    // if we can't read the input file then return 0
+    FILE* f = fopen( filename, "r" );
+    if( !f )
+    {
+        printf("ERROR: cannot read file %s\n",  filename);
+        return 0; // all not OK
+    }
+
+    // for each sample in the file
+
+    for(int line = 0; line < n_samples; line++)
+    {
+
+        // for each attribute on the line in the file
+
+        for(int attribute = 0; attribute < (ATTRIBUTES_PER_SAMPLE + 1); attribute++)
+        {
+            if (attribute < 64)
+            {
+
+                // first 64 elements (0-63) in each line are the attributes
+
+                fscanf(f, "%f,", &tmp);
+                data.at<float>(line, attribute) = tmp;
+                // printf("%f,", data.at<float>(line, attribute));
+
+            }
+            else if (attribute == 64)
+            {
+
+                // attribute 65 is the class label {0 ... 9}
+
+                fscanf(f, "%f,", &tmp);
+                classes.at<float>(line, 0) = tmp;
+                // printf("%f\n", classes.at<float>(line, 0));
+
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 1; // all OK
+}
+
+/******************************************************************************/
+
+// classify the testing data with a forest - returns the percentage correct
+
+double test_forest(const CvRTrees* forest, const Mat& testing_data,
+                   const Mat& testing_classifications)
+{
+    int correct_class = 0;
+    for (int tsample = 0; tsample < testing_data.rows; tsample++)
+    {
+        if (fabs(forest->predict(testing_data.row(tsample), Mat())
+                 - testing_classifications.at<float>(tsample, 0)) < FLT_EPSILON)
+        {
+            correct_class++;
+        }
+    }
+    return (double) correct_class*100/testing_data.rows;
+}
+
+/******************************************************************************/
+
+int main( int argc, char** argv )
+{
+    // lets just check the version first
+
+    printf ("OpenCV version %s (%d.%d.%d)\n",
+            CV_VERSION,
+            CV_MAJOR_VERSION, CV_MINOR_VERSION, CV_SUBMINOR_VERSION);
+
+    // define training data storage matrices (one for attribute examples, one
+    // for classifications)
+
+    Mat training_data = Mat(NUMBER_OF_TRAINING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat training_classifications = Mat(NUMBER_OF_TRAINING_SAMPLES, 1, CV_32FC1);
+
+    //define testing data storage matrices
+
+    Mat testing_data = Mat(NUMBER_OF_TESTING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat testing_classifications = Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    // define all the attributes as numerical (with a categorical output, as
+    // randomforest.cpp)
+
+    Mat var_type = Mat(ATTRIBUTES_PER_SAMPLE + 1, 1, CV_8U );
+    var_type.setTo(Scalar(CV_VAR_NUMERICAL) ); // all inputs are numerical
+    var_type.at<uchar>(ATTRIBUTES_PER_SAMPLE, 0) = CV_VAR_CATEGORICAL;
+
+    // load training and testing data sets
+
+    if (((argc == 3) || (argc == 4)) &&
+            read_data_from_csv(argv[1], training_data, training_classifications, NUMBER_OF_TRAINING_SAMPLES) &&
+            read_data_from_csv(argv[2], testing_data, testing_classifications, NUMBER_OF_TESTING_SAMPLES))
+    {
+        // define the parameters for training the random forest (as
+        // randomforest.cpp, all of the trees)
+
+        float priors[] = {1,1,1,1,1,1,1,1,1,1};  // weights of each classification for classes
+        // (all equal as equal samples of each digit)
+
+        CvRTParams params = CvRTParams(25, // max depth
+                                       5, // min sample count
+                                       0, // regression accuracy: N/A here
+                                       false, // compute surrogate split, no missing data
+                                       15, // max number of categories (use sub-optimal algorithm for larger numbers)
+                                       priors, // the array of priors
+                                       false,  // calculate variable importance
+                                       4,       // number of variables randomly selected at node and used to find the best split(s).
+                                       100,	 // max number of trees in the forest
+                                       0.01f,				// forrest accuracy
+                                       CV_TERMCRIT_ITER // termination cirteria (all of the trees)
+                                      );
+
+        printf( "\nUsing training database: %s\n", argv[1]);
+        printf( "Using testing database: %s\n\n", argv[2]);
+
+        // CvRTrees without, then with, the variable importance
+
+        CvRTrees* plain = new CvRTrees;
+
+        int64 start = getTickCount();
+        plain->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                     Mat(), Mat(), var_type, Mat(), params);
+        double plain_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        printf( "CvRTrees (%d trees, no variable importance): training %g s, "
+                "correct classification %g%%\n", plain->get_tree_count(), plain_time,
+                test_forest(plain, testing_data, testing_classifications));
+
+        params.calc_var_importance = true;
+
+        CvRTrees* rtree = new CvRTrees;
+
+        start = getTickCount();
+        rtree->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                     Mat(), Mat(), var_type, Mat(), params);
+        double rtree_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        printf( "CvRTrees (%d trees, variable importance): training %g s (x%g), "
+                "correct classification %g%%\n", rtree->get_tree_count(), rtree_time,
+                rtree_time / plain_time,
+                test_forest(rtree, testing_data, testing_classifications));
+
+        // ParallelRTrees (variable importance in a separate pass)
+
+        ParallelRTrees* forest = new ParallelRTrees;
+
+        start = getTickCount();
+        forest->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                      Mat(), Mat(), var_type, Mat(), params);
+        double forest_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        printf( "ParallelRTrees (%d trees, %d threads, variable importance): training %g s "
+                "(trees %g s, importance %g s), correct classification %g%%\n",
+                forest->get_tree_count(), getNumThreads(), forest_time,
+                forest->grow_time, forest->importance_time,
+                test_forest(forest, testing_data, testing_classifications));
+
+        // the importance of each attribute
+
+        const CvMat* rtree_importance = rtree->get_var_importance();
+        const CvMat* forest_importance = forest->get_var_importance();
+        const std::vector<double>& gini_importance = forest->get_gini_importance();
+
+        printf( "\nVariable importance (%%) : CvRTrees permutation, ParallelRTrees "
+                "permutation, ParallelRTrees Gini\n");
+
+        for (int i = 0; rtree_importance && forest_importance
+                && (i < forest_importance->cols); i++)
+        {
+            printf( "var #%d: %g%% %g%% %g%%\n", i,
+                    cvGetReal1D(rtree_importance, i)*100.,
+                    cvGetReal1D(forest_importance, i)*100.,
+                    gini_importance[i]*100.);
+        }
+
+        // save the forest with its variable importance (both)
+
+        if (argc == 4)
+        {
+            forest->save(argv[3]);
+            printf( "\nForest saved to %s (its variable importance is reported by dt_varimportance %s)\n",
+                    argv[3], argv[3]);
+        }
+
+        delete plain;
+        delete rtree;
+        delete forest;
+
+        // all matrix memory free by destructors
+
+        // all OK : main returns 0
+
+        return 0;
+    }
+
+    // not OK : main returns -1
+
+    printf("usage: %s training_data_file testing_data_file [forest_file.yml]\n", argv[0]);
+    return -1;
+}
+/******************************************************************************/
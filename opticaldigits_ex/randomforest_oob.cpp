@@ -0,0 +1,239 @@
+// Example : random forest (tree) learning stopped once the out of bag error
+// settles
+// usage: prog training_data_file testing_data_file
+
+// For use with test / training datasets : opticaldigits_ex
+
+// Trains the forest of randomforest.cpp with ParallelRTrees
+// (tools/parallel_rtrees.h) for up to 200 trees, the out of bag error of the
+// forest being reported as each tree is added and the growth stopped once it
+// has settled (changed by no more than 0.1% over the last 10 trees). The
+// forest is then compared with one grown to all 200 trees - the trees, the
+// training time and the classification of the testing data.
+
+// Author : Toby Breckon, toby.breckon@cranfield.ac.uk
+
+// Copyright (c) 2011 School of Engineering, Cranfield University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+
+#include "../tools/parallel_rtrees.h"
+
+/******************************************************************************/
+// global definitions (for speed and ease of use)
+
+#define NUMBER_OF_TRAINING_SAMPLES 3823
+#define ATTRIBUTES_PER_SAMPLE 64
+#define NUMBER_OF_TESTING_SAMPLES 1797
+
+#define NUMBER_OF_CLASSES 10
+
+#define MAX_NUMBER_OF_TREES 200
+
+// N.B. classes are integer handwritten digits in range 0-9
+
+/******************************************************************************/
+
+// loads the sample database from file (which is a CSV text file)
+
+int read_data_from_csv(const char* filename, Mat data, Mat classes,
+                       int n_samples )
+{
+    float tmp;
+
+    // if we can't read the input file then return 0
+    FILE* f = fopen( filename, "r" );
+    if( !f )
+    {
+        printf("ERROR: cannot read file %s\n",  filename);
+        return 0; // all not OK
+    }
+
+    // for each sample in the file
+
+    for(int line = 0; line < n_samples; line++)
+    {
+
+        // for each attribute on the line in the file
+
+        for(int attribute = 0; attribute < (ATTRIBUTES_PER_SAMPLE + 1); attribute++)
+        {
+            if (attribute < 64)
+            {
+
+                // first 64 elements (0-63) in each line are the attributes
+
+                fscanf(f, "%f,", &tmp);
+                data.at<float>(line, attribute) = tmp;
+                // printf("%f,", data.at<float>(line, attribute));
+
+            }
+            else if (attribute == 64)
+            {
+
+                // attribute 65 is the class label {0 ... 9}
+
+                fscanf(f, "%f,", &tmp);
+                classes.at<float>(line, 0) = tmp;
+                // printf("%f\n", classes.at<float>(line, 0));
+
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 1; // all OK
+}
+
+/******************************************************************************/
+
+// classify the testing data with a forest - returns the percentage correct
+
+double test_forest(const CvRTrees* forest, const Mat& testing_data,
+                   const Mat& testing_classifications)
+{
+    int correct_class = 0;
+    for (int tsample = 0; tsample < testing_data.rows; tsample++)
+    {
+        if (fabs(forest->predict(testing_data.row(tsample), Mat())
+                 - testing_classifications.at<float>(tsample, 0)) < FLT_EPSILON)
+        {
+            correct_class++;
+        }
+    }
+    return (double) correct_class*100/testing_data.rows;
+}
+
+/******************************************************************************/
+
+// reports the out of bag error as each tree is added (every 5th tree)
+
+void report_oob_error(int ntrees, float oob_error, void* /* user_data */)
+{
+    if ((ntrees == 1) || ((ntrees % 5) == 0))
+    {
+        printf("\t%3d trees: out of bag error %.4f%%\n", ntrees, oob_error * 100);
+    }
+}
+
+/******************************************************************************/
+
+int main( int argc, char** argv )
+{
+    // lets just check the version first
+
+    printf ("OpenCV version %s (%d.%d.%d)\n",
+            CV_VERSION,
+            CV_MAJOR_VERSION, CV_MINOR_VERSION, CV_SUBMINOR_VERSION);
+
+    // define training data storage matrices (one for attribute examples, one
+    // for classifications)
+
+    Mat training_data = Mat(NUMBER_OF_TRAINING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat training_classifications = Mat(NUMBER_OF_TRAINING_SAMPLES, 1, CV_32FC1);
+
+    //define testing data storage matrices
+
+    Mat testing_data = Mat(NUMBER_OF_TESTING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat testing_classifications = Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    // define all the attributes as numerical (with a categorical output, as
+    // randomforest.cpp)
+
+    Mat var_type = Mat(ATTRIBUTES_PER_SAMPLE + 1, 1, CV_8U );
+    var_type.setTo(Scalar(CV_VAR_NUMERICAL) ); // all inputs are numerical
+    var_type.at<uchar>(ATTRIBUTES_PER_SAMPLE, 0) = CV_VAR_CATEGORICAL;
+
+    // load training and testing data sets
+
+    if ((argc == 3) &&
+            read_data_from_csv(argv[1], training_data, training_classifications, NUMBER_OF_TRAINING_SAMPLES) &&
+            read_data_from_csv(argv[2], testing_data, testing_classifications, NUMBER_OF_TESTING_SAMPLES))
+    {
+        // define the parameters for training the random forest (as
+        // randomforest.cpp, stopping on the out of bag error)
+
+        float priors[] = {1,1,1,1,1,1,1,1,1,1};  // weights of each classification for classes
+        // (all equal as equal samples of each digit)
+
+        CvRTParams params = CvRTParams(25, // max depth
+                                       5, // min sample count
+                                       0, // regression accuracy: N/A here
+                                       false, // compute surrogate split, no missing data
+                                       15, // max number of categories (use sub-optimal algorithm for larger numbers)
+                                       priors, // the array of priors
+                                       false,  // calculate variable importance
+                                       4,       // number of variables randomly selected at node and used to find the best split(s).
+                                       MAX_NUMBER_OF_TREES,	 // max number of trees in the forest
+                                       0.01f,				// forrest accuracy
+                                       CV_TERMCRIT_ITER |	CV_TERMCRIT_EPS // termination cirteria
+                                      );
+
+        printf( "\nUsing training database: %s\n", argv[1]);
+        printf( "Using testing database: %s\n\n", argv[2]);
+
+        // grow the forest until the out of bag error settles
+
+        ParallelRTrees* stopped = new ParallelRTrees;
+        stopped->oob_window = 10;
+        stopped->oob_tolerance = 0.001f;
+        stopped->set_oob_callback(report_oob_error);
+
+        printf( "Growing the forest (stopping once the out of bag error changes by "
+                "<= %g%% over %d trees):\n", stopped->oob_tolerance * 100, stopped->oob_window);
+
+        int64 start = getTickCount();
+        stopped->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                       Mat(), Mat(), var_type, Mat(), params);
+        double stopped_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        const std::vector<float>& oob_errors = stopped->get_oob_errors();
+        printf( "\nStopped at %d trees (of up to %d) in %g s: out of bag error %.4f%%, "
+                "correct classification %g%%\n",
+                stopped->get_tree_count(), MAX_NUMBER_OF_TREES, stopped_time,
+                oob_errors.empty() ? 0 : oob_errors.back() * 100,
+                test_forest(stopped, testing_data, testing_classifications));
+
+        // grow all of the trees (tracking the out of bag error, not stopping)
+
+        params.term_crit.type = CV_TERMCRIT_ITER;
+
+        ParallelRTrees* full = new ParallelRTrees;
+        full->set_oob_callback(report_oob_error);
+
+        printf( "\nGrowing all %d trees:\n", MAX_NUMBER_OF_TREES);
+
+        start = getTickCount();
+        full->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                    Mat(), Mat(), var_type, Mat(), params);
+        double full_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        printf( "\nAll %d trees in %g s (x%g the time): out of bag error %.4f%%, "
+                "correct classification %g%%\n",
+                full->get_tree_count(), full_time, full_time / stopped_time,
+                full->get_oob_errors().back() * 100,
+                test_forest(full, testing_data, testing_classifications));
+
+        delete stopped;
+        delete full;
+
+        // all matrix memory free by destructors
+
+        // all OK : main returns 0
+
+        return 0;
+    }
+
+    // not OK : main returns -1
+
+    printf("usage: %s training_data_file testing_data_file\n", argv[0]);
+    return -1;
+}
+/******************************************************************************/
@@ -0,0 +1,288 @@
+// Example : random forest (tree) learning with the trees trained in parallel
+// usage: prog training_data_file testing_data_file [forest_file.yml]
+
+// For use with test / training datasets : opticaldigits_ex
+
+// Trains the forest of randomforest.cpp (100 trees) with CvRTrees and with
+// ParallelRTrees (tools/parallel_rtrees.h), which grows the trees concurrently
+// each with its own seeded random number generator, using 1, 2, 4 ... up to
+// all of the available cores. The training time and speedup of each are
+// reported and the forests trained with different numbers of threads checked
+// to classify the testing data identically. The forest can be saved and is
+// then read back with CvRTrees::load() and checked to classify identically.
+
+// Author : Toby Breckon, toby.breckon@cranfield.ac.uk
+
+// Copyright (c) 2011 School of Engineering, Cranfield University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+
+#include "../tools/parallel_rtrees.h"
+
+/******************************************************************************/
+// global definitions (for speed and ease of use)
+
+#define NUMBER_OF_TRAINING_SAMPLES 3823
+#define ATTRIBUTES_PER_SAMPLE 64
+#define NUMBER_OF_TESTING_SAMPLES 1797
+
+#define NUMBER_OF_CLASSES 10
+
+// N.B. classes are integer handwritten digits in range 0-9
+
+/******************************************************************************/
+
+// loads the sample database from file (which is a CSV text file)
+
+int read_data_from_csv(const char* filename, Mat data, Mat classes,
+                       int n_samples )
+{
+    float tmp;
+
+    // if we can't read the input file then return 0
+    FILE* f = fopen( filename, "r" );
+    if( !f )
+    {
+        printf("ERROR: cannot read file %s\n",  filename);
+        return 0; // all not OK
+    }
+
+    // for each sample in the file
+
+    for(int line = 0; line < n_samples; line++)
+    {
+
+        // for each attribute on the line in the file
+
+        for(int attribute = 0; attribute < (ATTRIBUTES_PER_SAMPLE + 1); attribute++)
+        {
+            if (attribute < 64)
+            {
+
+                // first 64 elements (0-63) in each line are the attributes
+
+                fscanf(f, "%f,", &tmp);
+                data.at<float>(line, attribute) = tmp;
+                // printf("%f,", data.at<float>(line, attribute));
+
+            }
+            else if (attribute == 64)
+            {
+
+                // attribute 65 is the class label {0 ... 9}
+
+                fscanf(f, "%f,", &tmp);
+                classes.at<float>(line, 0) = tmp;
+                // printf("%f\n", classes.at<float>(line, 0));
+
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 1; // all OK
+}
+
+/******************************************************************************/
+
+// classify the testing data with a forest - returns the number correct
+
+int test_forest(const CvRTrees* forest, const Mat& testing_data,
+                const Mat& testing_classifications, std::vector<float>& results)
+{
+    int correct_class = 0;
+
+    results.resize(testing_data.rows);
+    for (int tsample = 0; tsample < testing_data.rows; tsample++)
+    {
+        results[tsample] = forest->predict(testing_data.row(tsample), Mat());
+        if (fabs(results[tsample] - testing_classifications.at<float>(tsample, 0)) < FLT_EPSILON)
+        {
+            correct_class++;
+        }
+    }
+
+    return correct_class;
+}
+
+/******************************************************************************/
+
+int main( int argc, char** argv )
+{
+    // lets just check the version first
+
+    printf ("OpenCV version %s (%d.%d.%d)\n",
+            CV_VERSION,
+            CV_MAJOR_VERSION, CV_MINOR_VERSION, CV_SUBMINOR_VERSION);
+
+    // define training data storage matrices (one for attribute examples, one
+    // for classifications)
+
+    Mat training_data = Mat(NUMBER_OF_TRAINING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat training_classifications = Mat(NUMBER_OF_TRAINING_SAMPLES, 1, CV_32FC1);
+
+    //define testing data storage matrices
+
+    Mat testing_data = Mat(NUMBER_OF_TESTING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat testing_classifications = Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    // define all the attributes as numerical (with a categorical output, as
+    // randomforest.cpp)
+
+    Mat var_type = Mat(ATTRIBUTES_PER_SAMPLE + 1, 1, CV_8U );
+    var_type.setTo(Scalar(CV_VAR_NUMERICAL) ); // all inputs are numerical
+    var_type.at<uchar>(ATTRIBUTES_PER_SAMPLE, 0) = CV_VAR_CATEGORICAL;
+
+    // load training and testing data sets
+
+    if (((argc == 3) || (argc == 4)) &&
+            read_data_from_csv(argv[1], training_data, training_classifications, NUMBER_OF_TRAINING_SAMPLES) &&
+            read_data_from_csv(argv[2], testing_data, testing_classifications, NUMBER_OF_TESTING_SAMPLES))
+    {
+        // define the parameters for training the random forest (as
+        // randomforest.cpp, the trees all being grown)
+
+        float priors[] = {1,1,1,1,1,1,1,1,1,1};  // weights of each classification for classes
+        // (all equal as equal samples of each digit)
+
+        CvRTParams params = CvRTParams(25, // max depth
+                                       5, // min sample count
+                                       0, // regression accuracy: N/A here
+                                       false, // compute surrogate split, no missing data
+                                       15, // max number of categories (use sub-optimal algorithm for larger numbers)
+                                       priors, // the array of priors
+                                       false,  // calculate variable importance
+                                       4,       // number of variables randomly selected at node and used to find the best split(s).
+                                       100,	 // max number of trees in the forest
+                                       0.01f,				// forrest accuracy
+                                       CV_TERMCRIT_ITER // termination cirteria
+                                      );
+
+        printf( "\nUsing training database: %s\n", argv[1]);
+        printf( "Using testing database: %s\n\n", argv[2]);
+
+        std::vector<float> results;
+        std::vector<float> first_results;
+
+        // train with CvRTrees (one tree after another)
+
+        CvRTrees* rtree = new CvRTrees;
+
+        int64 start = getTickCount();
+        rtree->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                     Mat(), Mat(), var_type, Mat(), params);
+        double rtree_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        int correct_class = test_forest(rtree, testing_data, testing_classifications, results);
+
+        printf( "CvRTrees: %d trees trained in %g s, correct classification %g%%\n\n",
+                rtree->get_tree_count(), rtree_time,
+                (double) correct_class*100/NUMBER_OF_TESTING_SAMPLES);
+
+        delete rtree;
+
+        // train with ParallelRTrees over increasing numbers of threads
+
+        int max_threads = getNumberOfCPUs();
+        int threads = 1;
+        double one_thread_time = 0;
+        ParallelRTrees* prtree = 0;
+
+        for (;;)
+        {
+            setNumThreads(threads);
+
+            delete prtree;
+            prtree = new ParallelRTrees;
+
+            start = getTickCount();
+            prtree->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                          Mat(), Mat(), var_type, Mat(), params);
+            double prtree_time = (double) (getTickCount() - start) / getTickFrequency();
+
+            if (threads == 1)
+            {
+                one_thread_time = prtree_time;
+            }
+
+            correct_class = test_forest(prtree, testing_data, testing_classifications, results);
+
+            // the forest must not depend on the number of threads
+
+            int mismatches = 0;
+            if (threads == 1)
+            {
+                first_results = results;
+            }
+            for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+            {
+                if (results[tsample] != first_results[tsample])
+                {
+                    mismatches++;
+                }
+            }
+
+            printf( "ParallelRTrees (%d threads): %d trees trained in %g s (x%g on 1 thread, x%g on CvRTrees)\n"
+                    "\tdata preparation: %g s, tree growing: %g s, training data copies: %d\n"
+                    "\tcorrect classification %g%%, mismatches to 1 thread %d\n",
+                    threads, prtree->get_tree_count(), prtree_time,
+                    one_thread_time / prtree_time, rtree_time / prtree_time,
+                    prtree->data_time, prtree->grow_time, prtree->get_train_data_count(),
+                    (double) correct_class*100/NUMBER_OF_TESTING_SAMPLES, mismatches);
+
+            if (threads == max_threads)
+            {
+                break;
+            }
+            threads = MIN(threads * 2, max_threads);
+        }
+
+        // save the forest (as a CvRTrees) and check it reads back the same
+
+        if (argc == 4)
+        {
+            prtree->save(argv[3]);
+
+            CvRTrees* loaded = new CvRTrees;
+            loaded->load(argv[3]);
+
+            std::vector<float> loaded_results;
+            test_forest(loaded, testing_data, testing_classifications, loaded_results);
+
+            int mismatches = 0;
+            for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+            {
+                if (loaded_results[tsample] != results[tsample])
+                {
+                    mismatches++;
+                }
+            }
+
+            printf( "\nSaved forest to %s, read back by CvRTrees: %d trees, mismatches %d\n",
+                    argv[3], loaded->get_tree_count(), mismatches);
+
+            delete loaded;
+        }
+
+        delete prtree;
+
+        // all matrix memory free by destructors
+
+        // all OK : main returns 0
+
+        return 0;
+    }
+
+    // not OK : main returns -1
+
+    printf("usage: %s training_data_file testing_data_file [forest_file.yml]\n", argv[0]);
+    return -1;
+}
+/******************************************************************************/
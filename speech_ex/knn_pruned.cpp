@@ -0,0 +1,248 @@
+// Example : exact knn with early abandoning and pivot pruning
+// usage: prog training_data_file testing_data_file
+
+// For use with test / training datasets : speech_ex
+
+// Compares the pruned exact kNN search (tools/knn_pruned.h) against the brute
+// force CvKNearest search - results must be identical for every test sample.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+
+#include "../tools/knn_pruned.h"
+
+/******************************************************************************/
+// global definitions (for speed and ease of use)
+
+#define NUMBER_OF_TRAINING_SAMPLES 6238
+#define ATTRIBUTES_PER_SAMPLE 617
+#define NUMBER_OF_TESTING_SAMPLES 1559
+
+#define NUMBER_OF_CLASSES 26
+
+#define K_NEIGHBOURS 7      // k for the kNN classification
+#define NUMBER_OF_PIVOTS 8  // LAESA pivots used for pruning
+
+// N.B. classes are spoken alphabetric letters A-Z labelled 1 -> 26
+
+/******************************************************************************/
+
+// loads the sample database from file (which is a CSV text file)
+
+int read_data_from_csv(const char* filename, Mat data, Mat classes,
+                       int n_samples )
+{
+    float tmp;
+
+    // if we can't read the input file then return 0
+    FILE* f = fopen( filename, "r" );
+    if( !f )
+    {
+        printf("ERROR: cannot read file %s\n",  filename);
+        return 0; // all not OK
+    }
+
+    // for each sample in the file
+
+    for(int line = 0; line < n_samples; line++)
+    {
+
+        // for each attribute on the line in the file
+
+        for(int attribute = 0; attribute < (ATTRIBUTES_PER_SAMPLE + 1); attribute++)
+        {
+            if (attribute < ATTRIBUTES_PER_SAMPLE)
+            {
+
+                // first 617 elements (0-616) in each line are the attributes
+
+                fscanf(f, "%f,", &tmp);
+                data.at<float>(line, attribute) = tmp;
+
+            }
+            else if (attribute == ATTRIBUTES_PER_SAMPLE)
+            {
+
+                // attribute 617 is the class label {1 ... 26} == {A-Z}
+
+                fscanf(f, "%f,", &tmp);
+                classes.at<float>(line, 0) = tmp;
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 1; // all OK
+}
+
+/******************************************************************************/
+
+int main( int argc, char** argv )
+{
+    // lets just check the version first
+
+    printf ("OpenCV version %s (%d.%d.%d)\n",
+            CV_VERSION,
+            CV_MAJOR_VERSION, CV_MINOR_VERSION, CV_SUBMINOR_VERSION);
+
+    // define training data storage matrices (one for attribute examples, one
+    // for classifications)
+
+    Mat training_data =
+        Mat(NUMBER_OF_TRAINING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat training_classifications = Mat(NUMBER_OF_TRAINING_SAMPLES, 1, CV_32FC1);
+
+    //define testing data storage matrices
+
+    Mat testing_data =
+        Mat(NUMBER_OF_TESTING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat testing_classifications =
+        Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    // load training and testing data sets
+
+    if ((argc == 3) &&
+            read_data_from_csv(argv[1], training_data, training_classifications, NUMBER_OF_TRAINING_SAMPLES) &&
+            read_data_from_csv(argv[2], testing_data, testing_classifications, NUMBER_OF_TESTING_SAMPLES))
+    {
+        // train (index) both the brute force and the pruned kNN search
+
+        printf( "\nUsing training database: %s\n\n", argv[1]);
+
+        CvKNearest knn;
+        knn.train(training_data, training_classifications, Mat(), false, 32, false);
+
+        PrunedKNearest pknn;
+        pknn.train(training_data, training_classifications, NUMBER_OF_PIVOTS);
+
+        // perform classifier testing and report results
+
+        Mat test_sample;
+        int correct_class = 0;
+        int wrong_class = 0;
+        int mismatches = 0;
+        int false_positives [NUMBER_OF_CLASSES];
+        char class_labels[NUMBER_OF_CLASSES];
+        Mat results, knn_responses, knn_dists, pknn_responses, pknn_dists;
+        float knn_result, pknn_result;
+        int64 knn_ticks = 0, pknn_ticks = 0, start;
+
+        // zero the false positive counters in a simple loop
+
+        for (int i = 0; i < NUMBER_OF_CLASSES; i++)
+        {
+            false_positives[i] = 0;
+            class_labels[i] = (char) 65 + i; // ASCII 65 = A
+        }
+
+        printf( "\nUsing testing database: %s\n\n", argv[2]);
+
+        for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+        {
+
+            // extract a row from the testing matrix
+
+            test_sample = testing_data.row(tsample);
+
+            // run brute force and pruned kNN classification
+
+            start = getTickCount();
+            knn_result = knn.find_nearest(test_sample, K_NEIGHBOURS,
+                                          results, knn_responses, knn_dists);
+            knn_ticks += getTickCount() - start;
+
+            start = getTickCount();
+            pknn_result = pknn.find_nearest(test_sample, K_NEIGHBOURS,
+                                            &pknn_responses, &pknn_dists);
+            pknn_ticks += getTickCount() - start;
+
+            // both searches must agree exactly (class, neighbours, distances)
+
+            if ((knn_result != pknn_result)
+                    || (countNonZero(knn_responses != pknn_responses) > 0)
+                    || (countNonZero(knn_dists != pknn_dists) > 0))
+            {
+                printf("Testing Sample %i -> MISMATCH (CvKNearest character %c, pruned character %c)\n",
+                       tsample, class_labels[((int) knn_result) - 1],
+                       class_labels[((int) pknn_result) - 1]);
+                mismatches++;
+            }
+            else
+            {
+                printf("Testing Sample %i -> class result (character %c)\n",
+                       tsample, class_labels[((int) pknn_result) - 1]);
+            }
+
+            // if the prediction and the (true) testing classification are the same
+            // (within the bounds of floating point error for cross-platfom safety)
+
+            if (fabs(pknn_result - testing_classifications.at<float>(tsample, 0))
+                    >= FLT_EPSILON)
+            {
+                // if they differ more than floating point error => wrong class
+
+                wrong_class++;
+
+                false_positives[((int) pknn_result) - 1]++;
+
+            }
+            else
+            {
+
+                // otherwise correct
+
+                correct_class++;
+            }
+        }
+
+        printf( "\nResults on the testing database: %s\n"
+                "\tCorrect classification: %d (%g%%)\n"
+                "\tWrong classifications: %d (%g%%)\n",
+                argv[2],
+                correct_class, (double) correct_class*100/NUMBER_OF_TESTING_SAMPLES,
+                wrong_class, (double) wrong_class*100/NUMBER_OF_TESTING_SAMPLES);
+
+        for (int i = 0; i < NUMBER_OF_CLASSES; i++)
+        {
+            printf( "\tClass (character %c) false postives 	%d (%g%%)\n", class_labels[i],
+                    false_positives[i],
+                    (double) false_positives[i]*100/NUMBER_OF_TESTING_SAMPLES);
+        }
+
+        // report the pruning statistics and timing of both searches
+
+        printf( "\nPruned search (k = %d, %d pivots):\n"
+                "\tMismatches against CvKNearest: %d\n"
+                "\tCandidates skipped by pivot bound: %g%%\n"
+                "\tCandidates abandoned early: %g%%\n"
+                "\tDistance arithmetic avoided: %g%%\n"
+                "\tCvKNearest: %g ms, pruned: %g ms\n",
+                K_NEIGHBOURS, pknn.get_pivot_count(), mismatches,
+                (double) pknn.skipped_pivot*100/((double) pknn.queries*NUMBER_OF_TRAINING_SAMPLES),
+                (double) pknn.skipped_abandon*100/((double) pknn.queries*NUMBER_OF_TRAINING_SAMPLES),
+                pknn.fraction_avoided()*100,
+                (double) knn_ticks*1000/getTickFrequency(),
+                (double) pknn_ticks*1000/getTickFrequency());
+
+        // all matrix memory free by destructors
+
+        // all OK : main returns 0 (unless the searches disagree)
+
+        return (mismatches == 0) ? 0 : -1;
+    }
+
+    // not OK : main returns -1
+
+    printf("usage: %s training_data_file testing_data_file\n", argv[0]);
+    return -1;
+}
+/******************************************************************************/
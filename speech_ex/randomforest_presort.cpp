@@ -0,0 +1,252 @@
+// Example : random forest training from a single presort of the training data
+// usage: prog training_data_file testing_data_file [forest_file.yml]
+
+// For use with test / training datasets : speech_ex
+
+// Trains a random forest of 100 trees over the 617 attributes of the speech
+// data with CvRTrees and with PresortForest (tools/presort_forest.h), which
+// sorts each attribute once for the whole of the training data and grows
+// every tree (in parallel) from that one presort with its bootstrap sample as
+// per sample counts, comparing the training time and the classification of
+// the testing data. If a forest file is given the PresortForest forest is
+// saved to it and read back with CvRTrees::load(), checking that it then
+// classifies identically.
+
+// Author : Toby Breckon, toby.breckon@cranfield.ac.uk
+
+// Copyright (c) 2011 School of Engineering, Cranfield University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+
+#include "../tools/presort_forest.h"
+
+/******************************************************************************/
+// global definitions (for speed and ease of use)
+
+#define NUMBER_OF_TRAINING_SAMPLES 6238
+#define ATTRIBUTES_PER_SAMPLE 617
+#define NUMBER_OF_TESTING_SAMPLES 1559
+
+#define NUMBER_OF_CLASSES 26
+
+// N.B. classes are spoken alphabetric letters A-Z labelled 1 -> 26
+
+/******************************************************************************/
+
+// loads the sample database from file (which is a CSV text file)
+
+int read_data_from_csv(const char* filename, Mat data, Mat classes, int n_samples )
+{
+    float tmp;
+
+    // if we can't read the input file then return 0
+    FILE* f = fopen( filename, "r" );
+    if( !f )
+    {
+        printf("ERROR: cannot read file %s\n",  filename);
+        return 0; // all not OK
+    }
+
+    // for each sample in the file
+
+    for(int line = 0; line < n_samples; line++)
+    {
+
+        // for each attribute on the line in the file
+
+        for(int attribute = 0; attribute < (ATTRIBUTES_PER_SAMPLE + 1); attribute++)
+        {
+            if (attribute < ATTRIBUTES_PER_SAMPLE)
+            {
+
+                // first 617 elements (0-616) in each line are the attributes
+
+                fscanf(f, "%f,", &tmp);
+                data.at<float>(line, attribute) = tmp;
+
+
+            }
+            else if (attribute == ATTRIBUTES_PER_SAMPLE)
+            {
+
+                // attribute 617 is the class label {1 ... 26} == {A-Z}
+
+                fscanf(f, "%f,", &tmp);
+                classes.at<float>(line, 0) = tmp;
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 1; // all OK
+}
+
+/******************************************************************************/
+
+// the percentage of the testing data classified correctly by a forest
+
+double test_accuracy(const CvRTrees* forest, const Mat& testing_data,
+                     const Mat& testing_classifications)
+{
+    int correct_class = 0;
+    for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+    {
+        if (fabs(forest->predict(testing_data.row(tsample), Mat())
+                 - testing_classifications.at<float>(tsample, 0)) < FLT_EPSILON)
+        {
+            correct_class++;
+        }
+    }
+    return (double) correct_class*100/NUMBER_OF_TESTING_SAMPLES;
+}
+
+/******************************************************************************/
+
+int main( int argc, char** argv )
+{
+    // lets just check the version first
+
+    printf ("OpenCV version %s (%d.%d.%d)\n",
+            CV_VERSION,
+            CV_MAJOR_VERSION, CV_MINOR_VERSION, CV_SUBMINOR_VERSION);
+
+    // define training data storage matrices (one for attribute examples, one
+    // for classifications)
+
+    Mat training_data = Mat(NUMBER_OF_TRAINING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat training_classifications = Mat(NUMBER_OF_TRAINING_SAMPLES, 1, CV_32FC1);
+
+    //define testing data storage matrices
+
+    Mat testing_data = Mat(NUMBER_OF_TESTING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat testing_classifications = Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    // define all the attributes as numerical (with a categorical output)
+
+    Mat var_type = Mat(ATTRIBUTES_PER_SAMPLE + 1, 1, CV_8U );
+    var_type.setTo(Scalar(CV_VAR_NUMERICAL) ); // all inputs are numerical
+    var_type.at<uchar>(ATTRIBUTES_PER_SAMPLE, 0) = CV_VAR_CATEGORICAL;
+
+    // load training and testing data sets
+
+    if (((argc == 3) || (argc == 4)) &&
+            read_data_from_csv(argv[1], training_data, training_classifications, NUMBER_OF_TRAINING_SAMPLES) &&
+            read_data_from_csv(argv[2], testing_data, testing_classifications, NUMBER_OF_TESTING_SAMPLES))
+    {
+        // define the parameters for training the random forest (trees)
+
+        float *priors = NULL;  // weights of each classification for classes
+        // (all equal as equal samples of each character)
+
+        CvRTParams params = CvRTParams(25, // max depth
+                                       5, // min sample count
+                                       0, // regression accuracy: N/A here
+                                       false, // compute surrogate split, no missing data
+                                       15, // max number of categories (use sub-optimal algorithm for larger numbers)
+                                       priors, // the array of priors
+                                       false,  // calculate variable importance
+                                       0,       // number of variables randomly selected at node and used to find the best split(s) (0 => sqrt(617)).
+                                       100,	 // max number of trees in the forest
+                                       0.01f,				// forrest accuracy
+                                       CV_TERMCRIT_ITER // termination cirteria (all of the trees)
+                                      );
+
+        printf( "\nUsing training database: %s\n", argv[1]);
+        printf( "Using testing database: %s\n\n", argv[2]);
+
+        // CvRTrees (the training data prepared for each tree)
+
+        CvRTrees* rtree = new CvRTrees;
+
+        int64 start = getTickCount();
+        rtree->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                     Mat(), Mat(), var_type, Mat(), params);
+        double rtree_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        double rtree_accuracy = test_accuracy(rtree, testing_data, testing_classifications);
+
+        printf( "CvRTrees (%d trees): training %g s, correct classification %g%%\n",
+                rtree->get_tree_count(), rtree_time, rtree_accuracy);
+
+        // PresortForest (one presort shared by all of the trees)
+
+        PresortForest pforest;
+
+        start = getTickCount();
+        if (!pforest.train(training_data, training_classifications, params))
+        {
+            printf("ERROR: cannot train the presorted forest\n");
+            delete rtree;
+            return -1;
+        }
+        double pforest_time = (double) (getTickCount() - start) / getTickFrequency();
+
+        int correct_class = 0;
+        for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+        {
+            if (fabs(pforest.predict(testing_data.ptr<float>(tsample))
+                     - testing_classifications.at<float>(tsample, 0)) < FLT_EPSILON)
+            {
+                correct_class++;
+            }
+        }
+
+        printf( "PresortForest (%d trees, %d nodes, %d threads): training %g s "
+                "(presort %g s, trees %g s, x%g), correct classification %g%%\n",
+                pforest.get_tree_count(), pforest.get_node_count(), getNumThreads(),
+                pforest_time, pforest.presort_time, pforest.grow_time,
+                rtree_time / pforest_time,
+                (double) correct_class*100/NUMBER_OF_TESTING_SAMPLES);
+
+        // save the forest and read it back as a CvRTrees
+
+        if (argc == 4)
+        {
+            if (!pforest.save(argv[3]))
+            {
+                printf("ERROR: cannot save the forest to %s\n", argv[3]);
+                delete rtree;
+                return -1;
+            }
+
+            CvRTrees* loaded = new CvRTrees;
+            loaded->load(argv[3]);
+
+            int mismatches = 0;
+            for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+            {
+                if (loaded->predict(testing_data.row(tsample), Mat())
+                        != pforest.predict(testing_data.ptr<float>(tsample)))
+                {
+                    mismatches++;
+                }
+            }
+
+            printf( "\nForest saved to %s and loaded by CvRTrees (%d trees): mismatches %d\n",
+                    argv[3], loaded->get_tree_count(), mismatches);
+
+            delete loaded;
+        }
+
+        delete rtree;
+
+        // all matrix memory free by destructors
+
+        // all OK : main returns 0
+
+        return 0;
+    }
+
+    // not OK : main returns -1
+
+    printf("usage: %s training_data_file testing_data_file [forest_file.yml]\n", argv[0]);
+    return -1;
+}
+/******************************************************************************/
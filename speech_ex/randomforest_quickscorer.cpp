@@ -0,0 +1,273 @@
+// Example : random forest prediction with QuickScorer bitvector evaluation
+// usage: prog training_data_file testing_data_file
+
+// For use with test / training datasets : speech_ex
+
+// Trains a random forest and an extremely random forest (up to 100 trees each,
+// as opticaldigits_ex/randomforest.cpp with sqrt(617) variables tried at each
+// split) over the 617 attributes of the speech data, compiles each into the
+// QuickScorer form of tools/quickscorer.h (the trees evaluated a feature at a
+// time by clearing bits of per tree leaf bitvectors) and compares the time to
+// classify the testing data with node by node traversal - CvRTrees::predict()
+// and the flattened trees of FlatForest (tools/flat_forest.h) all evaluated
+// on one thread - checking that all three classify identically.
+
+// Author : Toby Breckon, toby.breckon@cranfield.ac.uk
+
+// Copyright (c) 2011 School of Engineering, Cranfield University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+
+#include "../tools/flat_forest.h"
+#include "../tools/quickscorer.h"
+
+/******************************************************************************/
+// global definitions (for speed and ease of use)
+
+#define NUMBER_OF_TRAINING_SAMPLES 6238
+#define ATTRIBUTES_PER_SAMPLE 617
+#define NUMBER_OF_TESTING_SAMPLES 1559
+
+#define NUMBER_OF_CLASSES 26
+
+#define NUMBER_OF_REPEATS 10 // predictions of the testing data timed
+
+// N.B. classes are spoken alphabetric letters A-Z labelled 1 -> 26
+
+/******************************************************************************/
+
+// loads the sample database from file (which is a CSV text file)
+
+int read_data_from_csv(const char* filename, Mat data, Mat classes, int n_samples )
+{
+    float tmp;
+
+    // if we can't read the input file then return 0
+    FILE* f = fopen( filename, "r" );
+    if( !f )
+    {
+        printf("ERROR: cannot read file %s\n",  filename);
+        return 0; // all not OK
+    }
+
+    // for each sample in the file
+
+    for(int line = 0; line < n_samples; line++)
+    {
+
+        // for each attribute on the line in the file
+
+        for(int attribute = 0; attribute < (ATTRIBUTES_PER_SAMPLE + 1); attribute++)
+        {
+            if (attribute < ATTRIBUTES_PER_SAMPLE)
+            {
+
+                // first 617 elements (0-616) in each line are the attributes
+
+                fscanf(f, "%f,", &tmp);
+                data.at<float>(line, attribute) = tmp;
+
+
+            }
+            else if (attribute == ATTRIBUTES_PER_SAMPLE)
+            {
+
+                // attribute 617 is the class label {1 ... 26} == {A-Z}
+
+                fscanf(f, "%f,", &tmp);
+                classes.at<float>(line, 0) = tmp;
+            }
+        }
+    }
+
+    fclose(f);
+
+    return 1; // all OK
+}
+
+/******************************************************************************/
+
+// number of results that differ between two predictions of the testing data
+
+int count_mismatches(const Mat& results1, const Mat& results2)
+{
+    int mismatches = 0;
+    for (int tsample = 0; tsample < results1.rows; tsample++)
+    {
+        if (results1.at<float>(tsample, 0) != results2.at<float>(tsample, 0))
+        {
+            mismatches++;
+        }
+    }
+    return mismatches;
+}
+
+/******************************************************************************/
+
+// classify the testing data with a forest by node by node traversal and with
+// QuickScorer reporting the time taken and the agreement
+
+void compare_predictions(const char* name, const CvRTrees* forest,
+                         const Mat& testing_data, const Mat& testing_classifications)
+{
+    // row by row with CvRTrees::predict()
+
+    Mat results = Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    int64 start = getTickCount();
+    for (int repeat = 0; repeat < NUMBER_OF_REPEATS; repeat++)
+    {
+        for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+        {
+            results.at<float>(tsample, 0) = forest->predict(testing_data.row(tsample), Mat());
+        }
+    }
+    double forest_time = (double) (getTickCount() - start) / getTickFrequency();
+
+    int correct_class = 0;
+    for (int tsample = 0; tsample < NUMBER_OF_TESTING_SAMPLES; tsample++)
+    {
+        if (fabs(results.at<float>(tsample, 0) - testing_classifications.at<float>(tsample, 0))
+                < FLT_EPSILON)
+        {
+            correct_class++;
+        }
+    }
+
+    // the flattened trees (all of the trees, one thread)
+
+    FlatForest fforest;
+    QuickScorer qscorer;
+    if (!fforest.build(forest) || !qscorer.build(forest))
+    {
+        printf("ERROR: cannot compile the trees of the forest\n");
+        return;
+    }
+
+    int n_threads = getNumThreads();
+    setNumThreads(1);
+
+    Mat flat_results;
+    start = getTickCount();
+    for (int repeat = 0; repeat < NUMBER_OF_REPEATS; repeat++)
+    {
+        fforest.predict(testing_data, flat_results, false);
+    }
+    double flat_time = (double) (getTickCount() - start) / getTickFrequency();
+
+    setNumThreads(n_threads);
+
+    // QuickScorer
+
+    Mat qs_results;
+    start = getTickCount();
+    for (int repeat = 0; repeat < NUMBER_OF_REPEATS; repeat++)
+    {
+        qscorer.predict(testing_data, qs_results);
+    }
+    double qs_time = (double) (getTickCount() - start) / getTickFrequency();
+
+    printf( "%s (%d trees, %d leaves, %d split nodes, %d bitvector words, %g KB):\n"
+            "\tcorrect classification %g%%\n"
+            "\tCvRTrees::predict() row by row: %g s\n"
+            "\tFlatForest (node by node, all trees): %g s (x%g), mismatches %d\n"
+            "\tQuickScorer: %g s (x%g, x%g on FlatForest), mismatches %d\n\n",
+            name, qscorer.get_tree_count(), qscorer.get_leaf_count(),
+            qscorer.get_condition_count(), qscorer.get_word_count(),
+            (double) qscorer.get_size_bytes() / 1024,
+            (double) correct_class*100/NUMBER_OF_TESTING_SAMPLES,
+            forest_time / NUMBER_OF_REPEATS,
+            flat_time / NUMBER_OF_REPEATS, forest_time / flat_time,
+            count_mismatches(results, flat_results),
+            qs_time / NUMBER_OF_REPEATS, forest_time / qs_time, flat_time / qs_time,
+            count_mismatches(results, qs_results));
+}
+
+/******************************************************************************/
+
+int main( int argc, char** argv )
+{
+    // lets just check the version first
+
+    printf ("OpenCV version %s (%d.%d.%d)\n",
+            CV_VERSION,
+            CV_MAJOR_VERSION, CV_MINOR_VERSION, CV_SUBMINOR_VERSION);
+
+    // define training data storage matrices (one for attribute examples, one
+    // for classifications)
+
+    Mat training_data = Mat(NUMBER_OF_TRAINING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat training_classifications = Mat(NUMBER_OF_TRAINING_SAMPLES, 1, CV_32FC1);
+
+    //define testing data storage matrices
+
+    Mat testing_data = Mat(NUMBER_OF_TESTING_SAMPLES, ATTRIBUTES_PER_SAMPLE, CV_32FC1);
+    Mat testing_classifications = Mat(NUMBER_OF_TESTING_SAMPLES, 1, CV_32FC1);
+
+    // define all the attributes as numerical (with a categorical output)
+
+    Mat var_type = Mat(ATTRIBUTES_PER_SAMPLE + 1, 1, CV_8U );
+    var_type.setTo(Scalar(CV_VAR_NUMERICAL) ); // all inputs are numerical
+    var_type.at<uchar>(ATTRIBUTES_PER_SAMPLE, 0) = CV_VAR_CATEGORICAL;
+
+    // load training and testing data sets
+
+    if ((argc == 3) &&
+            read_data_from_csv(argv[1], training_data, training_classifications, NUMBER_OF_TRAINING_SAMPLES) &&
+            read_data_from_csv(argv[2], testing_data, testing_classifications, NUMBER_OF_TESTING_SAMPLES))
+    {
+        // define the parameters for training the forests
+
+        float *priors = NULL;  // weights of each classification for classes
+        // (all equal as equal samples of each character)
+
+        CvRTParams params = CvRTParams(25, // max depth
+                                       5, // min sample count
+                                       0, // regression accuracy: N/A here
+                                       false, // compute surrogate split, no missing data
+                                       15, // max number of categories (use sub-optimal algorithm for larger numbers)
+                                       priors, // the array of priors
+                                       false,  // calculate variable importance
+                                       0,       // number of variables randomly selected at node and used to find the best split(s) (0 => sqrt(617)).
+                                       100,	 // max number of trees in the forest
+                                       0.01f,				// forrest accuracy
+                                       CV_TERMCRIT_ITER |	CV_TERMCRIT_EPS // termination cirteria
+                                      );
+
+        printf( "\nUsing training database: %s\n", argv[1]);
+        printf( "Using testing database: %s\n\n", argv[2]);
+
+        CvRTrees* rtree = new CvRTrees;
+        rtree->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                     Mat(), Mat(), var_type, Mat(), params);
+
+        compare_predictions("Random forest", rtree, testing_data, testing_classifications);
+
+        CvERTrees* ertree = new CvERTrees;
+        ertree->train(training_data, CV_ROW_SAMPLE, training_classifications,
+                      Mat(), Mat(), var_type, Mat(), params);
+
+        compare_predictions("Extremely random forest", ertree, testing_data, testing_classifications);
+
+        delete rtree;
+        delete ertree;
+
+        // all matrix memory free by destructors
+
+        // all OK : main returns 0
+
+        return 0;
+    }
+
+    // not OK : main returns -1
+
+    printf("usage: %s training_data_file testing_data_file\n", argv[0]);
+    return -1;
+}
+/******************************************************************************/
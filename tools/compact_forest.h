@@ -0,0 +1,539 @@
+// Support : compressed random forest - 8 bit thresholds and shared subtrees
+
+// A forest of deep trees (CvRTrees / CvERTrees) holds every split threshold
+// as a float, although for data of few distinct values (e.g. the 0 .. 16
+// pixel counts of opticaldigits_ex) a threshold only ever separates one
+// training value from the next. CompactForest compresses a trained / loaded
+// forest in three passes over its (flattened, flat_dtree.h) trees:
+//
+// - each threshold is quantized to the bins of its feature's values in the
+//   training data: it is lowered to the largest training value below or
+//   equal to it (so it separates those values exactly as before), and the
+//   distinct lowered thresholds of the feature (at most 256) become its bin
+//   edges. A node keeps the 8 bit index of its edge and a sample is
+//   compared bin index to bin index (a sample value is binned once per
+//   feature, not once per node).
+//
+// - branches that no sample of training values can reach (a test decided by
+//   the bins of the tests above it on the path, or by a threshold below /
+//   above all of the training values) are dropped, the node replaced by the
+//   child always taken, as are tests whose two subtrees are the same.
+//
+// - identical subtrees, within and across the trees, are stored once (the
+//   trees become a graph of shared nodes) - in particular each leaf value is
+//   stored only once.
+//
+// Predictions are unchanged for any sample whose value of each feature is
+// one seen in the training data for it (the case for opticaldigits_ex, in
+// general the samples should be checked - the example reports this). Only
+// forests of ordered (numerical) splits can be compressed. Classification
+// votes are counted and ties broken as CvRTrees::predict(), regression is
+// the mean of the trees.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#ifndef COMPACT_FOREST_H
+#define COMPACT_FOREST_H
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <stdio.h>
+#include <string.h>
+
+#include "flat_dtree.h"
+
+#define COMPACT_FOREST_MAX_BINS 256     // bin edges per feature (8 bit index)
+#define COMPACT_FOREST_LEAF 0xFFFF      // feature of a leaf node
+
+/******************************************************************************/
+
+class CompactForest
+{
+public:
+
+    CompactForest() : var_all(0), n_classes(0), n_source_nodes(0), n_decided(0),
+        n_shared(0) {}
+
+    // compress the trees of a trained / loaded forest (CvRTrees or CvERTrees)
+    // with the bins of the training data (1 sample per row, CV_32F) - returns
+    // false if it has no trees, a categorical split or a feature needing more
+    // than COMPACT_FOREST_MAX_BINS bins
+
+    bool build(const CvRTrees* forest, const cv::Mat& training_data)
+    {
+        clear();
+
+        int ntrees = forest->get_tree_count();
+        if (ntrees < 1)
+        {
+            return false;
+        }
+
+        std::vector<FlatDTree> trees(ntrees);
+        for (int k = 0; k < ntrees; k++)
+        {
+            if (!trees[k].build(forest->get_tree(k)))
+            {
+                return false;
+            }
+        }
+
+        return build(trees, forest->get_tree(0)->get_data()->is_classifier,
+                     training_data);
+    }
+
+    // compress flattened trees (as above)
+
+    bool build(const std::vector<FlatDTree>& trees, bool is_classifier,
+               const cv::Mat& training_data)
+    {
+        clear();
+
+        int ntrees = (int) trees.size();
+        if ((ntrees < 1) || (training_data.type() != CV_32FC1))
+        {
+            return false;
+        }
+
+        for (int k = 0; k < ntrees; k++)
+        {
+            for (int n = 0; n < trees[k].get_node_count(); n++)
+            {
+                if (trees[k].split[n] >= 0)
+                {
+                    printf("ERROR: categorical splits cannot be compressed\n");
+                    clear();
+                    return false;
+                }
+            }
+            var_all = MAX(var_all, trees[k].get_var_all());
+            n_source_nodes += trees[k].get_node_count();
+        }
+
+        if ((training_data.cols < var_all) || (var_all >= COMPACT_FOREST_LEAF))
+        {
+            clear();
+            return false;
+        }
+
+        // the distinct training values of each feature (that is split on)
+
+        std::vector<std::vector<float> > values(var_all);
+        for (int k = 0; k < ntrees; k++)
+        {
+            for (int n = 0; n < trees[k].get_node_count(); n++)
+            {
+                int f = trees[k].feature[n];
+                if ((f >= 0) && values[f].empty())
+                {
+                    for (int i = 0; i < training_data.rows; i++)
+                    {
+                        values[f].push_back(training_data.at<float>(i, f));
+                    }
+                    std::sort(values[f].begin(), values[f].end());
+                    values[f].erase(std::unique(values[f].begin(), values[f].end()),
+                                    values[f].end());
+                }
+            }
+        }
+
+        // the bin edges of each feature - the thresholds lowered to the
+        // training values
+
+        std::vector<std::vector<float> > edges(var_all);
+        for (int k = 0; k < ntrees; k++)
+        {
+            for (int n = 0; n < trees[k].get_node_count(); n++)
+            {
+                float lowered;
+                int f = trees[k].feature[n];
+                if ((f >= 0) && lower_threshold(values[f], trees[k].threshold[n], lowered))
+                {
+                    edges[f].push_back(lowered);
+                }
+            }
+        }
+
+        bin_ofs.assign(var_all + 1, 0);
+        for (int f = 0; f < var_all; f++)
+        {
+            std::sort(edges[f].begin(), edges[f].end());
+            edges[f].erase(std::unique(edges[f].begin(), edges[f].end()), edges[f].end());
+            if ((int) edges[f].size() > COMPACT_FOREST_MAX_BINS)
+            {
+                printf("ERROR: feature %d has %d thresholds (more than %d bins)\n",
+                       f, (int) edges[f].size(), COMPACT_FOREST_MAX_BINS);
+                clear();
+                return false;
+            }
+            bin_edges.insert(bin_edges.end(), edges[f].begin(), edges[f].end());
+            bin_ofs[f + 1] = (int) bin_edges.size();
+        }
+
+        // the range of bins of the training values of each feature
+
+        std::vector<int> lowest(var_all, 0);
+        std::vector<int> highest(var_all, 0);
+        for (int f = 0; f < var_all; f++)
+        {
+            if (!values[f].empty())
+            {
+                lowest[f] = bin(f, values[f].front());
+                highest[f] = bin(f, values[f].back());
+            }
+        }
+
+        // compile each tree into the shared nodes
+
+        for (int k = 0; k < ntrees; k++)
+        {
+            roots.push_back(add_node(trees[k], 0, values, lowest, highest));
+        }
+
+        // for a classifier, the class (index into class_values) of each value
+
+        if (is_classifier)
+        {
+            class_values = leaf_value;
+            std::sort(class_values.begin(), class_values.end());
+            class_values.erase(std::unique(class_values.begin(), class_values.end()),
+                               class_values.end());
+            n_classes = (int) class_values.size();
+
+            leaf_class.resize(leaf_value.size());
+            for (size_t l = 0; l < leaf_value.size(); l++)
+            {
+                leaf_class[l] = (int) (std::lower_bound(class_values.begin(),
+                                       class_values.end(), leaf_value[l])
+                                       - class_values.begin());
+            }
+        }
+
+        node_index.clear();
+        value_index.clear();
+
+        return true;
+    }
+
+    void clear()
+    {
+        bin_ofs.clear();
+        bin_edges.clear();
+        feature.clear();
+        edge.clear();
+        left.clear();
+        right.clear();
+        roots.clear();
+        leaf_value.clear();
+        leaf_class.clear();
+        class_values.clear();
+        node_index.clear();
+        value_index.clear();
+        var_all = n_classes = 0;
+        n_source_nodes = n_decided = n_shared = 0;
+    }
+
+    // bin the values of a sample (pointer to var_all floats) into codes
+    // (var_all ints) - the index of the first bin edge above or equal to it
+
+    void encode(const float* sample, int* codes) const
+    {
+        for (int f = 0; f < var_all; f++)
+        {
+            codes[f] = bin(f, sample[f]);
+        }
+    }
+
+    // predict a single sample (pointer to var_all floats)
+
+    float predict(const float* sample) const
+    {
+        std::vector<int> codes(MAX(var_all, 1));
+        std::vector<int> votes(n_classes);
+        encode(sample, &codes[0]);
+        return predict_encoded(&codes[0], votes.empty() ? 0 : &votes[0]);
+    }
+
+    // predict a batch of samples (1 sample per row, CV_32F) into results (1
+    // result per row, CV_32F)
+
+    void predict(const cv::Mat& samples, cv::Mat& results) const
+    {
+        results.create(samples.rows, 1, CV_32F);
+
+        std::vector<int> codes(MAX(var_all, 1));
+        std::vector<int> votes(n_classes);
+        for (int i = 0; i < samples.rows; i++)
+        {
+            encode(samples.ptr<float>(i), &codes[0]);
+            results.at<float>(i, 0) = predict_encoded(&codes[0],
+                                      votes.empty() ? 0 : &votes[0]);
+        }
+    }
+
+    int get_tree_count() const { return (int) roots.size(); }
+    int get_node_count() const { return (int) feature.size(); }
+
+    // nodes of the trees before compression, tests dropped as decided (or
+    // with identical subtrees) and subtrees shared rather than stored again
+
+    int get_source_node_count() const { return n_source_nodes; }
+    int get_decided_count() const { return n_decided; }
+    int get_shared_count() const { return n_shared; }
+
+    // the largest number of bins of any feature
+
+    int get_max_bins() const
+    {
+        int max_bins = 0;
+        for (int f = 0; f < var_all; f++)
+        {
+            max_bins = MAX(max_bins, bin_ofs[f + 1] - bin_ofs[f]);
+        }
+        return max_bins;
+    }
+
+    // memory used by the compressed forest
+
+    size_t get_size_bytes() const
+    {
+        return feature.size() * (sizeof(unsigned short) + sizeof(uchar) + 2 * sizeof(int))
+               + bin_ofs.size() * sizeof(int) + bin_edges.size() * sizeof(float)
+               + roots.size() * sizeof(int)
+               + leaf_value.size() * sizeof(double) + leaf_class.size() * sizeof(int)
+               + class_values.size() * sizeof(double);
+    }
+
+    // memory used by the nodes and splits of a CvDTree (as trained / loaded)
+
+    static size_t get_tree_size_bytes(const CvDTreeNode* node)
+    {
+        if (!node)
+        {
+            return 0;
+        }
+
+        size_t bytes = sizeof(CvDTreeNode);
+        for (const CvDTreeSplit* s = node->split; s; s = s->next)
+        {
+            bytes += sizeof(CvDTreeSplit);
+        }
+        return bytes + get_tree_size_bytes(node->left) + get_tree_size_bytes(node->right);
+    }
+
+private:
+
+    // a node as stored: its feature (COMPACT_FOREST_LEAF for a leaf) and bin
+    // edge and its children (a leaf: its value index in left)
+
+    struct NodeKey
+    {
+        int feature;
+        int edge;
+        int left;
+        int right;
+
+        bool operator<(const NodeKey& k) const
+        {
+            if (feature != k.feature) return feature < k.feature;
+            if (edge != k.edge) return edge < k.edge;
+            if (left != k.left) return left < k.left;
+            return right < k.right;
+        }
+    };
+
+    // lower a threshold to the largest training value below or equal to it
+    // (returns false if there is none, i.e. no training value goes left)
+
+    static bool lower_threshold(const std::vector<float>& values, float threshold,
+                                float& lowered)
+    {
+        std::vector<float>::const_iterator v =
+            std::upper_bound(values.begin(), values.end(), threshold);
+        if (v == values.begin())
+        {
+            return false;
+        }
+        lowered = *(v - 1);
+        return true;
+    }
+
+    // the bin of a value of feature f
+
+    int bin(int f, float value) const
+    {
+        const float* first = bin_edges.empty() ? 0 : &bin_edges[0] + bin_ofs[f];
+        const float* last = bin_edges.empty() ? 0 : &bin_edges[0] + bin_ofs[f + 1];
+        return (int) (std::lower_bound(first, last, value) - first);
+    }
+
+    // the shared node of a key (added if new)
+
+    int intern(const NodeKey& key)
+    {
+        std::map<NodeKey, int>::const_iterator i = node_index.find(key);
+        if (i != node_index.end())
+        {
+            n_shared++;
+            return i->second;
+        }
+
+        int id = (int) feature.size();
+        feature.push_back((unsigned short) key.feature);
+        edge.push_back((uchar) key.edge);
+        left.push_back(key.left);
+        right.push_back(key.right);
+        node_index[key] = id;
+        return id;
+    }
+
+    // compile node n of a tree (and its subtree) given the bins [lowest,
+    // highest] of each feature that can reach it - returns its shared node
+
+    int add_node(const FlatDTree& tree, int n, const std::vector<std::vector<float> >& values,
+                 std::vector<int>& lowest, std::vector<int>& highest)
+    {
+        int f = tree.feature[n];
+
+        if (f < 0)
+        {
+            std::map<double, int>::const_iterator v = value_index.find(tree.value[n]);
+            int vi;
+            if (v == value_index.end())
+            {
+                vi = (int) leaf_value.size();
+                leaf_value.push_back(tree.value[n]);
+                value_index[tree.value[n]] = vi;
+            }
+            else
+            {
+                vi = v->second;
+            }
+
+            NodeKey key = { COMPACT_FOREST_LEAF, 0, vi, 0 };
+            return intern(key);
+        }
+
+        // the bin edge of the test (none => all training values go right)
+        // and whether its outcome is already decided
+
+        float lowered;
+        int e = lower_threshold(values[f], tree.threshold[n], lowered)
+                ? bin(f, lowered) : -1;
+
+        if (highest[f] <= e)
+        {
+            n_decided++;
+            return add_node(tree, tree.left[n], values, lowest, highest);
+        }
+        if (lowest[f] > e)
+        {
+            n_decided++;
+            return add_node(tree, tree.right[n], values, lowest, highest);
+        }
+
+        int saved = highest[f];
+        highest[f] = e;
+        int l = add_node(tree, tree.left[n], values, lowest, highest);
+        highest[f] = saved;
+
+        saved = lowest[f];
+        lowest[f] = e + 1;
+        int r = add_node(tree, tree.right[n], values, lowest, highest);
+        lowest[f] = saved;
+
+        if (l == r)
+        {
+            n_decided++;
+            return l;
+        }
+
+        NodeKey key = { f, e, l, r };
+        return intern(key);
+    }
+
+    // predict a sample from its codes with the given vote (n_classes) work
+    // space
+
+    float predict_encoded(const int* codes, int* votes) const
+    {
+        const unsigned short* f = &feature[0];
+        const uchar* e = &edge[0];
+        const int* l = &left[0];
+        const int* r = &right[0];
+        int ntrees = (int) roots.size();
+
+        if (n_classes > 0)
+        {
+            memset(votes, 0, n_classes * sizeof(int));
+            int max_votes = 0;
+            int leader = 0;
+
+            for (int k = 0; k < ntrees; k++)
+            {
+                int n = roots[k];
+                while (f[n] != COMPACT_FOREST_LEAF)
+                {
+                    n = (codes[f[n]] <= e[n]) ? l[n] : r[n];
+                }
+                int c = leaf_class[l[n]];
+                if (++votes[c] > max_votes)
+                {
+                    max_votes = votes[c];
+                    leader = c;
+                }
+            }
+            return (float) class_values[leader];
+        }
+
+        double sum = 0;
+        for (int k = 0; k < ntrees; k++)
+        {
+            int n = roots[k];
+            while (f[n] != COMPACT_FOREST_LEAF)
+            {
+                n = (codes[f[n]] <= e[n]) ? l[n] : r[n];
+            }
+            sum += leaf_value[l[n]];
+        }
+        return (float) (sum / ntrees);
+    }
+
+    // the bin edges of each feature (from bin_ofs[f])
+
+    std::vector<int> bin_ofs;
+    std::vector<float> bin_edges;
+
+    // the shared nodes and the root of each tree
+
+    std::vector<unsigned short> feature;
+    std::vector<uchar> edge;
+    std::vector<int> left;
+    std::vector<int> right;
+    std::vector<int> roots;
+
+    std::vector<double> leaf_value;     // distinct leaf values
+    std::vector<int> leaf_class;        // class index of each (classifier)
+    std::vector<double> class_values;   // (sorted) class of each index
+
+    // (used while compressing)
+
+    std::map<NodeKey, int> node_index;
+    std::map<double, int> value_index;
+
+    int var_all;
+    int n_classes;  // 0 => regression
+    int n_source_nodes;
+    int n_decided;
+    int n_shared;
+};
+
+/******************************************************************************/
+
+#endif
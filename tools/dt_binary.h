@@ -0,0 +1,648 @@
+// Support : compact versioned binary file format for decision trees and
+// forests, with a memory mapped loader
+
+// Stores the struct of arrays form of each tree (flat_dtree.h) - node, split
+// and categorical dictionary arrays - together with the variable importance
+// of the model, in a single binary file that is memory mapped on loading.
+// Loading involves no text parsing and no copying: every array is accessed
+// in place through the mapping (the pages are read in on first use).
+//
+// Layout (native byte order, all arrays 8 byte aligned):
+//
+//   DTBinaryHeader                    magic "CVDT", version, tree count ...
+//   double var_importance[n_importance]
+//   DTBinaryTree tree_table[n_trees]  counts and offsets of the arrays
+//   ... the arrays of each tree (DT_BINARY_ARRAYS of them)
+//
+// Files are written by tools/dt_tobinary (from a YAML / XML CvDTree or
+// CvRTrees model) and checked on loading for magic, version, byte order,
+// that every array lies within the file and that the indices the arrays hold
+// (children, attributes, splits, subsets, categories) lie within their
+// arrays - so that a truncated or corrupt file is rejected rather than read
+// out of bounds by predict().
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#ifndef DT_BINARY_H
+#define DT_BINARY_H
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#ifdef _WIN32
+#define DT_BINARY_NO_MMAP // (whole file read instead)
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "flat_dtree.h"
+
+/******************************************************************************/
+
+#define DT_BINARY_MAGIC "CVDT"
+#define DT_BINARY_VERSION 1
+#define DT_BINARY_BYTE_ORDER 0x01020304 // reads back differently if swapped
+
+// the arrays of each tree (in file order)
+
+enum
+{
+    DT_FEATURE = 0, DT_THRESHOLD, DT_LEFT, DT_RIGHT, DT_VALUE, DT_SPLIT,
+    DT_DEFAULT_CHILD, DT_SPLIT_COLUMN, DT_SPLIT_CAT, DT_SPLIT_C, DT_SPLIT_SUBSET,
+    DT_SPLIT_INVERSED, DT_SPLIT_NEXT, DT_SUBSETS, DT_VAR_COLUMN, DT_VAR_CAT,
+    DT_CAT_OFS, DT_CAT_MAP,
+    DT_BINARY_ARRAYS
+};
+
+struct DTBinaryHeader
+{
+    char magic[4];
+    int version;
+    int byte_order;
+    int header_size;            // sizeof(DTBinaryHeader)
+    int n_trees;
+    int var_all;                // sample attributes
+    int n_importance;           // length of var_importance (0 => none)
+    int reserved;
+    int64 importance_offset;
+    int64 tree_table_offset;
+    int64 file_size;
+};
+
+struct DTBinaryTree
+{
+    int node_count;
+    int depth;
+    int reserved[2];
+    int64 count[DT_BINARY_ARRAYS];  // elements in each array
+    int64 offset[DT_BINARY_ARRAYS]; // file offset of each array
+};
+
+/******************************************************************************/
+
+// read only view of one tree of a mapped file (pointers into the mapping) -
+// the arrays are as the members of the same name in FlatDTree
+
+class BinaryDTree
+{
+public:
+
+    BinaryDTree() : node_count(0), depth(0), feature(0), threshold(0), left(0),
+        right(0), value(0), split(0), default_child(0), split_column(0),
+        split_cat(0), split_c(0), split_subset(0), split_inversed(0),
+        split_next(0), subsets(0), var_column(0), var_cat(0), cat_ofs(0),
+        cat_map(0), n_splits(0), n_subsets(0), n_vars(0), n_cat_ofs(0), n_cat_map(0) {}
+
+    // predict a single sample (as FlatDTree::predict())
+
+    double predict(const float* sample) const
+    {
+        int n = 0;
+        while (feature[n] >= 0)
+        {
+            if (split[n] < 0)
+            {
+                n = (sample[feature[n]] <= threshold[n]) ? left[n] : right[n];
+            }
+            else
+            {
+                n = categorical_child(n, sample);
+            }
+        }
+        return value[n];
+    }
+
+    int node_count;
+    int depth;
+
+    const int* feature;
+    const float* threshold;
+    const int* left;
+    const int* right;
+    const double* value;
+    const int* split;
+    const int* default_child;
+
+    const int* split_column;
+    const int* split_cat;
+    const float* split_c;
+    const int* split_subset;
+    const int* split_inversed;
+    const int* split_next;
+    const int* subsets;
+
+    const int* var_column;
+    const int* var_cat;
+    const int* cat_ofs;
+    const int* cat_map;
+
+    int n_splits, n_subsets, n_vars, n_cat_ofs, n_cat_map;
+
+private:
+
+    // categorical split child (as FlatDTree::categorical_child())
+
+    int categorical_child(int n, const float* sample) const
+    {
+        for (int s = split[n]; s >= 0; s = split_next[s])
+        {
+            float val = sample[split_column[s]];
+            int dir;
+
+            if (split_cat[s] < 0)
+            {
+                dir = (val <= split_c[s]) ? -1 : 1;
+            }
+            else
+            {
+                int ci = split_cat[s];
+                int ival = cvRound(val);
+                if (ival != val)
+                {
+                    CV_Error(CV_StsBadArg, "one of input categorical variable is not an integer");
+                }
+
+                int a = cat_ofs[ci];
+                int b = (ci + 1 >= n_cat_ofs) ? n_cat_map : cat_ofs[ci + 1];
+                int c = a;
+                while (a < b)
+                {
+                    c = (a + b) >> 1;
+                    if (ival < cat_map[c])
+                    {
+                        b = c;
+                    }
+                    else if (ival > cat_map[c])
+                    {
+                        a = c + 1;
+                    }
+                    else
+                    {
+                        break;
+                    }
+                }
+                if ((c < 0) || (c >= n_cat_map) || (ival != cat_map[c]))
+                {
+                    continue;
+                }
+
+                const int* subset = subsets + split_subset[s];
+                dir = CV_DTREE_CAT_DIR(c - cat_ofs[ci], subset);
+            }
+
+            if (split_inversed[s])
+            {
+                dir = -dir;
+            }
+            return (dir < 0) ? left[n] : right[n];
+        }
+        return default_child[n];
+    }
+
+    friend class BinaryDTreeFile;
+};
+
+/******************************************************************************/
+
+class BinaryDTreeFile
+{
+public:
+
+    BinaryDTreeFile() : base(0), size(0), header(0), mapped(false) {}
+    ~BinaryDTreeFile() { close(); }
+
+    // write a model (one or more flattened trees and the model's variable
+    // importance, which may be empty) - returns false on failure
+
+    static bool write(const char* filename, const std::vector<const FlatDTree*>& trees,
+                      const std::vector<double>& var_importance)
+    {
+        FILE* f = fopen(filename, "wb");
+        if (!f)
+        {
+            return false;
+        }
+
+        DTBinaryHeader h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, DT_BINARY_MAGIC, 4);
+        h.version = DT_BINARY_VERSION;
+        h.byte_order = DT_BINARY_BYTE_ORDER;
+        h.header_size = (int) sizeof(DTBinaryHeader);
+        h.n_trees = (int) trees.size();
+        h.var_all = trees.empty() ? 0 : trees[0]->get_var_all();
+        h.n_importance = (int) var_importance.size();
+
+        // lay out the file
+
+        int64 pos = align(sizeof(DTBinaryHeader));
+        h.importance_offset = pos;
+        pos = align(pos + var_importance.size() * sizeof(double));
+        h.tree_table_offset = pos;
+        pos = align(pos + trees.size() * sizeof(DTBinaryTree));
+
+        std::vector<DTBinaryTree> table(trees.size());
+        for (size_t t = 0; t < trees.size(); t++)
+        {
+            const FlatDTree& ftree = *trees[t];
+            DTBinaryTree& bt = table[t];
+            memset(&bt, 0, sizeof(bt));
+            bt.node_count = ftree.get_node_count();
+            bt.depth = ftree.get_depth();
+
+            for (int a = 0; a < DT_BINARY_ARRAYS; a++)
+            {
+                size_t bytes;
+                array_data(ftree, a, bytes);
+                bt.count[a] = (int64) (bytes / element_size(a));
+                bt.offset[a] = pos;
+                pos = align(pos + bytes);
+            }
+        }
+        h.file_size = pos;
+
+        // then write it
+
+        bool ok = put(f, &h, sizeof(h));
+        ok = ok && pad(f, h.importance_offset);
+        ok = ok && (var_importance.empty()
+                    || put(f, &var_importance[0], var_importance.size() * sizeof(double)));
+        ok = ok && pad(f, h.tree_table_offset);
+        ok = ok && (table.empty() || put(f, &table[0], table.size() * sizeof(DTBinaryTree)));
+
+        for (size_t t = 0; ok && (t < trees.size()); t++)
+        {
+            for (int a = 0; ok && (a < DT_BINARY_ARRAYS); a++)
+            {
+                size_t bytes;
+                const void* p = array_data(*trees[t], a, bytes);
+                ok = pad(f, table[t].offset[a]) && ((bytes == 0) || put(f, p, bytes));
+            }
+        }
+        ok = ok && pad(f, h.file_size);
+
+        return (fclose(f) == 0) && ok;
+    }
+
+    // map a file - returns false (with a message) if it is not a valid
+    // binary tree file of this version
+
+    bool open(const char* filename)
+    {
+        close();
+
+#ifdef DT_BINARY_NO_MMAP
+        FILE* f = fopen(filename, "rb");
+        if (!f)
+        {
+            return fail(filename, "cannot open file");
+        }
+        fseek(f, 0, SEEK_END);
+        size = (size_t) ftell(f);
+        fseek(f, 0, SEEK_SET);
+        buffer.resize(size + 1);
+        bool ok = (fread(&buffer[0], 1, size, f) == size);
+        fclose(f);
+        if (!ok)
+        {
+            return fail(filename, "cannot read file");
+        }
+        base = &buffer[0];
+#else
+        int fd = ::open(filename, O_RDONLY);
+        if (fd < 0)
+        {
+            return fail(filename, "cannot open file");
+        }
+        struct stat st;
+        if ((fstat(fd, &st) != 0) || (st.st_size < (off_t) sizeof(DTBinaryHeader)))
+        {
+            ::close(fd);
+            return fail(filename, "not a binary tree file");
+        }
+        size = (size_t) st.st_size;
+        void* p = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        ::close(fd);
+        if (p == MAP_FAILED)
+        {
+            return fail(filename, "cannot map file");
+        }
+        base = (const char*) p;
+        mapped = true;
+#endif
+
+        // check the header and the table of trees
+
+        header = (const DTBinaryHeader*) base;
+        if ((size < sizeof(DTBinaryHeader)) || memcmp(header->magic, DT_BINARY_MAGIC, 4))
+        {
+            return fail(filename, "not a binary tree file");
+        }
+        if (header->byte_order != DT_BINARY_BYTE_ORDER)
+        {
+            return fail(filename, "written with a different byte order");
+        }
+        if ((header->version != DT_BINARY_VERSION)
+                || (header->header_size != (int) sizeof(DTBinaryHeader)))
+        {
+            return fail(filename, "unsupported binary tree file version");
+        }
+        if ((header->file_size != (int64) size) || (header->n_trees < 0)
+                || (header->n_importance < 0)
+                || !in_file(header->importance_offset, header->n_importance, sizeof(double))
+                || !in_file(header->tree_table_offset, header->n_trees, sizeof(DTBinaryTree)))
+        {
+            return fail(filename, "truncated or corrupt binary tree file");
+        }
+
+        const DTBinaryTree* table = (const DTBinaryTree*) (base + header->tree_table_offset);
+        trees.resize(header->n_trees);
+        for (int t = 0; t < header->n_trees; t++)
+        {
+            if (!set_tree(table[t], trees[t]))
+            {
+                return fail(filename, "truncated or corrupt binary tree file");
+            }
+        }
+
+        return true;
+    }
+
+    void close()
+    {
+#ifndef DT_BINARY_NO_MMAP
+        if (mapped)
+        {
+            munmap((void*) base, size);
+        }
+#endif
+        buffer.clear();
+        trees.clear();
+        base = 0;
+        size = 0;
+        header = 0;
+        mapped = false;
+    }
+
+    int get_tree_count() const { return (int) trees.size(); }
+    const BinaryDTree& get_tree(int i) const { return trees[i]; }
+    int get_var_all() const { return header ? header->var_all : 0; }
+
+    // variable importance of the model (0 if none was stored)
+
+    const double* get_var_importance() const
+    {
+        return (header && header->n_importance)
+               ? (const double*) (base + header->importance_offset) : 0;
+    }
+    int get_var_importance_count() const { return header ? header->n_importance : 0; }
+
+    // is a file a binary tree file (by its magic number) ?
+
+    static bool is_binary(const char* filename)
+    {
+        char magic[4] = {0, 0, 0, 0};
+        FILE* f = fopen(filename, "rb");
+        if (!f)
+        {
+            return false;
+        }
+        size_t n = fread(magic, 1, 4, f);
+        fclose(f);
+        return (n == 4) && !memcmp(magic, DT_BINARY_MAGIC, 4);
+    }
+
+private:
+
+    static int64 align(int64 pos) { return (pos + 7) & ~((int64) 7); }
+
+    static size_t element_size(int a)
+    {
+        return (a == DT_VALUE) ? sizeof(double)
+               : ((a == DT_THRESHOLD) || (a == DT_SPLIT_C)) ? sizeof(float) : sizeof(int);
+    }
+
+    // the array a of a flattened tree (and its size in bytes)
+
+    static const void* array_data(const FlatDTree& ftree, int a, size_t& bytes)
+    {
+        const void* p = 0;
+        size_t n = 0;
+
+        switch (a)
+        {
+        case DT_FEATURE: p = vector_data(ftree.feature, n); break;
+        case DT_THRESHOLD: p = vector_data(ftree.threshold, n); break;
+        case DT_LEFT: p = vector_data(ftree.left, n); break;
+        case DT_RIGHT: p = vector_data(ftree.right, n); break;
+        case DT_VALUE: p = vector_data(ftree.value, n); break;
+        case DT_SPLIT: p = vector_data(ftree.split, n); break;
+        case DT_DEFAULT_CHILD: p = vector_data(ftree.default_child, n); break;
+        case DT_SPLIT_COLUMN: p = vector_data(ftree.split_column, n); break;
+        case DT_SPLIT_CAT: p = vector_data(ftree.split_cat, n); break;
+        case DT_SPLIT_C: p = vector_data(ftree.split_c, n); break;
+        case DT_SPLIT_SUBSET: p = vector_data(ftree.split_subset, n); break;
+        case DT_SPLIT_INVERSED: p = vector_data(ftree.split_inversed, n); break;
+        case DT_SPLIT_NEXT: p = vector_data(ftree.split_next, n); break;
+        case DT_SUBSETS: p = vector_data(ftree.subsets, n); break;
+        case DT_VAR_COLUMN: p = vector_data(ftree.var_column, n); break;
+        case DT_VAR_CAT: p = vector_data(ftree.var_cat, n); break;
+        case DT_CAT_OFS: p = vector_data(ftree.cat_ofs, n); break;
+        case DT_CAT_MAP: p = vector_data(ftree.cat_map, n); break;
+        }
+
+        bytes = n * element_size(a);
+        return p;
+    }
+
+    template<typename T>
+    static const void* vector_data(const std::vector<T>& v, size_t& n)
+    {
+        n = v.size();
+        return v.empty() ? 0 : (const void*) &v[0];
+    }
+
+    static bool put(FILE* f, const void* p, size_t bytes)
+    {
+        return fwrite(p, 1, bytes, f) == bytes;
+    }
+
+    // zero fill up to a file position
+
+    static bool pad(FILE* f, int64 pos)
+    {
+        static const char zeros[8] = {0, 0, 0, 0, 0, 0, 0, 0};
+        long cur = ftell(f);
+        return (cur >= 0) && (cur <= pos) && put(f, zeros, (size_t) (pos - cur));
+    }
+
+    bool in_file(int64 offset, int64 count, size_t elem) const
+    {
+        return (offset >= 0) && (count >= 0) && ((offset & 7) == 0)
+               && (offset <= (int64) size)
+               && (count <= ((int64) size - offset) / (int64) elem);
+    }
+
+    // point a tree view at its arrays (checking they lie within the file and
+    // the values they hold, see valid_tree())
+
+    bool set_tree(const DTBinaryTree& bt, BinaryDTree& tree) const
+    {
+        for (int a = 0; a < DT_BINARY_ARRAYS; a++)
+        {
+            if (!in_file(bt.offset[a], bt.count[a], element_size(a)))
+            {
+                return false;
+            }
+        }
+        for (int a = DT_FEATURE; a <= DT_DEFAULT_CHILD; a++)
+        {
+            if (bt.count[a] != bt.node_count)
+            {
+                return false;
+            }
+        }
+        for (int a = DT_SPLIT_CAT; a <= DT_SPLIT_NEXT; a++)
+        {
+            if (bt.count[a] != bt.count[DT_SPLIT_COLUMN])
+            {
+                return false;
+            }
+        }
+        if ((bt.node_count < 1) || (bt.count[DT_VAR_CAT] != bt.count[DT_VAR_COLUMN]))
+        {
+            return false;
+        }
+
+        tree.node_count = bt.node_count;
+        tree.depth = bt.depth;
+        tree.feature = (const int*) (base + bt.offset[DT_FEATURE]);
+        tree.threshold = (const float*) (base + bt.offset[DT_THRESHOLD]);
+        tree.left = (const int*) (base + bt.offset[DT_LEFT]);
+        tree.right = (const int*) (base + bt.offset[DT_RIGHT]);
+        tree.value = (const double*) (base + bt.offset[DT_VALUE]);
+        tree.split = (const int*) (base + bt.offset[DT_SPLIT]);
+        tree.default_child = (const int*) (base + bt.offset[DT_DEFAULT_CHILD]);
+        tree.split_column = (const int*) (base + bt.offset[DT_SPLIT_COLUMN]);
+        tree.split_cat = (const int*) (base + bt.offset[DT_SPLIT_CAT]);
+        tree.split_c = (const float*) (base + bt.offset[DT_SPLIT_C]);
+        tree.split_subset = (const int*) (base + bt.offset[DT_SPLIT_SUBSET]);
+        tree.split_inversed = (const int*) (base + bt.offset[DT_SPLIT_INVERSED]);
+        tree.split_next = (const int*) (base + bt.offset[DT_SPLIT_NEXT]);
+        tree.subsets = (const int*) (base + bt.offset[DT_SUBSETS]);
+        tree.var_column = (const int*) (base + bt.offset[DT_VAR_COLUMN]);
+        tree.var_cat = (const int*) (base + bt.offset[DT_VAR_CAT]);
+        tree.cat_ofs = (const int*) (base + bt.offset[DT_CAT_OFS]);
+        tree.cat_map = (const int*) (base + bt.offset[DT_CAT_MAP]);
+        tree.n_splits = (int) bt.count[DT_SPLIT_COLUMN];
+        tree.n_subsets = (int) bt.count[DT_SUBSETS];
+        tree.n_vars = (int) bt.count[DT_VAR_COLUMN];
+        tree.n_cat_ofs = (int) bt.count[DT_CAT_OFS];
+        tree.n_cat_map = (int) bt.count[DT_CAT_MAP];
+
+        return valid_tree(tree, header->var_all);
+    }
+
+    // check the indices held by the arrays of a tree, in one pass over its
+    // categories, variables, splits and nodes: each within the array it
+    // indexes, and the children of a node and the next (surrogate) split of
+    // a split after it (as FlatDTree writes them, whatever the layout) so
+    // that every traversal ends - a negative categorical variable index is an
+    // ordered variable (numbered -1, -2 ... by CvDTreeTrainData, as copied)
+
+    static bool valid_tree(const BinaryDTree& t, int var_all)
+    {
+        for (int ci = 0; ci < t.n_cat_ofs; ci++)
+        {
+            if ((t.cat_ofs[ci] < 0) || (t.cat_ofs[ci] > t.n_cat_map)
+                    || ((ci > 0) && (t.cat_ofs[ci] < t.cat_ofs[ci - 1])))
+            {
+                return false;
+            }
+        }
+
+        for (int vi = 0; vi < t.n_vars; vi++)
+        {
+            if ((t.var_column[vi] < 0) || (t.var_column[vi] >= var_all)
+                    || (t.var_cat[vi] >= t.n_cat_ofs))
+            {
+                return false;
+            }
+        }
+
+        for (int s = 0; s < t.n_splits; s++)
+        {
+            int ci = t.split_cat[s];
+            int next = t.split_next[s];
+            if ((t.split_column[s] < 0) || (t.split_column[s] >= var_all)
+                    || (ci >= t.n_cat_ofs)
+                    || ((next != -1) && ((next <= s) || (next >= t.n_splits))))
+            {
+                return false;
+            }
+
+            // the subset bits of a categorical split (as FlatDTree::add_splits())
+
+            if (ci >= 0)
+            {
+                int n_cats = ((ci + 1 < t.n_cat_ofs) ? t.cat_ofs[ci + 1] : t.n_cat_map)
+                             - t.cat_ofs[ci];
+                int n_words = std::max(2, (n_cats + 31) / 32);
+                if ((t.split_subset[s] < 0) || (t.split_subset[s] > t.n_subsets - n_words))
+                {
+                    return false;
+                }
+            }
+        }
+
+        for (int n = 0; n < t.node_count; n++)
+        {
+            if ((t.left[n] < 0) || (t.left[n] >= t.node_count)
+                    || (t.right[n] < 0) || (t.right[n] >= t.node_count)
+                    || (t.default_child[n] < 0) || (t.default_child[n] >= t.node_count))
+            {
+                return false;
+            }
+            if (t.feature[n] < 0)
+            {
+                continue; // (leaf)
+            }
+            if ((t.feature[n] >= var_all) || (t.left[n] <= n) || (t.right[n] <= n)
+                    || ((t.default_child[n] != t.left[n]) && (t.default_child[n] != t.right[n]))
+                    || (t.split[n] < -1) || (t.split[n] >= t.n_splits))
+            {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    bool fail(const char* filename, const char* message)
+    {
+        printf("ERROR: %s: %s\n", filename, message);
+        close();
+        return false;
+    }
+
+    const char* base;           // start of the file (mapped or in buffer)
+    size_t size;
+    const DTBinaryHeader* header;
+    bool mapped;
+    std::vector<char> buffer;   // (DT_BINARY_NO_MMAP only)
+    std::vector<BinaryDTree> trees;
+};
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,354 @@
+// Example : compile a saved decision tree into C++ source code
+// usage: prog tree.{yml|.xml} output.cpp function_name
+
+// For use with any saved decision tree (e.g. tree.yml, ex_tree.xml)
+
+// Writes a standalone C++ function "double function_name(const float* sample)"
+// of nested comparisons that gives the same result as CvDTree::predict() for
+// the saved tree, with no tree interpretation at all at run time:
+//
+// - ordered splits become (sample[i] <= T) tests on constexpr thresholds
+// - categorical splits map the sample value to its category index through
+//   the (sorted) cat_map values of the variable and test that bit of a
+//   constant 64-bit subset mask (an array of masks for > 64 categories)
+// - surrogate splits and the default direction are only emitted for
+//   categorical splits, where a category not seen in training leaves the
+//   primary split undecided (N.B. a non-integer categorical value is treated
+//   as unseen rather than raising an error as CvDTree does)
+//
+// The generated code does not depend on OpenCV - see add_compiled_tree() in
+// CMakeLists.txt to build it into a target.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+#include <string.h>
+
+#include "flat_dtree.h"
+
+/*****************************************************************************/
+
+// format a float as a C++ float literal that reads back to the same value
+
+const char* float_literal(float v, char* buf)
+{
+	sprintf(buf, "%.9g", v);
+	if (!strpbrk(buf, ".e"))
+	{
+		strcat(buf, ".0");
+	}
+	strcat(buf, "f");
+	return buf;
+}
+
+/*****************************************************************************/
+
+// indent the generated code to a given depth
+
+void indent(FILE* f, int depth)
+{
+	for (int i = 0; i < depth; i++)
+	{
+		fprintf(f, "    ");
+	}
+}
+
+/*****************************************************************************/
+
+// number of categories of categorical variable ci
+
+int category_count(const FlatDTree& ftree, int ci)
+{
+	int b = (ci + 1 < (int) ftree.cat_ofs.size())
+		? ftree.cat_ofs[ci + 1] : (int) ftree.cat_map.size();
+	return b - ftree.cat_ofs[ci];
+}
+
+/*****************************************************************************/
+
+// emit the category lookup function for every categorical variable and the
+// subset mask of every categorical split
+
+void emit_tables(FILE* f, const FlatDTree& ftree)
+{
+	std::vector<bool> used(ftree.cat_ofs.size(), false);
+	for (size_t s = 0; s < ftree.split_cat.size(); s++)
+	{
+		if (ftree.split_cat[s] >= 0)
+		{
+			used[ftree.split_cat[s]] = true;
+		}
+	}
+
+	for (size_t ci = 0; ci < used.size(); ci++)
+	{
+		if (!used[ci])
+		{
+			continue;
+		}
+
+		int n_cats = category_count(ftree, (int) ci);
+		const int* values = &ftree.cat_map[ftree.cat_ofs[ci]];
+
+		fprintf(f, "// categorical variable %d: value -> category index (-1 unseen)\n\n", (int) ci);
+		fprintf(f, "static const int cat_values_%d[%d] = {", (int) ci, n_cats);
+		for (int c = 0; c < n_cats; c++)
+		{
+			fprintf(f, "%s%s%d", (c ? ", " : " "), ((c % 8) ? "" : "\n    "), values[c]);
+		}
+		fprintf(f, "\n};\n\n");
+
+		fprintf(f, "static inline int cat_%d(float v)\n{\n", (int) ci);
+		fprintf(f, "    if (!((v > -2147483648.0f) && (v < 2147483648.0f)) || ((float) (int) v != v))\n");
+		fprintf(f, "    {\n        return -1;\n    }\n");
+		fprintf(f, "    int iv = (int) v, a = 0, b = %d;\n", n_cats);
+		fprintf(f, "    while (a < b)\n    {\n");
+		fprintf(f, "        int c = (a + b) >> 1;\n");
+		fprintf(f, "        if (iv < cat_values_%d[c]) b = c;\n", (int) ci);
+		fprintf(f, "        else if (iv > cat_values_%d[c]) a = c + 1;\n", (int) ci);
+		fprintf(f, "        else return c;\n");
+		fprintf(f, "    }\n    return -1;\n}\n\n");
+	}
+
+	for (size_t s = 0; s < ftree.split_cat.size(); s++)
+	{
+		int ci = ftree.split_cat[s];
+		if (ci < 0)
+		{
+			continue;
+		}
+
+		int n_cats = category_count(ftree, ci);
+		const int* subset = &ftree.subsets[ftree.split_subset[s]];
+
+		if (n_cats <= 64)
+		{
+			uint64 mask = ((uint64) (unsigned) subset[0])
+				| (((uint64) (unsigned) subset[1]) << 32);
+			fprintf(f, "DT_CONSTEXPR unsigned long long M%d = 0x%016llxULL;\n",
+			        (int) s, (unsigned long long) mask);
+		}
+		else
+		{
+			int n_words = (n_cats + 31) / 32;
+			fprintf(f, "static const unsigned int M%d[%d] = {", (int) s, n_words);
+			for (int w = 0; w < n_words; w++)
+			{
+				fprintf(f, "%s0x%08xU", (w ? ", " : " "), (unsigned) subset[w]);
+			}
+			fprintf(f, " };\n");
+		}
+	}
+	fprintf(f, "\n");
+}
+
+/*****************************************************************************/
+
+// emit the threshold constant of every ordered split node
+
+void emit_thresholds(FILE* f, const FlatDTree& ftree)
+{
+	char buf[64];
+
+	for (int n = 0; n < ftree.get_node_count(); n++)
+	{
+		if ((ftree.feature[n] >= 0) && (ftree.split[n] < 0))
+		{
+			fprintf(f, "DT_CONSTEXPR float T%d = %s;\n", n,
+			        float_literal(ftree.threshold[n], buf));
+		}
+	}
+	fprintf(f, "\n");
+}
+
+/*****************************************************************************/
+
+// emit the code setting "dir" from split s (and its surrogates) of a node
+
+void emit_split_chain(FILE* f, const FlatDTree& ftree, int s, int depth)
+{
+	char buf[64];
+	int first = 1;
+
+	for (; s >= 0; s = ftree.split_next[s])
+	{
+		int ci = ftree.split_cat[s];
+		int neg = ftree.split_inversed[s] ? 1 : -1; // dir for "bit set" / "<="
+
+		if (!first)
+		{
+			indent(f, depth);
+			fprintf(f, "if (!dir)\n");
+		}
+		indent(f, depth);
+		fprintf(f, "{\n");
+
+		if (ci < 0)
+		{
+			indent(f, depth + 1);
+			fprintf(f, "dir = (sample[%d] <= %s) ? %d : %d;\n",
+			        ftree.split_column[s], float_literal(ftree.split_c[s], buf),
+			        neg, -neg);
+		}
+		else if (category_count(ftree, ci) <= 64)
+		{
+			indent(f, depth + 1);
+			fprintf(f, "int c = cat_%d(sample[%d]);\n", ci, ftree.split_column[s]);
+			indent(f, depth + 1);
+			fprintf(f, "if (c >= 0) dir = ((M%d >> c) & 1) ? %d : %d;\n", s, neg, -neg);
+		}
+		else
+		{
+			indent(f, depth + 1);
+			fprintf(f, "int c = cat_%d(sample[%d]);\n", ci, ftree.split_column[s]);
+			indent(f, depth + 1);
+			fprintf(f, "if (c >= 0) dir = ((M%d[c >> 5] >> (c & 31)) & 1) ? %d : %d;\n",
+			        s, neg, -neg);
+		}
+
+		indent(f, depth);
+		fprintf(f, "}\n");
+		first = 0;
+	}
+}
+
+/*****************************************************************************/
+
+// emit the nested comparisons for the sub-tree at node n
+
+void emit_node(FILE* f, const FlatDTree& ftree, int n, int depth)
+{
+	if (ftree.feature[n] < 0)
+	{
+		indent(f, depth);
+		fprintf(f, "return %.17g;\n", ftree.value[n]);
+		return;
+	}
+
+	if (ftree.split[n] < 0)
+	{
+		indent(f, depth);
+		fprintf(f, "if (sample[%d] <= T%d)\n", ftree.feature[n], n);
+		indent(f, depth);
+		fprintf(f, "{\n");
+		emit_node(f, ftree, ftree.left[n], depth + 1);
+		indent(f, depth);
+		fprintf(f, "}\n");
+		indent(f, depth);
+		fprintf(f, "else\n");
+		indent(f, depth);
+		fprintf(f, "{\n");
+		emit_node(f, ftree, ftree.right[n], depth + 1);
+		indent(f, depth);
+		fprintf(f, "}\n");
+		return;
+	}
+
+	// categorical split (with surrogates, then the default direction)
+
+	indent(f, depth);
+	fprintf(f, "{\n");
+	indent(f, depth + 1);
+	fprintf(f, "int dir = 0;\n");
+	emit_split_chain(f, ftree, ftree.split[n], depth + 1);
+	indent(f, depth + 1);
+	fprintf(f, "if (!dir) dir = %d;\n",
+	        (ftree.default_child[n] == ftree.left[n]) ? -1 : 1);
+	indent(f, depth + 1);
+	fprintf(f, "if (dir < 0)\n");
+	indent(f, depth + 1);
+	fprintf(f, "{\n");
+	emit_node(f, ftree, ftree.left[n], depth + 2);
+	indent(f, depth + 1);
+	fprintf(f, "}\n");
+	indent(f, depth + 1);
+	fprintf(f, "else\n");
+	indent(f, depth + 1);
+	fprintf(f, "{\n");
+	emit_node(f, ftree, ftree.right[n], depth + 2);
+	indent(f, depth + 1);
+	fprintf(f, "}\n");
+	indent(f, depth);
+	fprintf(f, "}\n");
+}
+
+/*****************************************************************************/
+
+int main( int argc, char** argv )
+{
+
+	// check we have enough command line arguments
+
+	if (argc == 4)
+	{
+		// define a decision tree object
+
+		CvDTree* dtree = new CvDTree;
+
+		// load tree structure from XML / YML file and flatten it
+
+		dtree->load(argv[1]);
+
+		FlatDTree ftree;
+		if (!ftree.build(dtree))
+		{
+			printf("ERROR: cannot read the decision tree in %s\n", argv[1]);
+			return -1;
+		}
+
+		FILE* f = fopen(argv[2], "w");
+		if (!f)
+		{
+			printf("ERROR: cannot write output file %s\n", argv[2]);
+			return -1;
+		}
+
+		const char* name = argv[3];
+
+		fprintf(f, "// Generated by dt_codegen from %s - do not edit\n", argv[1]);
+		fprintf(f, "// %d nodes, depth %d, %d sample attributes\n\n",
+		        ftree.get_node_count(), ftree.get_depth(), ftree.get_var_all());
+		fprintf(f, "// usage: double %s(const float* sample);\n\n", name);
+
+		fprintf(f, "#ifndef DT_CONSTEXPR\n");
+		fprintf(f, "#if __cplusplus >= 201103L\n");
+		fprintf(f, "#define DT_CONSTEXPR static constexpr\n");
+		fprintf(f, "#else\n");
+		fprintf(f, "#define DT_CONSTEXPR static const\n");
+		fprintf(f, "#endif\n");
+		fprintf(f, "#endif\n\n");
+
+		fprintf(f, "namespace %s_tree\n{\n\n", name);
+		emit_tables(f, ftree);
+		emit_thresholds(f, ftree);
+		fprintf(f, "}\n\n");
+
+		fprintf(f, "double %s(const float* sample)\n{\n", name);
+		fprintf(f, "    using namespace %s_tree;\n\n", name);
+		emit_node(f, ftree, 0, 1);
+		fprintf(f, "}\n");
+
+		fclose(f);
+
+		printf("Compiled %s (%d nodes) to %s as %s()\n",
+		       argv[1], ftree.get_node_count(), argv[2], name);
+
+		return 0; // all OK
+
+    } else {
+
+    // not OK : main returns -1
+
+	printf("usage: %s decision_tree_filename.{xml|yml} output.cpp function_name\n", argv[0]);
+    return -1;
+
+    }
+}
+/******************************************************************************/
@@ -0,0 +1,169 @@
+// Example : flatten a saved decision tree and check / benchmark it
+// usage: prog tree.{yml|.xml} [number_of_samples]
+
+// For use with any saved decision tree (e.g. tree.yml, ex_tree.xml)
+
+// Loads the tree, converts it to the struct of arrays form of flat_dtree.h
+// and checks that the flattened tree gives identical predictions to
+// CvDTree::predict() over synthetic samples drawn from the tree itself
+// (categorical values from its cat_map, ordered values at and either side
+// of its split thresholds) before reporting the throughput of both, and of
+// the lockstep batch traversal (AVX2 where available) of the flattened tree.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "flat_dtree.h"
+
+#define DEFAULT_NUMBER_OF_SAMPLES 100000
+
+/*****************************************************************************/
+
+// generate synthetic samples that exercise every split of the tree
+
+void generate_samples(const FlatDTree& ftree, Mat& samples, int n_samples)
+{
+	RNG rng(0x5eed);
+
+	// thresholds used on each ordered sample column
+
+	std::vector< std::vector<float> > thresholds(ftree.get_var_all());
+	for (int n = 0; n < ftree.get_node_count(); n++)
+	{
+		if ((ftree.feature[n] >= 0) && (ftree.split[n] < 0))
+		{
+			thresholds[ftree.feature[n]].push_back(ftree.threshold[n]);
+		}
+	}
+
+	samples = Mat::zeros(n_samples, ftree.get_var_all(), CV_32F);
+
+	for (int i = 0; i < n_samples; i++)
+	{
+		for (size_t vi = 0; vi < ftree.var_column.size(); vi++)
+		{
+			int column = ftree.var_column[vi];
+			int ci = ftree.var_cat[vi];
+			float v = 0;
+
+			if (ci >= 0)
+			{
+				// a category seen in training
+
+				int a = ftree.cat_ofs[ci];
+				int b = (ci + 1 < (int) ftree.cat_ofs.size())
+					? ftree.cat_ofs[ci + 1] : (int) ftree.cat_map.size();
+				if (b > a)
+				{
+					v = (float) ftree.cat_map[rng.uniform(a, b)];
+				}
+			}
+			else if (!thresholds[column].empty())
+			{
+				// a split threshold, just below it or just above it
+
+				float t = thresholds[column][rng.uniform(0, (int) thresholds[column].size())];
+				int side = rng.uniform(0, 3);
+				v = (side == 0) ? t : (side == 1) ? (t - (float) rng.uniform(0.0, 1.0))
+					: (t + (float) rng.uniform(0.0, 1.0));
+			}
+			else
+			{
+				v = (float) rng.uniform(-1.0, 1.0);
+			}
+
+			samples.at<float>(i, column) = v;
+		}
+	}
+}
+
+/*****************************************************************************/
+
+int main( int argc, char** argv )
+{
+
+	// check we have enough command line arguments
+
+	if ((argc == 2) || (argc == 3))
+	{
+		int n_samples = (argc == 3) ? atoi(argv[2]) : DEFAULT_NUMBER_OF_SAMPLES;
+
+		// define a decision tree object
+
+		CvDTree* dtree = new CvDTree;
+
+		// load tree structure from XML / YML file
+
+		dtree->load(argv[1]);
+
+		// flatten it
+
+		FlatDTree ftree;
+		if (!ftree.build(dtree))
+		{
+			printf("ERROR: cannot flatten the decision tree in %s\n", argv[1]);
+			return -1;
+		}
+
+		printf("Flattened tree: %d nodes, depth %d, %d bytes\n",
+		       ftree.get_node_count(), ftree.get_depth(),
+		       (int) ftree.get_size_bytes());
+
+		// check both predictors agree on the synthetic samples
+
+		Mat samples, flat_results;
+		generate_samples(ftree, samples, n_samples);
+
+		int64 start = getTickCount();
+		ftree.predict(samples, flat_results);
+		double flat_time = (double) (getTickCount() - start) / getTickFrequency();
+
+		int mismatches = 0;
+		start = getTickCount();
+		for (int i = 0; i < n_samples; i++)
+		{
+			CvDTreeNode* resultNode = dtree->predict(samples.row(i), Mat(), false);
+			if (resultNode->value != flat_results.at<double>(i, 0))
+			{
+				mismatches++;
+			}
+		}
+		double dtree_time = (double) (getTickCount() - start) / getTickFrequency();
+
+		Mat lockstep_results;
+		start = getTickCount();
+		ftree.predict_lockstep(samples, lockstep_results);
+		double lockstep_time = (double) (getTickCount() - start) / getTickFrequency();
+
+		mismatches += countNonZero(lockstep_results != flat_results);
+
+		printf("Synthetic samples: %d, mismatches: %d\n", n_samples, mismatches);
+		printf("CvDTree::predict: %g samples/s\n", n_samples / dtree_time);
+		printf("Flattened batch predict: %g samples/s (x%g)\n",
+		       n_samples / flat_time, dtree_time / flat_time);
+		printf("Flattened lockstep predict (%s): %g samples/s (x%g)\n",
+		       (checkHardwareSupport(CV_CPU_AVX2) && ftree.split_column.empty())
+		       ? "AVX2" : "scalar",
+		       n_samples / lockstep_time, dtree_time / lockstep_time);
+
+		return (mismatches == 0) ? 0 : -1;
+
+    } else {
+
+    // not OK : main returns -1
+
+	printf("usage: %s decision_tree_filename.{xml|yml} [number_of_samples]\n", argv[0]);
+    return -1;
+
+    }
+}
+/******************************************************************************/
@@ -0,0 +1,257 @@
+// Example : compare the memory layouts of a flattened decision tree
+// usage: prog tree.{yml|.xml} testing_data_file [number_of_passes]
+
+// For use with any saved decision tree (e.g. from opticaldigits_ex/decisiontree
+// or speech_ex/decisiontree) and its testing data set (CSV text file, one
+// sample per line of the tree's attributes followed by the class label)
+
+// Flattens the tree (flat_dtree.h) and, for each node layout, checks the
+// predictions are unchanged and reports the prediction throughput over the
+// testing data, the cache lines of the node arrays crossed per sample (a
+// count independent of the hardware: steps along a sample's path to a node
+// in a different 64 byte line of the feature array) and, where the kernel
+// performance counters are accessible, the L1 data / last level cache misses
+// per sample (perf_counter.h). The profile guided layout uses node visit
+// counts profiled on the testing data itself (see dt_profile to profile other
+// data and keep the counts). The best layout generally depends on the depth
+// of the tree relative to the cache sizes.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+
+#include "flat_dtree.h"
+#include "perf_counter.h"
+
+#define DEFAULT_NUMBER_OF_PASSES 100
+#define CACHE_LINE_BYTES 64
+
+/*****************************************************************************/
+
+// the sum of the timed predictions is stored here, where the compiler must
+// keep it, rather than printed
+
+volatile double prediction_sink;
+
+/*****************************************************************************/
+
+// loads a labelled sample file (CSV text file of n_attributes values then the
+// class label per line) of any number of samples - returns 0 on failure
+// (the labels are not used here)
+
+int read_labelled_data(const char* filename, int n_attributes, Mat& data)
+{
+	FILE* f = fopen(filename, "r");
+	if (!f)
+	{
+		printf("ERROR: cannot read file %s\n", filename);
+		return 0; // all not OK
+	}
+
+	std::vector<float> values;
+	float tmp;
+
+	while (fscanf(f, "%f,", &tmp) == 1)
+	{
+		values.push_back(tmp);
+	}
+	fclose(f);
+
+	if (values.empty() || (values.size() % (n_attributes + 1)))
+	{
+		printf("ERROR: %s is not %d attributes and a label per sample\n",
+		       filename, n_attributes);
+		return 0; // all not OK
+	}
+
+	int n_samples = (int) (values.size() / (n_attributes + 1));
+	data = Mat(n_samples, n_attributes, CV_32FC1);
+
+	for (int i = 0; i < n_samples; i++)
+	{
+		const float* line = &values[(size_t) i * (n_attributes + 1)];
+		std::copy(line, line + n_attributes, data.ptr<float>(i));
+	}
+
+	return 1; // all OK
+}
+
+/*****************************************************************************/
+
+// cache lines of the (int) feature array crossed on the path of a sample
+
+int lines_crossed(const FlatDTree& ftree, const float* sample)
+{
+	const int nodes_per_line = CACHE_LINE_BYTES / sizeof(int);
+	int lines = 1;
+	int n = 0;
+
+	while (ftree.feature[n] >= 0)
+	{
+		int next = ftree.child(n, sample);
+		if (next / nodes_per_line != n / nodes_per_line)
+		{
+			lines++;
+		}
+		n = next;
+	}
+
+	return lines;
+}
+
+/*****************************************************************************/
+
+int main( int argc, char** argv )
+{
+
+	// check we have enough command line arguments
+
+	if ((argc == 3) || (argc == 4))
+	{
+		int n_passes = (argc == 4) ? MAX(atoi(argv[3]), 1) : DEFAULT_NUMBER_OF_PASSES;
+
+		// load tree structure from XML / YML file and flatten it
+
+		CvDTree* dtree = new CvDTree;
+		dtree->load(argv[1]);
+
+		FlatDTree ftree;
+		if (!ftree.build(dtree))
+		{
+			printf("ERROR: cannot read the decision tree in %s\n", argv[1]);
+			return -1;
+		}
+
+		Mat data;
+		if (!read_labelled_data(argv[2], ftree.get_var_all(), data))
+		{
+			return -1;
+		}
+
+		Mat reference;
+		ftree.predict(data, reference);
+
+		std::vector<double> node_hits, left_hits;
+		ftree.profile(data, node_hits, left_hits);
+
+		CacheMissCounter l1_counter(CACHE_MISSES_L1D);
+		CacheMissCounter llc_counter(CACHE_MISSES_LLC);
+
+		printf("Tree %s : %d nodes, depth %d, %d samples x %d passes\n",
+		       argv[1], ftree.get_node_count(), ftree.get_depth(), data.rows, n_passes);
+		if (!l1_counter.available() || !llc_counter.available())
+		{
+			printf("(hardware cache miss counters not available)\n");
+		}
+		printf("\n%-16s %14s %14s %12s %12s\n", "layout", "samples/s",
+		       "lines/sample", "L1D/sample", "LLC/sample");
+
+		int best = -1;
+		double best_rate = 0;
+
+		for (int layout = 0; layout < FLAT_DTREE_LAYOUTS; layout++)
+		{
+			FlatDTree ltree = ftree;
+			ltree.set_layout(layout, &node_hits);
+
+			// the layout must not change any prediction
+
+			Mat results;
+			ltree.predict(data, results);
+			int mismatches = 0;
+			for (int i = 0; i < data.rows; i++)
+			{
+				if (results.at<double>(i, 0) != reference.at<double>(i, 0))
+				{
+					mismatches++;
+				}
+			}
+			if (mismatches)
+			{
+				printf("ERROR: %s layout changes %d predictions\n",
+				       FlatDTree::get_layout_name(layout), mismatches);
+				return -1;
+			}
+
+			long long lines = 0;
+			for (int i = 0; i < data.rows; i++)
+			{
+				lines += lines_crossed(ltree, data.ptr<float>(i));
+			}
+
+			// time the passes (counting cache misses if possible)
+
+			double sum = 0;
+
+			l1_counter.start();
+			llc_counter.start();
+			int64 start = getTickCount();
+			for (int pass = 0; pass < n_passes; pass++)
+			{
+				for (int i = 0; i < data.rows; i++)
+				{
+					sum += ltree.predict(data.ptr<float>(i));
+				}
+			}
+			double elapsed = (double) (getTickCount() - start) / getTickFrequency();
+			prediction_sink = sum; // (so the predictions are not optimised away)
+			long long l1_misses = l1_counter.stop();
+			long long llc_misses = llc_counter.stop();
+
+			double n_predictions = (double) data.rows * n_passes;
+			double rate = n_predictions / elapsed;
+
+			printf("%-16s %14.0f %14.2f", FlatDTree::get_layout_name(layout), rate,
+			       (double) lines / data.rows);
+			if (l1_misses >= 0)
+			{
+				printf(" %12.3f", l1_misses / n_predictions);
+			}
+			else
+			{
+				printf(" %12s", "n/a");
+			}
+			if (llc_misses >= 0)
+			{
+				printf(" %12.3f", llc_misses / n_predictions);
+			}
+			else
+			{
+				printf(" %12s", "n/a");
+			}
+			printf("\n");
+
+			if (rate > best_rate)
+			{
+				best_rate = rate;
+				best = layout;
+			}
+		}
+
+		printf("\nFastest layout for this tree (depth %d): %s\n",
+		       ftree.get_depth(), FlatDTree::get_layout_name(best));
+
+		delete dtree;
+
+		return 0; // all OK
+
+    } else {
+
+    // not OK : main returns -1
+
+	printf("usage: %s decision_tree_filename.{xml|yml} testing_data_file [number_of_passes]\n", argv[0]);
+    return -1;
+
+    }
+}
+/******************************************************************************/
@@ -0,0 +1,479 @@
+// Example : profile guided layout of a saved decision tree or random forest
+// usage: prog model.{yml|.xml} counts.yml data_file [output.bin]
+
+// For use with any saved decision tree (e.g. from opticaldigits_ex/decisiontree)
+// or random forest (CvRTrees::save()) and a data set representative of the
+// samples it will predict (CSV text file, one sample per line of the model's
+// attributes followed by the class label, e.g. optdigits.test)
+
+// Counts how often each node of each (flattened) tree is visited and each
+// branch taken while predicting the data set, adding the counts to those
+// already in counts.yml (if it exists, for the same model - each tree's
+// checksum of its shape, split attributes and thresholds is saved with its
+// counts, and counts of any other tree are rejected) and saving them there,
+// so that traffic can be profiled in several runs and layouts re-optimised
+// offline later (a data_file of "-" just uses the saved counts).
+// Each tree is then laid out with the likely child immediately after its
+// parent and the hot paths packed together (FLAT_DTREE_PROFILE_GUIDED), the
+// prediction time compared with the other layouts and optionally the laid
+// out model written as a binary tree file (dt_binary.h) for loading directly.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+#include <string.h>
+#include <vector>
+#include <algorithm>
+
+#include "flat_dtree.h"
+#include "dt_binary.h"
+
+#define NUMBER_OF_TIMING_PASSES 20
+
+/*****************************************************************************/
+
+// loads a labelled sample file (CSV text file of n_attributes values then the
+// class label per line) of any number of samples - returns 0 on failure
+// (the labels are not used here)
+
+int read_labelled_data(const char* filename, int n_attributes, Mat& data)
+{
+	FILE* f = fopen(filename, "r");
+	if (!f)
+	{
+		printf("ERROR: cannot read file %s\n", filename);
+		return 0; // all not OK
+	}
+
+	std::vector<float> values;
+	float tmp;
+
+	while (fscanf(f, "%f,", &tmp) == 1)
+	{
+		values.push_back(tmp);
+	}
+	fclose(f);
+
+	if (values.empty() || (values.size() % (n_attributes + 1)))
+	{
+		printf("ERROR: %s is not %d attributes and a label per sample\n",
+		       filename, n_attributes);
+		return 0; // all not OK
+	}
+
+	int n_samples = (int) (values.size() / (n_attributes + 1));
+	data = Mat(n_samples, n_attributes, CV_32FC1);
+
+	for (int i = 0; i < n_samples; i++)
+	{
+		const float* line = &values[(size_t) i * (n_attributes + 1)];
+		std::copy(line, line + n_attributes, data.ptr<float>(i));
+	}
+
+	return 1; // all OK
+}
+
+/*****************************************************************************/
+
+// loads the model (a single tree or a forest) flattening its tree(s) - and
+// the model's variable importance if it has any
+
+bool load_model(const char* filename, std::vector<FlatDTree>& ftrees,
+                std::vector<double>& importance)
+{
+	FileStorage fs(filename, FileStorage::READ);
+	if (!fs.isOpened())
+	{
+		printf("ERROR: cannot read model file %s\n", filename);
+		return false;
+	}
+	bool is_forest = !fs.getFirstTopLevelNode()["ntrees"].empty();
+	fs.release();
+
+	const CvMat* var_importance = 0;
+	bool ok = true;
+
+	if (is_forest)
+	{
+		CvRTrees* forest = new CvRTrees;
+		forest->load(filename);
+
+		ftrees.resize(forest->get_tree_count());
+		for (int i = 0; ok && (i < forest->get_tree_count()); i++)
+		{
+			ok = ftrees[i].build(forest->get_tree(i));
+		}
+		var_importance = forest->get_var_importance();
+		for (int i = 0; var_importance && (i < var_importance->rows * var_importance->cols); i++)
+		{
+			importance.push_back(cvGetReal1D(var_importance, i));
+		}
+		delete forest;
+	}
+	else
+	{
+		CvDTree* dtree = new CvDTree;
+		dtree->load(filename);
+
+		ftrees.resize(1);
+		ok = ftrees[0].build(dtree);
+		var_importance = ok ? dtree->get_var_importance() : 0;
+		for (int i = 0; var_importance && (i < var_importance->rows * var_importance->cols); i++)
+		{
+			importance.push_back(cvGetReal1D(var_importance, i));
+		}
+		delete dtree;
+	}
+
+	if (!ok || ftrees.empty())
+	{
+		printf("ERROR: cannot read the tree(s) in %s\n", filename);
+		return false;
+	}
+	return true;
+}
+
+/*****************************************************************************/
+
+// checksum (32-bit FNV-1a) of a flattened tree - of each node in node id
+// order (so whatever its layout) its split attribute (-1 at a leaf, which
+// also fixes the shape of the tree) and threshold and direction, or its
+// chain of categorical / surrogate splits
+
+unsigned int add_checksum(unsigned int h, const void* p, size_t bytes)
+{
+	const unsigned char* b = (const unsigned char*) p;
+	for (size_t i = 0; i < bytes; i++)
+	{
+		h = (h ^ b[i]) * 16777619u;
+	}
+	return h;
+}
+
+unsigned int tree_checksum(const FlatDTree& ftree)
+{
+	int n_nodes = ftree.get_node_count();
+	std::vector<int> position(n_nodes);
+	for (int n = 0; n < n_nodes; n++)
+	{
+		position[ftree.node_id[n]] = n;
+	}
+
+	unsigned int h = 2166136261u;
+	for (int id = 0; id < n_nodes; id++)
+	{
+		int n = position[id];
+		h = add_checksum(h, &ftree.feature[n], sizeof(int));
+		if (ftree.feature[n] < 0)
+		{
+			continue;
+		}
+		if (ftree.split[n] < 0)
+		{
+			// (an inversed split's children are swapped, its left child -
+			// that of the lower values - not being the next node id)
+
+			int inversed = (ftree.node_id[ftree.left[n]] != id + 1);
+			h = add_checksum(h, &ftree.threshold[n], sizeof(float));
+			h = add_checksum(h, &inversed, sizeof(int));
+			continue;
+		}
+		for (int sp = ftree.split[n]; sp >= 0; sp = ftree.split_next[sp])
+		{
+			h = add_checksum(h, &ftree.split_column[sp], sizeof(int));
+			h = add_checksum(h, &ftree.split_c[sp], sizeof(float));
+			h = add_checksum(h, &ftree.split_inversed[sp], sizeof(int));
+			int ci = ftree.split_cat[sp];
+			if (ci >= 0)
+			{
+				// (the subset words of the split, as FlatDTree::add_splits())
+
+				int n_cats = ((ci + 1 < (int) ftree.cat_ofs.size()) ? ftree.cat_ofs[ci + 1]
+				              : (int) ftree.cat_map.size()) - ftree.cat_ofs[ci];
+				int n_words = std::max(2, (n_cats + 31) / 32);
+				h = add_checksum(h, &ftree.subsets[ftree.split_subset[sp]], n_words * sizeof(int));
+			}
+		}
+	}
+	return h;
+}
+
+/*****************************************************************************/
+
+// add the counts saved in a counts file (if it exists) to those given -
+// returns false if the file is for a different model (the number of trees,
+// or the checksum of a tree, differ)
+
+bool read_counts(const char* filename, const std::vector<FlatDTree>& ftrees,
+                 std::vector< std::vector<double> >& node_hits,
+                 std::vector< std::vector<double> >& left_hits)
+{
+	FileStorage fs(filename, FileStorage::READ);
+	if (!fs.isOpened())
+	{
+		return true; // (no counts yet)
+	}
+
+	int n_trees = (int) fs["trees"];
+	if (n_trees != (int) ftrees.size())
+	{
+		printf("ERROR: %s holds counts of %d tree(s), not %d\n",
+		       filename, n_trees, (int) ftrees.size());
+		return false;
+	}
+
+	for (int t = 0; t < n_trees; t++)
+	{
+		char name[32];
+		sprintf(name, "tree_%d", t);
+		FileNode tree = fs[name];
+
+		std::vector<double> hits, lefts;
+		tree["node_hits"] >> hits;
+		tree["left_hits"] >> lefts;
+
+		if (tree["checksum"].empty()
+				|| ((unsigned int) (int) tree["checksum"] != tree_checksum(ftrees[t]))
+				|| ((int) hits.size() != ftrees[t].get_node_count()) || (hits.size() != lefts.size()))
+		{
+			printf("ERROR: %s holds counts of a different model (tree %d)\n", filename, t);
+			return false;
+		}
+
+		for (size_t n = 0; n < hits.size(); n++)
+		{
+			node_hits[t][n] += hits[n];
+			left_hits[t][n] += lefts[n];
+		}
+	}
+
+	return true;
+}
+
+/*****************************************************************************/
+
+// save the counts (indexed by the node id of flat_dtree.h) with the checksum
+// of each tree
+
+bool write_counts(const char* filename, const char* model,
+                  const std::vector<FlatDTree>& ftrees,
+                  const std::vector< std::vector<double> >& node_hits,
+                  const std::vector< std::vector<double> >& left_hits)
+{
+	FileStorage fs(filename, FileStorage::WRITE);
+	if (!fs.isOpened())
+	{
+		printf("ERROR: cannot write counts file %s\n", filename);
+		return false;
+	}
+
+	fs << "model" << model;
+	fs << "trees" << (int) node_hits.size();
+	for (size_t t = 0; t < node_hits.size(); t++)
+	{
+		char name[32];
+		sprintf(name, "tree_%d", (int) t);
+		fs << name << "{";
+		fs << "checksum" << (int) tree_checksum(ftrees[t]);
+		fs << "node_hits" << node_hits[t];
+		fs << "left_hits" << left_hits[t];
+		fs << "}";
+	}
+
+	return true;
+}
+
+/*****************************************************************************/
+
+// (so the timed predictions are not optimised away)
+
+volatile double prediction_sink = 0;
+
+// time to predict the data set with every tree (N.B. the tree predictions
+// themselves, not the vote / average of a forest)
+
+double prediction_time(const std::vector<FlatDTree>& ftrees, const Mat& data)
+{
+	double sum = 0;
+
+	int64 start = getTickCount();
+	for (int pass = 0; pass < NUMBER_OF_TIMING_PASSES; pass++)
+	{
+		for (int i = 0; i < data.rows; i++)
+		{
+			const float* sample = data.ptr<float>(i);
+			for (size_t t = 0; t < ftrees.size(); t++)
+			{
+				sum += ftrees[t].predict(sample);
+			}
+		}
+	}
+	double elapsed = (double) (getTickCount() - start) / getTickFrequency();
+
+	prediction_sink = sum;
+	return elapsed;
+}
+
+/*****************************************************************************/
+
+int main( int argc, char** argv )
+{
+
+	// check we have enough command line arguments
+
+	if ((argc == 4) || (argc == 5))
+	{
+		std::vector<FlatDTree> ftrees;
+		std::vector<double> importance;
+
+		if (!load_model(argv[1], ftrees, importance))
+		{
+			return -1;
+		}
+
+		int n_trees = (int) ftrees.size();
+		std::vector< std::vector<double> > node_hits(n_trees), left_hits(n_trees);
+		for (int t = 0; t < n_trees; t++)
+		{
+			node_hits[t].assign(ftrees[t].get_node_count(), 0.0);
+			left_hits[t].assign(ftrees[t].get_node_count(), 0.0);
+		}
+
+		// counts so far, plus those of this data set
+
+		if (!read_counts(argv[2], ftrees, node_hits, left_hits))
+		{
+			return -1;
+		}
+
+		double previous = 0;
+		for (int t = 0; t < n_trees; t++)
+		{
+			previous += node_hits[t][0];
+		}
+
+		Mat data;
+		bool profiled = (strcmp(argv[3], "-") != 0);
+
+		if (profiled)
+		{
+			if (!read_labelled_data(argv[3], ftrees[0].get_var_all(), data))
+			{
+				return -1;
+			}
+			for (int t = 0; t < n_trees; t++)
+			{
+				ftrees[t].profile(data, node_hits[t], left_hits[t]);
+			}
+			if (!write_counts(argv[2], argv[1], ftrees, node_hits, left_hits))
+			{
+				return -1;
+			}
+		}
+
+		if (node_hits[0][0] == 0)
+		{
+			printf("ERROR: no counts in %s and no data to profile\n", argv[2]);
+			return -1;
+		}
+
+		printf("Model %s : %d tree(s), %.0f profiled tree predictions (%.0f new)\n",
+		       argv[1], n_trees, node_hits[0][0] * n_trees,
+		       (node_hits[0][0] * n_trees) - previous);
+
+		// branch bias - the share of visits taking the likely branch
+
+		double likely = 0, visits = 0;
+		for (int t = 0; t < n_trees; t++)
+		{
+			const FlatDTree& ftree = ftrees[t];
+			for (int n = 0; n < ftree.get_node_count(); n++)
+			{
+				if (ftree.feature[n] >= 0)
+				{
+					int id = ftree.node_id[n];
+					likely += std::max(left_hits[t][id], node_hits[t][id] - left_hits[t][id]);
+					visits += node_hits[t][id];
+				}
+			}
+		}
+		printf("Likely branch taken at %g%% of split node visits\n\n",
+		       (visits > 0) ? likely * 100. / visits : 0.);
+
+		// lay out every tree from the counts (checking predictions are
+		// unchanged on the profiled data)
+
+		std::vector<FlatDTree> laid_out = ftrees;
+		int mismatches = 0;
+		for (int t = 0; t < n_trees; t++)
+		{
+			laid_out[t].set_layout(FLAT_DTREE_PROFILE_GUIDED, &node_hits[t]);
+			for (int i = 0; i < data.rows; i++)
+			{
+				if (laid_out[t].predict(data.ptr<float>(i)) != ftrees[t].predict(data.ptr<float>(i)))
+				{
+					mismatches++;
+				}
+			}
+		}
+		if (mismatches)
+		{
+			printf("ERROR: the profile guided layout changes %d predictions\n", mismatches);
+			return -1;
+		}
+
+		// compare the prediction time of each layout on the profiled data
+
+		if (profiled)
+		{
+			double n_predictions = (double) data.rows * NUMBER_OF_TIMING_PASSES;
+
+			for (int layout = 0; layout < FLAT_DTREE_LAYOUTS; layout++)
+			{
+				std::vector<FlatDTree> ltrees = ftrees;
+				for (int t = 0; t < n_trees; t++)
+				{
+					ltrees[t].set_layout(layout, &node_hits[t]);
+				}
+				double elapsed = prediction_time(ltrees, data);
+				printf("%-16s %12.0f samples/s\n", FlatDTree::get_layout_name(layout),
+				       n_predictions / elapsed);
+			}
+		}
+
+		// write the laid out model
+
+		if (argc == 5)
+		{
+			std::vector<const FlatDTree*> trees;
+			for (int t = 0; t < n_trees; t++)
+			{
+				trees.push_back(&laid_out[t]);
+			}
+			if (!BinaryDTreeFile::write(argv[4], trees, importance))
+			{
+				printf("ERROR: cannot write binary tree file %s\n", argv[4]);
+				return -1;
+			}
+			printf("\nProfile guided model written to %s\n", argv[4]);
+		}
+
+		return 0; // all OK
+
+    } else {
+
+    // not OK : main returns -1
+
+	printf("usage: %s model_filename.{xml|yml} counts.yml {data_file|-} [output.bin]\n", argv[0]);
+    return -1;
+
+    }
+}
+/******************************************************************************/
@@ -0,0 +1,203 @@
+// Example : convert a saved decision tree or random forest to the compact
+// binary tree format
+// usage: prog model.{yml|.xml} model.bin
+
+// For use with any saved decision tree (e.g. tree.yml, ex_tree.xml) or
+// random forest (CvRTrees::save())
+
+// Loads the model, flattens each of its trees (flat_dtree.h) and writes them
+// with the model's variable importance in the binary format of dt_binary.h.
+// The binary file is then mapped back and checked against the flattened trees
+// and the time taken to load each form is reported. The binary file can be
+// given to dt_varimportance in place of the YAML / XML file.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+#include <string.h>
+
+#include "flat_dtree.h"
+#include "dt_binary.h"
+
+/*****************************************************************************/
+
+// is the saved model a random forest (rather than a single tree) ?
+
+bool is_forest(const char* filename)
+{
+	FileStorage fs(filename, FileStorage::READ);
+	if (!fs.isOpened())
+	{
+		return false;
+	}
+	FileNode model = fs.getFirstTopLevelNode();
+	return !model["ntrees"].empty();
+}
+
+/*****************************************************************************/
+
+// copy the values of an importance matrix (if there is one)
+
+void get_importance(const CvMat* var_importance, std::vector<double>& importance)
+{
+	importance.clear();
+	if (var_importance)
+	{
+		for (int i = 0; i < var_importance->rows * var_importance->cols; i++)
+		{
+			importance.push_back(cvGetReal1D(var_importance, i));
+		}
+	}
+}
+
+/*****************************************************************************/
+
+// does a mapped tree hold exactly the arrays of a flattened tree ?
+
+template<typename T>
+bool same(const T* mapped, const std::vector<T>& v)
+{
+	return v.empty() || !memcmp(mapped, &v[0], v.size() * sizeof(T));
+}
+
+bool same_tree(const BinaryDTree& btree, const FlatDTree& ftree)
+{
+	return (btree.node_count == ftree.get_node_count())
+		&& (btree.depth == ftree.get_depth())
+		&& (btree.n_splits == (int) ftree.split_column.size())
+		&& (btree.n_subsets == (int) ftree.subsets.size())
+		&& (btree.n_vars == (int) ftree.var_column.size())
+		&& (btree.n_cat_ofs == (int) ftree.cat_ofs.size())
+		&& (btree.n_cat_map == (int) ftree.cat_map.size())
+		&& same(btree.feature, ftree.feature) && same(btree.threshold, ftree.threshold)
+		&& same(btree.left, ftree.left) && same(btree.right, ftree.right)
+		&& same(btree.value, ftree.value) && same(btree.split, ftree.split)
+		&& same(btree.default_child, ftree.default_child)
+		&& same(btree.split_column, ftree.split_column)
+		&& same(btree.split_cat, ftree.split_cat) && same(btree.split_c, ftree.split_c)
+		&& same(btree.split_subset, ftree.split_subset)
+		&& same(btree.split_inversed, ftree.split_inversed)
+		&& same(btree.split_next, ftree.split_next) && same(btree.subsets, ftree.subsets)
+		&& same(btree.var_column, ftree.var_column) && same(btree.var_cat, ftree.var_cat)
+		&& same(btree.cat_ofs, ftree.cat_ofs) && same(btree.cat_map, ftree.cat_map);
+}
+
+/*****************************************************************************/
+
+int main( int argc, char** argv )
+{
+
+	// check we have enough command line arguments
+
+	if (argc == 3)
+	{
+		std::vector<FlatDTree> ftrees;
+		std::vector<double> importance;
+
+		// load the model from XML / YML file and flatten its tree(s)
+
+		int64 start = getTickCount();
+
+		if (is_forest(argv[1]))
+		{
+			CvRTrees* forest = new CvRTrees;
+			forest->load(argv[1]);
+
+			ftrees.resize(forest->get_tree_count());
+			for (int i = 0; i < forest->get_tree_count(); i++)
+			{
+				if (!ftrees[i].build(forest->get_tree(i)))
+				{
+					printf("ERROR: cannot read tree %d of the forest in %s\n", i, argv[1]);
+					return -1;
+				}
+			}
+			get_importance(forest->get_var_importance(), importance);
+			delete forest;
+		}
+		else
+		{
+			CvDTree* dtree = new CvDTree;
+			dtree->load(argv[1]);
+
+			ftrees.resize(1);
+			if (!ftrees[0].build(dtree))
+			{
+				printf("ERROR: cannot read the decision tree in %s\n", argv[1]);
+				return -1;
+			}
+			get_importance(dtree->get_var_importance(), importance);
+			delete dtree;
+		}
+
+		double text_time = (double) (getTickCount() - start) / getTickFrequency();
+
+		// write the binary file
+
+		std::vector<const FlatDTree*> trees;
+		for (size_t i = 0; i < ftrees.size(); i++)
+		{
+			trees.push_back(&ftrees[i]);
+		}
+
+		if (!BinaryDTreeFile::write(argv[2], trees, importance))
+		{
+			printf("ERROR: cannot write binary tree file %s\n", argv[2]);
+			return -1;
+		}
+
+		// map it back and check it
+
+		start = getTickCount();
+
+		BinaryDTreeFile bfile;
+		if (!bfile.open(argv[2]))
+		{
+			return -1;
+		}
+
+		double binary_time = (double) (getTickCount() - start) / getTickFrequency();
+
+		int mismatches = 0;
+		for (int i = 0; i < bfile.get_tree_count(); i++)
+		{
+			if (!same_tree(bfile.get_tree(i), ftrees[i]))
+			{
+				mismatches++;
+			}
+		}
+		if ((bfile.get_tree_count() != (int) ftrees.size())
+				|| (bfile.get_var_importance_count() != (int) importance.size()))
+		{
+			mismatches++;
+		}
+
+		printf("Converted %s (%d tree(s), %d variable importance values) to %s\n",
+		       argv[1], (int) ftrees.size(), (int) importance.size(), argv[2]);
+		printf("Load time : text %f s, binary (mapped) %f s\n", text_time, binary_time);
+
+		if (mismatches)
+		{
+			printf("ERROR: %d tree(s) differ in the binary file\n", mismatches);
+			return -1;
+		}
+
+		return 0; // all OK
+
+    } else {
+
+    // not OK : main returns -1
+
+	printf("usage: %s model_filename.{xml|yml} output_filename.bin\n", argv[0]);
+    return -1;
+
+    }
+}
+/******************************************************************************/
@@ -1,8 +1,26 @@
 // Example : decision tree variable importance
-// usage: prog tree.{yml|.xml}
+// usage: prog {tree|forest}.{yml|.xml|.bin} [labelled_data_file [number_of_repeats]]
 
 // For use with any test / training datasets
 
+// (a .bin file is a model converted by dt_tobinary, which is memory mapped
+// with no parsing rather than loaded by CvDTree::load())
+
+// (a saved random forest - CvRTrees::save(), e.g. a ParallelRTrees forest
+// with its variable importance computed after training, see
+// tools/parallel_rtrees.h - is loaded by CvRTrees::load() and the variable
+// importance stored with it reported, followed by the Gini importance a
+// ParallelRTrees forest also saves)
+
+// Given a labelled data file (CSV, one sample per line of the tree's
+// attributes followed by the class label) the permutation importance of each
+// attribute is reported instead: the drop in accuracy on that data when the
+// attribute's column is randomly shuffled (averaged over a number of
+// shuffles). The attributes are processed in parallel (cv::parallel_for_) each
+// task shuffling its own copy of just the one column. Only samples whose path
+// through the tree tests the attribute can change prediction, so only those
+// are re-predicted, and attributes the tree never tests have no drop at all.
+
 // Author : Toby Breckon, toby.breckon@cranfield.ac.uk
 
 // Copyright (c) 2011 School of Engineering, Cranfield University
@@ -17,6 +35,15 @@
 using namespace cv; // OpenCV API is in the C++ "cv" namespace
 
 #include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <algorithm>
+
+#include "flat_dtree.h"
+#include "dt_binary.h"
+#include "parallel_rtrees.h"
+
+#define DEFAULT_NUMBER_OF_REPEATS 5
 
 /*****************************************************************************/
 
@@ -47,13 +74,370 @@ int print_variable_importance(CvDTree* dtree)
 
 /*****************************************************************************/
 
+// as above from the variable importance stored with a random forest
+
+int print_variable_importance(CvRTrees* forest)
+{
+    const CvMat* var_importance = forest->get_var_importance();
+
+    if( !var_importance )
+    {
+        printf( "Error: Variable importance can not be retrieved\n" );
+        return -1;
+    }
+
+    for(int i = 0; i < var_importance->cols*var_importance->rows; i++ )
+    {
+        printf( "var #%d", i );
+        printf( ": %g%%\n", cvGetReal1D(var_importance, i)*100. );
+    }
+
+	return 1;
+}
+
+/*****************************************************************************/
+
+// as above from the Gini importance saved with a ParallelRTrees forest (if
+// any - returns 0 if there is none)
+
+int print_gini_importance(const char* filename)
+{
+    FileStorage fs(filename, FileStorage::READ);
+    Mat gini_importance;
+    if (fs.isOpened())
+    {
+        fs[PARALLEL_RTREES_GINI_NODE] >> gini_importance;
+    }
+
+    if( gini_importance.empty() )
+    {
+        return 0;
+    }
+
+    printf( "Gini importance:\n" );
+    for(int i = 0; i < gini_importance.cols*gini_importance.rows; i++ )
+    {
+        printf( "var #%d", i );
+        printf( ": %g%%\n", gini_importance.at<float>(i)*100. );
+    }
+
+    return 1;
+}
+
+/*****************************************************************************/
+
+// as above from the variable importance stored in a binary tree file
+
+int print_variable_importance(const BinaryDTreeFile& bfile)
+{
+    const double* var_importance = bfile.get_var_importance();
+
+    if( !var_importance )
+    {
+        printf( "Error: Variable importance can not be retrieved\n" );
+        return -1;
+    }
+
+    for(int i = 0; i < bfile.get_var_importance_count(); i++ )
+    {
+        printf( "var #%d", i );
+        printf( ": %g%%\n", var_importance[i]*100. );
+    }
+
+	return 1;
+}
+
+/*****************************************************************************/
+
+// is the saved model a random forest (rather than a single tree) ?
+
+bool is_forest(const char* filename)
+{
+    FileStorage fs(filename, FileStorage::READ);
+    if (!fs.isOpened())
+    {
+        return false;
+    }
+    FileNode model = fs.getFirstTopLevelNode();
+    return !model["ntrees"].empty();
+}
+
+/*****************************************************************************/
+
+// loads a labelled sample file (CSV text file of n_attributes values then the
+// class label per line) of any number of samples - returns 0 on failure
+
+int read_labelled_data(const char* filename, int n_attributes, Mat& data, Mat& classes)
+{
+	FILE* f = fopen(filename, "r");
+	if (!f)
+	{
+		printf("ERROR: cannot read file %s\n", filename);
+		return 0; // all not OK
+	}
+
+	std::vector<float> values;
+	float tmp;
+	int n_values = 0;
+
+	while (fscanf(f, "%f,", &tmp) == 1)
+	{
+		values.push_back(tmp);
+		n_values++;
+	}
+	fclose(f);
+
+	if ((n_values == 0) || (n_values % (n_attributes + 1)))
+	{
+		printf("ERROR: %s is not %d attributes and a label per sample\n",
+		       filename, n_attributes);
+		return 0; // all not OK
+	}
+
+	int n_samples = n_values / (n_attributes + 1);
+	data = Mat(n_samples, n_attributes, CV_32FC1);
+	classes = Mat(n_samples, 1, CV_32FC1);
+
+	for (int i = 0; i < n_samples; i++)
+	{
+		const float* line = &values[(size_t) i * (n_attributes + 1)];
+		std::copy(line, line + n_attributes, data.ptr<float>(i));
+		classes.at<float>(i, 0) = line[n_attributes];
+	}
+
+	return 1; // all OK
+}
+
+/*****************************************************************************/
+
+// record for every leaf of the tree the sample columns tested on the path to
+// it (including surrogate splits)
+
+void path_columns(const FlatDTree& ftree, int n, std::vector<int>& path,
+                  std::vector< std::vector<int> >& leaf_columns)
+{
+	if (ftree.feature[n] < 0)
+	{
+		leaf_columns[n] = path;
+		std::sort(leaf_columns[n].begin(), leaf_columns[n].end());
+		leaf_columns[n].erase(std::unique(leaf_columns[n].begin(), leaf_columns[n].end()),
+		                      leaf_columns[n].end());
+		return;
+	}
+
+	size_t length = path.size();
+	if (ftree.split[n] < 0)
+	{
+		path.push_back(ftree.feature[n]);
+	}
+	else
+	{
+		for (int s = ftree.split[n]; s >= 0; s = ftree.split_next[s])
+		{
+			path.push_back(ftree.split_column[s]);
+		}
+	}
+
+	path_columns(ftree, ftree.left[n], path, leaf_columns);
+	path_columns(ftree, ftree.right[n], path, leaf_columns);
+	path.resize(length);
+}
+
+/*****************************************************************************/
+
+// permutation importance of a range of the tested sample columns
+
+class PermutationImportance : public ParallelLoopBody
+{
+public:
+
+	PermutationImportance(const FlatDTree& _ftree, const Mat& _data,
+	                      const std::vector<uchar>& _correct, const Mat& _classes,
+	                      const std::vector<int>& _columns,
+	                      const std::vector< std::vector<int> >& _column_samples,
+	                      int _n_repeats, double* _drop) :
+		ftree(_ftree), data(_data), correct(_correct), classes(_classes),
+		columns(_columns), column_samples(_column_samples),
+		n_repeats(_n_repeats), drop(_drop) {}
+
+	virtual void operator()(const Range& range) const
+	{
+		std::vector<float> permuted(data.rows); // this task's copy of the column
+
+		for (int k = range.start; k < range.end; k++)
+		{
+			int column = columns[k];
+			const std::vector<int>& samples = column_samples[column];
+			double total = 0;
+
+			for (int repeat = 0; repeat < n_repeats; repeat++)
+			{
+				// shuffle the column (seeded by column and repeat so the
+				// result does not depend on the number of threads)
+
+				RNG rng((uint64) column * n_repeats + repeat + 1);
+
+				for (int i = 0; i < data.rows; i++)
+				{
+					permuted[i] = data.at<float>(i, column);
+				}
+				for (int i = data.rows - 1; i > 0; i--)
+				{
+					std::swap(permuted[i], permuted[rng.uniform(0, i + 1)]);
+				}
+
+				// re-predict the samples whose path tests this column
+
+				int lost = 0;
+				for (size_t j = 0; j < samples.size(); j++)
+				{
+					int i = samples[j];
+					int leaf = ftree.find_leaf(ReplacedColumnSample(data.ptr<float>(i),
+					                           column, permuted[i]));
+					lost += (int) correct[i]
+					        - (ftree.value[leaf] == (double) classes.at<float>(i, 0));
+				}
+				total += (double) lost / data.rows;
+			}
+
+			drop[column] = total / n_repeats;
+		}
+	}
+
+private:
+
+	const FlatDTree& ftree;
+	const Mat& data;
+	const std::vector<uchar>& correct;
+	const Mat& classes;
+	const std::vector<int>& columns;
+	const std::vector< std::vector<int> >& column_samples;
+	int n_repeats;
+	double* drop;
+};
+
+/*****************************************************************************/
+
+// prints out the permutation importance of the variables (i.e. attributes)
+// as the drop in accuracy on a labelled data set when each is shuffled
+
+int print_permutation_importance(CvDTree* dtree, const char* filename, int n_repeats)
+{
+	FlatDTree ftree;
+	if (!ftree.build(dtree))
+	{
+		printf("Error: cannot read the decision tree\n");
+		return -1;
+	}
+
+	Mat data, classes;
+	if (!read_labelled_data(filename, ftree.get_var_all(), data, classes))
+	{
+		return -1;
+	}
+
+	int64 start = getTickCount();
+
+	// baseline predictions, and for each column the samples whose path
+	// tests it
+
+	std::vector< std::vector<int> > leaf_columns(ftree.get_node_count());
+	std::vector<int> path;
+	path_columns(ftree, 0, path, leaf_columns);
+
+	std::vector<uchar> correct(data.rows);
+	std::vector< std::vector<int> > column_samples(ftree.get_var_all());
+	int n_correct = 0;
+
+	for (int i = 0; i < data.rows; i++)
+	{
+		int leaf = ftree.find_leaf(data.ptr<float>(i));
+		correct[i] = (ftree.value[leaf] == (double) classes.at<float>(i, 0));
+		n_correct += correct[i];
+
+		const std::vector<int>& tested = leaf_columns[leaf];
+		for (size_t j = 0; j < tested.size(); j++)
+		{
+			column_samples[tested[j]].push_back(i);
+		}
+	}
+
+	std::vector<int> columns;
+	for (int c = 0; c < ftree.get_var_all(); c++)
+	{
+		if (!column_samples[c].empty())
+		{
+			columns.push_back(c);
+		}
+	}
+
+	// shuffle the tested columns in parallel
+
+	std::vector<double> drop(ftree.get_var_all(), 0.0);
+	parallel_for_(Range(0, (int) columns.size()),
+	              PermutationImportance(ftree, data, correct, classes, columns,
+	                                    column_samples, n_repeats, &drop[0]));
+
+	double elapsed = (double) (getTickCount() - start) / getTickFrequency();
+
+	printf("Permutation importance : %d samples, accuracy %g%%, %d of %d attributes tested by the tree, %d repeat(s), %f s\n",
+	       data.rows, (double) n_correct * 100. / data.rows, (int) columns.size(),
+	       ftree.get_var_all(), n_repeats, elapsed);
+
+	for (int i = 0; i < ftree.get_var_all(); i++)
+	{
+		printf( "var #%d", i );
+		printf( ": %g%% (accuracy drop)\n", drop[i]*100. );
+	}
+
+	return 1;
+}
+
+/*****************************************************************************/
+
 int main( int argc, char** argv )
 {
 
 	// check we have enough command line arguments
 
-	if (argc == 2)
+	if ((argc >= 2) && (argc <= 4))
 	{
+		// binary tree file - map it and read the stored variable importance
+
+		if (BinaryDTreeFile::is_binary(argv[1]))
+		{
+			if (argc > 2)
+			{
+				printf("ERROR: permutation importance needs the .xml / .yml tree\n");
+				return -1;
+			}
+
+			BinaryDTreeFile bfile;
+			if (!bfile.open(argv[1]))
+			{
+				return -1;
+			}
+			return (print_variable_importance(bfile) > 0) ? 0 : -1;
+		}
+
+		// random forest - load it and read the stored variable importance
+
+		if (is_forest(argv[1]))
+		{
+			if (argc > 2)
+			{
+				printf("ERROR: permutation importance needs a single decision tree\n");
+				return -1;
+			}
+
+			CvRTrees* forest = new CvRTrees;
+			forest->load(argv[1]);
+			int result = print_variable_importance(forest);
+			delete forest;
+			print_gini_importance(argv[1]);
+			return (result > 0) ? 0 : -1;
+		}
+
 		// define a decision tree object
 
 		CvDTree* dtree = new CvDTree;
@@ -62,6 +446,15 @@ int main( int argc, char** argv )
 
 		dtree->load(argv[1]);
 
+		// permutation importance on a labelled data set
+
+		if (argc > 2)
+		{
+			int n_repeats = (argc == 4) ? atoi(argv[3]) : DEFAULT_NUMBER_OF_REPEATS;
+			return (print_permutation_importance(dtree, argv[2], MAX(n_repeats, 1)) > 0)
+				? 0 : -1;
+		}
+
 		// extract (and display) variable importance information
 
 		if (print_variable_importance(dtree)){
@@ -74,7 +467,8 @@ int main( int argc, char** argv )
 
     // not OK : main returns -1
 
-	printf("usage: %s decision_tree_filename.xml\n", argv[0]);
+	printf("usage: %s {decision_tree|random_forest}_filename.{xml|yml|bin}\n", argv[0]);
+	printf("       %s decision_tree_filename.{xml|yml} labelled_data_file [number_of_repeats]\n", argv[0]);
     return -1;
 
     }
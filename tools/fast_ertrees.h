@@ -0,0 +1,488 @@
+// Support : extremely random forest training with vectorised split evaluation
+
+// An extremely random tree (Geurts et al., 2006 - CvERTrees) does not search
+// the split points of an attribute: at each node it draws one threshold for
+// each attribute tried, uniformly between the attribute's minimum and maximum
+// over the node's samples, and takes the attribute whose random split is best.
+// Evaluating such a split needs only the class counts of the samples left of
+// the threshold, yet CvERTrees still evaluates it through the CvDTree split
+// machinery a sample (and a data dependent branch) at a time.
+//
+// FastERTrees grows the trees with the samples of each node kept grouped by
+// class (the groups partitioned into those of the children at each split).
+// For each attribute tried the node's values are gathered into a contiguous
+// buffer, their minimum and maximum found and the threshold drawn, and the
+// left count of each class is then just the number of values of its group at
+// or below the threshold - a compare and count over the buffer, with no
+// per sample branch. Where the CPU supports it (and use_simd is set) the
+// gather, the minimum / maximum and the compare and count use AVX2, 8 values
+// per instruction; otherwise the same loops are scalar.
+//
+// As CvERTrees each tree is grown from all of the training data (no
+// bootstrap), trying nactive_vars attributes chosen at random at each node
+// (Gini impurity, class priors) and stopping as CvDTree (maximum depth,
+// minimum sample count, a single class). The trees are grown concurrently
+// each with its own seeded random number generator (grown_forest.h), and the
+// forest is saved in the CvERTrees model format (CvERTrees::load() reads it).
+// Only classification of ordered (CV_VAR_NUMERICAL) attributes, none missing,
+// is supported.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#ifndef FAST_ERTREES_H
+#define FAST_ERTREES_H
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+#include <vector>
+#include <algorithm>
+
+#include "grown_forest.h"
+
+// AVX2 split evaluation (GCC / clang on x86, selected at run time)
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FAST_ERTREES_AVX2
+#endif
+
+/******************************************************************************/
+
+class FastERTrees : public GrownForest
+{
+public:
+
+    FastERTrees() : GrownForest(CV_TYPE_NAME_ML_ERTREES), use_simd(true), grow_time(0),
+        simd(false) {}
+
+    // use AVX2 for the split evaluation where the CPU supports it
+
+    bool use_simd;
+
+    // wall time (seconds) of growing all of the trees in the last training
+
+    double grow_time;
+
+    // whether the last training used AVX2
+
+    bool is_simd_used() const { return simd; }
+
+    // train the forest
+    // data = attributes (1 sample per row, CV_32F)
+    // responses = integer class labels (1 sample per row, CV_32F)
+    // params = forest parameters as CvERTrees (max_depth, min_sample_count,
+    //          priors, nactive_vars and term_crit.max_iter are used)
+
+    bool train(const cv::Mat& data, const cv::Mat& responses, const CvRTParams& params)
+    {
+        clear();
+        if (!set_training(data, responses, params))
+        {
+            return false;
+        }
+
+        std::vector<uint64> tree_seeds;
+        int ntrees = draw_tree_seeds(params, tree_seeds);
+        if (ntrees < 1)
+        {
+            return false;
+        }
+
+#ifdef FAST_ERTREES_AVX2
+        simd = use_simd && cv::checkHardwareSupport(CV_CPU_AVX2);
+#else
+        simd = false;
+#endif
+
+        // the attribute values (per attribute, in sample order) and the
+        // samples grouped by class (the root's groups)
+
+        columns.resize((size_t) nvars * nsamples);
+        for (int i = 0; i < nsamples; i++)
+        {
+            const float* row = data.ptr<float>(i);
+            for (int vi = 0; vi < nvars; vi++)
+            {
+                columns[(size_t) vi * nsamples + i] = row[vi];
+            }
+        }
+
+        class_ofs.assign(nclasses + 1, 0);
+        for (int i = 0; i < nsamples; i++)
+        {
+            class_ofs[responses_idx[i] + 1]++;
+        }
+        for (int c = 0; c < nclasses; c++)
+        {
+            class_ofs[c + 1] += class_ofs[c];
+        }
+
+        class_order.resize(nsamples);
+        std::vector<int> pos(class_ofs.begin(), class_ofs.end() - 1);
+        for (int i = 0; i < nsamples; i++)
+        {
+            class_order[pos[responses_idx[i]]++] = i;
+        }
+
+        // grow the trees (one task each)
+
+        int64 start = cv::getTickCount();
+
+        trees.resize(ntrees);
+        cv::parallel_for_(cv::Range(0, ntrees), TreeGrower(this, &tree_seeds[0]), ntrees);
+
+        grow_time = (double) (cv::getTickCount() - start) / cv::getTickFrequency();
+
+        std::vector<float>().swap(columns);
+        std::vector<int>().swap(class_order);
+        std::vector<int>().swap(responses_idx);
+
+        return true;
+    }
+
+    virtual void clear()
+    {
+        GrownForest::clear();
+        columns.clear();
+        class_order.clear();
+        class_ofs.clear();
+    }
+
+private:
+
+    // grows a range of trees
+
+    class TreeGrower : public cv::ParallelLoopBody
+    {
+    public:
+
+        TreeGrower(FastERTrees* _forest, const uint64* _tree_seeds) :
+            forest(_forest), tree_seeds(_tree_seeds) {}
+
+        virtual void operator()(const cv::Range& range) const
+        {
+            for (int k = range.start; k < range.end; k++)
+            {
+                forest->grow_tree(k, tree_seeds[k]);
+            }
+        }
+
+    private:
+
+        FastERTrees* forest;
+        const uint64* tree_seeds;
+    };
+
+    // a node still to be split: its node index, depth and the offset of its
+    // class group boundaries (nclasses + 1 positions in the tree's samples)
+    // in the offsets stack
+
+    struct OpenNode
+    {
+        int node;
+        int depth;
+        int ofs;
+    };
+
+    // add a node of the given class group boundaries - pushed to be split
+    // unless it stops (as CvDTree)
+
+    int add_node(std::vector<Node>& nodes, std::vector<OpenNode>& open,
+                 std::vector<int>& open_ofs, const int* ofs, int depth) const
+    {
+        std::vector<double> totals(nclasses);
+        int n_nonzero = 0;
+        for (int c = 0; c < nclasses; c++)
+        {
+            totals[c] = (ofs[c + 1] - ofs[c]) * class_weights[c];
+            n_nonzero += (ofs[c + 1] > ofs[c]);
+        }
+
+        int sample_count = ofs[nclasses] - ofs[0];
+        nodes.push_back(leaf_node(&totals[0], sample_count, depth));
+
+        if ((depth < tree_max_depth) && (sample_count > min_sample_count) && (n_nonzero > 1))
+        {
+            OpenNode node = { (int) nodes.size() - 1, depth, (int) open_ofs.size() };
+            open.push_back(node);
+            open_ofs.insert(open_ofs.end(), ofs, ofs + nclasses + 1);
+        }
+
+        return (int) nodes.size() - 1;
+    }
+
+    // grow tree k (depth first) with its own random number generator
+
+    void grow_tree(int k, uint64 tree_seed)
+    {
+        cv::RNG rng(tree_seed);
+        std::vector<Node>& nodes = trees[k];
+        nodes.clear();
+
+        std::vector<int> rows(class_order);     // the samples, grouped by node then class
+        std::vector<int> partitioned(nsamples);
+        std::vector<float> values(nsamples);    // an attribute's values of a node's samples
+
+        std::vector<int> vars(nvars);
+        for (int vi = 0; vi < nvars; vi++)
+        {
+            vars[vi] = vi;
+        }
+
+        std::vector<int> ofs(nclasses + 1);
+        std::vector<int> left(nclasses), best_left(nclasses);
+        std::vector<int> left_ofs(nclasses + 1), right_ofs(nclasses + 1);
+
+        std::vector<OpenNode> open;
+        std::vector<int> open_ofs;
+        add_node(nodes, open, open_ofs, &class_ofs[0], 0);
+
+        while (!open.empty())
+        {
+            OpenNode node = open.back();
+            open.pop_back();
+            std::copy(open_ofs.begin() + node.ofs, open_ofs.begin() + node.ofs + nclasses + 1,
+                      ofs.begin());
+            open_ofs.resize(node.ofs);
+
+            int begin = ofs[0];
+            int n = ofs[nclasses] - begin;
+
+            double weight = 0;
+            for (int c = 0; c < nclasses; c++)
+            {
+                weight += (ofs[c + 1] - ofs[c]) * class_weights[c];
+            }
+
+            // a random split of each of nactive_vars attributes chosen at
+            // random, keeping the best (Gini: maximise sum(lc^2)/L +
+            // sum(rc^2)/R as CvDTree)
+
+            double best_quality = 0;
+            int best_var = -1;
+            float best_c = 0;
+
+            for (int j = 0; j < nactive_vars; j++)
+            {
+                std::swap(vars[j], vars[j + rng((unsigned) (nvars - j))]);
+                int vi = vars[j];
+
+                gather(&columns[(size_t) vi * nsamples], &rows[begin], n, &values[0]);
+
+                float min_value, max_value;
+                min_max(&values[0], n, min_value, max_value);
+                if (!(min_value < max_value))
+                {
+                    continue;
+                }
+
+                float c = rng.uniform(min_value, max_value);
+                if (!(c < max_value))
+                {
+                    continue;
+                }
+
+                double L = 0, lsum2 = 0, rsum2 = 0;
+                for (int cl = 0; cl < nclasses; cl++)
+                {
+                    left[cl] = count_le(&values[ofs[cl] - begin], ofs[cl + 1] - ofs[cl], c);
+                    double lc = left[cl] * class_weights[cl];
+                    double rc = (ofs[cl + 1] - ofs[cl] - left[cl]) * class_weights[cl];
+                    L += lc;
+                    lsum2 += lc * lc;
+                    rsum2 += rc * rc;
+                }
+
+                double R = weight - L;
+                if ((L > 0) && (R > 0))
+                {
+                    double quality = lsum2 / L + rsum2 / R;
+                    if (quality > best_quality)
+                    {
+                        best_quality = quality;
+                        best_var = vi;
+                        best_c = c;
+                        best_left.swap(left);
+                    }
+                }
+            }
+
+            if (best_var < 0)
+            {
+                continue;   // (no attribute tried splits the node, a leaf)
+            }
+
+            // partition each class group into its left and right parts, the
+            // left child's groups first then the right child's
+
+            left_ofs[0] = begin;
+            right_ofs[0] = begin;
+            for (int cl = 0; cl < nclasses; cl++)
+            {
+                right_ofs[0] += best_left[cl];
+            }
+            for (int cl = 0; cl < nclasses; cl++)
+            {
+                left_ofs[cl + 1] = left_ofs[cl] + best_left[cl];
+                right_ofs[cl + 1] = right_ofs[cl] + (ofs[cl + 1] - ofs[cl] - best_left[cl]);
+            }
+
+            const float* column = &columns[(size_t) best_var * nsamples];
+            for (int cl = 0; cl < nclasses; cl++)
+            {
+                int l = left_ofs[cl], r = right_ofs[cl];
+                for (int j = ofs[cl]; j < ofs[cl + 1]; j++)
+                {
+                    int i = rows[j];
+                    if (column[i] <= best_c)
+                    {
+                        partitioned[l++] = i;
+                    }
+                    else
+                    {
+                        partitioned[r++] = i;
+                    }
+                }
+            }
+            std::copy(partitioned.begin() + begin, partitioned.begin() + begin + n,
+                      rows.begin() + begin);
+
+            nodes[node.node].var = best_var;
+            nodes[node.node].c = best_c;
+            nodes[node.node].quality = (float) best_quality;
+
+            int l = add_node(nodes, open, open_ofs, &left_ofs[0], node.depth + 1);
+            int r = add_node(nodes, open, open_ofs, &right_ofs[0], node.depth + 1);
+            nodes[node.node].left = l;
+            nodes[node.node].right = r;
+        }
+    }
+
+    // the values of column for the given samples
+
+    void gather(const float* column, const int* samples, int n, float* out) const
+    {
+        int j = 0;
+#ifdef FAST_ERTREES_AVX2
+        if (simd)
+        {
+            j = gather_avx2(column, samples, n, out);
+        }
+#endif
+        for (; j < n; j++)
+        {
+            out[j] = column[samples[j]];
+        }
+    }
+
+    // the minimum and maximum of n (> 0) values
+
+    void min_max(const float* v, int n, float& min_value, float& max_value) const
+    {
+        int j = 0;
+        min_value = max_value = v[0];
+#ifdef FAST_ERTREES_AVX2
+        if (simd)
+        {
+            j = min_max_avx2(v, n, min_value, max_value);
+        }
+#endif
+        for (; j < n; j++)
+        {
+            min_value = MIN(min_value, v[j]);
+            max_value = MAX(max_value, v[j]);
+        }
+    }
+
+    // the number of values <= c
+
+    int count_le(const float* v, int n, float c) const
+    {
+        int j = 0, count = 0;
+#ifdef FAST_ERTREES_AVX2
+        if (simd)
+        {
+            j = count_le_avx2(v, n, c, count);
+        }
+#endif
+        for (; j < n; j++)
+        {
+            count += (v[j] <= c);
+        }
+        return count;
+    }
+
+#ifdef FAST_ERTREES_AVX2
+
+    // AVX2 versions of the above over whole groups of 8 values - each returns
+    // the number of values done (the rest left to the scalar loop)
+
+    __attribute__((target("avx2")))
+    static int gather_avx2(const float* column, const int* samples, int n, float* out)
+    {
+        int j = 0;
+        for (; j + 8 <= n; j += 8)
+        {
+            __m256i idx = _mm256_loadu_si256((const __m256i*) (samples + j));
+            _mm256_storeu_ps(out + j, _mm256_i32gather_ps(column, idx, 4));
+        }
+        return j;
+    }
+
+    __attribute__((target("avx2")))
+    static int min_max_avx2(const float* v, int n, float& min_value, float& max_value)
+    {
+        if (n < 8)
+        {
+            return 0;
+        }
+
+        __m256 lo = _mm256_loadu_ps(v);
+        __m256 hi = lo;
+        int j = 8;
+        for (; j + 8 <= n; j += 8)
+        {
+            __m256 x = _mm256_loadu_ps(v + j);
+            lo = _mm256_min_ps(lo, x);
+            hi = _mm256_max_ps(hi, x);
+        }
+
+        float lanes_lo[8], lanes_hi[8];
+        _mm256_storeu_ps(lanes_lo, lo);
+        _mm256_storeu_ps(lanes_hi, hi);
+        for (int i = 0; i < 8; i++)
+        {
+            min_value = MIN(min_value, lanes_lo[i]);
+            max_value = MAX(max_value, lanes_hi[i]);
+        }
+        return j;
+    }
+
+    __attribute__((target("avx2,popcnt")))
+    static int count_le_avx2(const float* v, int n, float c, int& count)
+    {
+        __m256 t = _mm256_set1_ps(c);
+        int j = 0;
+        for (; j + 8 <= n; j += 8)
+        {
+            __m256 le = _mm256_cmp_ps(_mm256_loadu_ps(v + j), t, _CMP_LE_OQ);
+            count += __builtin_popcount(_mm256_movemask_ps(le));
+        }
+        return j;
+    }
+
+#endif
+
+    bool simd;  // (the last training used AVX2)
+
+    std::vector<float> columns;     // attribute values (per attribute, in sample order)
+    std::vector<int> class_order;   // the samples grouped by class
+    std::vector<int> class_ofs;     // the class group boundaries in class_order
+};
+
+/******************************************************************************/
+
+#endif
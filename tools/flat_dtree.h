@@ -0,0 +1,937 @@
+// Support : flattened (struct of arrays) decision tree for fast batch inference
+
+// Converts a trained (or loaded) CvDTree into contiguous arrays - one entry
+// per node of the feature (sample column) tested, split threshold, child node
+// indices and node value - so that prediction walks a few small arrays rather
+// than the pointer linked CvDTreeNode / CvDTreeSplit objects scattered across
+// the heap. Predictions are identical to CvDTree::predict(sample, Mat(), false)
+// including categorical splits, inversed splits, surrogate splits (used when a
+// category was not seen in training) and cost complexity pruning (nodes with
+// Tn <= pruned_tree_idx are leaves).
+
+// Categorical splits are also compiled into a 64-bit mask per node (bit c set
+// => category c goes left) so that, once the categorical columns of a sample
+// have been dictionary encoded to category indices (encode(), one cat_map
+// search per column rather than one per split), predict_encoded() decides
+// each categorical split with a single shift and test.
+
+// The order of the nodes in memory can be changed (set_layout()) without
+// changing any prediction so that the nodes a sample visits are close
+// together: depth first (as built), breadth first, van Emde Boas (recursive
+// blocks of half the height, so any path crosses few blocks whatever the
+// cache line / page size) or hot path first (depth first, the child that more
+// training samples reached placed immediately after its parent).
+//
+// profile() counts the visits of each node and the branches taken while
+// predicting a data set, and the profile guided layout uses these counts:
+// the more frequently taken child always follows its parent (falls through)
+// and the hottest paths are packed contiguously from the root, colder
+// subtrees after them in order of decreasing visits.
+
+// For trees with only ordered splits, predict_lockstep() advances blocks of 16
+// samples through the tree together, one level per step, using AVX2 gather and
+// compare instructions where the CPU supports them (scalar code otherwise).
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#ifndef FLAT_DTREE_H
+#define FLAT_DTREE_H
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+#include <vector>
+#include <algorithm>
+#include <queue>
+#include <utility>
+
+// AVX2 lockstep traversal (GCC / clang on x86, selected at run time)
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define FLAT_DTREE_AVX2
+#endif
+
+#define FLAT_DTREE_BLOCK 16 // samples advanced in lockstep (2 x 8 AVX2 lanes)
+
+// node layouts (FlatDTree::set_layout())
+
+enum
+{
+    FLAT_DTREE_DEPTH_FIRST = 0,
+    FLAT_DTREE_BREADTH_FIRST,
+    FLAT_DTREE_VAN_EMDE_BOAS,
+    FLAT_DTREE_HOT_PATH_FIRST,
+    FLAT_DTREE_PROFILE_GUIDED,  // (from profile() node visit counts)
+    FLAT_DTREE_LAYOUTS
+};
+
+/******************************************************************************/
+
+// a sample with the value of one column replaced, without copying the sample
+// (for FlatDTree::find_leaf(), e.g. in permutation importance)
+
+struct ReplacedColumnSample
+{
+    ReplacedColumnSample(const float* _row, int _column, float _value) :
+        row(_row), column(_column), value(_value) {}
+
+    float operator[](int c) const
+    {
+        return (c == column) ? value : row[c];
+    }
+
+    const float* row;
+    int column;
+    float value;
+};
+
+/******************************************************************************/
+
+class FlatDTree
+{
+public:
+
+    FlatDTree() : var_all(0), max_depth(0), pruned_tree_idx(0), use_cat_masks(false),
+        layout(FLAT_DTREE_DEPTH_FIRST) {}
+
+    // flatten a trained / loaded tree (returns false if it has no nodes)
+
+    bool build(CvDTree* dtree)
+    {
+        clear();
+
+        const CvDTreeNode* root = dtree->get_root();
+        CvDTreeTrainData* data = dtree->get_data();
+        if (!root || !data)
+        {
+            return false;
+        }
+
+        pruned_tree_idx = dtree->get_pruned_tree_idx();
+        var_all = data->var_all;
+
+        // copy the mapping from the split variable index to the sample column
+        // and the categorical value dictionary (cat_map) used by the tree
+
+        int var_count = data->var_count;
+        var_column.resize(var_count);
+        var_cat.resize(var_count);
+        for (int vi = 0; vi < var_count; vi++)
+        {
+            var_column[vi] = data->var_idx ? data->var_idx->data.i[vi] : vi;
+            var_cat[vi] = data->var_type->data.i[vi];
+        }
+
+        if (data->cat_ofs && data->cat_map)
+        {
+            cat_ofs.assign(data->cat_ofs->data.i,
+                           data->cat_ofs->data.i + data->cat_ofs->cols);
+            cat_map.assign(data->cat_map->data.i,
+                           data->cat_map->data.i + data->cat_map->cols);
+        }
+
+        add_node(root, 0);
+        build_cat_masks();
+
+        return true;
+    }
+
+    void clear()
+    {
+        feature.clear();
+        threshold.clear();
+        left.clear();
+        right.clear();
+        value.clear();
+        split.clear();
+        default_child.clear();
+        node_id.clear();
+        split_column.clear();
+        split_cat.clear();
+        split_c.clear();
+        split_subset.clear();
+        split_inversed.clear();
+        split_next.clear();
+        subsets.clear();
+        var_column.clear();
+        var_cat.clear();
+        cat_ofs.clear();
+        cat_map.clear();
+        cat_mask.clear();
+        column_cat.clear();
+        cat_columns.clear();
+        max_depth = 0;
+        use_cat_masks = false;
+        layout = FLAT_DTREE_DEPTH_FIRST;
+    }
+
+    // predict a single sample (pointer to var_all floats)
+
+    double predict(const float* sample) const
+    {
+        return value[find_leaf(sample)];
+    }
+
+    // index of the leaf node reached by a sample - a pointer to var_all
+    // floats or any type indexed by column (e.g. ReplacedColumnSample)
+
+    template<typename Sample>
+    int find_leaf(const Sample& sample) const
+    {
+        const int* f = &feature[0];
+        const float* t = &threshold[0];
+        const int* l = &left[0];
+        const int* r = &right[0];
+        const int* s = &split[0];
+        int n = 0;
+
+        while (f[n] >= 0)
+        {
+            if (s[n] < 0)
+            {
+                n = (sample[f[n]] <= t[n]) ? l[n] : r[n];
+            }
+            else
+            {
+                n = categorical_child(n, sample);
+            }
+        }
+
+        return n;
+    }
+
+    // the child of split node n taken by a sample (as find_leaf())
+
+    template<typename Sample>
+    int child(int n, const Sample& sample) const
+    {
+        if (split[n] < 0)
+        {
+            return (sample[feature[n]] <= threshold[n]) ? left[n] : right[n];
+        }
+        return categorical_child(n, sample);
+    }
+
+    // dictionary encode the categorical columns of a sample (pointer to
+    // var_all floats) into codes (var_all ints) - the category index of the
+    // value within its variable, -1 if it was not seen in training (or is
+    // not an integer). Codes of ordered columns are not set.
+
+    void encode(const float* sample, int* codes) const
+    {
+        for (size_t k = 0; k < cat_columns.size(); k++)
+        {
+            int column = cat_columns[k];
+            int ival = cvRound(sample[column]);
+            codes[column] = (ival == sample[column])
+                            ? find_category(column_cat[column], ival) : -1;
+        }
+    }
+
+    // predict a single sample given its codes from encode() - categorical
+    // splits test one bit of the node mask (the sample itself is used for
+    // ordered splits and, for a category not seen in training, to fall back
+    // to the surrogate splits as predict())
+
+    double predict_encoded(const float* sample, const int* codes) const
+    {
+        if (!use_cat_masks)
+        {
+            return predict(sample);
+        }
+
+        const int* f = &feature[0];
+        const float* t = &threshold[0];
+        const int* l = &left[0];
+        const int* r = &right[0];
+        const int* s = &split[0];
+        const uint64* m = &cat_mask[0];
+        int n = 0;
+
+        while (f[n] >= 0)
+        {
+            if (s[n] < 0)
+            {
+                n = (sample[f[n]] <= t[n]) ? l[n] : r[n];
+            }
+            else
+            {
+                int c = codes[f[n]];
+                n = (c < 0) ? categorical_child(n, sample)
+                    : (((m[n] >> c) & 1) ? l[n] : r[n]);
+            }
+        }
+
+        return value[n];
+    }
+
+    // encode a batch of samples (1 sample per row, CV_32F) into codes
+    // (1 row of var_all codes per sample, CV_32S)
+
+    void encode(const cv::Mat& samples, cv::Mat& codes) const
+    {
+        codes.create(samples.rows, var_all, CV_32S);
+        for (int i = 0; i < samples.rows; i++)
+        {
+            encode(samples.ptr<float>(i), codes.ptr<int>(i));
+        }
+    }
+
+    // predict a batch of encoded samples (as predict(samples, results))
+
+    void predict_encoded(const cv::Mat& samples, const cv::Mat& codes,
+                         cv::Mat& results) const
+    {
+        results.create(samples.rows, 1, CV_64F);
+        for (int i = 0; i < samples.rows; i++)
+        {
+            results.at<double>(i, 0) = predict_encoded(samples.ptr<float>(i),
+                                       codes.ptr<int>(i));
+        }
+    }
+
+    // true if every categorical split has a node mask (<= 64 categories),
+    // otherwise predict_encoded() is simply predict()
+
+    bool has_cat_masks() const { return use_cat_masks; }
+
+    // predict a batch of samples (1 sample per row, CV_32F) into results
+    // (1 result per row, CV_64F)
+
+    void predict(const cv::Mat& samples, cv::Mat& results) const
+    {
+        results.create(samples.rows, 1, CV_64F);
+        for (int i = 0; i < samples.rows; i++)
+        {
+            results.at<double>(i, 0) = predict(samples.ptr<float>(i));
+        }
+    }
+
+    // predict a batch of samples (as above) advancing FLAT_DTREE_BLOCK samples
+    // through the tree in lockstep - with AVX2 if use_simd is set and the CPU
+    // supports it, otherwise (or if the tree has categorical splits) with the
+    // scalar single sample traversal
+
+    void predict_lockstep(const cv::Mat& samples, cv::Mat& results,
+                          bool use_simd = true) const
+    {
+        results.create(samples.rows, 1, CV_64F);
+
+        int i = 0;
+
+#ifdef FLAT_DTREE_AVX2
+        if (use_simd && split_column.empty() && cv::checkHardwareSupport(CV_CPU_AVX2))
+        {
+            int leaf[FLAT_DTREE_BLOCK];
+            int row_step = (int) (samples.step / sizeof(float));
+
+            for (; i + FLAT_DTREE_BLOCK <= samples.rows; i += FLAT_DTREE_BLOCK)
+            {
+                traverse_block_avx2(samples.ptr<float>(i), row_step, leaf);
+                for (int j = 0; j < FLAT_DTREE_BLOCK; j++)
+                {
+                    results.at<double>(i + j, 0) = value[leaf[j]];
+                }
+            }
+        }
+#else
+        (void) use_simd;
+#endif
+
+        // remaining samples (or all of them without AVX2)
+
+        for (; i < samples.rows; i++)
+        {
+            results.at<double>(i, 0) = predict(samples.ptr<float>(i));
+        }
+    }
+
+    // count, for each node, the samples that visit it and that take its
+    // left branch while predicting a batch of samples (1 sample per row,
+    // CV_32F) - counts are added to node_hits / left_hits, indexed by node id
+    // so they remain valid whatever the layout of the tree
+
+    void profile(const cv::Mat& samples, std::vector<double>& node_hits,
+                 std::vector<double>& left_hits) const
+    {
+        node_hits.resize(feature.size(), 0.0);
+        left_hits.resize(feature.size(), 0.0);
+
+        for (int i = 0; i < samples.rows; i++)
+        {
+            const float* sample = samples.ptr<float>(i);
+            int n = 0;
+
+            for (;;)
+            {
+                node_hits[node_id[n]] += 1.0;
+                if (feature[n] < 0)
+                {
+                    break;
+                }
+                int next = child(n, sample);
+                if (next == left[n])
+                {
+                    left_hits[node_id[n]] += 1.0;
+                }
+                n = next;
+            }
+        }
+    }
+
+    // reorder the nodes in memory to one of the FLAT_DTREE_ layouts (node 0
+    // remains the root and predictions are unchanged) - the profile guided
+    // layout needs the node_hits of profile() (without them it is the hot
+    // path first layout)
+
+    void set_layout(int _layout, const std::vector<double>* node_hits = 0)
+    {
+        if (feature.empty())
+        {
+            return;
+        }
+
+        std::vector<int> order; // node (current index) at each new position
+        order.reserve(feature.size());
+
+        switch (_layout)
+        {
+        case FLAT_DTREE_BREADTH_FIRST:
+            order.push_back(0);
+            for (size_t i = 0; i < order.size(); i++)
+            {
+                int n = order[i];
+                if (feature[n] >= 0)
+                {
+                    order.push_back(left[n]);
+                    order.push_back(right[n]);
+                }
+            }
+            break;
+        case FLAT_DTREE_VAN_EMDE_BOAS:
+            van_emde_boas_order(0, max_depth + 1, order);
+            break;
+        case FLAT_DTREE_PROFILE_GUIDED:
+            if (node_hits && (node_hits->size() == feature.size()))
+            {
+                profile_guided_order(*node_hits, order);
+                break;
+            }
+            _layout = FLAT_DTREE_HOT_PATH_FIRST;
+            depth_first_order(0, true, order);
+            break;
+        case FLAT_DTREE_HOT_PATH_FIRST:
+            depth_first_order(0, true, order);
+            break;
+        default:
+            _layout = FLAT_DTREE_DEPTH_FIRST;
+            depth_first_order(0, false, order);
+            break;
+        }
+
+        permute_nodes(order);
+        layout = _layout;
+    }
+
+    int get_layout() const { return layout; }
+
+    static const char* get_layout_name(int _layout)
+    {
+        static const char* names[FLAT_DTREE_LAYOUTS] =
+        {"depth first", "breadth first", "van Emde Boas", "hot path first", "profile guided"};
+        return ((_layout >= 0) && (_layout < FLAT_DTREE_LAYOUTS)) ? names[_layout] : "unknown";
+    }
+
+    int get_node_count() const { return (int) feature.size(); }
+    int get_depth() const { return max_depth; }
+    int get_var_all() const { return var_all; }
+
+    // bytes used by the flattened representation
+
+    size_t get_size_bytes() const
+    {
+        return feature.size() * (sizeof(int) * 6 + sizeof(float) + sizeof(double))
+               + split_column.size() * (sizeof(int) * 5 + sizeof(float))
+               + cat_mask.size() * sizeof(uint64)
+               + (subsets.size() + var_column.size() + var_cat.size()
+                  + cat_ofs.size() + cat_map.size() + column_cat.size()
+                  + cat_columns.size()) * sizeof(int);
+    }
+
+    // node arrays - node 0 is the root, the other nodes are in the order of
+    // the layout (initially depth first, the (tree) left child immediately
+    // following its parent)
+
+    std::vector<int> feature;       // sample column tested (-1 => leaf)
+    std::vector<float> threshold;   // ordered split: value <= threshold => left
+    std::vector<int> left;          // child node index taken on the left
+    std::vector<int> right;         // child node index taken on the right
+    std::vector<double> value;      // node value (prediction at a leaf)
+    std::vector<int> split;         // categorical split (-1 => ordered)
+    std::vector<int> default_child; // child taken if no split can be evaluated
+    std::vector<int> node_id;       // index of the node as built (depth first)
+
+    // categorical primary splits and all surrogate splits (slow path only)
+
+    std::vector<int> split_column;  // sample column tested
+    std::vector<int> split_cat;     // categorical variable index (-1 ordered)
+    std::vector<float> split_c;     // ordered split threshold
+    std::vector<int> split_subset;  // offset of the subset bits in subsets
+    std::vector<int> split_inversed;
+    std::vector<int> split_next;    // next (surrogate) split, -1 => none
+    std::vector<int> subsets;       // categorical subset bit masks
+
+    // categorical value dictionary of the tree (as CvDTreeTrainData)
+
+    std::vector<int> var_column;
+    std::vector<int> var_cat;
+    std::vector<int> cat_ofs;
+    std::vector<int> cat_map;
+
+    // categorical split node masks (bit c set => category c goes left, 0
+    // for other nodes) and the categorical variable of each sample column
+    // (-1 for ordered / unused columns)
+
+    std::vector<uint64> cat_mask;
+    std::vector<int> column_cat;
+    std::vector<int> cat_columns;
+
+protected:
+
+#ifdef FLAT_DTREE_AVX2
+
+    // advance 16 samples (rows row_step floats apart) to their leaves as two
+    // groups of 8 AVX2 lanes - each step gathers the feature, threshold and
+    // children of the current node of every lane, gathers the sample values
+    // and selects the child on the compare mask. Leaves loop back to
+    // themselves so lanes that arrive early simply wait for the rest.
+    // (ordered splits only)
+
+    __attribute__((target("avx2")))
+    void traverse_block_avx2(const float* samples, int row_step, int* leaf) const
+    {
+        const int* f = &feature[0];
+        const float* t = &threshold[0];
+        const int* l = &left[0];
+        const int* r = &right[0];
+
+        const __m256i zero = _mm256_setzero_si256();
+        const __m256i row0 = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7),
+                                                _mm256_set1_epi32(row_step));
+        const __m256i row1 = _mm256_add_epi32(row0, _mm256_set1_epi32(8 * row_step));
+
+        __m256i n0 = zero;
+        __m256i n1 = zero;
+
+        for (;;)
+        {
+            __m256i f0 = _mm256_i32gather_epi32(f, n0, 4);
+            __m256i f1 = _mm256_i32gather_epi32(f, n1, 4);
+
+            // all 16 at a leaf (feature -1) ?
+
+            if (_mm256_movemask_ps(_mm256_castsi256_ps(_mm256_and_si256(f0, f1))) == 0xff)
+            {
+                break;
+            }
+
+            // sample values (feature 0 for lanes at a leaf, whose children
+            // are themselves whatever the comparison)
+
+            __m256 v0 = _mm256_i32gather_ps(samples, _mm256_add_epi32(row0, _mm256_max_epi32(f0, zero)), 4);
+            __m256 v1 = _mm256_i32gather_ps(samples, _mm256_add_epi32(row1, _mm256_max_epi32(f1, zero)), 4);
+
+            __m256 le0 = _mm256_cmp_ps(v0, _mm256_i32gather_ps(t, n0, 4), _CMP_LE_OQ);
+            __m256 le1 = _mm256_cmp_ps(v1, _mm256_i32gather_ps(t, n1, 4), _CMP_LE_OQ);
+
+            n0 = _mm256_castps_si256(_mm256_blendv_ps(
+                                         _mm256_castsi256_ps(_mm256_i32gather_epi32(r, n0, 4)),
+                                         _mm256_castsi256_ps(_mm256_i32gather_epi32(l, n0, 4)), le0));
+            n1 = _mm256_castps_si256(_mm256_blendv_ps(
+                                         _mm256_castsi256_ps(_mm256_i32gather_epi32(r, n1, 4)),
+                                         _mm256_castsi256_ps(_mm256_i32gather_epi32(l, n1, 4)), le1));
+        }
+
+        _mm256_storeu_si256((__m256i*) leaf, n0);
+        _mm256_storeu_si256((__m256i*) (leaf + 8), n1);
+    }
+
+#endif
+
+    // category index (within its variable) of a raw sample value, -1 if the
+    // value was not seen in training (as per CvDTree::predict())
+
+    int category(int ci, float val) const
+    {
+        int ival = cvRound(val);
+        if (ival != val)
+        {
+            CV_Error(CV_StsBadArg, "one of input categorical variable is not an integer");
+        }
+        return find_category(ci, ival);
+    }
+
+    // category index of an integer value (binary search of cat_map)
+
+    int find_category(int ci, int ival) const
+    {
+        int a = cat_ofs[ci];
+        int b = (ci + 1 >= (int) cat_ofs.size()) ? (int) cat_map.size() : cat_ofs[ci + 1];
+        int c = a;
+
+        while (a < b)
+        {
+            c = (a + b) >> 1;
+            if (ival < cat_map[c])
+            {
+                b = c;
+            }
+            else if (ival > cat_map[c])
+            {
+                a = c + 1;
+            }
+            else
+            {
+                break;
+            }
+        }
+
+        if ((c < 0) || (c >= (int) cat_map.size()) || (ival != cat_map[c]))
+        {
+            return -1;
+        }
+        return c - cat_ofs[ci];
+    }
+
+    // direction (-1 left, +1 right, 0 undecided) of split s for a sample
+
+    template<typename Sample>
+    int split_direction(int s, const Sample& sample) const
+    {
+        float val = sample[split_column[s]];
+        int dir;
+
+        if (split_cat[s] < 0)
+        {
+            dir = (val <= split_c[s]) ? -1 : 1;
+        }
+        else
+        {
+            int c = category(split_cat[s], val);
+            if (c < 0)
+            {
+                return 0;
+            }
+            const int* subset = &subsets[split_subset[s]];
+            dir = CV_DTREE_CAT_DIR(c, subset);
+        }
+
+        return split_inversed[s] ? -dir : dir;
+    }
+
+    // child of a categorical split node - the primary split then surrogates,
+    // and finally the default (larger) child
+
+    template<typename Sample>
+    int categorical_child(int n, const Sample& sample) const
+    {
+        for (int s = split[n]; s >= 0; s = split_next[s])
+        {
+            int dir = split_direction(s, sample);
+            if (dir)
+            {
+                return (dir < 0) ? left[n] : right[n];
+            }
+        }
+        return default_child[n];
+    }
+
+    // add the split chain of a node to the split table, returning the index
+    // of the first entry
+
+    int add_splits(const CvDTreeSplit* s)
+    {
+        if (!s)
+        {
+            return -1;
+        }
+
+        int idx = (int) split_column.size();
+        int ci = var_cat[s->var_idx];
+
+        split_column.push_back(var_column[s->var_idx]);
+        split_cat.push_back(ci);
+        split_c.push_back((ci < 0) ? s->ord.c : 0.0f);
+        split_subset.push_back((int) subsets.size());
+        split_inversed.push_back(s->inversed);
+        split_next.push_back(-1);
+
+        if (ci >= 0)
+        {
+            // subset is (at least) 2 ints - longer for > 64 categories
+
+            int n_cats = ((ci + 1 < (int) cat_ofs.size()) ? cat_ofs[ci + 1]
+                          : (int) cat_map.size()) - cat_ofs[ci];
+            int n_words = std::max(2, (n_cats + 31) / 32);
+            subsets.insert(subsets.end(), s->subset, s->subset + n_words);
+        }
+
+        int next = add_splits(s->next);
+        split_next[idx] = next;
+
+        return idx;
+    }
+
+    // add a node (and recursively its children) returning its index
+
+    int add_node(const CvDTreeNode* node, int depth)
+    {
+        int idx = (int) feature.size();
+        max_depth = std::max(max_depth, depth);
+
+        feature.push_back(-1);
+        threshold.push_back(0.0f);
+        left.push_back(idx);
+        right.push_back(idx);
+        value.push_back(node->value);
+        split.push_back(-1);
+        default_child.push_back(idx);
+        node_id.push_back(idx);
+
+        // leaf (or pruned away by cost complexity pruning)
+
+        if (!node->left || (node->Tn <= pruned_tree_idx))
+        {
+            return idx;
+        }
+
+        const CvDTreeSplit* s = node->split;
+        int ci = var_cat[s->var_idx];
+
+        feature[idx] = var_column[s->var_idx];
+        if (ci < 0)
+        {
+            threshold[idx] = s->ord.c;
+        }
+        else
+        {
+            int first = add_splits(s);
+            split[idx] = first;
+        }
+
+        int l = add_node(node->left, depth + 1);
+        int r = add_node(node->right, depth + 1);
+
+        // CvDTree falls back to the child with more training samples
+
+        default_child[idx] =
+            ((node->right->sample_count - node->left->sample_count) < 0) ? l : r;
+
+        // an inversed ordered split sends (value <= threshold) to the right
+
+        if ((ci < 0) && s->inversed)
+        {
+            std::swap(l, r);
+        }
+
+        left[idx] = l;
+        right[idx] = r;
+
+        return idx;
+    }
+
+    // the categorical node masks and column dictionary of the tree
+
+    void build_cat_masks()
+    {
+        column_cat.assign(var_all, -1);
+        for (size_t vi = 0; vi < var_column.size(); vi++)
+        {
+            if (var_cat[vi] >= 0)
+            {
+                column_cat[var_column[vi]] = var_cat[vi];
+                cat_columns.push_back(var_column[vi]);
+            }
+        }
+
+        use_cat_masks = true;
+        cat_mask.assign(feature.size(), 0);
+        for (size_t n = 0; n < feature.size(); n++)
+        {
+            if ((feature[n] < 0) || (split[n] < 0))
+            {
+                continue;
+            }
+
+            int s = split[n];
+            int ci = split_cat[s];
+            int n_cats = ((ci + 1 < (int) cat_ofs.size()) ? cat_ofs[ci + 1]
+                          : (int) cat_map.size()) - cat_ofs[ci];
+            if (n_cats > 64)
+            {
+                use_cat_masks = false;
+                continue;
+            }
+
+            const int* subset = &subsets[split_subset[s]];
+            uint64 bits = ((uint64) (unsigned) subset[0])
+                          | (((uint64) (unsigned) subset[1]) << 32);
+            if (split_inversed[s])
+            {
+                bits = ~bits;
+            }
+            if (n_cats < 64)
+            {
+                bits &= (((uint64) 1) << n_cats) - 1;
+            }
+            cat_mask[n] = bits;
+        }
+    }
+
+    // depth first node order from n - the left child first, or if hot_first
+    // the child taken by default (that more training samples reached)
+
+    void depth_first_order(int n, bool hot_first, std::vector<int>& order) const
+    {
+        order.push_back(n);
+        if (feature[n] >= 0)
+        {
+            int first = left[n];
+            int second = right[n];
+            if (hot_first && (default_child[n] == second))
+            {
+                std::swap(first, second);
+            }
+            depth_first_order(first, hot_first, order);
+            depth_first_order(second, hot_first, order);
+        }
+    }
+
+    // profile guided node order - the hottest pending subtree is laid out by
+    // following its more visited children (the hot path) to a leaf, the
+    // other child of each node on the path becoming a pending subtree
+
+    void profile_guided_order(const std::vector<double>& node_hits,
+                              std::vector<int>& order) const
+    {
+        std::priority_queue< std::pair<double, int> > pending; // (visits, -node)
+        pending.push(std::make_pair(node_hits[node_id[0]], 0));
+
+        while (!pending.empty())
+        {
+            int n = -pending.top().second;
+            pending.pop();
+
+            for (;;)
+            {
+                order.push_back(n);
+                if (feature[n] < 0)
+                {
+                    break;
+                }
+
+                double l_hits = node_hits[node_id[left[n]]];
+                double r_hits = node_hits[node_id[right[n]]];
+                int hot = (l_hits > r_hits) ? left[n]
+                          : ((r_hits > l_hits) ? right[n] : default_child[n]);
+                int cold = (hot == left[n]) ? right[n] : left[n];
+
+                pending.push(std::make_pair(node_hits[node_id[cold]], -cold));
+                n = hot;
+            }
+        }
+    }
+
+    // van Emde Boas node order of the top height levels of the subtree at n:
+    // the top half of the levels recursively, then each subtree hanging
+    // below them (left to right) recursively
+
+    void van_emde_boas_order(int n, int height, std::vector<int>& order) const
+    {
+        if ((height <= 1) || (feature[n] < 0))
+        {
+            order.push_back(n);
+            return;
+        }
+
+        int top = height / 2;
+        van_emde_boas_order(n, top, order);
+
+        std::vector<int> bottom;
+        nodes_at_depth(n, top, bottom);
+        for (size_t i = 0; i < bottom.size(); i++)
+        {
+            van_emde_boas_order(bottom[i], height - top, order);
+        }
+    }
+
+    // the nodes depth levels below n (left to right)
+
+    void nodes_at_depth(int n, int depth, std::vector<int>& nodes) const
+    {
+        if (depth == 0)
+        {
+            nodes.push_back(n);
+        }
+        else if (feature[n] >= 0)
+        {
+            nodes_at_depth(left[n], depth - 1, nodes);
+            nodes_at_depth(right[n], depth - 1, nodes);
+        }
+    }
+
+    // move the nodes so that node order[i] becomes node i
+
+    void permute_nodes(const std::vector<int>& order)
+    {
+        std::vector<int> position(order.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            position[order[i]] = (int) i;
+        }
+
+        permute(feature, order);
+        permute(threshold, order);
+        permute(value, order);
+        permute(split, order);
+        permute(node_id, order);
+        if (!cat_mask.empty())
+        {
+            permute(cat_mask, order);
+        }
+
+        permute(left, order);
+        permute(right, order);
+        permute(default_child, order);
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            left[i] = position[left[i]];
+            right[i] = position[right[i]];
+            default_child[i] = position[default_child[i]];
+        }
+    }
+
+    template<typename T>
+    static void permute(std::vector<T>& v, const std::vector<int>& order)
+    {
+        std::vector<T> moved(order.size());
+        for (size_t i = 0; i < order.size(); i++)
+        {
+            moved[i] = v[order[i]];
+        }
+        v.swap(moved);
+    }
+
+    int var_all;
+    int max_depth;
+    int pruned_tree_idx;
+    bool use_cat_masks;
+    int layout;
+};
+
+/******************************************************************************/
+
+#endif
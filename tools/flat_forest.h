@@ -0,0 +1,299 @@
+// Support : flattened random forest with batched, parallel and early exit
+// prediction
+
+// CvRTrees::predict() (and CvERTrees) walks every tree of the forest for each
+// sample, although for a classification forest the vote is usually decided
+// long before the last tree: once the leading class has more votes over the
+// runner up than there are trees left to evaluate it cannot be overtaken.
+//
+// FlatForest holds the trees of a trained / loaded forest flattened
+// (flat_dtree.h) and predicts a batch of samples in blocks of
+// FLAT_FOREST_BLOCK rows, the blocks shared across threads (cv::parallel_for_).
+// Each block is advanced through the trees a chunk at a time (all of its
+// undecided rows through each tree of the chunk in turn, keeping the tree in
+// cache) and after each chunk the rows whose vote is decided are retired. The
+// votes are counted, and ties broken, as CvRTrees::predict() so predictions
+// are identical to it with or without the early exit. Regression forests
+// (the mean of all of the trees) always evaluate every tree.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#ifndef FLAT_FOREST_H
+#define FLAT_FOREST_H
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+#include <vector>
+#include <algorithm>
+
+#include "flat_dtree.h"
+
+#define FLAT_FOREST_BLOCK 64 // rows predicted together (one task each)
+#define FLAT_FOREST_CHUNK 8  // trees evaluated between early exit checks
+
+/******************************************************************************/
+
+class FlatForest
+{
+public:
+
+    FlatForest() : n_classes(0), chunk_size(FLAT_FOREST_CHUNK) {}
+
+    // flatten the trees of a trained / loaded forest (returns false if it has
+    // no trees or one cannot be flattened)
+
+    bool build(const CvRTrees* forest)
+    {
+        clear();
+
+        int ntrees = forest->get_tree_count();
+        if (ntrees < 1)
+        {
+            return false;
+        }
+
+        trees.resize(ntrees);
+        for (int k = 0; k < ntrees; k++)
+        {
+            if (!trees[k].build(forest->get_tree(k)))
+            {
+                clear();
+                return false;
+            }
+        }
+
+        if (forest->get_tree(0)->get_data()->is_classifier)
+        {
+            index_classes();
+        }
+
+        return true;
+    }
+
+    void clear()
+    {
+        trees.clear();
+        node_class.clear();
+        class_values.clear();
+        n_classes = 0;
+    }
+
+    // number of trees evaluated between checks whether a vote is decided
+
+    void set_chunk_size(int _chunk_size) { chunk_size = MAX(_chunk_size, 1); }
+    int get_chunk_size() const { return chunk_size; }
+
+    int get_tree_count() const { return (int) trees.size(); }
+    bool is_classifier() const { return n_classes > 0; }
+    const FlatDTree& get_tree(int k) const { return trees[k]; }
+
+    // predict a single sample (pointer to var_all floats), stopping once the
+    // vote is decided if early_exit is set - the number of trees evaluated is
+    // returned in n_trees (if given)
+
+    float predict(const float* sample, bool early_exit = true, int* n_trees = 0) const
+    {
+        float result;
+        int evaluated;
+        predict_block(sample, 0, 1, early_exit, &result, &evaluated);
+        if (n_trees)
+        {
+            *n_trees = evaluated;
+        }
+        return result;
+    }
+
+    // predict a batch of samples (1 sample per row, CV_32F) into results (1
+    // result per row, CV_32F) across threads - returns the mean number of
+    // trees evaluated per sample
+
+    double predict(const cv::Mat& samples, cv::Mat& results, bool early_exit = true) const
+    {
+        results.create(samples.rows, 1, CV_32F);
+        if (samples.rows == 0)
+        {
+            return 0;
+        }
+
+        std::vector<int> evaluated(samples.rows);
+        int n_blocks = (samples.rows + FLAT_FOREST_BLOCK - 1) / FLAT_FOREST_BLOCK;
+        cv::parallel_for_(cv::Range(0, n_blocks),
+                          BlockPredictor(this, samples, early_exit,
+                                         results.ptr<float>(0), &evaluated[0]));
+
+        double total = 0;
+        for (int i = 0; i < samples.rows; i++)
+        {
+            total += evaluated[i];
+        }
+        return total / samples.rows;
+    }
+
+private:
+
+    // for a classifier, the class (index into class_values) of each node
+
+    void index_classes()
+    {
+        int ntrees = (int) trees.size();
+        for (int k = 0; k < ntrees; k++)
+        {
+            class_values.insert(class_values.end(), trees[k].value.begin(),
+                                trees[k].value.end());
+        }
+        std::sort(class_values.begin(), class_values.end());
+        class_values.erase(std::unique(class_values.begin(), class_values.end()),
+                           class_values.end());
+        n_classes = (int) class_values.size();
+
+        node_class.resize(ntrees);
+        for (int k = 0; k < ntrees; k++)
+        {
+            node_class[k].resize(trees[k].value.size());
+            for (size_t n = 0; n < trees[k].value.size(); n++)
+            {
+                node_class[k][n] = (int) (std::lower_bound(class_values.begin(),
+                                          class_values.end(), trees[k].value[n])
+                                          - class_values.begin());
+            }
+        }
+    }
+
+    // predicts a range of blocks of rows
+
+    class BlockPredictor : public cv::ParallelLoopBody
+    {
+    public:
+
+        BlockPredictor(const FlatForest* _forest, const cv::Mat& _samples,
+                       bool _early_exit, float* _results, int* _evaluated) :
+            forest(_forest), samples(_samples), early_exit(_early_exit),
+            results(_results), evaluated(_evaluated) {}
+
+        virtual void operator()(const cv::Range& range) const
+        {
+            int step = (int) (samples.step / sizeof(float));
+            for (int b = range.start; b < range.end; b++)
+            {
+                int start = b * FLAT_FOREST_BLOCK;
+                int count = MIN(FLAT_FOREST_BLOCK, samples.rows - start);
+                forest->predict_block(samples.ptr<float>(start), step, count,
+                                      early_exit, results + start, evaluated + start);
+            }
+        }
+
+    private:
+
+        const FlatForest* forest;
+        const cv::Mat& samples;
+        bool early_exit;
+        float* results;
+        int* evaluated;
+    };
+
+    // predict count rows (row_step floats apart) - all of the rows through
+    // each chunk of trees then retiring those whose vote is decided
+
+    void predict_block(const float* rows, int row_step, int count, bool early_exit,
+                       float* results, int* evaluated) const
+    {
+        int ntrees = (int) trees.size();
+
+        if (!is_classifier())
+        {
+            for (int i = 0; i < count; i++)
+            {
+                double sum = 0;
+                for (int k = 0; k < ntrees; k++)
+                {
+                    sum += trees[k].predict(rows + i * row_step);
+                }
+                results[i] = (float) (sum / ntrees);
+                evaluated[i] = ntrees;
+            }
+            return;
+        }
+
+        // votes of each row, its leading class and that class's votes (as
+        // CvRTrees::predict(), the first class to reach the most votes leads)
+
+        std::vector<int> votes(count * n_classes, 0);
+        std::vector<int> leader(count, 0);
+        std::vector<int> max_votes(count, 0);
+
+        std::vector<int> active(count);
+        for (int i = 0; i < count; i++)
+        {
+            active[i] = i;
+        }
+
+        for (int k0 = 0; (k0 < ntrees) && !active.empty(); k0 += chunk_size)
+        {
+            int k1 = MIN(k0 + chunk_size, ntrees);
+
+            for (int k = k0; k < k1; k++)
+            {
+                const FlatDTree& tree = trees[k];
+                const int* classes = &node_class[k][0];
+                for (size_t a = 0; a < active.size(); a++)
+                {
+                    int i = active[a];
+                    int c = classes[tree.find_leaf(rows + i * row_step)];
+                    int v = ++votes[i * n_classes + c];
+                    if (v > max_votes[i])
+                    {
+                        max_votes[i] = v;
+                        leader[i] = c;
+                    }
+                }
+            }
+
+            // retire the rows whose leading class cannot be overtaken (or
+            // tied) by the trees remaining
+
+            int remaining = ntrees - k1;
+            size_t n_active = 0;
+            for (size_t a = 0; a < active.size(); a++)
+            {
+                int i = active[a];
+                bool decided = (remaining == 0);
+                if (early_exit && !decided)
+                {
+                    int runner_up = 0;
+                    for (int c = 0; c < n_classes; c++)
+                    {
+                        if ((c != leader[i]) && (votes[i * n_classes + c] > runner_up))
+                        {
+                            runner_up = votes[i * n_classes + c];
+                        }
+                    }
+                    decided = (max_votes[i] - runner_up > remaining);
+                }
+
+                if (decided)
+                {
+                    results[i] = (float) class_values[leader[i]];
+                    evaluated[i] = k1;
+                }
+                else
+                {
+                    active[n_active++] = i;
+                }
+            }
+            active.resize(n_active);
+        }
+    }
+
+    std::vector<FlatDTree> trees;
+    std::vector<std::vector<int> > node_class;  // class index of each node
+    std::vector<double> class_values;           // (sorted) class of each index
+    int n_classes;                              // 0 => regression
+    int chunk_size;
+};
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,343 @@
+// Support : classification forest grown outside CvRTrees and saved in its
+// format
+
+// GrownForest holds the trees of a classification forest grown by one of the
+// forest trainers here that do not use CvDTree (PresortForest, FastERTrees):
+// the nodes of each tree (as CvDTreeNode, a single ordered split each) and the
+// class labels. It predicts by the votes of the trees as CvRTrees::predict()
+// and saves the forest in the CvRTrees model format, so CvRTrees::load() (or
+// CvERTrees::load()) reads it for the usual prediction. The trainers set the
+// parameters and class indices of the training data (set_training()) and the
+// seeds of the trees (draw_tree_seeds(), one per tree drawn in order from a
+// master seed so that a forest grown in parallel does not depend on the
+// number of threads).
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#ifndef GROWN_FOREST_H
+#define GROWN_FOREST_H
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+#include "parallel_rtrees.h" // (PARALLEL_RTREES_SEED, the default master seed)
+
+/******************************************************************************/
+
+#define GROWN_FOREST_MAX_TREES 50 // trees grown when term_crit has no max_iter
+
+class GrownForest
+{
+public:
+
+    GrownForest(const char* _type_name = CV_TYPE_NAME_ML_RTREES) : seed(PARALLEL_RTREES_SEED),
+        type_name(_type_name), nsamples(0), nvars(0), nclasses(0), nactive_vars(0),
+        tree_max_depth(0), min_sample_count(0), max_categories(0) {}
+
+    virtual ~GrownForest() {}
+
+    // master seed of the per tree random number generators (set before
+    // training to train a different forest)
+
+    uint64 seed;
+
+    virtual void clear()
+    {
+        trees.clear();
+        labels.clear();
+        class_weights.clear();
+        responses_idx.clear();
+        nsamples = nvars = nclasses = 0;
+    }
+
+    // predict the class label of a single sample (pointer to nvars floats) -
+    // the votes of the trees as CvRTrees::predict()
+
+    float predict(const float* sample) const
+    {
+        std::vector<int> votes(nclasses, 0);
+        int max_votes = 0;
+        double result = 0;
+
+        for (size_t k = 0; k < trees.size(); k++)
+        {
+            const std::vector<Node>& nodes = trees[k];
+            int n = 0;
+            while (nodes[n].var >= 0)
+            {
+                n = (sample[nodes[n].var] <= nodes[n].c) ? nodes[n].left : nodes[n].right;
+            }
+            if (++votes[nodes[n].class_idx] > max_votes)
+            {
+                max_votes = votes[nodes[n].class_idx];
+                result = nodes[n].value;
+            }
+        }
+
+        return (float) result;
+    }
+
+    // save the forest in the CvRTrees model format - load it with
+    // CvRTrees::load() (or CvERTrees::load() for an extremely random forest)
+
+    bool save(const char* filename, const char* name = "my_random_trees") const
+    {
+        if (trees.empty())
+        {
+            return false;
+        }
+
+        CvFileStorage* fs = cvOpenFileStorage(filename, 0, CV_STORAGE_WRITE);
+        if (!fs)
+        {
+            return false;
+        }
+
+        cvStartWriteStruct(fs, name, CV_NODE_MAP, type_name);
+
+        cvWriteInt(fs, "nclasses", nclasses);
+        cvWriteInt(fs, "nsamples", nsamples);
+        cvWriteInt(fs, "nactive_vars", nactive_vars);
+        cvWriteReal(fs, "oob_error", 0);
+        cvWriteInt(fs, "ntrees", (int) trees.size());
+
+        // training data parameters (as CvDTreeTrainData::write_params(), see
+        // HistDTree::save())
+
+        cvWriteInt(fs, "is_classifier", 1);
+        cvWriteInt(fs, "var_all", nvars);
+        cvWriteInt(fs, "var_count", nvars);
+        cvWriteInt(fs, "ord_var_count", nvars);
+        cvWriteInt(fs, "cat_var_count", 0);
+
+        cvStartWriteStruct(fs, "training_params", CV_NODE_MAP);
+        cvWriteInt(fs, "use_surrogates", 0);
+        cvWriteInt(fs, "max_categories", max_categories);
+        cvWriteInt(fs, "max_depth", tree_max_depth);
+        cvWriteInt(fs, "min_sample_count", min_sample_count);
+        cvWriteInt(fs, "cross_validation_folds", 0);
+        cvEndWriteStruct(fs);
+
+        cvStartWriteStruct(fs, "var_type", CV_NODE_SEQ + CV_NODE_FLOW);
+        for (int vi = 0; vi < nvars; vi++)
+        {
+            cvWriteInt(fs, 0, 0);
+        }
+        cvEndWriteStruct(fs);
+
+        int n_classes = nclasses;
+        CvMat cat_count = cvMat(1, 1, CV_32SC1, &n_classes);
+        CvMat cat_map = cvMat(1, nclasses, CV_32SC1, (void*) &labels[0]);
+        cvWrite(fs, "cat_count", &cat_count);
+        cvWrite(fs, "cat_map", &cat_map);
+
+        // the trees (as CvDTree::write(), none pruned)
+
+        cvStartWriteStruct(fs, "trees", CV_NODE_SEQ);
+        for (size_t k = 0; k < trees.size(); k++)
+        {
+            cvStartWriteStruct(fs, 0, CV_NODE_MAP);
+            cvWriteInt(fs, "best_tree_idx", -1);
+            cvStartWriteStruct(fs, "nodes", CV_NODE_SEQ);
+            write_node(fs, trees[k], 0);
+            cvEndWriteStruct(fs);
+            cvEndWriteStruct(fs);
+        }
+        cvEndWriteStruct(fs);
+
+        cvEndWriteStruct(fs);
+        cvReleaseFileStorage(&fs);
+
+        return true;
+    }
+
+    int get_tree_count() const { return (int) trees.size(); }
+
+    int get_node_count() const
+    {
+        int n = 0;
+        for (size_t k = 0; k < trees.size(); k++)
+        {
+            n += (int) trees[k].size();
+        }
+        return n;
+    }
+
+protected:
+
+    struct Node
+    {
+        int var;            // attribute tested (-1 => leaf)
+        float c;            // value <= c => left
+        float quality;      // split quality (as CvDTreeSplit)
+        int left, right;    // child node indices
+        int depth;
+        int sample_count;   // training samples (with repeats) reaching it
+        int class_idx;      // index of the class label predicted
+        double value;       // class label predicted
+        double risk;        // (weighted) training samples misclassified
+    };
+
+    // set the parameters of the training data and the class index of each
+    // sample (returns false if the data is not one CV_32F sample per row with
+    // a CV_32F class label each)
+
+    bool set_training(const cv::Mat& data, const cv::Mat& responses, const CvRTParams& params)
+    {
+        if ((data.type() != CV_32FC1) || (responses.type() != CV_32FC1)
+                || (data.rows != (int) responses.total()) || (data.rows < 1))
+        {
+            return false;
+        }
+
+        nsamples = data.rows;
+        nvars = data.cols;
+        tree_max_depth = params.max_depth;
+        min_sample_count = params.min_sample_count;
+        max_categories = params.max_categories;
+
+        nactive_vars = params.nactive_vars;
+        if ((nactive_vars <= 0) || (nactive_vars > nvars))
+        {
+            nactive_vars = (nactive_vars <= 0) ? (int) sqrt((double) nvars) : nvars;
+        }
+        nactive_vars = MAX(nactive_vars, 1);
+
+        // map the class labels to class indices 0 ... nclasses - 1
+
+        for (int i = 0; i < nsamples; i++)
+        {
+            labels.push_back(cvRound(responses.at<float>(i)));
+        }
+        std::sort(labels.begin(), labels.end());
+        labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+        nclasses = (int) labels.size();
+
+        responses_idx.resize(nsamples);
+        std::vector<int> class_totals(nclasses, 0);
+        for (int i = 0; i < nsamples; i++)
+        {
+            responses_idx[i] = (int) (std::lower_bound(labels.begin(), labels.end(),
+                                      cvRound(responses.at<float>(i))) - labels.begin());
+            class_totals[responses_idx[i]]++;
+        }
+
+        // class weights (as CvDTree, from the whole of the training data)
+
+        class_weights.assign(nclasses, 1.0);
+        if (params.priors)
+        {
+            for (int k = 0; k < nclasses; k++)
+            {
+                class_weights[k] = params.priors[k] / class_totals[k];
+            }
+        }
+
+        return true;
+    }
+
+    // the seed of each tree (drawn in order, independent of the threads) -
+    // returns the number of trees (term_crit.max_iter)
+
+    int draw_tree_seeds(const CvRTParams& params, std::vector<uint64>& tree_seeds) const
+    {
+        int ntrees = (params.term_crit.type & CV_TERMCRIT_ITER)
+                     ? params.term_crit.max_iter : GROWN_FOREST_MAX_TREES;
+
+        cv::RNG master(seed);
+        tree_seeds.resize(MAX(ntrees, 0));
+        for (int k = 0; k < ntrees; k++)
+        {
+            uint64 high = master.next();
+            tree_seeds[k] = (high << 32) | master.next();
+        }
+        return ntrees;
+    }
+
+    // a node (leaf) of the given (weighted) class totals
+
+    Node leaf_node(const double* totals, int sample_count, int depth) const
+    {
+        Node node;
+        node.var = -1;
+        node.c = 0;
+        node.quality = 0;
+        node.left = node.right = -1;
+        node.depth = depth;
+        node.sample_count = sample_count;
+
+        int class_idx = 0;
+        double weight = 0;
+        for (int k = 0; k < nclasses; k++)
+        {
+            weight += totals[k];
+            if (totals[k] > totals[class_idx])
+            {
+                class_idx = k;
+            }
+        }
+        node.class_idx = class_idx;
+        node.value = labels[class_idx];
+        node.risk = weight - totals[class_idx];
+        return node;
+    }
+
+    // write a node and its sub-tree (depth first, left first, as CvDTree)
+
+    static void write_node(CvFileStorage* fs, const std::vector<Node>& nodes, int n)
+    {
+        const Node& node = nodes[n];
+
+        cvStartWriteStruct(fs, 0, CV_NODE_MAP);
+        cvWriteInt(fs, "depth", node.depth);
+        cvWriteInt(fs, "sample_count", node.sample_count);
+        cvWriteReal(fs, "value", node.value);
+        cvWriteInt(fs, "norm_class_idx", node.class_idx);
+        cvWriteInt(fs, "Tn", 0);
+        cvWriteInt(fs, "complexity", 0);
+        cvWriteReal(fs, "alpha", 0);
+        cvWriteReal(fs, "node_risk", node.risk);
+        cvWriteReal(fs, "tree_risk", 0);
+        cvWriteReal(fs, "tree_error", 0);
+
+        if (node.var >= 0)
+        {
+            cvStartWriteStruct(fs, "splits", CV_NODE_SEQ);
+            cvStartWriteStruct(fs, 0, CV_NODE_MAP + CV_NODE_FLOW);
+            cvWriteInt(fs, "var", node.var);
+            cvWriteReal(fs, "quality", node.quality);
+            cvWriteReal(fs, "le", node.c);
+            cvEndWriteStruct(fs);
+            cvEndWriteStruct(fs);
+        }
+        cvEndWriteStruct(fs);
+
+        if (node.var >= 0)
+        {
+            write_node(fs, nodes, node.left);
+            write_node(fs, nodes, node.right);
+        }
+    }
+
+    const char* type_name;  // model type saved
+
+    int nsamples, nvars, nclasses;
+    int nactive_vars;
+    int tree_max_depth, min_sample_count, max_categories;
+
+    std::vector< std::vector<Node> > trees;   // nodes of each tree (0 = root)
+
+    std::vector<int> labels;            // class label of each class index
+    std::vector<double> class_weights;  // weight of a sample of each class
+    std::vector<int> responses_idx;     // class index of each sample
+};
+
+/******************************************************************************/
+
+#endif
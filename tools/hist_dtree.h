@@ -0,0 +1,1118 @@
+// Support : histogram based decision tree training on pre-binned features
+
+// Grows a classification tree (Gini impurity, as CvDTree) without sorting
+// the raw attribute values at every node:
+//
+// - each attribute is quantized once into at most 256 bins - one bin per
+//   distinct value where there are few enough of them (the optdigits
+//   attributes take only 17 values) otherwise bins of roughly equal
+//   population - and the training data is stored as 8-bit bin indices
+//
+// - the best split of a node is found by a single scan over a per node
+//   histogram of class counts per bin of each attribute
+//
+// - only the histogram of the smaller child of a split is built from its
+//   samples, the histogram of the larger child is that of its parent minus
+//   that of its sibling (sibling subtraction)
+//
+// Split thresholds fall midway between the adjacent training values either
+// side of the split (as CvDTree) and the tree can be saved in the CvDTree
+// model format, so it can be loaded by CvDTree::load() (and used by
+// flat_dtree.h / dt_codegen.cc) exactly as a tree trained by CvDTree itself.
+// Cross validation pruning and surrogate splits are not supported - all
+// attributes are treated as ordered (CV_VAR_NUMERICAL) and none may be missing.
+//
+// The tree can be updated incrementally with new training samples (update())
+// rather than retrained from scratch: the new samples are binned with the
+// existing bins, each node they reach has its histogram updated and its best
+// split found again, and only the subtrees whose best split changed (or that
+// now split / no longer split) are regrown - unchanged subtrees, and those
+// no new sample reaches, are kept as they are. The histograms of the nodes
+// down to the depth a memory budget allows are kept for this (train()
+// cache_bytes) so that updating them costs only the new samples; below that
+// they are rebuilt from the node samples (with sibling subtraction). The
+// result is the tree that training from scratch on all the samples would
+// give with the same bins and class weights - these are fixed by the initial
+// training (new values join the nearest bin, class weights from the priors
+// keep the initial class totals).
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#ifndef HIST_DTREE_H
+#define HIST_DTREE_H
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+#include <vector>
+#include <algorithm>
+
+/******************************************************************************/
+
+#define HIST_DTREE_MAX_BINS 256 // bin indices are stored as uchar
+
+/******************************************************************************/
+
+// a subtree regrown by HistDTree::update()
+
+struct HistDTreeRebuild
+{
+    int depth;              // depth of its root
+    int sample_count;       // training samples at its root (after the update)
+    int old_var, new_var;   // attribute split on by its root (-1 => leaf)
+    int old_nodes;          // nodes in the subtree before and after
+    int new_nodes;
+};
+
+/******************************************************************************/
+
+class HistDTree
+{
+public:
+
+    HistDTree() : binning_time(0), growing_time(0), update_time(0), nsamples(0),
+        nvars(0), nclasses(0), tree_max_depth(0), min_sample_count(0),
+        max_categories(0), max_depth(0), cache_depth(0), hist_size(0) {}
+
+    // train the tree
+    // data = attributes (1 sample per row, CV_32F)
+    // responses = integer class labels (1 sample per row, CV_32F)
+    // params = tree parameters as CvDTree (max_depth, min_sample_count and
+    //          priors are used, the remainder are ignored other than being
+    //          saved with the tree)
+    // max_bins = maximum number of bins per attribute (<= 256)
+    // cache_bytes = memory for the node histograms kept for update() (0 =>
+    //               none, so every node update() reaches is rebuilt from its
+    //               samples)
+
+    bool train(const cv::Mat& data, const cv::Mat& responses,
+               const CvDTreeParams& params, int max_bins = HIST_DTREE_MAX_BINS,
+               size_t cache_bytes = 0)
+    {
+        if ((data.type() != CV_32FC1) || (responses.type() != CV_32FC1)
+                || (data.rows != (int) responses.total()) || (data.rows < 1)
+                || (max_bins < 2) || (max_bins > HIST_DTREE_MAX_BINS))
+        {
+            return false;
+        }
+
+        clear();
+
+        nsamples = data.rows;
+        nvars = data.cols;
+        tree_max_depth = params.max_depth;
+        min_sample_count = params.min_sample_count;
+        max_categories = params.max_categories;
+
+        int64 start = cv::getTickCount();
+
+        // map the class labels to class indices 0 ... nclasses - 1
+
+        for (int i = 0; i < nsamples; i++)
+        {
+            labels.push_back(cvRound(responses.at<float>(i)));
+        }
+        std::sort(labels.begin(), labels.end());
+        labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+        nclasses = (int) labels.size();
+
+        responses_idx.resize(nsamples);
+        std::vector<int> class_totals(nclasses, 0);
+        for (int i = 0; i < nsamples; i++)
+        {
+            responses_idx[i] = (int) (std::lower_bound(labels.begin(), labels.end(),
+                                      cvRound(responses.at<float>(i))) - labels.begin());
+            class_totals[responses_idx[i]]++;
+        }
+
+        // class weights - as CvDTree, a class with prior p and n training
+        // samples has a total weight of p (so each sample counts p / n)
+
+        class_weights.assign(nclasses, 1.0);
+        if (params.priors)
+        {
+            for (int k = 0; k < nclasses; k++)
+            {
+                class_weights[k] = params.priors[k] / class_totals[k];
+            }
+        }
+
+        // quantize each attribute once
+
+        bins.resize((size_t) nvars * nsamples);
+        bin_ofs.resize(nvars + 1);
+        bin_min.clear();
+        bin_max.clear();
+
+        std::vector< std::pair<float, int> > sorted(nsamples);
+        for (int vi = 0; vi < nvars; vi++)
+        {
+            for (int i = 0; i < nsamples; i++)
+            {
+                sorted[i] = std::make_pair(data.at<float>(i, vi), i);
+            }
+            std::sort(sorted.begin(), sorted.end());
+
+            bin_ofs[vi] = (int) bin_min.size();
+            quantize(sorted, max_bins, &bins[(size_t) vi * nsamples]);
+        }
+        bin_ofs[nvars] = (int) bin_min.size();
+
+        binning_time = (double) (cv::getTickCount() - start) / cv::getTickFrequency();
+
+        // grow the tree depth first from the histogram of the root
+
+        start = cv::getTickCount();
+
+        hist_size = (size_t) bin_ofs[nvars] * (nclasses + 1);
+
+        // cache the histograms of the nodes of depth < cache_depth (at most
+        // 2^cache_depth - 1 of them) within the memory allowed
+
+        size_t hist_bytes = hist_size * sizeof(int);
+        cache_depth = 0;
+        while ((cache_depth < 30)
+                && ((((size_t) 2 << cache_depth) - 1) * hist_bytes <= cache_bytes))
+        {
+            cache_depth++;
+        }
+
+        order.resize(nsamples);
+        for (int i = 0; i < nsamples; i++)
+        {
+            order[i] = i;
+        }
+
+        std::vector<int> hist;
+        acquire_hist(hist);
+        build_hist(0, nsamples, hist);
+        grow(0, nsamples, 0, hist);
+        release_hist(hist);
+
+        pool.clear();
+        std::vector<int>().swap(order);
+
+        growing_time = (double) (cv::getTickCount() - start) / cv::getTickFrequency();
+
+        return true;
+    }
+
+    // update the tree with new training samples (as train(), with the same
+    // attributes and only class labels seen in training) - returns false if
+    // they cannot be added (the tree is then unchanged), the subtrees that
+    // were regrown are listed in rebuilt
+
+    bool update(const cv::Mat& data, const cv::Mat& responses)
+    {
+        if (nodes.empty() || (data.type() != CV_32FC1) || (responses.type() != CV_32FC1)
+                || (data.cols != nvars) || (data.rows != (int) responses.total()))
+        {
+            return false;
+        }
+
+        int n_new = data.rows;
+        std::vector<int> new_idx(n_new);
+        for (int i = 0; i < n_new; i++)
+        {
+            int label = cvRound(responses.at<float>(i));
+            std::vector<int>::const_iterator it =
+                std::lower_bound(labels.begin(), labels.end(), label);
+            if ((it == labels.end()) || (*it != label))
+            {
+                return false; // (a new class - retrain)
+            }
+            new_idx[i] = (int) (it - labels.begin());
+        }
+
+        int64 start = cv::getTickCount();
+        rebuilt.clear();
+
+        // bin the new samples (appended after the existing ones)
+
+        int n_old = nsamples;
+        nsamples += n_new;
+
+        std::vector<uchar> new_bins((size_t) nvars * nsamples);
+        for (int vi = 0; vi < nvars; vi++)
+        {
+            std::copy(&bins[(size_t) vi * n_old], &bins[(size_t) vi * n_old] + n_old,
+                      &new_bins[(size_t) vi * nsamples]);
+            for (int i = 0; i < n_new; i++)
+            {
+                new_bins[(size_t) vi * nsamples + n_old + i] =
+                    (uchar) bin_value(vi, data.at<float>(i, vi));
+            }
+        }
+        bins.swap(new_bins);
+        responses_idx.insert(responses_idx.end(), new_idx.begin(), new_idx.end());
+
+        // update the tree from the root (into a new node list)
+
+        order.resize(nsamples);
+        for (int i = 0; i < nsamples; i++)
+        {
+            order[i] = i;
+        }
+
+        old_nodes.swap(nodes);
+        nodes.clear();
+        max_depth = 0;
+
+        std::vector<int> hist;
+        acquire_hist(hist);
+        if (old_nodes[0].cache >= 0)
+        {
+            hist = cache[old_nodes[0].cache];
+            add_hist(0, nsamples, n_old, hist);
+        }
+        else
+        {
+            build_hist(0, nsamples, hist);
+        }
+        update_node(0, 0, nsamples, n_old, hist);
+        if (!hist.empty())
+        {
+            release_hist(hist);
+        }
+
+        // thresholds (a bin's range may have grown)
+
+        for (size_t n = 0; n < nodes.size(); n++)
+        {
+            if (nodes[n].var >= 0)
+            {
+                nodes[n].c = threshold(nodes[n].var, nodes[n].bin, nodes[n].next);
+            }
+        }
+
+        std::vector<Node>().swap(old_nodes);
+        std::vector<int>().swap(order);
+        pool.clear();
+
+        update_time = (double) (cv::getTickCount() - start) / cv::getTickFrequency();
+
+        return true;
+    }
+
+    void clear()
+    {
+        nodes.clear();
+        cache.clear();
+        free_cache.clear();
+        rebuilt.clear();
+        labels.clear();
+        class_weights.clear();
+        bins.clear();
+        bin_ofs.clear();
+        bin_min.clear();
+        bin_max.clear();
+        responses_idx.clear();
+        pool.clear();
+        nsamples = nvars = nclasses = max_depth = 0;
+    }
+
+    // predict the class label of a single sample (pointer to nvars floats)
+
+    double predict(const float* sample) const
+    {
+        int n = 0;
+        while (nodes[n].var >= 0)
+        {
+            n = (sample[nodes[n].var] <= nodes[n].c) ? nodes[n].left : nodes[n].right;
+        }
+        return nodes[n].value;
+    }
+
+    // save the tree in the CvDTree model format - load it with CvDTree::load()
+
+    bool save(const char* filename, const char* name = "my_tree") const
+    {
+        if (nodes.empty())
+        {
+            return false;
+        }
+
+        CvFileStorage* fs = cvOpenFileStorage(filename, 0, CV_STORAGE_WRITE);
+        if (!fs)
+        {
+            return false;
+        }
+
+        cvStartWriteStruct(fs, name, CV_NODE_MAP, CV_TYPE_NAME_ML_TREE);
+
+        // training data parameters (as CvDTreeTrainData::write_params())
+
+        cvWriteInt(fs, "is_classifier", 1);
+        cvWriteInt(fs, "var_all", nvars);
+        cvWriteInt(fs, "var_count", nvars);
+        cvWriteInt(fs, "ord_var_count", nvars);
+        cvWriteInt(fs, "cat_var_count", 0);
+
+        cvStartWriteStruct(fs, "training_params", CV_NODE_MAP);
+        cvWriteInt(fs, "use_surrogates", 0);
+        cvWriteInt(fs, "max_categories", max_categories);
+        cvWriteInt(fs, "max_depth", tree_max_depth);
+        cvWriteInt(fs, "min_sample_count", min_sample_count);
+        cvWriteInt(fs, "cross_validation_folds", 0);
+        cvEndWriteStruct(fs);
+
+        cvStartWriteStruct(fs, "var_type", CV_NODE_SEQ + CV_NODE_FLOW);
+        for (int vi = 0; vi < nvars; vi++)
+        {
+            cvWriteInt(fs, 0, 0);
+        }
+        cvEndWriteStruct(fs);
+
+        // the class labels are the only categorical "variable"
+
+        int n_classes = nclasses;
+        CvMat cat_count = cvMat(1, 1, CV_32SC1, &n_classes);
+        CvMat cat_map = cvMat(1, nclasses, CV_32SC1, (void*) &labels[0]);
+        cvWrite(fs, "cat_count", &cat_count);
+        cvWrite(fs, "cat_map", &cat_map);
+
+        // the tree itself (no pruning so every node is in the tree)
+
+        cvWriteInt(fs, "best_tree_idx", -1);
+        cvStartWriteStruct(fs, "nodes", CV_NODE_SEQ);
+        write_node(fs, 0);
+        cvEndWriteStruct(fs);
+
+        cvEndWriteStruct(fs);
+        cvReleaseFileStorage(&fs);
+
+        return true;
+    }
+
+    int get_node_count() const { return (int) nodes.size(); }
+    int get_depth() const { return max_depth; }
+    int get_bin_count(int vi) const { return bin_ofs[vi + 1] - bin_ofs[vi]; }
+
+    int get_sample_count() const { return nsamples; }
+    int get_cached_node_count() const { return (int) (cache.size() - free_cache.size()); }
+
+    double binning_time;    // seconds spent quantizing the attributes
+    double growing_time;    // seconds spent growing the tree
+    double update_time;     // seconds spent in the last update()
+
+    std::vector<HistDTreeRebuild> rebuilt; // subtrees regrown by the last update()
+
+private:
+
+    struct Node
+    {
+        int var;            // attribute tested (-1 => leaf)
+        float c;            // value <= c => left
+        float quality;      // split quality (as CvDTreeSplit)
+        int bin, next;      // last bin sent left, first (non-empty) bin sent right
+        int left, right;    // child node indices
+        int depth;
+        int sample_count;
+        int class_idx;      // index of the class label predicted
+        double value;       // class label predicted
+        double risk;        // (weighted) training samples misclassified
+        int cache;          // kept histogram (index in cache, -1 => none)
+    };
+
+    // quantize one attribute given its values in sorted order - writes the
+    // bin index of each sample and adds the (training) range of each bin
+
+    void quantize(const std::vector< std::pair<float, int> >& sorted, int max_bins,
+                  uchar* sample_bins)
+    {
+        int n_distinct = 1;
+        for (int i = 1; i < nsamples; i++)
+        {
+            if (sorted[i].first != sorted[i - 1].first)
+            {
+                n_distinct++;
+            }
+        }
+
+        // close a bin after a run of equal values once it holds its share of
+        // the samples (every run if there are few enough distinct values)
+
+        int bin = 0;
+        bin_min.push_back(sorted[0].first);
+        for (int i = 0; i < nsamples; i++)
+        {
+            if ((i > 0) && (sorted[i].first != sorted[i - 1].first)
+                    && ((n_distinct <= max_bins)
+                        || ((double) i * max_bins >= (double) (bin + 1) * nsamples))
+                    && (bin < max_bins - 1))
+            {
+                bin_max.push_back(sorted[i - 1].first);
+                bin_min.push_back(sorted[i].first);
+                bin++;
+            }
+            sample_bins[sorted[i].second] = (uchar) bin;
+        }
+        bin_max.push_back(sorted[nsamples - 1].first);
+    }
+
+    // bin of a new value of attribute vi (the nearest bin, whose training
+    // range is extended to include it)
+
+    int bin_value(int vi, float v)
+    {
+        int a = 0;
+        int b = get_bin_count(vi) - 1;
+        const float* lo = &bin_min[bin_ofs[vi]];
+        const float* hi = &bin_max[bin_ofs[vi]];
+
+        // first bin whose upper boundary (midway to the next bin) is >= v
+
+        while (a < b)
+        {
+            int m = (a + b) >> 1;
+            if (v <= (hi[m] + lo[m + 1]) * 0.5f)
+            {
+                b = m;
+            }
+            else
+            {
+                a = m + 1;
+            }
+        }
+
+        bin_min[bin_ofs[vi] + a] = std::min(lo[a], v);
+        bin_max[bin_ofs[vi] + a] = std::max(hi[a], v);
+        return a;
+    }
+
+    // split threshold midway between the training values either side of the
+    // split of attribute var after bin (the next non-empty bin being next)
+
+    float threshold(int var, int bin, int next) const
+    {
+        float lo = bin_max[bin_ofs[var] + bin];
+        float hi = bin_min[bin_ofs[var] + next];
+        float c = (lo + hi) * 0.5f;
+        return (c >= hi) ? lo : c;
+    }
+
+    // histogram buffers - each bin holds its sample count then its class
+    // counts, a buffer is only ever returned to the pool fully zeroed
+
+    void acquire_hist(std::vector<int>& hist)
+    {
+        if (pool.empty())
+        {
+            hist.assign(hist_size, 0);
+        }
+        else
+        {
+            hist.swap(pool.back());
+            pool.pop_back();
+        }
+    }
+
+    void release_hist(std::vector<int>& hist)
+    {
+        // zero only the bins in use (far fewer than all of them deep in the tree)
+
+        int stride = nclasses + 1;
+        for (int b = 0; b < bin_ofs[nvars]; b++)
+        {
+            int* h = &hist[(size_t) b * stride];
+            if (h[0])
+            {
+                std::fill(h, h + stride, 0);
+            }
+        }
+        pool.push_back(std::vector<int>());
+        pool.back().swap(hist);
+    }
+
+    // add the samples order[begin ... end - 1] to a histogram
+
+    void build_hist(int begin, int end, std::vector<int>& hist) const
+    {
+        int stride = nclasses + 1;
+        for (int vi = 0; vi < nvars; vi++)
+        {
+            const uchar* b = &bins[(size_t) vi * nsamples];
+            int* h = &hist[(size_t) bin_ofs[vi] * stride];
+            for (int j = begin; j < end; j++)
+            {
+                int i = order[j];
+                int* e = h + b[i] * stride;
+                e[0]++;
+                e[1 + responses_idx[i]]++;
+            }
+        }
+    }
+
+    // add the new samples (index >= first_new) of order[begin ... end - 1]
+    // to a histogram
+
+    void add_hist(int begin, int end, int first_new, std::vector<int>& hist) const
+    {
+        std::vector<int> added;
+        for (int j = begin; j < end; j++)
+        {
+            if (order[j] >= first_new)
+            {
+                added.push_back(order[j]);
+            }
+        }
+        if (added.empty())
+        {
+            return;
+        }
+
+        int stride = nclasses + 1;
+        for (int vi = 0; vi < nvars; vi++)
+        {
+            const uchar* b = &bins[(size_t) vi * nsamples];
+            int* h = &hist[(size_t) bin_ofs[vi] * stride];
+            for (size_t j = 0; j < added.size(); j++)
+            {
+                int* e = h + b[added[j]] * stride;
+                e[0]++;
+                e[1 + responses_idx[added[j]]]++;
+            }
+        }
+    }
+
+    // hist -= sibling (over the bins in use by hist only)
+
+    void subtract_hist(std::vector<int>& hist, const std::vector<int>& sibling) const
+    {
+        int stride = nclasses + 1;
+        for (int b = 0; b < bin_ofs[nvars]; b++)
+        {
+            int* h = &hist[(size_t) b * stride];
+            if (h[0])
+            {
+                const int* s = &sibling[(size_t) b * stride];
+                for (int k = 0; k < stride; k++)
+                {
+                    h[k] -= s[k];
+                }
+            }
+        }
+    }
+
+    // find the best split of a node from its histogram - returns the quality
+    // (0 if there is no split) with the attribute, the last bin sent left and
+    // the first (non-empty) bin sent right
+
+    double find_split(const std::vector<int>& hist, const std::vector<double>& totals,
+                      int& best_var, int& best_bin, int& best_next) const
+    {
+        int stride = nclasses + 1;
+        double best_quality = 0;
+        std::vector<double> lc(nclasses);
+
+        double total_weight = 0, total_sum2 = 0;
+        for (int k = 0; k < nclasses; k++)
+        {
+            total_weight += totals[k];
+            total_sum2 += totals[k] * totals[k];
+        }
+
+        best_var = -1;
+
+        for (int vi = 0; vi < nvars; vi++)
+        {
+            const int* h = &hist[(size_t) bin_ofs[vi] * stride];
+            int n_bins = bin_ofs[vi + 1] - bin_ofs[vi];
+            double L = 0, lsum2 = 0, rsum2 = total_sum2;
+            int prev = -1;
+
+            std::fill(lc.begin(), lc.end(), 0.0);
+
+            for (int b = 0; b < n_bins; b++)
+            {
+                const int* e = h + b * stride;
+                if (!e[0])
+                {
+                    continue;
+                }
+
+                // split between the previous non-empty bin and this one
+                // (Gini: maximise sum(lc^2)/L + sum(rc^2)/R as CvDTree)
+
+                if (prev >= 0)
+                {
+                    double quality = lsum2 / L + rsum2 / (total_weight - L);
+                    if (quality > best_quality)
+                    {
+                        best_quality = quality;
+                        best_var = vi;
+                        best_bin = prev;
+                        best_next = b;
+                    }
+                }
+
+                // move this bin to the left
+
+                for (int k = 0; k < nclasses; k++)
+                {
+                    if (e[1 + k])
+                    {
+                        double w = e[1 + k] * class_weights[k];
+                        double rc = totals[k] - lc[k];
+                        lsum2 += w * (2 * lc[k] + w);
+                        rsum2 -= w * (2 * rc - w);
+                        lc[k] += w;
+                        L += w;
+                    }
+                }
+                prev = b;
+            }
+        }
+
+        return best_quality;
+    }
+
+    // class totals (weighted) of a node from its histogram (that of the
+    // first attribute) - returns the number of classes present
+
+    int node_totals(const std::vector<int>& hist, std::vector<double>& totals) const
+    {
+        int stride = nclasses + 1;
+        totals.assign(nclasses, 0.0);
+        for (int b = bin_ofs[0]; b < bin_ofs[1]; b++)
+        {
+            for (int k = 0; k < nclasses; k++)
+            {
+                totals[k] += hist[(size_t) b * stride + 1 + k];
+            }
+        }
+
+        int n_nonzero = 0;
+        for (int k = 0; k < nclasses; k++)
+        {
+            n_nonzero += (totals[k] > 0);
+            totals[k] *= class_weights[k];
+        }
+        return n_nonzero;
+    }
+
+    // set the prediction of a node from its class totals
+
+    void set_node_value(Node& node, const std::vector<double>& totals) const
+    {
+        int class_idx = 0;
+        double total_weight = 0;
+        for (int k = 0; k < nclasses; k++)
+        {
+            total_weight += totals[k];
+            if (totals[k] > totals[class_idx])
+            {
+                class_idx = k;
+            }
+        }
+
+        node.class_idx = class_idx;
+        node.value = labels[class_idx];
+        node.risk = total_weight - totals[class_idx];
+    }
+
+    // keep a copy of the histogram of a node for update() (if within the
+    // depth cached)
+
+    int cache_hist(int depth, const std::vector<int>& hist)
+    {
+        if (depth >= cache_depth)
+        {
+            return -1;
+        }
+
+        int slot;
+        if (free_cache.empty())
+        {
+            slot = (int) cache.size();
+            cache.push_back(std::vector<int>());
+        }
+        else
+        {
+            slot = free_cache.back();
+            free_cache.pop_back();
+        }
+        cache[slot] = hist;
+        return slot;
+    }
+
+    // grow the sub-tree of the samples order[begin ... end - 1] whose
+    // histogram is hist (left holding the histogram of the larger child)
+
+    int grow(int begin, int end, int depth, std::vector<int>& hist)
+    {
+        int idx = (int) nodes.size();
+        nodes.push_back(Node());
+        max_depth = std::max(max_depth, depth);
+
+        std::vector<double> totals;
+        int n_nonzero = node_totals(hist, totals);
+
+        Node& node = nodes[idx];
+        node.var = -1;
+        node.c = 0;
+        node.quality = 0;
+        node.bin = node.next = 0;
+        node.left = node.right = idx;
+        node.depth = depth;
+        node.sample_count = end - begin;
+        set_node_value(node, totals);
+        node.cache = cache_hist(depth, hist);
+
+        // stop as CvDTree (depth, sample count or a pure node)
+
+        if ((depth >= tree_max_depth) || ((end - begin) <= min_sample_count)
+                || (n_nonzero <= 1))
+        {
+            return idx;
+        }
+
+        int var, bin, next;
+        double quality = find_split(hist, totals, var, bin, next);
+        if (var < 0)
+        {
+            return idx;
+        }
+
+        // threshold midway between the training values either side of the split
+
+        nodes[idx].var = var;
+        nodes[idx].c = threshold(var, bin, next);
+        nodes[idx].quality = (float) quality;
+        nodes[idx].bin = bin;
+        nodes[idx].next = next;
+
+        // partition the samples and derive the child histograms
+
+        const uchar* b = &bins[(size_t) var * nsamples];
+        int mid = begin;
+        for (int j = begin; j < end; j++)
+        {
+            if (b[order[j]] <= bin)
+            {
+                std::swap(order[j], order[mid++]);
+            }
+        }
+
+        bool left_smaller = (mid - begin) <= (end - mid);
+        std::vector<int> small_hist;
+        acquire_hist(small_hist);
+        if (left_smaller)
+        {
+            build_hist(begin, mid, small_hist);
+        }
+        else
+        {
+            build_hist(mid, end, small_hist);
+        }
+        subtract_hist(hist, small_hist);
+
+        // grow the smaller child first (the larger child is then grown in the
+        // histogram of this node so at most log2(samples) are held at once)
+
+        int l, r;
+        if (left_smaller)
+        {
+            l = grow(begin, mid, depth + 1, small_hist);
+            release_hist(small_hist);
+            r = grow(mid, end, depth + 1, hist);
+        }
+        else
+        {
+            r = grow(mid, end, depth + 1, small_hist);
+            release_hist(small_hist);
+            l = grow(begin, mid, depth + 1, hist);
+        }
+
+        nodes[idx].left = l;
+        nodes[idx].right = r;
+
+        return idx;
+    }
+
+    // update the sub-tree of old node n given its samples order[begin ...
+    // end - 1] (those >= first_new being new) and their histogram hist -
+    // returns the index of the node in the new node list
+
+    int update_node(int n, int begin, int end, int first_new, std::vector<int>& hist)
+    {
+        const Node old = old_nodes[n];
+        int depth = old.depth;
+
+        // the split the node would now be given (as grow())
+
+        std::vector<double> totals;
+        int n_nonzero = node_totals(hist, totals);
+
+        int var = -1, bin = 0, next = 0;
+        double quality = 0;
+        if ((depth < tree_max_depth) && ((end - begin) > min_sample_count) && (n_nonzero > 1))
+        {
+            quality = find_split(hist, totals, var, bin, next);
+        }
+
+        // a different split (or a leaf that now splits / a split that no
+        // longer does) - regrow the sub-tree
+
+        if ((var != old.var) || ((var >= 0) && (bin != old.bin)))
+        {
+            HistDTreeRebuild info;
+            info.depth = depth;
+            info.sample_count = end - begin;
+            info.old_var = old.var;
+            info.new_var = var;
+            info.old_nodes = release_subtree(n);
+
+            int first = (int) nodes.size();
+            int idx = grow(begin, end, depth, hist);
+            info.new_nodes = (int) nodes.size() - first;
+            rebuilt.push_back(info);
+            return idx;
+        }
+
+        // same split - update the node and continue down to its children
+
+        int idx = (int) nodes.size();
+        nodes.push_back(old);
+        max_depth = std::max(max_depth, depth);
+
+        Node& node = nodes[idx];
+        node.sample_count = end - begin;
+        set_node_value(node, totals);
+        if (old.cache >= 0)
+        {
+            cache[old.cache] = hist;
+        }
+
+        if (var < 0)
+        {
+            node.left = node.right = idx;
+            return idx;
+        }
+
+        node.quality = (float) quality;
+        node.next = next;
+
+        const uchar* b = &bins[(size_t) var * nsamples];
+        int mid = begin;
+        for (int j = begin; j < end; j++)
+        {
+            if (b[order[j]] <= bin)
+            {
+                std::swap(order[j], order[mid++]);
+            }
+        }
+
+        // the child histograms (the kept ones plus the new samples, otherwise
+        // the smaller child from its samples and the other by subtraction)
+
+        int child[2] = { old.left, old.right };
+        int child_begin[2] = { begin, mid };
+        int child_end[2] = { mid, end };
+        bool reached[2];
+        std::vector<int> child_hist[2];
+
+        for (int k = 0; k < 2; k++)
+        {
+            reached[k] = new_samples(child_begin[k], child_end[k], first_new);
+            int slot = old_nodes[child[k]].cache;
+            if (reached[k] && (slot >= 0))
+            {
+                acquire_hist(child_hist[k]);
+                child_hist[k] = cache[slot];
+                add_hist(child_begin[k], child_end[k], first_new, child_hist[k]);
+            }
+        }
+
+        for (int k = 0; k < 2; k++)
+        {
+            if (!reached[k] || !child_hist[k].empty())
+            {
+                continue;
+            }
+
+            int other = 1 - k;
+            if (child_hist[other].empty())
+            {
+                int slot = old_nodes[child[other]].cache;
+                acquire_hist(child_hist[other]);
+                if (!reached[other] && (slot >= 0))
+                {
+                    child_hist[other] = cache[slot];
+                }
+                else if ((child_end[k] - child_begin[k]) <= (child_end[other] - child_begin[other]))
+                {
+                    child_hist[other].swap(child_hist[k]);
+                    build_hist(child_begin[k], child_end[k], child_hist[k]);
+                    continue;
+                }
+                else
+                {
+                    build_hist(child_begin[other], child_end[other], child_hist[other]);
+                }
+            }
+
+            subtract_hist(hist, child_hist[other]);
+            child_hist[k].swap(hist);
+        }
+
+        // update (or keep) the children
+
+        int l, r;
+        if (reached[0])
+        {
+            l = update_node(old.left, child_begin[0], child_end[0], first_new, child_hist[0]);
+        }
+        else
+        {
+            l = copy_subtree(old.left);
+        }
+        if (reached[1])
+        {
+            r = update_node(old.right, child_begin[1], child_end[1], first_new, child_hist[1]);
+        }
+        else
+        {
+            r = copy_subtree(old.right);
+        }
+
+        for (int k = 0; k < 2; k++)
+        {
+            if (!child_hist[k].empty())
+            {
+                release_hist(child_hist[k]);
+            }
+        }
+
+        nodes[idx].left = l;
+        nodes[idx].right = r;
+
+        return idx;
+    }
+
+    // are any of order[begin ... end - 1] new samples ?
+
+    bool new_samples(int begin, int end, int first_new) const
+    {
+        for (int j = begin; j < end; j++)
+        {
+            if (order[j] >= first_new)
+            {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // copy an unchanged sub-tree of the old node list into the new one
+
+    int copy_subtree(int n)
+    {
+        int idx = (int) nodes.size();
+        nodes.push_back(old_nodes[n]);
+        max_depth = std::max(max_depth, old_nodes[n].depth);
+
+        if (old_nodes[n].var >= 0)
+        {
+            int l = copy_subtree(old_nodes[n].left);
+            int r = copy_subtree(old_nodes[n].right);
+            nodes[idx].left = l;
+            nodes[idx].right = r;
+        }
+        else
+        {
+            nodes[idx].left = nodes[idx].right = idx;
+        }
+        return idx;
+    }
+
+    // free the kept histograms of an old sub-tree - returns its node count
+
+    int release_subtree(int n)
+    {
+        if (old_nodes[n].cache >= 0)
+        {
+            std::vector<int>().swap(cache[old_nodes[n].cache]);
+            free_cache.push_back(old_nodes[n].cache);
+        }
+        if (old_nodes[n].var < 0)
+        {
+            return 1;
+        }
+        return 1 + release_subtree(old_nodes[n].left) + release_subtree(old_nodes[n].right);
+    }
+
+    // write a node and its sub-tree (depth first, left first, as CvDTree)
+
+    void write_node(CvFileStorage* fs, int n) const
+    {
+        const Node& node = nodes[n];
+
+        cvStartWriteStruct(fs, 0, CV_NODE_MAP);
+        cvWriteInt(fs, "depth", node.depth);
+        cvWriteInt(fs, "sample_count", node.sample_count);
+        cvWriteReal(fs, "value", node.value);
+        cvWriteInt(fs, "norm_class_idx", node.class_idx);
+        cvWriteInt(fs, "Tn", 0);
+        cvWriteInt(fs, "complexity", 0);
+        cvWriteReal(fs, "alpha", 0);
+        cvWriteReal(fs, "node_risk", node.risk);
+        cvWriteReal(fs, "tree_risk", 0);
+        cvWriteReal(fs, "tree_error", 0);
+
+        if (node.var >= 0)
+        {
+            cvStartWriteStruct(fs, "splits", CV_NODE_SEQ);
+            cvStartWriteStruct(fs, 0, CV_NODE_MAP + CV_NODE_FLOW);
+            cvWriteInt(fs, "var", node.var);
+            cvWriteReal(fs, "quality", node.quality);
+            cvWriteReal(fs, "le", node.c);
+            cvEndWriteStruct(fs);
+            cvEndWriteStruct(fs);
+        }
+        cvEndWriteStruct(fs);
+
+        if (node.var >= 0)
+        {
+            write_node(fs, node.left);
+            write_node(fs, node.right);
+        }
+    }
+
+    int nsamples, nvars, nclasses;
+    int tree_max_depth, min_sample_count, max_categories;
+    int max_depth;
+    int cache_depth;                    // histograms kept for depth < cache_depth
+
+    std::vector<Node> nodes;            // node 0 is the root
+
+    std::vector<int> labels;            // class label of each class index
+    std::vector<double> class_weights;  // weight of a sample of each class
+
+    // quantized training data
+
+    std::vector<uchar> bins;            // bin of each sample (per attribute)
+    std::vector<int> bin_ofs;           // first bin of each attribute
+    std::vector<float> bin_min;         // smallest training value in each bin
+    std::vector<float> bin_max;         // largest training value in each bin
+    std::vector<int> responses_idx;     // class index of each sample
+
+    // training work space
+
+    std::vector<int> order;             // samples, partitioned by node
+    size_t hist_size;
+    std::vector< std::vector<int> > pool;
+
+    // histograms kept for update() (and the free entries) and the node list
+    // being updated
+
+    std::vector< std::vector<int> > cache;
+    std::vector<int> free_cache;
+    std::vector<Node> old_nodes;
+};
+
+/******************************************************************************/
+
+#endif
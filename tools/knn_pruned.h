@@ -0,0 +1,439 @@
+// Support : exact k-nearest neighbour search with early abandoning partial
+// distances and LAESA style pivot (triangle inequality) pruning
+
+// Gives identical neighbours, distances and class results to a brute force
+// CvKNearest::find_nearest() search over the same training data, but rejects
+// most of the training samples before their full distance is computed:
+//
+// - the dimensions are visited in order of decreasing variance so that the
+//   partial (squared) distance of a poor candidate grows past the current k-th
+//   best distance as early as possible and its accumulation is abandoned.
+//
+// - the distance from every training sample to a small set of pivot samples
+//   is precomputed (LAESA, Mico et al. 1994), |d(q,p) - d(x,p)| <= d(q,x)
+//   then gives a lower bound on each candidate distance without touching the
+//   candidate itself. Candidates are visited in order of this bound and the
+//   search stops as soon as the bound exceeds the current k-th best.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#ifndef KNN_PRUNED_H
+#define KNN_PRUNED_H
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+
+/******************************************************************************/
+
+// relative safety margin used when rejecting a candidate on a bound - the
+// bounds are accumulated in a different order to the brute force distance
+// so we only ever reject when we are sure the exact distance is larger
+
+#define KNN_PRUNE_MARGIN 1e-5
+
+// number of dimensions accumulated between each early abandoning check
+
+#define KNN_ABANDON_BLOCK 8
+
+/******************************************************************************/
+
+class PrunedKNearest
+{
+public:
+
+    PrunedKNearest() : nsamples(0), nvars(0), npivots(0) { reset_stats(); }
+
+    // train (i.e. index) the training data
+    // training_data = attributes (1 sample per row, CV_32F)
+    // responses = classes (1 sample per row, CV_32F)
+    // n_pivots = number of LAESA pivots (0 = early abandoning only)
+
+    bool train(const cv::Mat& training_data, const cv::Mat& responses,
+               int n_pivots = 16)
+    {
+        if ((training_data.type() != CV_32FC1) || (responses.type() != CV_32FC1)
+                || (training_data.rows != (int) responses.total()))
+        {
+            return false;
+        }
+
+        nsamples = training_data.rows;
+        nvars = training_data.cols;
+        npivots = std::min(std::max(n_pivots, 0), nsamples);
+
+        data = training_data.clone();
+        labels.resize(nsamples);
+        for (int i = 0; i < nsamples; i++)
+        {
+            labels[i] = responses.at<float>(i);
+        }
+
+        // order the dimensions by decreasing variance
+
+        std::vector< std::pair<double, int> > var_order(nvars);
+        for (int j = 0; j < nvars; j++)
+        {
+            double s = 0, s2 = 0;
+            for (int i = 0; i < nsamples; i++)
+            {
+                double v = data.at<float>(i, j);
+                s += v;
+                s2 += v * v;
+            }
+            double mean = s / nsamples;
+            var_order[j] = std::make_pair(-((s2 / nsamples) - (mean * mean)), j);
+        }
+        std::stable_sort(var_order.begin(), var_order.end());
+
+        dim_order.resize(nvars);
+        for (int j = 0; j < nvars; j++)
+        {
+            dim_order[j] = var_order[j].second;
+        }
+
+        // keep a copy of the data with the columns permuted into this order
+
+        reordered.create(nsamples, nvars, CV_32F);
+        for (int i = 0; i < nsamples; i++)
+        {
+            const float* src = data.ptr<float>(i);
+            float* dst = reordered.ptr<float>(i);
+            for (int j = 0; j < nvars; j++)
+            {
+                dst[j] = src[dim_order[j]];
+            }
+        }
+
+        // select pivots by farthest first traversal (max-min distance) starting
+        // from the first sample and record the distance of every sample to each
+
+        pivots.clear();
+        pivot_dist.create(nsamples, std::max(npivots, 1), CV_64F);
+        std::vector<double> min_dist(nsamples, DBL_MAX);
+        int next = 0;
+
+        for (int p = 0; p < npivots; p++)
+        {
+            pivots.push_back(next);
+            const float* v = data.ptr<float>(next);
+            double farthest = -1;
+
+            for (int i = 0; i < nsamples; i++)
+            {
+                double d = sqrt(sq_distance(data.ptr<float>(i), v));
+                pivot_dist.at<double>(i, p) = d;
+                min_dist[i] = std::min(min_dist[i], d);
+                if (min_dist[i] > farthest)
+                {
+                    farthest = min_dist[i];
+                    next = i;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    // find the k nearest neighbours of a single sample (1 x nvars, CV_32F)
+    // returns the class result exactly as CvKNearest::find_nearest() would and
+    // optionally the neighbour responses and (squared) distances (1 x k)
+
+    float find_nearest(const cv::Mat& sample, int k,
+                       cv::Mat* neighbor_responses = 0, cv::Mat* dists = 0)
+    {
+        const float* u = sample.ptr<float>(0);
+        k = std::min(k, nsamples);
+
+        // permute the query into the variance order
+
+        std::vector<float> u_ordered(nvars);
+        for (int j = 0; j < nvars; j++)
+        {
+            u_ordered[j] = u[dim_order[j]];
+        }
+
+        // distance to each pivot and from that the lower bound on every
+        // candidate distance, candidates are then visited best bound first
+
+        std::vector<double> q_pivot(npivots);
+        for (int p = 0; p < npivots; p++)
+        {
+            q_pivot[p] = sqrt(sq_distance(u, data.ptr<float>(pivots[p])));
+        }
+        terms_computed += (int64) npivots * nvars;
+
+        candidates.resize(nsamples);
+        for (int i = 0; i < nsamples; i++)
+        {
+            const double* pd = pivot_dist.ptr<double>(i);
+            double lb = 0;
+            for (int p = 0; p < npivots; p++)
+            {
+                lb = std::max(lb, fabs(q_pivot[p] - pd[p]));
+            }
+            candidates[i] = std::make_pair(lb * lb, i);
+        }
+        terms_computed += (int64) nsamples * npivots;
+
+        if (npivots > 0)
+        {
+            std::sort(candidates.begin(), candidates.end());
+        }
+
+        // the k best exact distances found so far (ascending) and every
+        // candidate for which the exact distance was computed
+
+        std::vector<float> best;
+        survivors.clear();
+
+        for (int c = 0; c < nsamples; c++)
+        {
+            int i = candidates[c].second;
+            bool full = ((int) best.size() == k);
+            double bound = full ? (best[k - 1] * (1 + KNN_PRUNE_MARGIN)) : DBL_MAX;
+
+            // pivot bound - as candidates are sorted on it no remaining one
+            // can be any closer either
+
+            if (candidates[c].first > bound)
+            {
+                skipped_pivot += (nsamples - c);
+                break;
+            }
+
+            // early abandoning partial distance in variance order
+
+            const float* v = reordered.ptr<float>(i);
+            double partial = 0;
+            int t = 0;
+            bool abandoned = false;
+
+            while (t < nvars)
+            {
+                int t_end = std::min(t + KNN_ABANDON_BLOCK, nvars);
+                for (; t < t_end; t++)
+                {
+                    double diff = u_ordered[t] - v[t];
+                    partial += diff * diff;
+                }
+                if (partial > bound)
+                {
+                    abandoned = true;
+                    break;
+                }
+            }
+            terms_computed += t;
+
+            if (abandoned)
+            {
+                skipped_abandon++;
+                continue;
+            }
+
+            // full candidate - recompute its distance exactly as CvKNearest
+            // does (same summation order) so ties resolve identically
+
+            float d = exact_distance(u, data.ptr<float>(i));
+            terms_computed += nvars;
+            survivors.push_back(std::make_pair(i, d));
+
+            std::vector<float>::iterator pos =
+                std::upper_bound(best.begin(), best.end(), d);
+            best.insert(pos, d);
+            if ((int) best.size() > k)
+            {
+                best.pop_back();
+            }
+        }
+
+        terms_bruteforce += (int64) nsamples * nvars;
+        queries++;
+
+        // replay the surviving candidates no further than the final k-th
+        // distance in training order through the CvKNearest insertion rule,
+        // which gives the same neighbour list (and tie breaking) as brute force
+
+        float kth = best.empty() ? 0 : best.back();
+        std::sort(survivors.begin(), survivors.end());
+
+        std::vector<float> nn_dist(k), nn_resp(k);
+        int k1 = 0;
+
+        for (size_t s = 0; s < survivors.size(); s++)
+        {
+            if (survivors[s].second > kth)
+            {
+                continue;
+            }
+            insert_neighbour(survivors[s].second, labels[survivors[s].first],
+                             &nn_dist[0], &nn_resp[0], k, k1);
+        }
+
+        if (neighbor_responses)
+        {
+            neighbor_responses->create(1, k, CV_32F);
+            for (int j = 0; j < k; j++)
+            {
+                neighbor_responses->at<float>(0, j) = nn_resp[j];
+            }
+        }
+        if (dists)
+        {
+            dists->create(1, k, CV_32F);
+            for (int j = 0; j < k; j++)
+            {
+                dists->at<float>(0, j) = nn_dist[j];
+            }
+        }
+
+        return vote(&nn_resp[0], k1);
+    }
+
+    // fraction of the (subtract, square, add) distance terms of a brute force
+    // search that were not computed - pivot and bound overheads are included
+
+    double fraction_avoided() const
+    {
+        if (terms_bruteforce == 0)
+        {
+            return 0;
+        }
+        return 1.0 - ((double) terms_computed / (double) terms_bruteforce);
+    }
+
+    void reset_stats()
+    {
+        terms_computed = terms_bruteforce = 0;
+        skipped_pivot = skipped_abandon = queries = 0;
+    }
+
+    int get_pivot_count() const { return npivots; }
+
+    int64 terms_computed;   // distance terms actually computed
+    int64 terms_bruteforce; // distance terms a brute force search computes
+    int64 skipped_pivot;    // candidates rejected on the pivot bound alone
+    int64 skipped_abandon;  // candidates whose accumulation was abandoned
+    int64 queries;
+
+private:
+
+    // squared distance computed exactly as CvKNearest::find_neighbors_direct()
+    // (blocks of 4 terms summed in double, result rounded to float)
+
+    float exact_distance(const float* u, const float* v) const
+    {
+        return (float) sq_distance(u, v);
+    }
+
+    double sq_distance(const float* u, const float* v) const
+    {
+        double sum = 0;
+        int t;
+
+        for (t = 0; t <= nvars - 4; t += 4)
+        {
+            double t0 = u[t] - v[t], t1 = u[t+1] - v[t+1];
+            double t2 = u[t+2] - v[t+2], t3 = u[t+3] - v[t+3];
+            sum += t0*t0 + t1*t1 + t2*t2 + t3*t3;
+        }
+
+        for (; t < nvars; t++)
+        {
+            double t0 = u[t] - v[t];
+            sum += t0*t0;
+        }
+
+        return sum;
+    }
+
+    // insert a neighbour into the sorted list (length k1 <= k) using the
+    // comparison rule of CvKNearest (on the integer image of the float)
+
+    static void insert_neighbour(float d, float r, float* dd, float* nr,
+                                 int k, int& k1)
+    {
+        Cv32suf si, di;
+        int ii;
+        si.f = d;
+
+        for (ii = k1 - 1; ii >= 0; ii--)
+        {
+            di.f = dd[ii];
+            if (si.i > di.i)
+            {
+                break;
+            }
+        }
+        if (ii >= k - 1)
+        {
+            return;
+        }
+
+        int k2 = std::min(k1, k - 1);
+        for (int ii1 = k2 - 1; ii1 > ii; ii1--)
+        {
+            dd[ii1 + 1] = dd[ii1];
+            nr[ii1 + 1] = nr[ii1];
+        }
+        dd[ii + 1] = d;
+        nr[ii + 1] = r;
+        k1 = std::min(k1 + 1, k);
+    }
+
+    // majority vote over the neighbour responses (ties to the smallest class)
+    // as per CvKNearest::write_results()
+
+    static float vote(const float* nr, int k1)
+    {
+        std::vector<int> sorted(k1);
+        for (int j = 0; j < k1; j++)
+        {
+            Cv32suf r;
+            r.f = nr[j];
+            sorted[j] = r.i;
+        }
+        std::sort(sorted.begin(), sorted.end());
+
+        int prev_start = 0, best_count = 0;
+        Cv32suf best_val;
+        best_val.i = 0;
+
+        for (int j = 1; j <= k1; j++)
+        {
+            if ((j == k1) || (sorted[j] != sorted[j - 1]))
+            {
+                if (best_count < (j - prev_start))
+                {
+                    best_count = j - prev_start;
+                    best_val.i = sorted[j - 1];
+                }
+                prev_start = j;
+            }
+        }
+
+        return best_val.f;
+    }
+
+    int nsamples, nvars, npivots;
+    cv::Mat data;                   // training samples (original order)
+    cv::Mat reordered;              // training samples (variance order)
+    cv::Mat pivot_dist;             // distance of each sample to each pivot
+    std::vector<float> labels;
+    std::vector<int> dim_order;
+    std::vector<int> pivots;
+
+    // per query work space
+
+    std::vector< std::pair<double, int> > candidates;
+    std::vector< std::pair<int, float> > survivors;
+};
+
+/******************************************************************************/
+
+#endif
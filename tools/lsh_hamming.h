@@ -0,0 +1,305 @@
+// Support : bit sampling locality sensitive hashing (LSH) index for binary
+// feature vectors (e.g. the 16x16 binary semeion digits in handwritten_ex)
+
+// Each of the L hash tables keys a sample on K of its bits chosen at random
+// (Indyk & Motwani 1998) - samples close in Hamming distance share keys with
+// high probability. A query gathers the samples in its bucket from every
+// table (plus, for multi-probe, the buckets whose key differs from its own in
+// one or two bits, Lv et al. 2007) and re-ranks only those candidates by their
+// exact Hamming distance.
+
+// The tables are stored as sorted (key, sample) arrays searched by bisection
+// rather than as hash maps - compact, cache friendly and build once.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#ifndef LSH_HAMMING_H
+#define LSH_HAMMING_H
+
+#include <cv.h>       // opencv general include file
+
+#include <vector>
+#include <algorithm>
+
+/******************************************************************************/
+
+// number of set bits in a 64-bit word
+
+static inline int popcount64(uint64 x)
+{
+#if defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int) ((x * 0x0101010101010101ULL) >> 56);
+#endif
+}
+
+/******************************************************************************/
+
+class HammingLSH
+{
+public:
+
+    HammingLSH() : nsamples(0), nvars(0), nwords(0), ntables(0), key_bits(0),
+        probe_radius(0) { reset_stats(); }
+
+    // build the index over the training data
+    // data = binary attributes (1 sample per row, CV_32F, value != 0 => bit set)
+    // n_tables = number of hash tables (L)
+    // n_key_bits = bits sampled into each key (K <= 64)
+    // seed = seed for the choice of sampled bits
+
+    bool train(const cv::Mat& data, int n_tables, int n_key_bits,
+               uint64 seed = 0x12345678)
+    {
+        if ((data.type() != CV_32FC1) || (n_tables < 1) || (n_key_bits < 1)
+                || (n_key_bits > 64) || (n_key_bits > data.cols))
+        {
+            return false;
+        }
+
+        nsamples = data.rows;
+        nvars = data.cols;
+        nwords = (nvars + 63) / 64;
+        ntables = n_tables;
+        key_bits = n_key_bits;
+
+        // pack each sample into 64-bit words
+
+        codes.assign((size_t) nsamples * nwords, 0);
+        for (int i = 0; i < nsamples; i++)
+        {
+            pack(data.ptr<float>(i), &codes[(size_t) i * nwords]);
+        }
+
+        // draw K distinct bit positions for each table (partial Fisher-Yates)
+
+        cv::RNG rng(seed);
+        std::vector<int> all_bits(nvars);
+        sampled_bits.resize((size_t) ntables * key_bits);
+
+        for (int l = 0; l < ntables; l++)
+        {
+            for (int b = 0; b < nvars; b++)
+            {
+                all_bits[b] = b;
+            }
+            for (int b = 0; b < key_bits; b++)
+            {
+                int j = b + rng.uniform(0, nvars - b);
+                std::swap(all_bits[b], all_bits[j]);
+                sampled_bits[(size_t) l * key_bits + b] = all_bits[b];
+            }
+        }
+
+        // fill and sort each table
+
+        tables.resize(ntables);
+        for (int l = 0; l < ntables; l++)
+        {
+            tables[l].resize(nsamples);
+            for (int i = 0; i < nsamples; i++)
+            {
+                tables[l][i] = std::make_pair(key(l, &codes[(size_t) i * nwords]), i);
+            }
+            std::sort(tables[l].begin(), tables[l].end());
+        }
+
+        visited.assign(nsamples, 0);
+        stamp = 0;
+
+        return true;
+    }
+
+    // multi-probe radius - 0 = own bucket only, 1 = also all buckets at key
+    // Hamming distance 1 (K extra probes per table), 2 = also distance 2
+
+    void set_probe_radius(int radius) { probe_radius = std::max(0, std::min(radius, 2)); }
+
+    // find (approximate) k nearest neighbours of a single binary sample
+    // (1 x nvars, CV_32F) - returns the number found (<= k) with their sample
+    // indices and Hamming distances in ascending order of distance
+
+    int find_nearest(const cv::Mat& sample, int k,
+                     std::vector<int>& indices, std::vector<int>& dists)
+    {
+        std::vector<uint64> q(nwords);
+        pack(sample.ptr<float>(0), &q[0]);
+
+        // new visit stamp (clear the marks on wrap around)
+
+        if (++stamp == 0)
+        {
+            std::fill(visited.begin(), visited.end(), 0);
+            stamp = 1;
+        }
+
+        // gather the candidates from the probed buckets of every table and
+        // re-rank them on exact Hamming distance
+
+        ranked.clear();
+
+        for (int l = 0; l < ntables; l++)
+        {
+            uint64 qkey = key(l, &q[0]);
+            probe(l, qkey, &q[0]);
+
+            if (probe_radius >= 1)
+            {
+                for (int b1 = 0; b1 < key_bits; b1++)
+                {
+                    uint64 k1 = qkey ^ (((uint64) 1) << b1);
+                    probe(l, k1, &q[0]);
+
+                    if (probe_radius >= 2)
+                    {
+                        for (int b2 = b1 + 1; b2 < key_bits; b2++)
+                        {
+                            probe(l, k1 ^ (((uint64) 1) << b2), &q[0]);
+                        }
+                    }
+                }
+            }
+        }
+
+        int found = std::min(k, (int) ranked.size());
+        std::partial_sort(ranked.begin(), ranked.begin() + found, ranked.end());
+
+        indices.resize(found);
+        dists.resize(found);
+        for (int j = 0; j < found; j++)
+        {
+            dists[j] = ranked[j].first;
+            indices[j] = ranked[j].second;
+        }
+
+        queries++;
+        return found;
+    }
+
+    // exhaustive (exact) Hamming k nearest neighbours for comparison
+
+    int find_nearest_exhaustive(const cv::Mat& sample, int k,
+                                std::vector<int>& indices, std::vector<int>& dists)
+    {
+        std::vector<uint64> q(nwords);
+        pack(sample.ptr<float>(0), &q[0]);
+
+        ranked.resize(nsamples);
+        for (int i = 0; i < nsamples; i++)
+        {
+            ranked[i] = std::make_pair(hamming(&q[0], &codes[(size_t) i * nwords]), i);
+        }
+
+        int found = std::min(k, nsamples);
+        std::partial_sort(ranked.begin(), ranked.begin() + found, ranked.end());
+
+        indices.resize(found);
+        dists.resize(found);
+        for (int j = 0; j < found; j++)
+        {
+            dists[j] = ranked[j].first;
+            indices[j] = ranked[j].second;
+        }
+
+        return found;
+    }
+
+    // average number of candidates re-ranked per query
+
+    double average_candidates() const
+    {
+        return queries ? ((double) candidates / queries) : 0;
+    }
+
+    void reset_stats() { candidates = queries = 0; }
+
+    int get_sample_count() const { return nsamples; }
+
+    int64 candidates;   // total candidates re-ranked
+    int64 queries;      // total queries made
+
+private:
+
+    // pack a binary float vector into 64-bit words
+
+    void pack(const float* v, uint64* words) const
+    {
+        for (int w = 0; w < nwords; w++)
+        {
+            words[w] = 0;
+        }
+        for (int b = 0; b < nvars; b++)
+        {
+            if (v[b] != 0)
+            {
+                words[b >> 6] |= ((uint64) 1) << (b & 63);
+            }
+        }
+    }
+
+    // key of a packed sample in table l
+
+    uint64 key(int l, const uint64* words) const
+    {
+        const int* bits = &sampled_bits[(size_t) l * key_bits];
+        uint64 k = 0;
+        for (int b = 0; b < key_bits; b++)
+        {
+            k |= ((words[bits[b] >> 6] >> (bits[b] & 63)) & 1) << b;
+        }
+        return k;
+    }
+
+    int hamming(const uint64* a, const uint64* b) const
+    {
+        int d = 0;
+        for (int w = 0; w < nwords; w++)
+        {
+            d += popcount64(a[w] ^ b[w]);
+        }
+        return d;
+    }
+
+    // add the (not yet visited) samples of bucket k in table l as candidates
+
+    void probe(int l, uint64 k, const uint64* q)
+    {
+        std::vector< std::pair<uint64, int> >& table = tables[l];
+        std::vector< std::pair<uint64, int> >::const_iterator it =
+            std::lower_bound(table.begin(), table.end(), std::make_pair(k, -1));
+
+        for (; (it != table.end()) && (it->first == k); ++it)
+        {
+            int i = it->second;
+            if (visited[i] != stamp)
+            {
+                visited[i] = stamp;
+                ranked.push_back(std::make_pair(hamming(q, &codes[(size_t) i * nwords]), i));
+                candidates++;
+            }
+        }
+    }
+
+    int nsamples, nvars, nwords;
+    int ntables, key_bits, probe_radius;
+
+    std::vector<uint64> codes;          // packed samples (nwords per sample)
+    std::vector<int> sampled_bits;      // K bit positions per table
+    std::vector< std::vector< std::pair<uint64, int> > > tables;
+
+    // per query work space
+
+    std::vector<unsigned> visited;
+    unsigned stamp;
+    std::vector< std::pair<int, int> > ranked;
+};
+
+/******************************************************************************/
+
+#endif
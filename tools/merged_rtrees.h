@@ -0,0 +1,237 @@
+// Support : random forest (CvRTrees) merged from forests trained separately
+
+// A random forest's trees are independent, so a large forest can be trained
+// as several smaller ones - by separate processes, on one machine or many,
+// each growing its own range of the trees (ParallelRTrees::first_tree, see
+// rf_shard.cc) on all of the training data or on a shard of it - and then
+// merged. MergedRTrees loads the saved part forests and takes all of their
+// trees, in order, as one CvRTrees which is saved in, and predicts as, the
+// usual format (CvRTrees::load() reads it back).
+//
+// The trees of another saved forest can also be added to a merged forest
+// (add()), e.g. trees grown later for the same problem (rf_grow.cc).
+//
+// The parts must agree on the attributes and on the class labels (each
+// class's index in the forest, which CvRTrees::predict() votes by) - a part
+// trained on a shard of the data missing a class cannot be merged. The
+// variable importance of the merged forest (if every part has one) is the
+// mean of the parts', weighted by their number of trees, and its out of bag
+// error is the same weighted mean of the parts' (an estimate - the out of bag
+// error of the merged forest itself is not known).
+//
+// The part files of a sharded training are named by part_filename(), each
+// written under a temporary name then renamed so that a reader (rf_merge.cc)
+// sees only complete files - plain files being the only coordination between
+// the processes (so it also works across machines on a shared filesystem).
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#ifndef MERGED_RTREES_H
+#define MERGED_RTREES_H
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+#include <vector>
+#include <string>
+#include <stdio.h>
+#include <string.h>
+
+/******************************************************************************/
+
+class MergedRTrees : public CvRTrees
+{
+public:
+
+    MergedRTrees() {}
+
+    virtual ~MergedRTrees()
+    {
+        clear();
+    }
+
+    // the name of part (worker) k of n written to directory dir
+
+    static std::string part_filename(const char* dir, int k, int n)
+    {
+        char name[64];
+        sprintf(name, "/forest_part_%d_of_%d.yml", k, n);
+        return std::string(dir) + name;
+    }
+
+    // merge the forests saved in the given files (in order) - returns false,
+    // printing the reason, if one cannot be read or they do not agree
+
+    bool merge(const std::vector<std::string>& filenames)
+    {
+        clear();
+
+        for (size_t p = 0; p < filenames.size(); p++)
+        {
+            if (!add(filenames[p]))
+            {
+                clear();
+                return false;
+            }
+        }
+
+        return !parts.empty();
+    }
+
+    // add the trees of the forest saved in a file after those of this forest
+    // (e.g. more trees grown for a saved forest, see rf_grow.cc) - returns
+    // false, printing the reason, if it cannot be read or does not agree
+    // (this forest is then unchanged)
+
+    bool add(const std::string& filename)
+    {
+        FILE* f = fopen(filename.c_str(), "r");
+        if (!f)
+        {
+            printf("ERROR: cannot read file %s\n", filename.c_str());
+            return false;
+        }
+        fclose(f);
+
+        MergedRTrees* part = new MergedRTrees;
+        part->load(filename.c_str());
+
+        if ((part->get_tree_count() < 1) || (!parts.empty() && !agrees(part)))
+        {
+            printf("ERROR: %s is not a forest of the attributes and classes of the forest merged\n",
+                   filename.c_str());
+            delete part;
+            return false;
+        }
+        parts.push_back(part);
+
+        // this forest takes the trees, and from the first part the training
+        // data parameters and the active variable mask (the parts, with their
+        // training data holding the nodes of the trees, are kept until it is
+        // cleared)
+
+        if (parts.size() == 1)
+        {
+            data = part->data;
+            part->data = 0;
+            active_var_mask = part->active_var_mask;
+            part->active_var_mask = 0;
+            nclasses = part->nclasses;
+            nsamples = part->nsamples;
+            oob_error = 0;
+        }
+
+        int total = ntrees + part->ntrees;
+        CvForestTree** all_trees = (CvForestTree**) cvAlloc(sizeof(trees[0]) * total);
+        for (int k = 0; k < ntrees; k++)
+        {
+            all_trees[k] = trees[k];
+        }
+        for (int k = 0; k < part->ntrees; k++)
+        {
+            all_trees[ntrees + k] = part->trees[k];
+        }
+
+        // the (tree weighted) out of bag error and variable importance (if
+        // every part has one)
+
+        double weight = (double) part->ntrees / total;
+        oob_error = oob_error * (1 - weight) + part->oob_error * weight;
+
+        if (parts.size() == 1)
+        {
+            var_importance = part->var_importance ? cvCloneMat(part->var_importance) : 0;
+        }
+        else if (var_importance && part->var_importance)
+        {
+            for (int vi = 0; vi < var_importance->cols; vi++)
+            {
+                cvSetReal1D(var_importance, vi, (1 - weight) * cvGetReal1D(var_importance, vi)
+                            + weight * cvGetReal1D(part->var_importance, vi));
+            }
+        }
+        else
+        {
+            cvReleaseMat(&var_importance);
+        }
+
+        if (trees)
+        {
+            cvFree(&trees);
+        }
+        trees = all_trees;
+        ntrees = total;
+
+        cvFree(&part->trees);
+        part->ntrees = 0;
+
+        return true;
+    }
+
+    // as CvRTrees::clear() also releasing the parts (after the trees, whose
+    // nodes their training data hold)
+
+    virtual void clear()
+    {
+        CvRTrees::clear();
+        for (size_t p = 0; p < parts.size(); p++)
+        {
+            delete parts[p];
+        }
+        parts.clear();
+    }
+
+    int get_part_count() const { return (int) parts.size(); }
+
+    // the (estimated) out of bag error
+
+    double get_oob_error() const { return oob_error; }
+
+private:
+
+    // whether a part has the attributes and classes of this forest (the
+    // same categories, and so class indices, for every categorical variable)
+    // - its training data parameters being those taken from the first part
+
+    bool agrees(const MergedRTrees* part) const
+    {
+        const CvDTreeTrainData* d0 = data;
+        const CvDTreeTrainData* d = part->data;
+
+        if (!d0 || !d)
+        {
+            return false;
+        }
+
+        if ((d->var_all != d0->var_all) || (d->var_count != d0->var_count)
+                || (d->is_classifier != d0->is_classifier)
+                || (part->nclasses != nclasses)
+                || (d->cat_var_count != d0->cat_var_count))
+        {
+            return false;
+        }
+
+        return same_mat(d->var_idx, d0->var_idx) && same_mat(d->var_type, d0->var_type)
+               && same_mat(d->cat_count, d0->cat_count) && same_mat(d->cat_map, d0->cat_map);
+    }
+
+    static bool same_mat(const CvMat* a, const CvMat* b)
+    {
+        if (!a || !b)
+        {
+            return !a && !b;
+        }
+        return (a->rows == b->rows) && (a->cols == b->cols)
+               && (CV_MAT_TYPE(a->type) == CV_MAT_TYPE(b->type))
+               && !memcmp(a->data.ptr, b->data.ptr,
+                          (size_t) a->rows * a->cols * CV_ELEM_SIZE(a->type));
+    }
+
+    std::vector<MergedRTrees*> parts; // the loaded part forests
+};
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,876 @@
+// Support : multiclass boosted trees (SAMME / SAMME.R) on pre-binned features
+
+// CvBoost only trains 2-class problems, so a problem of K classes has to be
+// "unrolled" into K times as many samples (each with an extra attribute
+// holding a candidate class and a yes / no response, see
+// opticaldigits_ex/boosttree.cpp) and each prediction made K times. The
+// multiclass extensions of AdaBoost by Zhu et al. ("Multi-class AdaBoost",
+// 2009) need neither: every boosting round grows one K-class tree on the
+// original samples.
+//
+// - SAMME (CvBoost::DISCRETE) : each tree votes for the class of the leaf
+//   reached with weight alpha = log((1 - err) / err) + log(K - 1), where err
+//   is its weighted training error, and the weights of the samples it
+//   misclassifies are multiplied by exp(alpha)
+//
+// - SAMME.R (CvBoost::REAL) : each leaf holds the (weighted) class
+//   probabilities p_k of its training samples and the tree adds
+//   (K - 1) * (log p_k - mean_j log p_j) to the score of each class k, the
+//   weight of each sample being multiplied by
+//   exp(-(K - 1) / K * sum_k y_k log p_k) (y_k = 1 for its class and
+//   -1 / (K - 1) otherwise) - the probabilities are floored at
+//   MULTICLASS_BOOST_MIN_PROB, bounding the scores of leaves grown from a
+//   few samples of high weight
+//
+// A sample is predicted as the class of the highest summed score over the
+// trees - one tree traversal per boosting round, whatever the number of
+// classes. The trees are grown depth first on the weighted samples (Gini
+// impurity, as CvDTree) from histograms of the attributes, each quantized once
+// into at most 256 bins as hist_dtree.h, so the training data is held as 8-bit
+// bin indices. As CvBoost, the samples of least weight are left out of each
+// round (weight_trim_rate) and the class priors set the initial weights. All
+// attributes are treated as ordered (CV_VAR_NUMERICAL) and none may be
+// missing.
+//
+// The 2-class problem of the unrolled data can also be boosted (e.g. as a
+// faster, drop-in equivalent of the CvBoost of boosttree.cpp) from an
+// UnrolledData view (unrolled_data.h) without building the unrolled data:
+// the original attributes are binned once (quantizing K copies of a value
+// gives the same bins), the candidate class attribute has one bin per class,
+// and unrolled sample r reads its bins and response through the mapping
+// (r / K, r % K) - only its boosting weight and place in the sample order
+// of a round are held per unrolled sample. The candidate class attribute is
+// ordered here (splits on ranges of class labels), not categorical as in
+// boosttree.cpp. Such a model predicts a sample by scoring each candidate
+// class (predict_unrolled()).
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#ifndef MULTICLASS_BOOST_H
+#define MULTICLASS_BOOST_H
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+#include <vector>
+#include <algorithm>
+#include <math.h>
+#include <float.h>
+
+#include "unrolled_data.h"
+
+/******************************************************************************/
+
+#define MULTICLASS_BOOST_MAX_BINS 256 // bin indices are stored as uchar
+#define MULTICLASS_BOOST_MIN_PROB 1e-3 // SAMME.R leaf class probability floor
+
+class MulticlassBoost
+{
+public:
+
+    MulticlassBoost() : binning_time(0), boosting_time(0), nsamples(0), nvars(0),
+        nclasses(0), nbase(0), unroll(1), boost_type(CvBoost::REAL), max_depth(0),
+        min_sample_count(0) {}
+
+    // train the boosted trees
+    // data = attributes (1 sample per row, CV_32F)
+    // responses = integer class labels (1 sample per row, CV_32F)
+    // params = boosting parameters as CvBoost (boost_type - CvBoost::REAL
+    //          for SAMME.R or CvBoost::DISCRETE for SAMME -, weak_count,
+    //          weight_trim_rate, max_depth, min_sample_count and priors are
+    //          used)
+    // max_bins = maximum number of bins per attribute (<= 256)
+
+    bool train(const cv::Mat& data, const cv::Mat& responses, const CvBoostParams& params,
+               int max_bins = MULTICLASS_BOOST_MAX_BINS)
+    {
+        if ((data.type() != CV_32FC1) || (responses.type() != CV_32FC1)
+                || (data.rows != (int) responses.total()) || (data.rows < 1)
+                || !check_params(params, max_bins))
+        {
+            return false;
+        }
+
+        clear();
+
+        nbase = nsamples = data.rows;
+        nvars = data.cols;
+
+        int64 start = cv::getTickCount();
+
+        // map the class labels to class indices 0 ... nclasses - 1
+
+        for (int i = 0; i < nsamples; i++)
+        {
+            labels.push_back(cvRound(responses.at<float>(i)));
+        }
+        std::sort(labels.begin(), labels.end());
+        labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+        nclasses = (int) labels.size();
+
+        if (nclasses < 2)
+        {
+            clear();
+            return false;
+        }
+
+        responses_idx.resize(nsamples);
+        for (int i = 0; i < nsamples; i++)
+        {
+            responses_idx[i] = (int) (std::lower_bound(labels.begin(), labels.end(),
+                                      cvRound(responses.at<float>(i))) - labels.begin());
+        }
+
+        return boost(data, params, max_bins, start);
+    }
+
+    // train the boosted trees for the 2-class problem (responses 0 / 1) of
+    // unrolled data (see above) - parameters as train()
+
+    bool train(const UnrolledData& unrolled, const CvBoostParams& params,
+               int max_bins = MULTICLASS_BOOST_MAX_BINS)
+    {
+        const cv::Mat& data = unrolled.get_data();
+        if ((data.rows < 1) || (unrolled.get_class_count() < 2)
+                || !check_params(params, max_bins))
+        {
+            return false;
+        }
+
+        clear();
+
+        nbase = data.rows;
+        unroll = unrolled.get_class_count();
+        nsamples = unrolled.rows();
+        nvars = unrolled.cols();
+
+        int64 start = cv::getTickCount();
+
+        labels.push_back(0);
+        labels.push_back(1);
+        nclasses = 2;
+
+        for (int k = 0; k < unroll; k++)
+        {
+            candidate_labels.push_back(unrolled.get_class_label(k));
+        }
+
+        responses_idx.resize(nbase);
+        for (int i = 0; i < nbase; i++)
+        {
+            responses_idx[i] = unrolled.get_class_index(i);
+        }
+
+        return boost(data, params, max_bins, start);
+    }
+
+    void clear()
+    {
+        trees.clear();
+        leaf_values.clear();
+        labels.clear();
+        bins.clear();
+        bin_ofs.clear();
+        bin_min.clear();
+        bin_max.clear();
+        responses_idx.clear();
+        weights.clear();
+        candidate_labels.clear();
+        nsamples = nvars = nclasses = nbase = 0;
+        unroll = 1;
+    }
+
+    // predict the class label of a single sample (pointer to nvars floats),
+    // optionally returning the summed score of each class (nclasses floats)
+
+    float predict(const float* sample, float* class_scores = 0) const
+    {
+        std::vector<float> scores;
+        if (!class_scores)
+        {
+            scores.resize(nclasses);
+            class_scores = &scores[0];
+        }
+        std::fill(class_scores, class_scores + nclasses, 0.f);
+
+        for (size_t t = 0; t < trees.size(); t++)
+        {
+            const std::vector<Node>& nodes = trees[t];
+            int n = 0;
+            while (nodes[n].var >= 0)
+            {
+                n = (sample[nodes[n].var] <= nodes[n].c) ? nodes[n].left : nodes[n].right;
+            }
+
+            const float* value = &leaf_values[nodes[n].value];
+            for (int k = 0; k < nclasses; k++)
+            {
+                class_scores[k] += value[k];
+            }
+        }
+
+        int best = 0;
+        for (int k = 1; k < nclasses; k++)
+        {
+            if (class_scores[k] > class_scores[best])
+            {
+                best = k;
+            }
+        }
+        return (float) labels[best];
+    }
+
+    // predict the class label of a single sample (pointer to nvars - 1
+    // floats, without the candidate class attribute) by trees trained on
+    // unrolled data - the candidate class whose unrolled sample scores
+    // highest for response 1 (as boosttree.cpp)
+
+    float predict_unrolled(const float* sample) const
+    {
+        std::vector<float> unrolled_sample(sample, sample + nvars - 1);
+        unrolled_sample.push_back(0.f);
+        float scores[2];
+
+        int best = 0;
+        float best_score = -FLT_MAX;
+        for (int k = 0; k < unroll; k++)
+        {
+            unrolled_sample[nvars - 1] = (float) candidate_labels[k];
+            predict(&unrolled_sample[0], scores);
+            if (scores[1] > best_score)
+            {
+                best_score = scores[1];
+                best = k;
+            }
+        }
+        return (float) candidate_labels[best];
+    }
+
+    // predict a batch of samples (1 sample per row, CV_32F, without the
+    // candidate class attribute if trained on unrolled data) into results (1
+    // result per row, CV_32F)
+
+    void predict(const cv::Mat& samples, cv::Mat& results) const
+    {
+        results.create(samples.rows, 1, CV_32F);
+
+        std::vector<float> scores(nclasses);
+        for (int i = 0; i < samples.rows; i++)
+        {
+            results.at<float>(i, 0) = is_unrolled() ? predict_unrolled(samples.ptr<float>(i))
+                                      : predict(samples.ptr<float>(i), &scores[0]);
+        }
+    }
+
+    int get_weak_count() const { return (int) trees.size(); }
+    int get_class_count() const { return nclasses; }
+    bool is_unrolled() const { return unroll > 1; }
+
+    int get_node_count() const
+    {
+        int n = 0;
+        for (size_t t = 0; t < trees.size(); t++)
+        {
+            n += (int) trees[t].size();
+        }
+        return n;
+    }
+
+    // memory of the training data as boosted (the bin index of each
+    // attribute and class of each training sample, the bins and their class
+    // totals, and the weight, sorted weight (for trimming), order and leaf of
+    // each - if unrolled, unrolled - sample) for the number of samples and
+    // attributes last trained
+
+    size_t get_train_bytes() const
+    {
+        int base_vars = nvars - (is_unrolled() ? 1 : 0);
+        return (size_t) nbase * (base_vars * sizeof(uchar) + sizeof(int))
+               + bin_min.size() * (2 * sizeof(float) + nclasses * sizeof(double))
+               + bin_ofs.size() * sizeof(int)
+               + (size_t) nsamples * (2 * sizeof(double) + 2 * sizeof(int));
+    }
+
+    double binning_time;    // seconds spent quantizing the attributes
+    double boosting_time;   // seconds spent in the boosting rounds
+
+private:
+
+    // check the boosting parameters (see train())
+
+    static bool check_params(const CvBoostParams& params, int max_bins)
+    {
+        return (max_bins >= 2) && (max_bins <= MULTICLASS_BOOST_MAX_BINS)
+               && ((params.boost_type == CvBoost::REAL)
+                   || (params.boost_type == CvBoost::DISCRETE));
+    }
+
+    // quantize the attributes of the nbase training samples (data) and boost
+    // the trees - the classes (responses_idx) are set (start = ticks at the
+    // start of training)
+
+    bool boost(const cv::Mat& data, const CvBoostParams& params, int max_bins, int64 start)
+    {
+        boost_type = params.boost_type;
+        max_depth = params.max_depth;
+        min_sample_count = params.min_sample_count;
+
+        // quantize each attribute of the training data once (then, if
+        // unrolled, the candidate class attribute has a bin per class)
+
+        bins.resize((size_t) data.cols * nbase);
+        bin_ofs.resize(nvars + 1);
+
+        std::vector< std::pair<float, int> > sorted(nbase);
+        for (int vi = 0; vi < data.cols; vi++)
+        {
+            for (int i = 0; i < nbase; i++)
+            {
+                sorted[i] = std::make_pair(data.at<float>(i, vi), i);
+            }
+            std::sort(sorted.begin(), sorted.end());
+
+            bin_ofs[vi] = (int) bin_min.size();
+            quantize(sorted, max_bins, &bins[(size_t) vi * nbase]);
+        }
+        if (unroll > 1)
+        {
+            bin_ofs[nvars - 1] = (int) bin_min.size();
+            for (int k = 0; k < unroll; k++)
+            {
+                bin_min.push_back((float) candidate_labels[k]);
+                bin_max.push_back((float) candidate_labels[k]);
+            }
+        }
+        bin_ofs[nvars] = (int) bin_min.size();
+
+        binning_time = (double) (cv::getTickCount() - start) / cv::getTickFrequency();
+
+        // the initial sample weights (as CvDTree, a class with prior p and n
+        // training samples has a total weight of p)
+
+        start = cv::getTickCount();
+
+        std::vector<int> class_totals(nclasses, 0);
+        for (int i = 0; i < nsamples; i++)
+        {
+            class_totals[response(i)]++;
+        }
+
+        weights.resize(nsamples);
+        for (int i = 0; i < nsamples; i++)
+        {
+            int k = response(i);
+            weights[i] = params.priors ? params.priors[k] / class_totals[k] : 1.0;
+        }
+        normalise_weights();
+
+        // the boosting rounds
+
+        hist.resize((size_t) bin_ofs[nvars] * nclasses);
+        order.reserve(nsamples);
+        sample_leaf.resize(nsamples);
+
+        for (int m = 0; m < params.weak_count; m++)
+        {
+            select_samples(params.weight_trim_rate);
+            if (order.empty())
+            {
+                break;
+            }
+
+            // grow the tree, then find the leaf of every training sample
+
+            trees.push_back(std::vector<Node>());
+            split_bins.clear();
+            grow(trees.back(), 0, (int) order.size(), 0);
+
+            for (int i = 0; i < nsamples; i++)
+            {
+                sample_leaf[i] = find_training_leaf(trees.back(), i);
+            }
+
+            if (!(boost_type == CvBoost::REAL ? add_samme_r(trees.back(), sample_leaf)
+                    : add_samme(trees.back(), sample_leaf)))
+            {
+                break;
+            }
+        }
+
+        boosting_time = (double) (cv::getTickCount() - start) / cv::getTickFrequency();
+
+        // (keep only what prediction needs)
+
+        std::vector<uchar>().swap(bins);
+        std::vector<int>().swap(responses_idx);
+        std::vector<double>().swap(weights);
+        std::vector<double>().swap(hist);
+        std::vector<int>().swap(order);
+        std::vector<int>().swap(split_bins);
+        std::vector<int>().swap(sample_leaf);
+        std::vector<double>().swap(sorted_weights);
+
+        return !trees.empty();
+    }
+
+    struct Node
+    {
+        int var;            // attribute tested (-1 => leaf)
+        float c;            // value <= c => left
+        int left, right;    // child node indices
+        int value;          // (leaf) offset of its class scores in leaf_values
+    };
+
+    // quantize one attribute given its values in sorted order (as HistDTree) -
+    // writes the bin index of each sample and adds the (training) range of
+    // each bin
+
+    void quantize(const std::vector< std::pair<float, int> >& sorted, int max_bins,
+                  uchar* sample_bins)
+    {
+        int n = (int) sorted.size();
+        int n_distinct = 1;
+        for (int i = 1; i < n; i++)
+        {
+            if (sorted[i].first != sorted[i - 1].first)
+            {
+                n_distinct++;
+            }
+        }
+
+        int bin = 0;
+        bin_min.push_back(sorted[0].first);
+        for (int i = 0; i < n; i++)
+        {
+            if ((i > 0) && (sorted[i].first != sorted[i - 1].first)
+                    && ((n_distinct <= max_bins)
+                        || ((double) i * max_bins >= (double) (bin + 1) * n))
+                    && (bin < max_bins - 1))
+            {
+                bin_max.push_back(sorted[i - 1].first);
+                bin_min.push_back(sorted[i].first);
+                bin++;
+            }
+            sample_bins[sorted[i].second] = (uchar) bin;
+        }
+        bin_max.push_back(sorted[n - 1].first);
+    }
+
+    // the class (index) and the bin of attribute vi of (unrolled) training
+    // sample i - unrolled sample i being the training sample i / unroll with
+    // the candidate class i % unroll (see unrolled_data.h)
+
+    int response(int i) const
+    {
+        return (unroll == 1) ? responses_idx[i] : (responses_idx[i / unroll] == i % unroll);
+    }
+
+    int sample_bin(int vi, int i) const
+    {
+        if (unroll == 1)
+        {
+            return bins[(size_t) vi * nbase + i];
+        }
+        return (vi == nvars - 1) ? i % unroll : bins[(size_t) vi * nbase + i / unroll];
+    }
+
+    // scale the sample weights to sum to 1
+
+    void normalise_weights()
+    {
+        double sum = 0;
+        for (int i = 0; i < nsamples; i++)
+        {
+            sum += weights[i];
+        }
+        for (int i = 0; (sum > 0) && (i < nsamples); i++)
+        {
+            weights[i] /= sum;
+        }
+    }
+
+    // the samples of this round - leaving out (as CvBoost) those of least
+    // weight together making up no more than 1 - trim_rate of the total
+
+    void select_samples(double trim_rate)
+    {
+        order.clear();
+
+        double threshold = 0;
+        if ((trim_rate > 0) && (trim_rate < 1))
+        {
+            sorted_weights.assign(weights.begin(), weights.end());
+            std::sort(sorted_weights.begin(), sorted_weights.end());
+
+            double trimmed = 0;
+            for (int i = 0; i < nsamples; i++)
+            {
+                trimmed += sorted_weights[i];
+                if (trimmed > 1 - trim_rate)
+                {
+                    threshold = sorted_weights[i];
+                    break;
+                }
+            }
+        }
+
+        for (int i = 0; i < nsamples; i++)
+        {
+            if ((weights[i] >= threshold) && (weights[i] > 0))
+            {
+                order.push_back(i);
+            }
+        }
+    }
+
+    // split threshold midway between the training values either side of the
+    // split of attribute var after bin (the next non-empty bin being next)
+
+    float threshold(int var, int bin, int next) const
+    {
+        float lo = bin_max[bin_ofs[var] + bin];
+        float hi = bin_min[bin_ofs[var] + next];
+        float c = (lo + hi) * 0.5f;
+        return (c >= hi) ? lo : c;
+    }
+
+    // grow the (sub)tree of the samples order[begin ... end) - returns the
+    // index of its root
+
+    int grow(std::vector<Node>& nodes, int begin, int end, int depth)
+    {
+        int n = (int) nodes.size();
+        Node node = { -1, 0, -1, -1, -1 };
+        nodes.push_back(node);
+        split_bins.push_back(-1);
+
+        // the (weighted) class totals, stopping as CvDTree
+
+        std::vector<double> totals(nclasses, 0.0);
+        for (int j = begin; j < end; j++)
+        {
+            totals[response(order[j])] += weights[order[j]];
+        }
+
+        double weight = 0, sum2 = 0;
+        int n_nonzero = 0;
+        for (int k = 0; k < nclasses; k++)
+        {
+            weight += totals[k];
+            sum2 += totals[k] * totals[k];
+            n_nonzero += (totals[k] > 0);
+        }
+
+        if ((depth >= max_depth) || (end - begin <= min_sample_count) || (n_nonzero < 2))
+        {
+            nodes[n].value = add_leaf(totals);
+            return n;
+        }
+
+        // the best split of any attribute from its histogram of class totals
+        // per bin (Gini: maximise sum(lc^2)/L + sum(rc^2)/R as CvDTree, which
+        // must improve on sum(c^2)/W)
+
+        double best_quality = sum2 / weight * (1 + 1e-12);
+        int best_var = -1, best_bin = -1, best_next = -1;
+        std::vector<double> left(nclasses);
+
+        for (int vi = 0; vi < nvars; vi++)
+        {
+            double* h = &hist[(size_t) bin_ofs[vi] * nclasses];
+            int n_bins = bin_ofs[vi + 1] - bin_ofs[vi];
+            std::fill(h, h + (size_t) n_bins * nclasses, 0.0);
+
+            if (unroll == 1)
+            {
+                const uchar* var_bins = &bins[(size_t) vi * nbase];
+                for (int j = begin; j < end; j++)
+                {
+                    int i = order[j];
+                    h[var_bins[i] * nclasses + responses_idx[i]] += weights[i];
+                }
+            }
+            else
+            {
+                for (int j = begin; j < end; j++)
+                {
+                    int i = order[j];
+                    h[sample_bin(vi, i) * nclasses + response(i)] += weights[i];
+                }
+            }
+
+            std::fill(left.begin(), left.end(), 0.0);
+            double L = 0;
+            int last = -1;  // last non-empty bin
+
+            for (int b = 0; b < n_bins; b++)
+            {
+                double bin_weight = 0;
+                for (int k = 0; k < nclasses; k++)
+                {
+                    bin_weight += h[b * nclasses + k];
+                }
+                if (bin_weight <= 0)
+                {
+                    continue;
+                }
+
+                if ((last >= 0) && (L < weight))
+                {
+                    double lsum2 = 0, rsum2 = 0;
+                    for (int k = 0; k < nclasses; k++)
+                    {
+                        lsum2 += left[k] * left[k];
+                        rsum2 += (totals[k] - left[k]) * (totals[k] - left[k]);
+                    }
+                    double quality = lsum2 / L + rsum2 / (weight - L);
+                    if (quality > best_quality)
+                    {
+                        best_quality = quality;
+                        best_var = vi;
+                        best_bin = last;
+                        best_next = b;
+                    }
+                }
+
+                for (int k = 0; k < nclasses; k++)
+                {
+                    left[k] += h[b * nclasses + k];
+                }
+                L += bin_weight;
+                last = b;
+            }
+        }
+
+        if (best_var < 0)
+        {
+            nodes[n].value = add_leaf(totals);
+            return n;
+        }
+
+        // partition the samples and grow the children
+
+        int middle = (int) (std::stable_partition(order.begin() + begin, order.begin() + end,
+                            BinAtMost(this, best_var, best_bin)) - order.begin());
+
+        // the bins between best_bin and best_next are empty here but may
+        // hold samples trimmed from this round, which are routed to the
+        // leaves (find_training_leaf()) as prediction routes them - by c -
+        // so every bin must lie wholly on one side of c: a bin that c falls
+        // within (of training values still below those of best_next) goes
+        // to the left with c raised to its largest value
+
+        float c = threshold(best_var, best_bin, best_next);
+        int split_bin = best_bin;
+        for (int b = best_bin + 1; b < best_next; b++)
+        {
+            if (bin_min[bin_ofs[best_var] + b] <= c)
+            {
+                c = MAX(c, bin_max[bin_ofs[best_var] + b]);
+                split_bin = b;
+            }
+        }
+
+        nodes[n].var = best_var;
+        nodes[n].c = c;
+        split_bins[n] = split_bin;
+
+        int l = grow(nodes, begin, middle, depth + 1);
+        int r = grow(nodes, middle, end, depth + 1);
+        nodes[n].left = l;
+        nodes[n].right = r;
+
+        return n;
+    }
+
+    // (sample i has a bin of attribute var of at most bin)
+
+    struct BinAtMost
+    {
+        BinAtMost(const MulticlassBoost* _boost, int _var, int _bin)
+            : boost(_boost), var(_var), bin(_bin) {}
+        bool operator()(int i) const { return boost->sample_bin(var, i) <= bin; }
+
+        const MulticlassBoost* boost;
+        int var;
+        int bin;
+    };
+
+    // add the class scores of a leaf (its weighted class totals until the
+    // round sets them) - returns their offset
+
+    int add_leaf(const std::vector<double>& totals)
+    {
+        int value = (int) leaf_values.size();
+        for (int k = 0; k < nclasses; k++)
+        {
+            leaf_values.push_back((float) totals[k]);
+        }
+        return value;
+    }
+
+    // the leaf of a training sample (by its bins - those of at most a
+    // node's split bin being those of values of at most its c)
+
+    int find_training_leaf(const std::vector<Node>& nodes, int i) const
+    {
+        int n = 0;
+        while (nodes[n].var >= 0)
+        {
+            n = (sample_bin(nodes[n].var, i) <= split_bins[n])
+                ? nodes[n].left : nodes[n].right;
+        }
+        return n;
+    }
+
+    // SAMME.R : the leaf scores (K - 1) * (log p_k - mean_j log p_j) and the
+    // sample weights updated - returns false to stop boosting
+
+    bool add_samme_r(const std::vector<Node>& nodes, const std::vector<int>& leaf)
+    {
+        std::vector<double> log_p(nclasses);
+
+        for (size_t n = 0; n < nodes.size(); n++)
+        {
+            if (nodes[n].var >= 0)
+            {
+                continue;
+            }
+
+            float* value = &leaf_values[nodes[n].value];
+            double weight = 0;
+            for (int k = 0; k < nclasses; k++)
+            {
+                weight += value[k];
+            }
+
+            double mean = 0;
+            for (int k = 0; k < nclasses; k++)
+            {
+                log_p[k] = log(MAX(value[k] / weight, MULTICLASS_BOOST_MIN_PROB));
+                mean += log_p[k] / nclasses;
+            }
+            for (int k = 0; k < nclasses; k++)
+            {
+                value[k] = (float) ((nclasses - 1) * (log_p[k] - mean));
+            }
+        }
+
+        // w *= exp(-(K - 1) / K * sum_k y_k log p_k) - with the scores above
+        // sum_k y_k log p_k = K / (K - 1)^2 * score of the sample's class
+
+        for (int i = 0; i < nsamples; i++)
+        {
+            double score = leaf_values[nodes[leaf[i]].value + response(i)];
+            weights[i] *= exp(-score / (nclasses - 1));
+        }
+        normalise_weights();
+
+        return true;
+    }
+
+    // SAMME : the leaf votes alpha for its class, the weights of the samples
+    // misclassified multiplied by exp(alpha) - returns false to stop boosting
+    // (a tree no better than chance is dropped)
+
+    bool add_samme(std::vector<Node>& nodes, const std::vector<int>& leaf)
+    {
+        for (size_t n = 0; n < nodes.size(); n++)
+        {
+            if (nodes[n].var >= 0)
+            {
+                continue;
+            }
+
+            float* value = &leaf_values[nodes[n].value];
+            int best = (int) (std::max_element(value, value + nclasses) - value);
+            std::fill(value, value + nclasses, 0.f);
+            value[best] = 1;
+        }
+
+        double err = 0;
+        for (int i = 0; i < nsamples; i++)
+        {
+            if (leaf_values[nodes[leaf[i]].value + response(i)] == 0)
+            {
+                err += weights[i];
+            }
+        }
+
+        if (err >= 1 - 1.0 / nclasses)
+        {
+            leaf_values.resize(leaf_values.size() - (size_t) count_leaves(nodes) * nclasses);
+            trees.pop_back();
+            return false;
+        }
+
+        err = MAX(err, 1e-10);
+        double alpha = log((1 - err) / err) + log((double) nclasses - 1);
+
+        for (size_t n = 0; n < nodes.size(); n++)
+        {
+            if (nodes[n].var < 0)
+            {
+                float* value = &leaf_values[nodes[n].value];
+                for (int k = 0; k < nclasses; k++)
+                {
+                    value[k] *= (float) alpha;
+                }
+            }
+        }
+
+        for (int i = 0; i < nsamples; i++)
+        {
+            if (leaf_values[nodes[leaf[i]].value + response(i)] == 0)
+            {
+                weights[i] *= exp(alpha);
+            }
+        }
+        normalise_weights();
+
+        return err > 1e-10;  // (a perfect tree ends the boosting)
+    }
+
+    static int count_leaves(const std::vector<Node>& nodes)
+    {
+        int n_leaves = 0;
+        for (size_t n = 0; n < nodes.size(); n++)
+        {
+            n_leaves += (nodes[n].var < 0);
+        }
+        return n_leaves;
+    }
+
+    // the trees and the class scores of their leaves
+
+    std::vector< std::vector<Node> > trees;
+    std::vector<float> leaf_values;
+    std::vector<int> labels;        // class label of each class index
+    std::vector<int> candidate_labels; // (unrolled) label of each candidate class
+
+    // the training data (quantized) while boosting
+
+    std::vector<uchar> bins;        // bin of each training sample (per attribute, in sample order)
+    std::vector<int> bin_ofs;       // first bin of each attribute
+    std::vector<float> bin_min;     // training range of each bin
+    std::vector<float> bin_max;
+    std::vector<int> responses_idx; // class index of each training sample
+    std::vector<double> weights;    // boosting weight of each sample
+    std::vector<double> hist;       // class totals per bin of each attribute
+    std::vector<int> order;         // the samples of the round, grouped by node
+    std::vector<int> split_bins;    // split bin of each node of the current tree
+    std::vector<int> sample_leaf;   // leaf of each sample in the current tree
+    std::vector<double> sorted_weights; // (weight trimming) the weights in order
+
+    int nsamples, nvars, nclasses;
+    int nbase;                      // training samples (nsamples / unroll)
+    int unroll;                     // candidate classes if unrolled (else 1)
+    int boost_type;
+    int max_depth, min_sample_count;
+};
+
+/******************************************************************************/
+
+#endif
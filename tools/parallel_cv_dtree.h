@@ -0,0 +1,388 @@
+// Support : decision tree (CvDTree) with cross validation pruning run over
+// the folds in parallel
+
+// CvDTree cost complexity pruning (params.cv_folds > 1) grows the tree once,
+// keeping for every node the risk / error it would have had if each fold had
+// been left out of training, then for each fold in turn builds the sequence
+// of pruned subtrees of that fold's tree and evaluates it on the held out fold
+// (CvDTree::prune_cv()). The folds are processed one after another on one
+// core and all write their working values into the shared tree nodes.
+//
+// ParallelCvDTree is a drop in replacement for CvDTree that processes the
+// folds concurrently (cv::parallel_for_, i.e. the OpenCV thread pool) each in
+// its own work space. Every fold performs exactly the same arithmetic in the
+// same order as CvDTree, and the fold results are combined serially as before,
+// so the pruned tree chosen is identical to that of CvDTree (and independent
+// of the number of threads). The wall time of each training phase is
+// recorded.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#ifndef PARALLEL_CV_DTREE_H
+#define PARALLEL_CV_DTREE_H
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+#include <vector>
+#include <algorithm>
+#include <float.h>
+#include <math.h>
+
+/******************************************************************************/
+
+class ParallelCvDTree : public CvDTree
+{
+public:
+
+    ParallelCvDTree() : grow_time(0), sequence_time(0), folds_time(0),
+        select_time(0) {}
+
+    // wall time (seconds) of each phase of the last training
+
+    double grow_time;       // growing the tree (with the per fold statistics)
+    double sequence_time;   // pruned subtree sequence of the full tree
+    double folds_time;      // pruned subtree sequences of all the folds
+    double select_time;     // choice of the pruned tree (and truncation)
+
+protected:
+
+    // as CvDTree::do_train() but timed
+
+    virtual bool do_train(const CvMat* _subsample_idx)
+    {
+        grow_time = sequence_time = folds_time = select_time = 0;
+
+        int64 start = cv::getTickCount();
+        root = data->subsample_data(_subsample_idx);
+        try_split_node(root);
+        grow_time = (double) (cv::getTickCount() - start) / cv::getTickFrequency();
+
+        if (!root->split)
+        {
+            return false;
+        }
+
+        CV_Assert(root->left);
+        CV_Assert(root->right);
+
+        if (data->params.cv_folds > 0)
+        {
+            prune_cv();
+        }
+
+        if (!data->shared)
+        {
+            data->free_train_data();
+        }
+
+        return true;
+    }
+
+    // as CvDTree::prune_cv() with the folds processed in parallel
+
+    virtual void prune_cv()
+    {
+        int tree_count = 0;
+        int cv_n = data->params.cv_folds;
+        int n = root->sample_count;
+
+        // (as CvDTree, the 1SE rule is not implemented for regression)
+
+        bool use_1se = data->params.use_1se_rule && data->is_classifier;
+
+        // 1. the pruned subtree sequence of the full tree and its alphas
+
+        int64 start = cv::getTickCount();
+
+        std::vector<double> ab(1, 0.0);
+        for (;; tree_count++)
+        {
+            double min_alpha = update_tree_rnc(tree_count, -1);
+            if (cut_tree(tree_count, -1, min_alpha))
+            {
+                break;
+            }
+            ab.resize(tree_count + 1);
+            ab[tree_count] = min_alpha;
+        }
+
+        ab[0] = 0.;
+
+        sequence_time = (double) (cv::getTickCount() - start) / cv::getTickFrequency();
+
+        double min_err = 0, min_err_se = 0;
+        int min_idx = -1;
+
+        if (tree_count > 0)
+        {
+            for (int ti = 1; ti < tree_count - 1; ti++)
+            {
+                ab[ti] = sqrt(ab[ti] * ab[ti + 1]);
+            }
+            ab[tree_count - 1] = DBL_MAX * 0.5;
+
+            // 2. the error of each fold's pruned subtree sequence on the held
+            // out fold (one fold per task, each in its own work space)
+
+            start = cv::getTickCount();
+
+            index_nodes();
+
+            std::vector<double> err((size_t) cv_n * tree_count);
+            cv::parallel_for_(cv::Range(0, cv_n),
+                              FoldPruner(this, &ab[0], tree_count, &err[0]));
+
+            folds_time = (double) (cv::getTickCount() - start) / cv::getTickFrequency();
+
+            // 3. choose the best tree (with the 1SE rule if set) - serially,
+            // summing the folds in order, exactly as CvDTree
+
+            start = cv::getTickCount();
+
+            for (int ti = 0; ti < tree_count; ti++)
+            {
+                double sum_err = 0;
+                for (int j = 0; j < cv_n; j++)
+                {
+                    sum_err += err[(size_t) j * tree_count + ti];
+                }
+                if ((ti == 0) || (sum_err < min_err))
+                {
+                    min_err = sum_err;
+                    min_idx = ti;
+                    if (use_1se)
+                    {
+                        min_err_se = sqrt(sum_err * (n - sum_err));
+                    }
+                }
+                else if (sum_err < min_err + min_err_se)
+                {
+                    min_idx = ti;
+                }
+            }
+        }
+        else
+        {
+            start = cv::getTickCount();
+        }
+
+        pruned_tree_idx = min_idx;
+        free_prune_data(data->params.truncate_pruned_tree != 0);
+
+        select_time = (double) (cv::getTickCount() - start) / cv::getTickFrequency();
+    }
+
+private:
+
+    // work space of one fold (per node, as the CvDTreeNode fields)
+
+    struct FoldState
+    {
+        std::vector<int> Tn;
+        std::vector<int> complexity;
+        std::vector<double> alpha;
+        std::vector<double> tree_risk;
+        std::vector<double> tree_error;
+    };
+
+    // runs a range of folds
+
+    class FoldPruner : public cv::ParallelLoopBody
+    {
+    public:
+
+        FoldPruner(const ParallelCvDTree* _tree, const double* _ab, int _tree_count,
+                   double* _err) :
+            tree(_tree), ab(_ab), tree_count(_tree_count), err(_err) {}
+
+        virtual void operator()(const cv::Range& range) const
+        {
+            for (int j = range.start; j < range.end; j++)
+            {
+                tree->prune_fold(j, ab, tree_count, err + (size_t) j * tree_count);
+            }
+        }
+
+    private:
+
+        const ParallelCvDTree* tree;
+        const double* ab;
+        int tree_count;
+        double* err;
+    };
+
+    // number the nodes (depth first) recording the tree structure
+
+    void index_nodes()
+    {
+        nodes.clear();
+        node_left.clear();
+        node_right.clear();
+        node_parent.clear();
+        add_node(root, -1);
+    }
+
+    int add_node(CvDTreeNode* node, int parent)
+    {
+        int idx = (int) nodes.size();
+        nodes.push_back(node);
+        node_left.push_back(-1);
+        node_right.push_back(-1);
+        node_parent.push_back(parent);
+
+        if (node->left)
+        {
+            int l = add_node(node->left, idx);
+            int r = add_node(node->right, idx);
+            node_left[idx] = l;
+            node_right[idx] = r;
+        }
+        return idx;
+    }
+
+    // the pruned subtree sequence of fold j evaluated against the alphas ab
+    // of the full tree sequence (the fold loop of CvDTree::prune_cv())
+
+    void prune_fold(int j, const double* ab, int tree_count, double* err) const
+    {
+        FoldState s;
+        int n_nodes = (int) nodes.size();
+
+        s.Tn.resize(n_nodes);
+        s.complexity.resize(n_nodes);
+        s.alpha.resize(n_nodes);
+        s.tree_risk.resize(n_nodes);
+        s.tree_error.resize(n_nodes);
+
+        for (int i = 0; i < n_nodes; i++)
+        {
+            s.Tn[i] = nodes[i]->cv_Tn[j];
+        }
+
+        int tj = 0, tk = 0;
+        for (; tk < tree_count; tj++)
+        {
+            double min_alpha = update_fold_rnc(tj, j, s);
+            if (cut_fold(tj, min_alpha, s))
+            {
+                min_alpha = DBL_MAX;
+            }
+
+            for (; tk < tree_count; tk++)
+            {
+                if (ab[tk] > min_alpha)
+                {
+                    break;
+                }
+                err[tk] = s.tree_error[0];
+            }
+        }
+    }
+
+    // as CvDTree::update_tree_rnc(T, fold) within the fold work space
+
+    double update_fold_rnc(int T, int fold, FoldState& s) const
+    {
+        int node = 0;
+        double min_alpha = DBL_MAX;
+
+        for (;;)
+        {
+            int parent;
+            for (;;)
+            {
+                if ((s.Tn[node] <= T) || (node_left[node] < 0))
+                {
+                    s.complexity[node] = 1;
+                    s.tree_risk[node] = nodes[node]->cv_node_risk[fold];
+                    s.tree_error[node] = nodes[node]->cv_node_error[fold];
+                    break;
+                }
+                node = node_left[node];
+            }
+
+            for (parent = node_parent[node]; (parent >= 0) && (node_right[parent] == node);
+                    node = parent, parent = node_parent[parent])
+            {
+                s.complexity[parent] += s.complexity[node];
+                s.tree_risk[parent] += s.tree_risk[node];
+                s.tree_error[parent] += s.tree_error[node];
+                s.alpha[parent] = (nodes[parent]->cv_node_risk[fold] - s.tree_risk[parent])
+                                  / (s.complexity[parent] - 1);
+                min_alpha = MIN(min_alpha, s.alpha[parent]);
+            }
+
+            if (parent < 0)
+            {
+                break;
+            }
+
+            s.complexity[parent] = s.complexity[node];
+            s.tree_risk[parent] = s.tree_risk[node];
+            s.tree_error[parent] = s.tree_error[node];
+            node = node_right[parent];
+        }
+
+        return min_alpha;
+    }
+
+    // as CvDTree::cut_tree(T, fold, min_alpha) within the fold work space
+
+    int cut_fold(int T, double min_alpha, FoldState& s) const
+    {
+        int node = 0;
+
+        if (node_left[node] < 0)
+        {
+            return 1;
+        }
+
+        for (;;)
+        {
+            int parent;
+            for (;;)
+            {
+                if ((s.Tn[node] <= T) || (node_left[node] < 0))
+                {
+                    break;
+                }
+                if (s.alpha[node] <= min_alpha + FLT_EPSILON)
+                {
+                    s.Tn[node] = T;
+                    if (node == 0)
+                    {
+                        return 1;
+                    }
+                    break;
+                }
+                node = node_left[node];
+            }
+
+            for (parent = node_parent[node]; (parent >= 0) && (node_right[parent] == node);
+                    node = parent, parent = node_parent[parent])
+                ;
+
+            if (parent < 0)
+            {
+                break;
+            }
+            node = node_right[parent];
+        }
+
+        return 0;
+    }
+
+    // tree structure (node 0 is the root)
+
+    std::vector<CvDTreeNode*> nodes;
+    std::vector<int> node_left;
+    std::vector<int> node_right;
+    std::vector<int> node_parent;
+};
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,847 @@
+// Support : random forest (CvRTrees) with the trees trained concurrently
+
+// CvRTrees::train() grows the trees of the forest one after another on one
+// core, each from a bootstrap sample of the training data drawn from a single
+// random number generator shared by all of the trees (which also chooses the
+// variables tried at each node). The trees are otherwise independent.
+//
+// ParallelRTrees is a drop in replacement for CvRTrees that grows the trees
+// concurrently (cv::parallel_for_ with one task per tree, so that idle
+// threads of the OpenCV thread pool take the next untrained tree). Every tree
+// has its own random number generator seeded from a master seed, drawn in
+// tree order before the training starts, for its bootstrap sample and its
+// variable choices, so that the forest trained is the same whatever the
+// number of threads. As a tree is grown in the working buffers of the
+// training data (CvDTreeTrainData), each running task takes a copy of the
+// training data from a pool, created when the pool is empty (so at most one
+// per thread). The trained forest is an ordinary CvRTrees - it is saved in,
+// and predicts as, the usual format (CvRTrees::load() reads it back).
+//
+// With out of bag error tracking (CV_TERMCRIT_EPS set or a callback given)
+// the trees are grown in batches of as many trees as threads and the trees of
+// each batch then vote, in tree order, on the training samples outside their
+// bootstrap samples, the out of bag error of the forest so far being recorded
+// (and passed to the callback) after each tree. Growth stops at the first
+// tree count whose out of bag error is below term_crit.epsilon (as CvRTrees)
+// or has changed by no more than oob_tolerance over the last oob_window trees
+// (the curve has flattened) - the trees of the batch past it are discarded,
+// so the forest still does not depend on the number of threads. Otherwise
+// the forest is grown to the maximum number of trees (term_crit.max_iter).
+//
+// The variable importance (calc_var_importance) is not computed as the trees
+// are grown but in a separate pass once they all are (calc_var_importance(),
+// which may also be called on a forest trained without it). The trees are
+// divided between the threads, each accumulating the totals of its own trees,
+// and the totals of the threads are merged at the end. Two importances are
+// computed: the out of bag permutation importance of CvRTrees - per tree and
+// attribute, the out of bag samples correctly classified (or squared error)
+// lost when the attribute's values are shuffled among them - kept as the
+// forest's var_importance (CV_32FC1, as CvRTrees), and the Gini importance -
+// the sum of the qualities of the splits on each attribute, as
+// CvDTree::get_var_importance() - by get_gini_importance(). Both are saved
+// with the forest (save()): the permutation importance as by CvRTrees and the
+// Gini importance as an extra top level node (PARALLEL_RTREES_GINI_NODE)
+// after the forest, which CvRTrees::load() ignores and dt_varimportance
+// reports (it is not kept by merging saved forests, see merged_rtrees.h).
+// The permutation importance needs the bootstrap samples of the trees, so
+// only the Gini importance is computed for a forest that has been loaded.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#ifndef PARALLEL_RTREES_H
+#define PARALLEL_RTREES_H
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+#include <vector>
+#include <algorithm>
+#include <string.h>
+#include <math.h>
+
+/******************************************************************************/
+
+#define PARALLEL_RTREES_SEED 0x2545F4914F6CDD1DULL // default master seed
+#define PARALLEL_RTREES_MAX_TREES 50 // trees grown when term_crit has no max_iter
+#define PARALLEL_RTREES_OOB_WINDOW 10 // trees over which the oob error must settle
+#define PARALLEL_RTREES_OOB_TOLERANCE 0.001f // change in the oob error seen as settled
+#define PARALLEL_RTREES_GINI_NODE "gini_importance" // saved Gini importance (see save())
+
+class ParallelRTrees : public CvRTrees
+{
+public:
+
+    ParallelRTrees() : seed(PARALLEL_RTREES_SEED), first_tree(0), data_time(0), grow_time(0),
+        importance_time(0), oob_window(PARALLEL_RTREES_OOB_WINDOW), oob_tolerance(PARALLEL_RTREES_OOB_TOLERANCE),
+        oob_callback(0), oob_user_data(0), train_args(0) {}
+
+    virtual ~ParallelRTrees()
+    {
+        clear();
+    }
+
+    // master seed of the per tree random number generators (set before
+    // training to train a different forest)
+
+    uint64 seed;
+
+    // the index of the first tree trained within a larger forest (the trees
+    // take the seeds of trees first_tree, first_tree + 1 ... of that forest, so
+    // that forests of consecutive ranges of its trees, e.g. trained by
+    // separate processes, together make the same forest - see rf_merge.cc)
+
+    int first_tree;
+
+    // wall time (seconds) of each phase of the last training
+
+    double data_time;   // preparation of the (first copy of the) training data
+    double grow_time;   // growing all of the trees
+    double importance_time; // computing the variable importance
+
+    // growth stops once the out of bag error has changed by no more than
+    // oob_tolerance over the last oob_window trees (with CV_TERMCRIT_EPS)
+
+    int oob_window;
+    float oob_tolerance;
+
+    // called with the out of bag error of the first ntrees trees as each tree
+    // is added to the forest (from the thread calling train())
+
+    typedef void (*OOBCallback)(int ntrees, float oob_error, void* user_data);
+
+    void set_oob_callback(OOBCallback callback, void* user_data = 0)
+    {
+        oob_callback = callback;
+        oob_user_data = user_data;
+    }
+
+    // the out of bag error of the first 1, 2 ... ntrees trees of the last
+    // training (if tracked)
+
+    const std::vector<float>& get_oob_errors() const
+    {
+        return oob_errors;
+    }
+
+    // the number of copies of the training data used by the last training
+
+    int get_train_data_count() const
+    {
+        return (data ? 1 : 0) + (int) extra_data.size();
+    }
+
+    using CvRTrees::train;
+
+    // as CvRTrees::train() with the trees grown in parallel
+
+    virtual bool train(const CvMat* _train_data, int _tflag, const CvMat* _responses,
+                       const CvMat* _var_idx = 0, const CvMat* _sample_idx = 0,
+                       const CvMat* _var_type = 0, const CvMat* _missing_mask = 0,
+                       CvRTParams params = CvRTParams())
+    {
+        clear();
+        data_time = grow_time = importance_time = 0;
+
+        CvDTreeParams tree_params(params.max_depth, params.min_sample_count,
+                                  params.regression_accuracy, params.use_surrogates,
+                                  params.max_categories, params.cv_folds,
+                                  params.use_1se_rule, false, params.priors);
+
+        TrainArgs args = { _train_data, _tflag, _responses, _var_idx, _sample_idx,
+                           _var_type, _missing_mask, &tree_params
+                         };
+        train_args = &args;
+
+        int64 start = cv::getTickCount();
+        data = new_train_data();
+        data_time = (double) (cv::getTickCount() - start) / cv::getTickFrequency();
+
+        // the active variable mask (as CvRTrees, the first nactive_vars set)
+
+        int var_count = data->var_count;
+        int nactive_vars = params.nactive_vars;
+        if (nactive_vars > var_count)
+        {
+            nactive_vars = var_count;
+        }
+        else if (nactive_vars == 0)
+        {
+            nactive_vars = (int) sqrt((double) var_count);
+        }
+        CV_Assert((nactive_vars > 0) && (nactive_vars <= var_count));
+
+        active_var_mask = cvCreateMat(1, var_count, CV_8UC1);
+        for (int vi = 0; vi < var_count; vi++)
+        {
+            active_var_mask->data.ptr[vi] = (vi < nactive_vars) ? 1 : 0;
+        }
+
+        nclasses = data->get_num_classes();
+        nsamples = data->sample_count;
+        oob_error = 0;
+
+        // the seed of each tree (drawn in order, independent of the threads)
+
+        int max_ntrees = (params.term_crit.type & CV_TERMCRIT_ITER)
+                         ? params.term_crit.max_iter : PARALLEL_RTREES_MAX_TREES;
+        CV_Assert(max_ntrees > 0);
+
+        cv::RNG master(seed);
+        tree_seeds.assign(max_ntrees, 0);
+        for (int k = -MAX(first_tree, 0); k < max_ntrees; k++)
+        {
+            uint64 high = master.next();
+            uint64 tree_seed = (high << 32) | master.next();
+            if (k >= 0)
+            {
+                tree_seeds[k] = tree_seed;
+            }
+        }
+
+        // grow the trees (one task each), in batches of as many trees as
+        // threads when the out of bag error is tracked
+
+        trees = (CvForestTree**) cvAlloc(sizeof(trees[0]) * max_ntrees);
+        memset(trees, 0, sizeof(trees[0]) * max_ntrees);
+        ntrees = 0;
+
+        free_data.clear();
+        free_data.push_back(data);
+
+        bool stop_on_oob = (params.term_crit.type & CV_TERMCRIT_EPS) != 0;
+        bool track_oob = stop_on_oob || oob_callback;
+        oob_errors.clear();
+
+        OOBVotes oob;
+        if (track_oob)
+        {
+            start_oob(oob);
+        }
+        int batch = track_oob ? MAX(cv::getNumThreads(), 1) : max_ntrees;
+
+        start = cv::getTickCount();
+        for (int k0 = 0; k0 < max_ntrees; k0 += batch)
+        {
+            int k1 = MIN(k0 + batch, max_ntrees);
+            cv::parallel_for_(cv::Range(k0, k1), TreeGrower(this, &tree_seeds[0]), k1 - k0);
+
+            bool stop = false;
+            for (int k = k0; k < k1; k++)
+            {
+                if (stop)
+                {
+                    delete trees[k];
+                    trees[k] = 0;
+                    continue;
+                }
+
+                ntrees = k + 1;
+                if (!track_oob)
+                {
+                    continue;
+                }
+
+                oob_error = add_oob_votes(oob, k, tree_seeds[k]);
+                oob_errors.push_back(oob_error);
+                if (oob_callback)
+                {
+                    (*oob_callback)(ntrees, oob_error, oob_user_data);
+                }
+
+                stop = stop_on_oob && ((oob_error < params.term_crit.epsilon)
+                                       || ((ntrees > oob_window) && (fabs(oob_error
+                                               - oob_errors[ntrees - 1 - oob_window]) <= oob_tolerance)));
+            }
+            if (stop)
+            {
+                break;
+            }
+        }
+        grow_time = (double) (cv::getTickCount() - start) / cv::getTickFrequency();
+
+        free_data.clear();
+        train_args = 0;
+        tree_seeds.resize(ntrees);
+
+        if (params.calc_var_importance)
+        {
+            calc_var_importance();
+        }
+
+        return true;
+    }
+
+    // compute the variable importance of the forest (in parallel, see above)
+    // - the permutation importance (var_importance) only for a forest
+    // trained here, returns false if there are no trees
+
+    bool calc_var_importance()
+    {
+        if (!data || (ntrees < 1))
+        {
+            return false;
+        }
+
+        int64 start = cv::getTickCount();
+
+        int var_count = data->var_count;
+        bool permutation = ((int) tree_seeds.size() == ntrees) && (data->sample_count == nsamples);
+
+        // the training samples (as the trees see them) for the out of bag
+        // predictions
+
+        std::vector<float> samples, responses;
+        std::vector<uchar> missing;
+        if (permutation)
+        {
+            samples.resize((size_t) nsamples * var_count);
+            missing.resize((size_t) nsamples * var_count);
+            responses.resize(nsamples);
+            data->get_vectors(0, &samples[0], &missing[0], &responses[0], data->is_classifier);
+        }
+
+        // the totals of each thread's trees, then merged
+
+        int n_parts = MAX(MIN(cv::getNumThreads(), ntrees), 1);
+        std::vector<double> gini((size_t) n_parts * var_count, 0.0);
+        std::vector<double> lost(permutation ? (size_t) n_parts * var_count : 0, 0.0);
+
+        ImportanceSamples oob_samples = { permutation ? &samples[0] : 0,
+                                          permutation ? &missing[0] : 0,
+                                          permutation ? &responses[0] : 0
+                                        };
+        cv::parallel_for_(cv::Range(0, n_parts),
+                          ImportanceCounter(this, n_parts, oob_samples, &gini[0],
+                                            permutation ? &lost[0] : 0), n_parts);
+
+        gini_importance.assign(var_count, 0.0);
+        std::vector<double> permutation_importance(var_count, 0.0);
+        for (int p = 0; p < n_parts; p++)
+        {
+            for (int vi = 0; vi < var_count; vi++)
+            {
+                gini_importance[vi] += gini[(size_t) p * var_count + vi];
+                if (permutation)
+                {
+                    permutation_importance[vi] += lost[(size_t) p * var_count + vi];
+                }
+            }
+        }
+        normalise(gini_importance);
+
+        // (as CvRTrees, attributes whose shuffling helps count as unimportant)
+
+        if (permutation)
+        {
+            for (int vi = 0; vi < var_count; vi++)
+            {
+                permutation_importance[vi] = MAX(permutation_importance[vi], 0.0);
+            }
+            normalise(permutation_importance);
+
+            cvReleaseMat(&var_importance);
+            var_importance = cvCreateMat(1, var_count, CV_32FC1);
+            for (int vi = 0; vi < var_count; vi++)
+            {
+                var_importance->data.fl[vi] = (float) permutation_importance[vi];
+            }
+        }
+
+        importance_time = (double) (cv::getTickCount() - start) / cv::getTickFrequency();
+
+        return true;
+    }
+
+    // the Gini importance of each attribute (calc_var_importance(), summing
+    // to 1 - empty if not computed)
+
+    const std::vector<double>& get_gini_importance() const
+    {
+        return gini_importance;
+    }
+
+    // save the forest as CvRTrees::save() then, if computed, its Gini
+    // importance (1 x var_count, CV_32FC1) as the top level node
+    // PARALLEL_RTREES_GINI_NODE
+
+    virtual void save(const char* filename, const char* name = 0) const
+    {
+        CvFileStorage* fs = cvOpenFileStorage(filename, 0, CV_STORAGE_WRITE);
+        if (!fs)
+        {
+            CV_Error(CV_StsError, "Could not open the file storage. Check the path and permissions");
+        }
+
+        write(fs, name ? name : default_model_name);
+
+        if (!gini_importance.empty())
+        {
+            CvMat* gini = cvCreateMat(1, (int) gini_importance.size(), CV_32FC1);
+            for (size_t vi = 0; vi < gini_importance.size(); vi++)
+            {
+                gini->data.fl[vi] = (float) gini_importance[vi];
+            }
+            cvWrite(fs, PARALLEL_RTREES_GINI_NODE, gini);
+            cvReleaseMat(&gini);
+        }
+
+        cvReleaseFileStorage(&fs);
+    }
+
+    // as CvRTrees::clear() also releasing the extra copies of the training
+    // data (after the trees, whose nodes they hold)
+
+    virtual void clear()
+    {
+        CvRTrees::clear();
+        tree_seeds.clear();
+        gini_importance.clear();
+        for (size_t i = 0; i < extra_data.size(); i++)
+        {
+            delete extra_data[i];
+        }
+        extra_data.clear();
+    }
+
+private:
+
+    // the arguments of the current training (to create copies of the data)
+
+    struct TrainArgs
+    {
+        const CvMat* train_data;
+        int tflag;
+        const CvMat* responses;
+        const CvMat* var_idx;
+        const CvMat* sample_idx;
+        const CvMat* var_type;
+        const CvMat* missing_mask;
+        const CvDTreeParams* params;
+    };
+
+    // a tree of the forest (pointed at this forest once trained)
+
+    class ForestTree : public CvForestTree
+    {
+    public:
+
+        void set_forest(CvRTrees* _forest)
+        {
+            forest = _forest;
+        }
+    };
+
+    // the random number generator and active variable mask of one tree
+    // (CvForestTree takes both from the forest it is trained for)
+
+    class TreeContext : public CvRTrees
+    {
+    public:
+
+        TreeContext(cv::RNG* _rng, const CvMat* _active_var_mask)
+        {
+            rng = _rng;
+            active_var_mask = cvCloneMat(_active_var_mask);
+        }
+    };
+
+    // grows a range of trees
+
+    class TreeGrower : public cv::ParallelLoopBody
+    {
+    public:
+
+        TreeGrower(ParallelRTrees* _forest, const uint64* _tree_seeds) :
+            forest(_forest), tree_seeds(_tree_seeds) {}
+
+        virtual void operator()(const cv::Range& range) const
+        {
+            for (int k = range.start; k < range.end; k++)
+            {
+                forest->grow_tree(k, tree_seeds[k]);
+            }
+        }
+
+    private:
+
+        ParallelRTrees* forest;
+        const uint64* tree_seeds;
+    };
+
+    // a new copy of the training data of the current training
+
+    CvDTreeTrainData* new_train_data()
+    {
+        CvDTreeTrainData* train_data = new CvDTreeTrainData();
+        train_data->set_data(train_args->train_data, train_args->tflag,
+                             train_args->responses, train_args->var_idx,
+                             train_args->sample_idx, train_args->var_type,
+                             train_args->missing_mask, *train_args->params, true);
+        return train_data;
+    }
+
+    // take a copy of the training data from the pool (a new one if empty)
+
+    CvDTreeTrainData* acquire_data()
+    {
+        {
+            cv::AutoLock lock(pool_mutex);
+            if (!free_data.empty())
+            {
+                CvDTreeTrainData* train_data = free_data.back();
+                free_data.pop_back();
+                return train_data;
+            }
+        }
+
+        CvDTreeTrainData* train_data = new_train_data();
+
+        cv::AutoLock lock(pool_mutex);
+        extra_data.push_back(train_data);
+        return train_data;
+    }
+
+    void release_data(CvDTreeTrainData* train_data)
+    {
+        cv::AutoLock lock(pool_mutex);
+        free_data.push_back(train_data);
+    }
+
+    // grow tree k (as one iteration of CvRTrees::grow_forest()) with its own
+    // random number generator
+
+    void grow_tree(int k, uint64 tree_seed)
+    {
+        cv::RNG tree_rng(tree_seed);
+
+        // the bootstrap sample
+
+        cv::Mat sample_idx(1, nsamples, CV_32SC1);
+        int* idx = sample_idx.ptr<int>(0);
+        for (int i = 0; i < nsamples; i++)
+        {
+            idx[i] = tree_rng((unsigned) nsamples);
+        }
+        CvMat _sample_idx = sample_idx;
+
+        // train it in a copy of the training data (whose generator, used for
+        // clustering categories, is also the tree's)
+
+        CvDTreeTrainData* train_data = acquire_data();
+        cv::RNG* data_rng = train_data->rng;
+        train_data->rng = &tree_rng;
+
+        TreeContext context(&tree_rng, active_var_mask);
+        ForestTree* tree = new ForestTree;
+        tree->train(train_data, &_sample_idx, &context);
+        tree->set_forest(this);
+        trees[k] = tree;
+
+        train_data->rng = data_rng;
+        release_data(train_data);
+    }
+
+    // the out of bag votes of the forest so far on each training sample
+
+    struct OOBVotes
+    {
+        std::vector<float> samples;     // the training samples (as the trees see them)
+        std::vector<uchar> missing;
+        std::vector<float> responses;   // class index (classifier) or value
+        std::vector<int> votes;         // votes per class (classifier)
+        std::vector<int> leader;        // leading class and its votes
+        std::vector<int> max_votes;
+        std::vector<double> sum;        // sum of the predictions (regression)
+        std::vector<int> count;         // out of bag predictions
+        int n_oob;                      // samples with an out of bag prediction
+        double errors;                  // samples misclassified / squared error
+    };
+
+    void start_oob(OOBVotes& oob)
+    {
+        int var_count = data->var_count;
+
+        oob.samples.resize((size_t) nsamples * var_count);
+        oob.missing.resize((size_t) nsamples * var_count);
+        oob.responses.resize(nsamples);
+        data->get_vectors(0, &oob.samples[0], &oob.missing[0], &oob.responses[0],
+                          data->is_classifier);
+
+        if (data->is_classifier)
+        {
+            oob.votes.assign((size_t) nsamples * nclasses, 0);
+            oob.leader.assign(nsamples, 0);
+            oob.max_votes.assign(nsamples, 0);
+        }
+        else
+        {
+            oob.sum.assign(nsamples, 0.0);
+        }
+        oob.count.assign(nsamples, 0);
+        oob.n_oob = 0;
+        oob.errors = 0;
+    }
+
+    // the votes of tree k on the samples outside its bootstrap sample - returns
+    // the out of bag error of the forest to tree k (as CvRTrees, the fraction
+    // misclassified or the mean squared error)
+
+    float add_oob_votes(OOBVotes& oob, int k, uint64 tree_seed)
+    {
+        int var_count = data->var_count;
+
+        // (the bootstrap sample re-drawn from the tree's seed, as grow_tree())
+
+        std::vector<uchar> in_bag(nsamples, 0);
+        cv::RNG tree_rng(tree_seed);
+        for (int i = 0; i < nsamples; i++)
+        {
+            in_bag[tree_rng((unsigned) nsamples)] = 1;
+        }
+
+        for (int i = 0; i < nsamples; i++)
+        {
+            if (in_bag[i])
+            {
+                continue;
+            }
+
+            CvMat sample = cvMat(1, var_count, CV_32FC1, &oob.samples[(size_t) i * var_count]);
+            CvMat missing = cvMat(1, var_count, CV_8UC1, &oob.missing[(size_t) i * var_count]);
+            CvDTreeNode* node = trees[k]->predict(&sample, &missing, true);
+
+            if (oob.count[i]++ == 0)
+            {
+                oob.n_oob++;
+            }
+
+            if (data->is_classifier)
+            {
+                int truth = cvRound(oob.responses[i]);
+                bool was_wrong = (oob.count[i] > 1) && (oob.leader[i] != truth);
+
+                int c = node->class_idx;
+                if (++oob.votes[(size_t) i * nclasses + c] > oob.max_votes[i])
+                {
+                    oob.max_votes[i] = oob.votes[(size_t) i * nclasses + c];
+                    oob.leader[i] = c;
+                }
+                oob.errors += (oob.leader[i] != truth) - (was_wrong ? 1 : 0);
+            }
+            else
+            {
+                double before = (oob.count[i] > 1)
+                                ? oob.sum[i] / (oob.count[i] - 1) - oob.responses[i] : 0;
+                oob.sum[i] += node->value;
+                double after = oob.sum[i] / oob.count[i] - oob.responses[i];
+                oob.errors += after * after - before * before;
+            }
+        }
+
+        return (oob.n_oob > 0) ? (float) (oob.errors / oob.n_oob) : 0.f;
+    }
+
+    // the training samples as get_vectors() (for the permutation importance)
+
+    struct ImportanceSamples
+    {
+        const float* samples;
+        const uchar* missing;
+        const float* responses;
+    };
+
+    // adds the importance totals of the trees of a range of the parts (a
+    // part per thread, its trees consecutive)
+
+    class ImportanceCounter : public cv::ParallelLoopBody
+    {
+    public:
+
+        ImportanceCounter(const ParallelRTrees* _forest, int _n_parts,
+                          const ImportanceSamples& _oob_samples, double* _gini, double* _lost) :
+            forest(_forest), n_parts(_n_parts), oob_samples(_oob_samples),
+            gini(_gini), lost(_lost) {}
+
+        virtual void operator()(const cv::Range& range) const
+        {
+            int var_count = forest->data->var_count;
+            for (int p = range.start; p < range.end; p++)
+            {
+                int k0 = (int) ((int64) p * forest->ntrees / n_parts);
+                int k1 = (int) ((int64) (p + 1) * forest->ntrees / n_parts);
+                for (int k = k0; k < k1; k++)
+                {
+                    forest->add_importance(k, oob_samples, gini + (size_t) p * var_count,
+                                           lost ? lost + (size_t) p * var_count : 0);
+                }
+            }
+        }
+
+    private:
+
+        const ParallelRTrees* forest;
+        int n_parts;
+        ImportanceSamples oob_samples;
+        double* gini;
+        double* lost;
+    };
+
+    // add the split qualities of tree k to gini and (if lost is given) the
+    // out of bag samples correctly classified (or squared error) lost by
+    // shuffling each attribute it tests
+
+    void add_importance(int k, const ImportanceSamples& oob_samples, double* gini,
+                        double* lost) const
+    {
+        int var_count = data->var_count;
+
+        // the split qualities (of every split, with the surrogates, as
+        // CvDTree::get_var_importance())
+
+        std::vector<uchar> tested(var_count, 0);
+        std::vector<const CvDTreeNode*> nodes(1, trees[k]->get_root());
+        while (!nodes.empty())
+        {
+            const CvDTreeNode* node = nodes.back();
+            nodes.pop_back();
+            if (!node || !node->left)
+            {
+                continue;
+            }
+            for (const CvDTreeSplit* split = node->split; split; split = split->next)
+            {
+                gini[split->var_idx] += split->quality;
+                tested[split->var_idx] = 1;
+            }
+            nodes.push_back(node->right);
+            nodes.push_back(node->left);
+        }
+
+        if (!lost)
+        {
+            return;
+        }
+
+        // the out of bag samples (the bootstrap sample re-drawn from the
+        // tree's seed, as grow_tree(), whose generator then shuffles)
+
+        std::vector<uchar> in_bag(nsamples, 0);
+        cv::RNG tree_rng(tree_seeds[k]);
+        for (int i = 0; i < nsamples; i++)
+        {
+            in_bag[tree_rng((unsigned) nsamples)] = 1;
+        }
+
+        std::vector<int> oob;
+        for (int i = 0; i < nsamples; i++)
+        {
+            if (!in_bag[i])
+            {
+                oob.push_back(i);
+            }
+        }
+        int n_oob = (int) oob.size();
+
+        double base_loss = 0;
+        for (int j = 0; j < n_oob; j++)
+        {
+            size_t ofs = (size_t) oob[j] * var_count;
+            base_loss += sample_loss(k, &oob_samples.samples[ofs], &oob_samples.missing[ofs],
+                                     oob_samples.responses[oob[j]]);
+        }
+
+        // shuffle each attribute the tree tests among the out of bag samples
+        // (the others cannot change its predictions)
+
+        std::vector<float> sample(var_count), permuted(n_oob);
+        std::vector<uchar> sample_missing(var_count), permuted_missing(n_oob);
+
+        for (int vi = 0; vi < var_count; vi++)
+        {
+            if (!tested[vi])
+            {
+                continue;
+            }
+
+            for (int j = 0; j < n_oob; j++)
+            {
+                permuted[j] = oob_samples.samples[(size_t) oob[j] * var_count + vi];
+                permuted_missing[j] = oob_samples.missing[(size_t) oob[j] * var_count + vi];
+            }
+            for (int j = n_oob - 1; j > 0; j--)
+            {
+                int r = tree_rng.uniform(0, j + 1);
+                std::swap(permuted[j], permuted[r]);
+                std::swap(permuted_missing[j], permuted_missing[r]);
+            }
+
+            double loss = 0;
+            for (int j = 0; j < n_oob; j++)
+            {
+                size_t ofs = (size_t) oob[j] * var_count;
+                std::copy(&oob_samples.samples[ofs], &oob_samples.samples[ofs] + var_count,
+                          sample.begin());
+                std::copy(&oob_samples.missing[ofs], &oob_samples.missing[ofs] + var_count,
+                          sample_missing.begin());
+                sample[vi] = permuted[j];
+                sample_missing[vi] = permuted_missing[j];
+
+                loss += sample_loss(k, &sample[0], &sample_missing[0], oob_samples.responses[oob[j]]);
+            }
+
+            lost[vi] += loss - base_loss;
+        }
+    }
+
+    // whether tree k misclassifies a sample (or its squared error)
+
+    double sample_loss(int k, const float* sample, const uchar* missing, float response) const
+    {
+        int var_count = data->var_count;
+        CvMat _sample = cvMat(1, var_count, CV_32FC1, (void*) sample);
+        CvMat _missing = cvMat(1, var_count, CV_8UC1, (void*) missing);
+        CvDTreeNode* node = trees[k]->predict(&_sample, &_missing, true);
+
+        if (data->is_classifier)
+        {
+            return (node->class_idx != cvRound(response)) ? 1 : 0;
+        }
+        return (node->value - response) * (node->value - response);
+    }
+
+    // scale values to sum to 1 (if not all 0)
+
+    static void normalise(std::vector<double>& values)
+    {
+        double sum = 0;
+        for (size_t i = 0; i < values.size(); i++)
+        {
+            sum += values[i];
+        }
+        for (size_t i = 0; (sum > 0) && (i < values.size()); i++)
+        {
+            values[i] /= sum;
+        }
+    }
+
+    std::vector<uint64> tree_seeds;     // the seed of each tree trained
+    std::vector<double> gini_importance;
+
+    OOBCallback oob_callback;
+    void* oob_user_data;
+    std::vector<float> oob_errors;
+
+    const TrainArgs* train_args;
+
+    // copies of the training data (data is the first) and those not in use
+
+    std::vector<CvDTreeTrainData*> extra_data;
+    std::vector<CvDTreeTrainData*> free_data;
+    cv::Mutex pool_mutex;
+};
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,113 @@
+// Support : hardware cache miss counters (Linux perf events)
+
+// Counts the L1 data cache read misses or last level cache misses of the
+// calling thread between start() and stop() using the kernel performance
+// counters (perf_event_open). Where these are not available (not Linux, no
+// PMU access e.g. in a virtual machine, or perf_event_paranoid too strict)
+// available() is false and stop() returns -1.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#ifndef PERF_COUNTER_H
+#define PERF_COUNTER_H
+
+#include <string.h>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+/******************************************************************************/
+
+enum
+{
+    CACHE_MISSES_L1D = 0,  // L1 data cache read misses
+    CACHE_MISSES_LLC       // last level cache misses
+};
+
+class CacheMissCounter
+{
+public:
+
+    CacheMissCounter(int level = CACHE_MISSES_L1D) : fd(-1)
+    {
+#ifdef __linux__
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        if (level == CACHE_MISSES_LLC)
+        {
+            attr.type = PERF_TYPE_HARDWARE;
+            attr.config = PERF_COUNT_HW_CACHE_MISSES;
+        }
+        else
+        {
+            attr.type = PERF_TYPE_HW_CACHE;
+            attr.config = PERF_COUNT_HW_CACHE_L1D
+                          | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+                          | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+        }
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+
+        fd = (int) syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+#else
+        (void) level;
+#endif
+    }
+
+    ~CacheMissCounter()
+    {
+#ifdef __linux__
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+#endif
+    }
+
+    bool available() const { return fd >= 0; }
+
+    void start()
+    {
+#ifdef __linux__
+        if (fd >= 0)
+        {
+            ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+            ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+        }
+#endif
+    }
+
+    // misses since start() (-1 if not available)
+
+    long long stop()
+    {
+#ifdef __linux__
+        if (fd >= 0)
+        {
+            long long count = 0;
+            ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+            if (read(fd, &count, sizeof(count)) == (ssize_t) sizeof(count))
+            {
+                return count;
+            }
+        }
+#endif
+        return -1;
+    }
+
+private:
+
+    int fd;
+};
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,525 @@
+// Support : random forest training from a single presort of the training data
+
+// CvRTrees::train() prepares the training data of each tree of the forest
+// from that tree's bootstrap sample (CvDTreeTrainData::subsample_data()),
+// rebuilding the sorted sample index of every attribute over the sample, and
+// CvDTree then partitions every one of those indices at every split - for
+// data of many samples and attributes (e.g. the 617 attributes of speech_ex)
+// this setup, not the split search, dominates the training.
+//
+// PresortForest sorts each attribute of the training data once, and every
+// tree of the forest uses that one presort: a tree's bootstrap sample is
+// simply a count (weight) per training sample of the times it was drawn (0
+// => out of bag). Each tree is grown a level at a time - for each attribute,
+// one scan of its presorted samples evaluates every split of that attribute
+// for all of the nodes of the level that are considering it (the samples of
+// a node are those the scan meets assigned to it, in sorted order, each
+// weighted by its count). Deeper in the tree, once the nodes considering an
+// attribute hold few enough samples that sorting just those is cheaper than
+// a scan of the whole presort, each of them sorts its own samples instead
+// (decided per attribute at each level). The nodes then take the best of the
+// nactive_vars randomly chosen attributes each considers (Gini impurity,
+// class priors and thresholds midway between adjacent values, as CvDTree),
+// and stop as CvDTree (maximum depth, minimum sample count, a single class).
+//
+// As ParallelRTrees (parallel_rtrees.h) the trees are grown concurrently,
+// each with its own random number generator seeded from a master seed (the
+// forest is the same whatever the number of threads), and the forest is
+// saved in the CvRTrees model format - CvRTrees::load() reads it for the
+// usual prediction. Only classification of ordered (CV_VAR_NUMERICAL)
+// attributes, none missing, is supported; the out of bag error and the
+// variable importance are not computed.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#ifndef PRESORT_FOREST_H
+#define PRESORT_FOREST_H
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+#include <vector>
+#include <algorithm>
+
+#include "grown_forest.h"
+
+/******************************************************************************/
+
+class PresortForest : public GrownForest
+{
+public:
+
+    PresortForest() : presort_time(0), grow_time(0) {}
+
+    // wall time (seconds) of each phase of the last training
+
+    double presort_time;    // sorting the attributes (once)
+    double grow_time;       // growing all of the trees
+
+    // train the forest
+    // data = attributes (1 sample per row, CV_32F)
+    // responses = integer class labels (1 sample per row, CV_32F)
+    // params = forest parameters as CvRTrees (max_depth, min_sample_count,
+    //          priors, nactive_vars and term_crit.max_iter are used)
+
+    bool train(const cv::Mat& data, const cv::Mat& responses, const CvRTParams& params)
+    {
+        clear();
+        if (!set_training(data, responses, params))
+        {
+            return false;
+        }
+
+        // sort each attribute once - its samples in order with their values,
+        // and its values in sample order (to partition the nodes)
+
+        int64 start = cv::getTickCount();
+
+        sorted_samples.resize((size_t) nvars * nsamples);
+        sorted_values.resize((size_t) nvars * nsamples);
+        columns.resize((size_t) nvars * nsamples);
+
+        std::vector< std::pair<float, int> > sorted(nsamples);
+        for (int vi = 0; vi < nvars; vi++)
+        {
+            float* column = &columns[(size_t) vi * nsamples];
+            for (int i = 0; i < nsamples; i++)
+            {
+                column[i] = data.at<float>(i, vi);
+                sorted[i] = std::make_pair(column[i], i);
+            }
+            std::sort(sorted.begin(), sorted.end());
+
+            for (int i = 0; i < nsamples; i++)
+            {
+                sorted_values[(size_t) vi * nsamples + i] = sorted[i].first;
+                sorted_samples[(size_t) vi * nsamples + i] = sorted[i].second;
+            }
+        }
+
+        presort_time = (double) (cv::getTickCount() - start) / cv::getTickFrequency();
+
+        std::vector<uint64> tree_seeds;
+        int ntrees = draw_tree_seeds(params, tree_seeds);
+        if (ntrees < 1)
+        {
+            return false;
+        }
+
+        // grow the trees (one task each)
+
+        start = cv::getTickCount();
+
+        trees.resize(ntrees);
+        cv::parallel_for_(cv::Range(0, ntrees), TreeGrower(this, &tree_seeds[0]), ntrees);
+
+        grow_time = (double) (cv::getTickCount() - start) / cv::getTickFrequency();
+
+        // (the presort is no longer needed)
+
+        std::vector<int>().swap(sorted_samples);
+        std::vector<float>().swap(sorted_values);
+        std::vector<float>().swap(columns);
+        std::vector<int>().swap(responses_idx);
+
+        return true;
+    }
+
+    virtual void clear()
+    {
+        GrownForest::clear();
+        sorted_samples.clear();
+        sorted_values.clear();
+        columns.clear();
+    }
+
+private:
+
+    // grows a range of trees
+
+    class TreeGrower : public cv::ParallelLoopBody
+    {
+    public:
+
+        TreeGrower(PresortForest* _forest, const uint64* _tree_seeds) :
+            forest(_forest), tree_seeds(_tree_seeds) {}
+
+        virtual void operator()(const cv::Range& range) const
+        {
+            for (int k = range.start; k < range.end; k++)
+            {
+                forest->grow_tree(k, tree_seeds[k]);
+            }
+        }
+
+    private:
+
+        PresortForest* forest;
+        const uint64* tree_seeds;
+    };
+
+    // the nodes of the level being grown (by slot) and their split search
+
+    struct Level
+    {
+        std::vector<int> node;          // node index of each slot
+        std::vector<double> totals;     // class totals (weighted, per slot)
+        std::vector<double> weight;     // total weight
+        std::vector<double> sum2;       // sum of the squared class totals
+        std::vector<int> rows;          // distinct samples
+
+        std::vector<double> best_quality;
+        std::vector<int> best_var;
+        std::vector<float> best_c;
+
+        // the scan of the attribute in progress (per slot) - the totals left
+        // of the split and the last value met
+
+        std::vector<double> lc;
+        std::vector<double> left_weight;
+        std::vector<double> lsum2;
+        std::vector<double> rsum2;
+        std::vector<float> last_value;
+        std::vector<char> started;
+
+        void clear()
+        {
+            node.clear();
+            totals.clear();
+            weight.clear();
+            sum2.clear();
+            rows.clear();
+            best_quality.clear();
+            best_var.clear();
+            best_c.clear();
+        }
+    };
+
+    // add a node with the given (weighted) class totals and sample count -
+    // returns its slot in the next level if it is to be split, else -1
+
+    int add_node(std::vector<Node>& nodes, Level& next, const double* totals,
+                 int sample_count, int n_rows, int depth) const
+    {
+        Node node = leaf_node(totals, sample_count, depth);
+
+        int n_nonzero = 0;
+        double weight = 0, sum2 = 0;
+        for (int k = 0; k < nclasses; k++)
+        {
+            weight += totals[k];
+            sum2 += totals[k] * totals[k];
+            n_nonzero += (totals[k] > 0);
+        }
+
+        nodes.push_back(node);
+
+        // stop as CvDTree (depth, sample count or a pure node)
+
+        if ((depth >= tree_max_depth) || (sample_count <= min_sample_count)
+                || (n_nonzero <= 1))
+        {
+            return -1;
+        }
+
+        int slot = (int) next.node.size();
+        next.node.push_back((int) nodes.size() - 1);
+        next.totals.insert(next.totals.end(), totals, totals + nclasses);
+        next.weight.push_back(weight);
+        next.sum2.push_back(sum2);
+        next.rows.push_back(n_rows);
+        next.best_quality.push_back(0);
+        next.best_var.push_back(-1);
+        next.best_c.push_back(0);
+        return slot;
+    }
+
+    // start the scan of an attribute for the node of slot s (all of its
+    // samples to the right)
+
+    void start_search(Level& level, int s) const
+    {
+        std::fill(level.lc.begin() + (size_t) s * nclasses,
+                  level.lc.begin() + (size_t) (s + 1) * nclasses, 0.0);
+        level.left_weight[s] = level.lsum2[s] = 0;
+        level.rsum2[s] = level.sum2[s];
+        level.started[s] = 0;
+    }
+
+    // the next sample i (value v, drawn count times) of the scan of attribute
+    // vi for the node of slot s, in increasing order of value - evaluates the
+    // split between the previous value and this one (Gini, maximising
+    // sum(lc^2)/L + sum(rc^2)/R as CvDTree) then moves it to the left
+
+    void search_sample(Level& level, int s, int vi, int i, float v, int count) const
+    {
+        double L = level.left_weight[s];
+        double R = level.weight[s] - L;
+        if (level.started[s] && (v != level.last_value[s]) && (L > 0) && (R > 0))
+        {
+            double quality = level.lsum2[s] / L + level.rsum2[s] / R;
+            if (quality > level.best_quality[s])
+            {
+                level.best_quality[s] = quality;
+                level.best_var[s] = vi;
+                level.best_c[s] = (level.last_value[s] + v) * 0.5f;
+            }
+        }
+
+        int c = responses_idx[i];
+        double w = count * class_weights[c];
+        double& left_c = level.lc[(size_t) s * nclasses + c];
+        double right_c = level.totals[(size_t) s * nclasses + c] - left_c;
+        level.lsum2[s] += w * (2 * left_c + w);
+        level.rsum2[s] -= w * (2 * right_c - w);
+        left_c += w;
+        level.left_weight[s] += w;
+        level.last_value[s] = v;
+        level.started[s] = 1;
+    }
+
+    // grow tree k with its own random number generator
+
+    void grow_tree(int k, uint64 tree_seed)
+    {
+        cv::RNG rng(tree_seed);
+        std::vector<Node>& nodes = trees[k];
+        nodes.clear();
+
+        // the bootstrap sample as a count per sample
+
+        std::vector<int> counts(nsamples, 0);
+        for (int i = 0; i < nsamples; i++)
+        {
+            counts[rng((unsigned) nsamples)]++;
+        }
+
+        // the root (slot 0 of the first level), the slot of each sample in
+        // the level being grown (-1 => out of bag or in a leaf)
+
+        Level level, next;
+        std::vector<int> slot(nsamples, -1);
+        std::vector<double> totals(nclasses, 0.0);
+        int n_rows = 0;
+        for (int i = 0; i < nsamples; i++)
+        {
+            totals[responses_idx[i]] += counts[i] * class_weights[responses_idx[i]];
+            n_rows += (counts[i] > 0);
+        }
+
+        if (add_node(nodes, level, &totals[0], nsamples, n_rows, 0) == 0)
+        {
+            for (int i = 0; i < nsamples; i++)
+            {
+                slot[i] = counts[i] ? 0 : -1;
+            }
+        }
+
+        std::vector<int> vars(nvars);
+        for (int vi = 0; vi < nvars; vi++)
+        {
+            vars[vi] = vi;
+        }
+        std::vector< std::vector<int> > var_slots(nvars);
+        std::vector<int> considering;
+        std::vector<int> slot_ofs, slot_rows;
+        std::vector< std::pair<float, int> > node_values;
+        std::vector<int> child(nsamples);
+
+        for (int depth = 0; !level.node.empty(); depth++)
+        {
+            int n_slots = (int) level.node.size();
+
+            // each node considers nactive_vars attributes chosen at random
+
+            for (int vi = 0; vi < nvars; vi++)
+            {
+                var_slots[vi].clear();
+            }
+            for (int s = 0; s < n_slots; s++)
+            {
+                for (int j = 0; j < nactive_vars; j++)
+                {
+                    std::swap(vars[j], vars[j + rng((unsigned) (nvars - j))]);
+                    var_slots[vars[j]].push_back(s);
+                }
+            }
+
+            considering.assign(n_slots, -1);
+            level.lc.resize((size_t) n_slots * nclasses);
+            level.left_weight.resize(n_slots);
+            level.lsum2.resize(n_slots);
+            level.rsum2.resize(n_slots);
+            level.last_value.resize(n_slots);
+            level.started.resize(n_slots);
+
+            // the samples of each slot (for the nodes sorted locally)
+
+            slot_ofs.assign(n_slots + 1, 0);
+            for (int s = 0; s < n_slots; s++)
+            {
+                slot_ofs[s + 1] = slot_ofs[s] + level.rows[s];
+            }
+            slot_rows.resize(slot_ofs[n_slots]);
+            for (int i = 0, s; i < nsamples; i++)
+            {
+                if ((s = slot[i]) >= 0)
+                {
+                    slot_rows[slot_ofs[s]++] = i;
+                }
+            }
+            for (int s = n_slots; s > 0; s--)
+            {
+                slot_ofs[s] = slot_ofs[s - 1];
+            }
+            slot_ofs[0] = 0;
+
+            for (int vi = 0; vi < nvars; vi++)
+            {
+                const std::vector<int>& vslots = var_slots[vi];
+                if (vslots.empty())
+                {
+                    continue;
+                }
+
+                int var_rows = 0;
+                for (size_t j = 0; j < vslots.size(); j++)
+                {
+                    int s = vslots[j];
+                    considering[s] = vi;
+                    start_search(level, s);
+                    var_rows += level.rows[s];
+                }
+
+                // once the nodes considering the attribute are small enough
+                // sorting their own samples is cheaper than a scan of the
+                // whole of its presort (which otherwise evaluates the splits
+                // of all of them at once)
+
+                int mean_rows = var_rows / (int) vslots.size();
+                int log_rows = 1;
+                while ((1 << log_rows) < mean_rows)
+                {
+                    log_rows++;
+                }
+
+                if (var_rows * log_rows < nsamples)
+                {
+                    const float* column = &columns[(size_t) vi * nsamples];
+                    for (size_t j = 0; j < vslots.size(); j++)
+                    {
+                        int s = vslots[j];
+                        node_values.clear();
+                        for (int r = slot_ofs[s]; r < slot_ofs[s + 1]; r++)
+                        {
+                            node_values.push_back(std::make_pair(column[slot_rows[r]],
+                                                                 slot_rows[r]));
+                        }
+                        std::sort(node_values.begin(), node_values.end());
+
+                        for (size_t r = 0; r < node_values.size(); r++)
+                        {
+                            search_sample(level, s, vi, node_values[r].second,
+                                          node_values[r].first, counts[node_values[r].second]);
+                        }
+                    }
+                    continue;
+                }
+
+                const int* samples = &sorted_samples[(size_t) vi * nsamples];
+                const float* values = &sorted_values[(size_t) vi * nsamples];
+
+                for (int j = 0; j < nsamples; j++)
+                {
+                    int i = samples[j];
+                    int s = slot[i];
+                    if ((s >= 0) && (considering[s] == vi))
+                    {
+                        search_sample(level, s, vi, i, values[j], counts[i]);
+                    }
+                }
+            }
+
+            // split the nodes that found a split into the children (whose
+            // class totals and sample counts are then gathered)
+
+            int first_child = (int) nodes.size();
+            int n_children = 0;
+            std::vector<int> slot_child(n_slots, -1);
+            for (int s = 0; s < n_slots; s++)
+            {
+                if (level.best_var[s] >= 0)
+                {
+                    Node& node = nodes[level.node[s]];
+                    node.var = level.best_var[s];
+                    node.c = level.best_c[s];
+                    node.quality = (float) level.best_quality[s];
+                    node.left = first_child + n_children;
+                    node.right = node.left + 1;
+                    slot_child[s] = n_children;
+                    n_children += 2;
+                }
+            }
+
+            std::vector<double> child_totals((size_t) n_children * nclasses, 0.0);
+            std::vector<int> child_counts(n_children, 0);
+            std::vector<int> child_rows(n_children, 0);
+
+            for (int i = 0; i < nsamples; i++)
+            {
+                int s = slot[i];
+                if (s < 0)
+                {
+                    continue;
+                }
+                if (slot_child[s] < 0)
+                {
+                    slot[i] = -1;
+                    continue;
+                }
+
+                const Node& node = nodes[level.node[s]];
+                int ch = slot_child[s]
+                         + ((columns[(size_t) node.var * nsamples + i] <= node.c) ? 0 : 1);
+                int c = responses_idx[i];
+                child_totals[(size_t) ch * nclasses + c] += counts[i] * class_weights[c];
+                child_counts[ch] += counts[i];
+                child_rows[ch]++;
+                child[i] = ch;
+            }
+
+            // add the children (those to be split form the next level)
+
+            next.clear();
+            std::vector<int> child_slot(n_children);
+            for (int ch = 0; ch < n_children; ch++)
+            {
+                child_slot[ch] = add_node(nodes, next, &child_totals[(size_t) ch * nclasses],
+                                          child_counts[ch], child_rows[ch], depth + 1);
+            }
+
+            for (int i = 0; i < nsamples; i++)
+            {
+                if (slot[i] >= 0)
+                {
+                    slot[i] = child_slot[child[i]];
+                }
+            }
+
+            std::swap(level, next);
+        }
+    }
+
+    // the presort (per attribute) and the attribute values (per attribute,
+    // in sample order)
+
+    std::vector<int> sorted_samples;
+    std::vector<float> sorted_values;
+    std::vector<float> columns;
+};
+
+/******************************************************************************/
+
+#endif
@@ -0,0 +1,392 @@
+// Support : QuickScorer bitvector evaluation of a random forest
+
+// Rather than walking each tree node by node (a data dependent branch per
+// level per tree), QuickScorer (Lucchese et al., SIGIR 2015) evaluates the
+// whole forest one feature at a time. The leaves of each tree are numbered
+// left to right and each tree keeps a bitvector of the leaves still
+// reachable, initially all of them. For every split node whose test a sample
+// fails (value > threshold, so the sample goes right) the leaves of the
+// node's left subtree cannot be reached and are cleared with a bitwise AND.
+// The exit leaf of each tree is then the leftmost leaf left set - the leaf
+// the node by node traversal reaches. The split nodes are stored per feature
+// sorted by threshold, so for each feature of a sample only the (contiguous)
+// run of nodes whose threshold is below its value is visited, as a simple
+// loop over small arrays.
+//
+// Trees may have any number of leaves: the bitvector of a tree is as many 64
+// bit words as it needs and, as the leaves of a subtree are consecutive, each
+// node's mask is stored as its first and last word (words between them are
+// simply cleared). Only forests of ordered (numerical) splits can be compiled
+// (build() returns false otherwise). Classification votes are counted and
+// ties broken as CvRTrees::predict(), regression is the mean of the trees, so
+// predictions are identical to it.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#ifndef QUICKSCORER_H
+#define QUICKSCORER_H
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+#include <vector>
+#include <algorithm>
+#include <string.h>
+
+#include "flat_dtree.h"
+
+/******************************************************************************/
+
+class QuickScorer
+{
+public:
+
+    QuickScorer() : var_all(0), n_words(0), n_classes(0) {}
+
+    // compile the trees of a trained / loaded forest (CvRTrees or CvERTrees)
+    // - returns false if it has no trees or a categorical split
+
+    bool build(const CvRTrees* forest)
+    {
+        clear();
+
+        int ntrees = forest->get_tree_count();
+        if (ntrees < 1)
+        {
+            return false;
+        }
+
+        std::vector<FlatDTree> trees(ntrees);
+        for (int k = 0; k < ntrees; k++)
+        {
+            if (!trees[k].build(forest->get_tree(k)))
+            {
+                return false;
+            }
+        }
+
+        return build(trees, forest->get_tree(0)->get_data()->is_classifier);
+    }
+
+    // compile flattened trees (as above)
+
+    bool build(const std::vector<FlatDTree>& trees, bool is_classifier)
+    {
+        clear();
+
+        int ntrees = (int) trees.size();
+        if (ntrees < 1)
+        {
+            return false;
+        }
+
+        // number the leaves of each tree left to right recording the leaf
+        // range of the left subtree of every split node
+
+        std::vector<Condition> conditions;
+        leaf_ofs.push_back(0);
+
+        for (int k = 0; k < ntrees; k++)
+        {
+            for (int n = 0; n < trees[k].get_node_count(); n++)
+            {
+                if (trees[k].split[n] >= 0)
+                {
+                    clear();
+                    return false;
+                }
+            }
+
+            int first_leaf, last_leaf;
+            add_nodes(trees[k], 0, k, conditions, first_leaf, last_leaf);
+            leaf_ofs.push_back((int) leaf_value.size());
+            var_all = MAX(var_all, trees[k].get_var_all());
+        }
+
+        // the bitvector words of each tree
+
+        tree_word.push_back(0);
+        for (int k = 0; k < ntrees; k++)
+        {
+            int n_leaves = leaf_ofs[k + 1] - leaf_ofs[k];
+            tree_word.push_back(tree_word[k] + (n_leaves + 63) / 64);
+        }
+        n_words = tree_word[ntrees];
+
+        // the conditions grouped by feature, each sorted by threshold
+
+        std::sort(conditions.begin(), conditions.end());
+
+        feature_ofs.assign(var_all + 1, 0);
+        for (size_t i = 0; i < conditions.size(); i++)
+        {
+            const Condition& c = conditions[i];
+            feature_ofs[c.feature + 1]++;
+
+            int first_word = tree_word[c.tree] + c.first_leaf / 64;
+            int last_word = tree_word[c.tree] + c.last_leaf / 64;
+            int first_bit = c.first_leaf % 64;
+            int last_bit = c.last_leaf % 64;
+
+            threshold.push_back(c.threshold);
+            first.push_back(first_word);
+            last.push_back(last_word);
+            first_mask.push_back(~leaf_bits(first_bit,
+                                            (first_word == last_word) ? last_bit : 63));
+            last_mask.push_back(~leaf_bits(0, last_bit));
+        }
+        for (int f = 0; f < var_all; f++)
+        {
+            feature_ofs[f + 1] += feature_ofs[f];
+        }
+
+        // for a classifier, the class (index into class_values) of each leaf
+
+        if (is_classifier)
+        {
+            class_values = leaf_value;
+            std::sort(class_values.begin(), class_values.end());
+            class_values.erase(std::unique(class_values.begin(), class_values.end()),
+                               class_values.end());
+            n_classes = (int) class_values.size();
+
+            leaf_class.resize(leaf_value.size());
+            for (size_t l = 0; l < leaf_value.size(); l++)
+            {
+                leaf_class[l] = (int) (std::lower_bound(class_values.begin(),
+                                       class_values.end(), leaf_value[l])
+                                       - class_values.begin());
+            }
+        }
+
+        return true;
+    }
+
+    void clear()
+    {
+        feature_ofs.clear();
+        threshold.clear();
+        first.clear();
+        last.clear();
+        first_mask.clear();
+        last_mask.clear();
+        tree_word.clear();
+        leaf_ofs.clear();
+        leaf_value.clear();
+        leaf_class.clear();
+        class_values.clear();
+        var_all = n_words = n_classes = 0;
+    }
+
+    // predict a single sample (pointer to var_all floats)
+
+    float predict(const float* sample) const
+    {
+        std::vector<uint64> leaves(MAX(n_words, 1));
+        std::vector<int> votes(n_classes);
+        return predict(sample, &leaves[0], votes.empty() ? 0 : &votes[0]);
+    }
+
+    // predict a batch of samples (1 sample per row, CV_32F) into results (1
+    // result per row, CV_32F)
+
+    void predict(const cv::Mat& samples, cv::Mat& results) const
+    {
+        results.create(samples.rows, 1, CV_32F);
+
+        std::vector<uint64> leaves(MAX(n_words, 1));
+        std::vector<int> votes(n_classes);
+        for (int i = 0; i < samples.rows; i++)
+        {
+            results.at<float>(i, 0) = predict(samples.ptr<float>(i), &leaves[0],
+                                              votes.empty() ? 0 : &votes[0]);
+        }
+    }
+
+    int get_tree_count() const { return (int) leaf_ofs.size() - 1; }
+    int get_leaf_count() const { return (int) leaf_value.size(); }
+    int get_condition_count() const { return (int) threshold.size(); }
+    int get_word_count() const { return n_words; }
+
+    // memory used by the arrays scanned at prediction
+
+    size_t get_size_bytes() const
+    {
+        return threshold.size() * (sizeof(float) + 2 * sizeof(int) + 2 * sizeof(uint64))
+               + feature_ofs.size() * sizeof(int)
+               + leaf_value.size() * (sizeof(double) + sizeof(int))
+               + tree_word.size() * sizeof(int);
+    }
+
+private:
+
+    // a split node: the leaves [first_leaf, last_leaf] of its left subtree
+    // are unreachable when the feature value is above the threshold
+
+    struct Condition
+    {
+        int feature;
+        float threshold;
+        int tree;
+        int first_leaf;
+        int last_leaf;
+
+        bool operator<(const Condition& c) const
+        {
+            return (feature < c.feature)
+                   || ((feature == c.feature) && (threshold < c.threshold));
+        }
+    };
+
+    // number the leaves below node n (of tree k) left to right, adding a
+    // condition for each split node - returns the range of leaves
+
+    void add_nodes(const FlatDTree& tree, int n, int k,
+                   std::vector<Condition>& conditions, int& first_leaf, int& last_leaf)
+    {
+        if (tree.feature[n] < 0)
+        {
+            first_leaf = last_leaf = (int) leaf_value.size() - leaf_ofs[k];
+            leaf_value.push_back(tree.value[n]);
+            return;
+        }
+
+        int left_last, right_first;
+        add_nodes(tree, tree.left[n], k, conditions, first_leaf, left_last);
+        add_nodes(tree, tree.right[n], k, conditions, right_first, last_leaf);
+
+        Condition c;
+        c.feature = tree.feature[n];
+        c.threshold = tree.threshold[n];
+        c.tree = k;
+        c.first_leaf = first_leaf;
+        c.last_leaf = left_last;
+        conditions.push_back(c);
+    }
+
+    // the bits first ... last of a word
+
+    static uint64 leaf_bits(int first_bit, int last_bit)
+    {
+        uint64 upto = (last_bit == 63) ? ~(uint64) 0 : (((uint64) 1 << (last_bit + 1)) - 1);
+        return upto & ~(((uint64) 1 << first_bit) - 1);
+    }
+
+    // index of the lowest set bit of a (non zero) word
+
+    static int lowest_bit(uint64 w)
+    {
+#if defined(__GNUC__)
+        return __builtin_ctzll(w);
+#else
+        int b = 0;
+        while (!(w & 1))
+        {
+            w >>= 1;
+            b++;
+        }
+        return b;
+#endif
+    }
+
+    // predict a sample with the given bitvector (n_words) and vote (n_classes)
+    // work space
+
+    float predict(const float* sample, uint64* leaves, int* votes) const
+    {
+        memset(leaves, 0xFF, n_words * sizeof(uint64));
+
+        // clear the left subtree leaves of every node the sample fails, one
+        // feature at a time (nodes in increasing threshold order, so stopping
+        // at the first it passes - !(x <= t) as the node by node traversal)
+
+        const float* t = threshold.empty() ? 0 : &threshold[0];
+        for (int f = 0; f < var_all; f++)
+        {
+            float x = sample[f];
+            int end = feature_ofs[f + 1];
+            for (int i = feature_ofs[f]; (i < end) && !(x <= t[i]); i++)
+            {
+                int w = first[i];
+                leaves[w] &= first_mask[i];
+                if (last[i] != w)
+                {
+                    for (w++; w < last[i]; w++)
+                    {
+                        leaves[w] = 0;
+                    }
+                    leaves[w] &= last_mask[i];
+                }
+            }
+        }
+
+        // the exit leaf of each tree (the leftmost reachable) and the vote /
+        // mean over them (as CvRTrees::predict())
+
+        int ntrees = get_tree_count();
+
+        if (n_classes > 0)
+        {
+            memset(votes, 0, n_classes * sizeof(int));
+            int max_votes = 0;
+            int leader = 0;
+
+            for (int k = 0; k < ntrees; k++)
+            {
+                int c = leaf_class[leaf_ofs[k] + exit_leaf(k, leaves)];
+                if (++votes[c] > max_votes)
+                {
+                    max_votes = votes[c];
+                    leader = c;
+                }
+            }
+            return (float) class_values[leader];
+        }
+
+        double sum = 0;
+        for (int k = 0; k < ntrees; k++)
+        {
+            sum += leaf_value[leaf_ofs[k] + exit_leaf(k, leaves)];
+        }
+        return (float) (sum / ntrees);
+    }
+
+    int exit_leaf(int k, const uint64* leaves) const
+    {
+        int w = tree_word[k];
+        while (!leaves[w])
+        {
+            w++;
+        }
+        return (w - tree_word[k]) * 64 + lowest_bit(leaves[w]);
+    }
+
+    // the conditions, grouped by feature (feature_ofs) and each sorted by
+    // threshold - the bitvector words first ... last are cleared by the masks
+
+    std::vector<int> feature_ofs;
+    std::vector<float> threshold;
+    std::vector<int> first;
+    std::vector<int> last;
+    std::vector<uint64> first_mask;
+    std::vector<uint64> last_mask;
+
+    // per tree, its first bitvector word and its first leaf
+
+    std::vector<int> tree_word;
+    std::vector<int> leaf_ofs;
+
+    std::vector<double> leaf_value;     // value of each leaf
+    std::vector<int> leaf_class;        // class index of each leaf (classifier)
+    std::vector<double> class_values;   // (sorted) class of each index
+
+    int var_all;
+    int n_words;
+    int n_classes;  // 0 => regression
+};
+
+/******************************************************************************/
+
+#endif
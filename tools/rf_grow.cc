@@ -0,0 +1,235 @@
+// Example : grow more trees for a saved random forest (warm start)
+// usage: prog forest.yml labelled_data_file n_attributes n_more_trees grown_forest.yml [seed]
+
+// For use with any saved random forest (CvRTrees::save(), e.g. by rf_merge)
+// and test / training datasets (CSV text file, one sample per line of the
+// attributes followed by the class label, e.g. optdigits.tra)
+
+// Rather than training a larger forest from scratch, loads the saved forest
+// and trains only n_more_trees new trees with ParallelRTrees
+// (tools/parallel_rtrees.h) - on the same data or on new data of the same
+// attributes and classes, with the parameters the saved forest was trained
+// with - which are added after its trees (MergedRTrees::add(),
+// tools/merged_rtrees.h) and the whole saved. The new trees take the seeds
+// following those of the saved forest's trees (ParallelRTrees::first_tree),
+// so a ParallelRTrees forest grown from 100 to 200 trees on the same data is
+// the 200 tree forest trained at once - a different seed gives trees
+// independent of them. The out of bag error of the new trees is tracked as
+// they are grown and the forest's is kept as the tree weighted mean of the
+// saved forest's and theirs; its variable importance, if the saved forest
+// has one, is likewise combined with that of the new trees.
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "parallel_rtrees.h"
+#include "merged_rtrees.h"
+
+/*****************************************************************************/
+
+// loads a labelled sample file (CSV text file of n_attributes values then the
+// class label per line) of any number of samples - returns 0 on failure
+
+int read_labelled_data(const char* filename, int n_attributes, Mat& data, Mat& classes)
+{
+	FILE* f = fopen(filename, "r");
+	if (!f)
+	{
+		printf("ERROR: cannot read file %s\n", filename);
+		return 0; // all not OK
+	}
+
+	std::vector<float> values;
+	float tmp;
+	int n_values = 0;
+
+	while (fscanf(f, "%f,", &tmp) == 1)
+	{
+		values.push_back(tmp);
+		n_values++;
+	}
+	fclose(f);
+
+	if ((n_values == 0) || (n_values % (n_attributes + 1)))
+	{
+		printf("ERROR: %s is not %d attributes and a label per sample\n",
+		       filename, n_attributes);
+		return 0; // all not OK
+	}
+
+	int n_samples = n_values / (n_attributes + 1);
+	data = Mat(n_samples, n_attributes, CV_32FC1);
+	classes = Mat(n_samples, 1, CV_32FC1);
+
+	for (int i = 0; i < n_samples; i++)
+	{
+		const float* line = &values[(size_t) i * (n_attributes + 1)];
+		std::copy(line, line + n_attributes, data.ptr<float>(i));
+		classes.at<float>(i, 0) = line[n_attributes];
+	}
+
+	return 1; // all OK
+}
+
+/*****************************************************************************/
+
+// reports the out of bag error of the new trees (every 10th tree)
+
+void report_oob_error(int ntrees, float oob_error, void* /* user_data */)
+{
+	if ((ntrees % 10) == 0)
+	{
+		printf("  %d new trees : out of bag error %.4f%%\n", ntrees, oob_error * 100);
+	}
+}
+
+/*****************************************************************************/
+
+int main( int argc, char** argv )
+{
+	// check we have the command line arguments
+
+	if ((argc == 6) || (argc == 7))
+	{
+		int n_attributes = atoi(argv[3]);
+		int n_more_trees = atoi(argv[4]);
+
+		if ((n_attributes < 1) || (n_more_trees < 1))
+		{
+			printf("ERROR: need at least 1 attribute and 1 more tree\n");
+			return -1;
+		}
+
+		// load the saved forest
+
+		int64 start = getTickCount();
+
+		MergedRTrees* forest = new MergedRTrees;
+		std::vector<std::string> filenames(1, argv[1]);
+		if (!forest->merge(filenames))
+		{
+			delete forest;
+			return -1;
+		}
+
+		double load_time = (double) (getTickCount() - start) / getTickFrequency();
+
+		const CvDTreeTrainData* saved = forest->get_tree(0)->get_data();
+		if (saved->var_all != n_attributes)
+		{
+			printf("ERROR: the forest in %s is of %d attributes\n", argv[1], saved->var_all);
+			delete forest;
+			return -1;
+		}
+
+		int n_trees = forest->get_tree_count();
+		double saved_oob_error = forest->get_oob_error();
+
+		Mat data, classes;
+		if (!read_labelled_data(argv[2], n_attributes, data, classes))
+		{
+			delete forest;
+			return -1;
+		}
+
+		// define all the attributes as numerical (with a categorical output)
+
+		Mat var_type = Mat(n_attributes + 1, 1, CV_8U );
+		var_type.setTo(Scalar(CV_VAR_NUMERICAL) ); // all inputs are numerical
+		var_type.at<uchar>(n_attributes, 0) = CV_VAR_CATEGORICAL;
+
+		// the parameters the saved forest was trained with (its priors, and
+		// the number of variables its trees try at each split)
+
+		std::vector<float> priors;
+		for (int c = 0; saved->priors && (c < saved->priors->cols * saved->priors->rows); c++)
+		{
+			priors.push_back((float) cvGetReal1D(saved->priors, c));
+		}
+
+		CvRTParams params = CvRTParams(saved->params.max_depth, // max depth
+		                               saved->params.min_sample_count, // min sample count
+		                               saved->params.regression_accuracy, // regression accuracy
+		                               saved->params.use_surrogates, // compute surrogate split
+		                               saved->params.max_categories, // max number of categories
+		                               priors.empty() ? NULL : &priors[0], // the array of priors
+		                               forest->get_var_importance() != 0,  // calculate variable importance (if the saved forest has it)
+		                               cvCountNonZero(forest->get_active_var_mask()), // number of variables randomly selected at node and used to find the best split(s)
+		                               n_more_trees,	 // the new trees
+		                               0.01f,				// forrest accuracy
+		                               CV_TERMCRIT_ITER // termination cirteria (all of the trees)
+		                              );
+
+		// train the new trees (taking the seeds after those of the saved
+		// trees, tracking their out of bag error)
+
+		ParallelRTrees* more = new ParallelRTrees;
+		more->first_tree = n_trees;
+		if (argc == 7)
+		{
+			more->seed = (uint64) strtoull(argv[6], NULL, 0);
+		}
+		more->set_oob_callback(report_oob_error);
+
+		printf("Growing %d more trees for the %d of %s (%d samples, %d threads):\n",
+		       n_more_trees, n_trees, argv[1], data.rows, getNumThreads());
+
+		start = getTickCount();
+		more->train(data, CV_ROW_SAMPLE, classes, Mat(), Mat(), var_type, Mat(), params);
+		double train_time = (double) (getTickCount() - start) / getTickFrequency();
+
+		double more_oob_error = more->get_oob_errors().empty() ? 0 : more->get_oob_errors().back();
+
+		// add them to the forest (as a part written to a temporary file) and
+		// save the whole
+
+		start = getTickCount();
+
+		std::string temporary = std::string(argv[5]) + ".tmp";
+		more->save(temporary.c_str());
+		delete more;
+
+		bool added = forest->add(temporary);
+		remove(temporary.c_str());
+		if (!added)
+		{
+			delete forest;
+			return -1;
+		}
+		forest->save(argv[5]);
+
+		double save_time = (double) (getTickCount() - start) / getTickFrequency();
+
+		printf("%d + %d trees saved to %s: training %g s (load %g s, add and save %g s)\n",
+		       n_trees, n_more_trees, argv[5], train_time, load_time, save_time);
+		printf("out of bag error : saved trees %.4f%%, new trees %.4f%%, forest (estimated) %.4f%%, variable importance %s\n",
+		       saved_oob_error * 100, more_oob_error * 100, forest->get_oob_error() * 100,
+		       forest->get_var_importance() ? "combined" : "none");
+
+		delete forest;
+
+		// all matrix memory free by destructors
+
+		// all OK : main returns 0
+
+		return 0;
+	}
+
+	// not OK : main returns -1
+
+	printf("usage: %s forest.yml labelled_data_file n_attributes n_more_trees grown_forest.yml [seed]\n", argv[0]);
+	return -1;
+}
+/******************************************************************************/
@@ -0,0 +1,121 @@
+// Example : merge the parts of a random forest trained by several processes
+// usage: prog parts_dir n_workers merged_forest.yml [timeout_seconds]
+
+// For use with the part forests written by rf_shard
+
+// Waits (up to timeout_seconds, default 1 hour) for all n_workers part
+// forests to appear in parts_dir - each is renamed into place by its worker
+// once complete, so a part file that exists is a whole one - then merges
+// their trees into the one forest (tools/merged_rtrees.h: the out of bag
+// error and variable importance combined over the parts) and saves it as a
+// CvRTrees forest (read with CvRTrees::load(), e.g. by dt_profile).
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <vector>
+#include <string>
+
+#include "merged_rtrees.h"
+
+#define DEFAULT_TIMEOUT_SECONDS 3600
+
+/*****************************************************************************/
+
+// waits for all of the files to exist (polling every second) - returns the
+// number still missing at the timeout
+
+int wait_for_files(const std::vector<std::string>& filenames, int timeout_seconds)
+{
+	for (int waited = 0; ; waited++)
+	{
+		int missing = 0;
+		for (size_t p = 0; p < filenames.size(); p++)
+		{
+			missing += (access(filenames[p].c_str(), R_OK) != 0);
+		}
+
+		if ((missing == 0) || (waited >= timeout_seconds))
+		{
+			return missing;
+		}
+
+		if ((waited % 60) == 0)
+		{
+			printf("waiting for %d of %d parts ...\n", missing, (int) filenames.size());
+		}
+		sleep(1);
+	}
+}
+
+/*****************************************************************************/
+
+int main( int argc, char** argv )
+{
+	// check we have the command line arguments
+
+	if ((argc == 4) || (argc == 5))
+	{
+		int n_workers = atoi(argv[2]);
+		int timeout_seconds = (argc == 5) ? atoi(argv[4]) : DEFAULT_TIMEOUT_SECONDS;
+
+		if (n_workers < 1)
+		{
+			printf("ERROR: need at least 1 worker\n");
+			return -1;
+		}
+
+		std::vector<std::string> filenames;
+		for (int w = 0; w < n_workers; w++)
+		{
+			filenames.push_back(MergedRTrees::part_filename(argv[1], w, n_workers));
+		}
+
+		int missing = wait_for_files(filenames, timeout_seconds);
+		if (missing)
+		{
+			printf("ERROR: %d of %d parts missing after %d s\n", missing, n_workers,
+			       timeout_seconds);
+			return -1;
+		}
+
+		// merge and save the forest
+
+		int64 start = getTickCount();
+
+		MergedRTrees* forest = new MergedRTrees;
+		if (!forest->merge(filenames))
+		{
+			delete forest;
+			return -1;
+		}
+		forest->save(argv[3]);
+
+		double elapsed = (double) (getTickCount() - start) / getTickFrequency();
+
+		printf("merged %d parts: %d trees, out of bag error (estimated) %g, variable importance %s, saved to %s in %g s\n",
+		       forest->get_part_count(), forest->get_tree_count(), forest->get_oob_error(),
+		       forest->get_var_importance() ? "combined" : "none", argv[3], elapsed);
+
+		delete forest;
+
+		// all OK : main returns 0
+
+		return 0;
+	}
+
+	// not OK : main returns -1
+
+	printf("usage: %s parts_dir n_workers merged_forest.yml [timeout_seconds]\n", argv[0]);
+	return -1;
+}
+/******************************************************************************/
@@ -0,0 +1,208 @@
+// Example : train one part of a random forest in one of several processes
+// usage: prog labelled_data_file n_attributes n_trees worker n_workers output_dir [shard]
+
+// For use with any test / training datasets (CSV text file, one sample per
+// line of the attributes followed by the class label, e.g. optdigits.tra)
+
+// Each of n_workers processes training a random forest of n_trees trees (as
+// opticaldigits_ex/randomforest.cpp, with sqrt(n_attributes) variables tried
+// at each split) runs this as one worker (0 ... n_workers - 1), training its
+// own range of the trees with ParallelRTrees (tools/parallel_rtrees.h, on its
+// share of the cores) and saving them as a part forest in output_dir, for
+// rf_merge to merge into the one forest. The trees of each range take their
+// seeds in the whole forest, so the merged forest is that trained by a single
+// process whatever the number of workers. Given "shard" the worker trains on
+// only its shard of the data (the samples worker, worker + n_workers ...) -
+// each part is then a forest of less of the data. Each part is saved with
+// its out of bag error (on the samples it was trained on) and its variable
+// importance, which rf_merge combines over the parts.
+//
+// The part is written under a temporary name and renamed once complete
+// (tools/merged_rtrees.h), so the workers (and rf_merge) share nothing but
+// output_dir - e.g. on one machine:
+//
+//   for w in 0 1 2 3; do ./rf_shard optdigits.tra 64 100 $w 4 parts & done
+//   ./rf_merge parts 4 forest.yml
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+using namespace cv; // OpenCV API is in the C++ "cv" namespace
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+#include <string>
+#include <algorithm>
+
+#include "parallel_rtrees.h"
+#include "merged_rtrees.h"
+
+/*****************************************************************************/
+
+// loads a labelled sample file (CSV text file of n_attributes values then the
+// class label per line) of any number of samples, keeping every n_shards-th
+// sample from the first - returns 0 on failure
+
+int read_labelled_data(const char* filename, int n_attributes, int first, int n_shards,
+                       Mat& data, Mat& classes)
+{
+	FILE* f = fopen(filename, "r");
+	if (!f)
+	{
+		printf("ERROR: cannot read file %s\n", filename);
+		return 0; // all not OK
+	}
+
+	std::vector<float> values;
+	float tmp;
+	int n_values = 0;
+
+	while (fscanf(f, "%f,", &tmp) == 1)
+	{
+		values.push_back(tmp);
+		n_values++;
+	}
+	fclose(f);
+
+	if ((n_values == 0) || (n_values % (n_attributes + 1)))
+	{
+		printf("ERROR: %s is not %d attributes and a label per sample\n",
+		       filename, n_attributes);
+		return 0; // all not OK
+	}
+
+	int n_samples = (n_values / (n_attributes + 1) - first + n_shards - 1) / n_shards;
+	if (n_samples < 1)
+	{
+		printf("ERROR: %s has no samples in shard %d of %d\n", filename, first, n_shards);
+		return 0; // all not OK
+	}
+
+	data = Mat(n_samples, n_attributes, CV_32FC1);
+	classes = Mat(n_samples, 1, CV_32FC1);
+
+	for (int i = 0; i < n_samples; i++)
+	{
+		const float* line = &values[(size_t) (first + i * n_shards) * (n_attributes + 1)];
+		std::copy(line, line + n_attributes, data.ptr<float>(i));
+		classes.at<float>(i, 0) = line[n_attributes];
+	}
+
+	return 1; // all OK
+}
+
+/*****************************************************************************/
+
+// ParallelRTrees tracks the out of bag error only if it is asked for (or
+// stops on it) - the part's error is that of all of its trees, kept by the
+// forest, so there is nothing to do for each tree
+
+void track_oob_error(int /* ntrees */, float /* oob_error */, void* /* user_data */)
+{
+}
+
+/*****************************************************************************/
+
+int main( int argc, char** argv )
+{
+	// check we have the command line arguments
+
+	bool shard = (argc == 8) && !strcmp(argv[7], "shard");
+
+	if ((argc == 7) || shard)
+	{
+		int n_attributes = atoi(argv[2]);
+		int n_trees = atoi(argv[3]);
+		int worker = atoi(argv[4]);
+		int n_workers = atoi(argv[5]);
+		const char* output_dir = argv[6];
+
+		if ((n_attributes < 1) || (n_workers < 1) || (worker < 0) || (worker >= n_workers)
+		        || (n_trees < n_workers))
+		{
+			printf("ERROR: need 0 <= worker < n_workers <= n_trees\n");
+			return -1;
+		}
+
+		// this worker's range of the trees
+
+		int first_tree = (int) ((long long) n_trees * worker / n_workers);
+		int last_tree = (int) ((long long) n_trees * (worker + 1) / n_workers);
+
+		Mat data, classes;
+		if (!read_labelled_data(argv[1], n_attributes, shard ? worker : 0,
+		                        shard ? n_workers : 1, data, classes))
+		{
+			return -1;
+		}
+
+		// define all the attributes as numerical (with a categorical output)
+
+		Mat var_type = Mat(n_attributes + 1, 1, CV_8U );
+		var_type.setTo(Scalar(CV_VAR_NUMERICAL) ); // all inputs are numerical
+		var_type.at<uchar>(n_attributes, 0) = CV_VAR_CATEGORICAL;
+
+		CvRTParams params = CvRTParams(25, // max depth
+		                               5, // min sample count
+		                               0, // regression accuracy: N/A here
+		                               false, // compute surrogate split, no missing data
+		                               15, // max number of categories (use sub-optimal algorithm for larger numbers)
+		                               NULL, // the array of priors (all equal)
+		                               true,  // calculate variable importance
+		                               0,       // number of variables randomly selected at node and used to find the best split(s) (0 => sqrt(n_attributes))
+		                               last_tree - first_tree,	 // the trees of this worker
+		                               0.01f,				// forrest accuracy
+		                               CV_TERMCRIT_ITER // termination cirteria (all of the trees)
+		                              );
+
+		// train this worker's trees on its share of the cores
+
+		setNumThreads(MAX(getNumberOfCPUs() / n_workers, 1));
+
+		ParallelRTrees* forest = new ParallelRTrees;
+		forest->first_tree = first_tree;
+		forest->set_oob_callback(track_oob_error);
+
+		int64 start = getTickCount();
+		forest->train(data, CV_ROW_SAMPLE, classes, Mat(), Mat(), var_type, Mat(), params);
+		double elapsed = (double) (getTickCount() - start) / getTickFrequency();
+
+		// save the part (renamed once complete)
+
+		std::string filename = MergedRTrees::part_filename(output_dir, worker, n_workers);
+		std::string temporary = filename + ".tmp";
+
+		forest->save(temporary.c_str());
+		if (rename(temporary.c_str(), filename.c_str()))
+		{
+			printf("ERROR: cannot write %s\n", filename.c_str());
+			delete forest;
+			return -1;
+		}
+
+		printf("worker %d of %d: trees %d to %d (%d samples%s, %d threads) trained in %g s, out of bag error %.4f%%, saved to %s\n",
+		       worker, n_workers, first_tree, last_tree - 1, data.rows,
+		       shard ? ", a shard" : "", getNumThreads(), elapsed,
+		       forest->get_oob_errors().back() * 100, filename.c_str());
+
+		delete forest;
+
+		// all matrix memory free by destructors
+
+		// all OK : main returns 0
+
+		return 0;
+	}
+
+	// not OK : main returns -1
+
+	printf("usage: %s labelled_data_file n_attributes n_trees worker n_workers output_dir [shard]\n", argv[0]);
+	return -1;
+}
+/******************************************************************************/
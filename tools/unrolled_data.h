@@ -0,0 +1,137 @@
+// Support : "unrolled" view of a multiclass training set for 2-class boosting
+
+// To boost a problem of K classes with a 2-class learner each training
+// sample is "unrolled" into K samples, one per candidate class, each with an
+// extra attribute holding the candidate class label and a binary response of
+// whether it is the sample's class (see opticaldigits_ex/boosttree.cpp).
+// Copying the data this way holds every attribute K times over. UnrolledData
+// instead presents the unrolled samples as an index mapping onto the
+// original data, which is shared and not copied:
+//
+//   unrolled sample r = (training sample r / K, candidate class r % K)
+//
+// so that it costs one class index per original sample. A trainer that reads
+// the view (MulticlassBoost::train(), multiclass_boost.h) never materialises
+// the unrolled data - CvBoost itself can only be trained from a matrix, for
+// which copy_to() builds the same unrolled data as boosttree.cpp.
+//
+// The candidate classes are the distinct class labels of the training data
+// in increasing order (the digits 0 ... 9 for optdigits, as boosttree.cpp).
+
+// Copyright (c) 2013 Toby Breckon, toby.breckon@durham.ac.uk
+// School of Engineering and Computing Sciences, Durham University
+// License : LGPL - http://www.gnu.org/licenses/lgpl.html
+
+#ifndef UNROLLED_DATA_H
+#define UNROLLED_DATA_H
+
+#include <cv.h>       // opencv general include file
+#include <ml.h>		  // opencv machine learning include file
+
+#include <vector>
+#include <algorithm>
+
+/******************************************************************************/
+
+class UnrolledData
+{
+public:
+
+    // view of data = attributes (1 sample per row, CV_32F) and responses =
+    // integer class labels (1 sample per row, CV_32F) - the matrices are
+    // referenced, not copied, so must not change while the view is used
+
+    UnrolledData(const cv::Mat& _data, const cv::Mat& _responses)
+        : data(_data), nclasses(0)
+    {
+        CV_Assert((_data.type() == CV_32FC1) && (_responses.type() == CV_32FC1)
+                  && (_data.rows == (int) _responses.total()));
+
+        for (int i = 0; i < data.rows; i++)
+        {
+            labels.push_back(cvRound(_responses.at<float>(i)));
+        }
+        std::sort(labels.begin(), labels.end());
+        labels.erase(std::unique(labels.begin(), labels.end()), labels.end());
+        nclasses = (int) labels.size();
+
+        class_idx.resize(data.rows);
+        for (int i = 0; i < data.rows; i++)
+        {
+            class_idx[i] = (int) (std::lower_bound(labels.begin(), labels.end(),
+                                  cvRound(_responses.at<float>(i))) - labels.begin());
+        }
+    }
+
+    // the unrolled samples and their attributes (those of the original
+    // samples then the candidate class label)
+
+    int rows() const { return data.rows * nclasses; }
+    int cols() const { return data.cols + 1; }
+
+    // the original sample and candidate class (index) of unrolled sample r
+
+    int sample(int r) const { return r / nclasses; }
+    int candidate(int r) const { return r % nclasses; }
+
+    // attribute c of unrolled sample r
+
+    float at(int r, int c) const
+    {
+        return (c < data.cols) ? data.at<float>(sample(r), c)
+               : (float) labels[candidate(r)];
+    }
+
+    // the binary response of unrolled sample r (1 => its candidate class is
+    // the sample's class)
+
+    int response(int r) const
+    {
+        return class_idx[sample(r)] == candidate(r);
+    }
+
+    // materialise the unrolled data (rows() x cols(), CV_32F) and responses
+    // (rows() x 1, CV_32S) - e.g. to train CvBoost
+
+    void copy_to(cv::Mat& new_data, cv::Mat& new_responses) const
+    {
+        new_data.create(rows(), cols(), CV_32F);
+        new_responses.create(rows(), 1, CV_32S);
+
+        for (int r = 0; r < rows(); r++)
+        {
+            const float* src = data.ptr<float>(sample(r));
+            float* dst = new_data.ptr<float>(r);
+            std::copy(src, src + data.cols, dst);
+            dst[data.cols] = (float) labels[candidate(r)];
+
+            new_responses.at<int>(r, 0) = response(r);
+        }
+    }
+
+    // the original data and, per original sample, its class index
+
+    const cv::Mat& get_data() const { return data; }
+    int get_class_index(int i) const { return class_idx[i]; }
+
+    int get_class_count() const { return nclasses; }
+    int get_class_label(int k) const { return labels[k]; }
+
+    // memory of the view itself (excluding the original data it references)
+
+    size_t get_bytes() const
+    {
+        return sizeof(*this) + (labels.size() + class_idx.size()) * sizeof(int);
+    }
+
+private:
+
+    cv::Mat data;                   // the original attributes (shared)
+    std::vector<int> labels;        // class label of each candidate class
+    std::vector<int> class_idx;     // class index of each original sample
+    int nclasses;
+};
+
+/******************************************************************************/
+
+#endif